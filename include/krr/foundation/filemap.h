@@ -0,0 +1,59 @@
+#ifndef KRR_FILEMAP_h_
+#define KRR_FILEMAP_h_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Read-only view of whole content of a file.
+///
+/// On Linux and macOS, file is memory-mapped thus no copy is made.
+/// On other platforms (i.e. Android whose assets live inside apk), the whole file is read
+/// into a single heap buffer via SDL_RWops.
+///
+typedef struct
+{
+  /// content of file, NULL if file is empty
+  const void* data;
+
+  /// size in bytes of `data`
+  size_t size;
+
+  /// (internal) whether `data` is memory-mapped, otherwise it's heap allocated
+  bool mapped;
+} KRR_FILEMAP;
+
+///
+/// Check whether files can be memory-mapped on this platform.
+/// If not, KRR_FILEMAP_open() reads the whole file into memory.
+///
+/// \return true if files are memory-mapped, otherwise return false.
+///
+extern bool KRR_FILEMAP_can_map(void);
+
+///
+/// Open file and make its whole content available through `fm->data`.
+///
+/// \param fm pointer to KRR_FILEMAP to hold the result
+/// \param filepath path to file to open
+/// \return true if successfully opened, otherwise return false.
+///
+extern bool KRR_FILEMAP_open(KRR_FILEMAP* fm, const char* filepath);
+
+///
+/// Release content of opened file.
+/// After this call, `fm->data` cannot be accessed anymore.
+///
+/// \param fm pointer to KRR_FILEMAP
+///
+extern void KRR_FILEMAP_close(KRR_FILEMAP* fm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
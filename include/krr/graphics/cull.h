@@ -0,0 +1,186 @@
+#ifndef KRR_CULL_h_
+#define KRR_CULL_h_
+
+#include "krr/graphics/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Bounding volumes of mesh in its local space.
+///
+typedef struct
+{
+  /// axis-aligned bounding box
+  vec3 aabb_min;
+  vec3 aabb_max;
+
+  /// bounding sphere, centered at center of aabb
+  vec3 center;
+  float radius;
+} KRR_CULL_BOUNDS;
+
+///
+/// View frustum as 6 planes (left, right, bottom, top, near, far).
+/// Each plane is (a, b, c, d) with normal (a, b, c) pointing inside and normalized, so that
+/// a*x + b*y + c*z + d is signed distance of point to plane.
+///
+typedef struct
+{
+  vec4 planes[6];
+} KRR_CULL_FRUSTUM;
+
+///
+/// Bounding spheres in structure-of-arrays layout to be tested against frustum in batch.
+///
+typedef struct
+{
+  float* x;
+  float* y;
+  float* z;
+  float* radius;
+  int count;
+
+  /// (internally used)
+  int capacity;
+} KRR_CULL_SPHERES;
+
+///
+/// Counters of bounding volumes tested since last KRR_CULL_reset_stats().
+///
+typedef struct
+{
+  int tested;
+  int visible;
+  int culled;
+} KRR_CULL_STATS;
+
+///
+/// Compute bounds of vertices.
+///
+/// \param vertices vertices
+/// \param count number of vertices
+/// \param out result bounds, all zeros if there's no vertex
+///
+extern void KRR_CULL_bounds_from_vertices(const VERTEXTEXNORM3D* vertices, int count, KRR_CULL_BOUNDS* out);
+
+///
+/// Extract frustum planes from combined projection and view matrix.
+///
+/// Planes are in the space that matrix transforms from. Thus for projection * view, planes are in
+/// world space, and further multiplied with model matrix, planes are in that model's local space.
+///
+/// \param view_projection projection matrix multiplied by view matrix
+/// \param out result frustum
+///
+extern void KRR_CULL_extract_frustum(mat4 view_projection, KRR_CULL_FRUSTUM* out);
+
+///
+/// Test sphere against frustum.
+///
+/// \param frustum pointer to KRR_CULL_FRUSTUM
+/// \param center center of sphere
+/// \param radius radius of sphere
+/// \return true if sphere is inside or intersects frustum, otherwise return false.
+///
+extern bool KRR_CULL_test_sphere(const KRR_CULL_FRUSTUM* frustum, vec3 center, float radius);
+
+///
+/// Test axis-aligned bounding box against frustum.
+///
+/// \param frustum pointer to KRR_CULL_FRUSTUM
+/// \param aabb_min minimum corner of box
+/// \param aabb_max maximum corner of box
+/// \return true if box is inside or intersects frustum, otherwise return false.
+///
+extern bool KRR_CULL_test_aabb(const KRR_CULL_FRUSTUM* frustum, vec3 aabb_min, vec3 aabb_max);
+
+///
+/// Test bounds transformed by matrix against frustum.
+///
+/// \param frustum pointer to KRR_CULL_FRUSTUM
+/// \param bounds bounds in local space
+/// \param transform matrix to transform bounds into space of frustum
+/// \return true if bounds are visible, otherwise return false.
+///
+extern bool KRR_CULL_test_bounds(const KRR_CULL_FRUSTUM* frustum, const KRR_CULL_BOUNDS* bounds, mat4 transform);
+
+///
+/// Create a new KRR_CULL_SPHERES on heap.
+///
+/// \return Pointer to newly created KRR_CULL_SPHERES.
+///
+extern KRR_CULL_SPHERES* KRR_CULL_SPHERES_new(void);
+
+///
+/// Set number of spheres, arrays are grown when needed.
+/// Content of existing spheres is not preserved when grown.
+///
+/// \param spheres pointer to KRR_CULL_SPHERES
+/// \param count number of spheres
+///
+extern void KRR_CULL_SPHERES_resize(KRR_CULL_SPHERES* spheres, int count);
+
+///
+/// Free spheres.
+///
+/// \param spheres pointer to KRR_CULL_SPHERES
+///
+extern void KRR_CULL_SPHERES_free(KRR_CULL_SPHERES* spheres);
+
+///
+/// Set spheres from bounds transformed by matrices.
+/// Radius is scaled by the largest scale of matrix.
+///
+/// \param spheres pointer to KRR_CULL_SPHERES, it will be resized to `count`
+/// \param bounds array of bounds in local space
+/// \param bounds_stride bytes between consecutive bounds, or 0 to use the same bounds for all i.e. instances of a model
+/// \param transforms array of mat4
+/// \param transforms_stride bytes between consecutive matrices, i.e. sizeof(SIMPLEMODEL_INSTANCE) to use matrices in instances
+/// \param count number of spheres
+///
+extern void KRR_CULL_SPHERES_transform(KRR_CULL_SPHERES* spheres, const KRR_CULL_BOUNDS* bounds, size_t bounds_stride, const void* transforms, size_t transforms_stride, int count);
+
+///
+/// Test all spheres against frustum.
+///
+/// \param frustum pointer to KRR_CULL_FRUSTUM
+/// \param spheres pointer to KRR_CULL_SPHERES
+/// \param out_visible indices of visible spheres in ascending order, its size should be at least `spheres->count`
+/// \return number of visible spheres
+///
+extern int KRR_CULL_spheres(const KRR_CULL_FRUSTUM* frustum, const KRR_CULL_SPHERES* spheres, int* out_visible);
+
+///
+/// Transform bounds then test them against frustum, see KRR_CULL_SPHERES_transform() and KRR_CULL_spheres().
+///
+/// \param frustum pointer to KRR_CULL_FRUSTUM
+/// \param scratch spheres to hold transformed bounds, reuse it across calls to avoid allocation
+/// \param bounds array of bounds in local space
+/// \param bounds_stride bytes between consecutive bounds, or 0 to use the same bounds for all
+/// \param transforms array of mat4
+/// \param transforms_stride bytes between consecutive matrices
+/// \param count number of bounds to test
+/// \param out_visible indices of visible bounds in ascending order, its size should be at least `count`
+/// \return number of visible bounds
+///
+extern int KRR_CULL_batch(const KRR_CULL_FRUSTUM* frustum, KRR_CULL_SPHERES* scratch, const KRR_CULL_BOUNDS* bounds, size_t bounds_stride, const void* transforms, size_t transforms_stride, int count, int* out_visible);
+
+///
+/// Get counters of culling.
+///
+/// \return counters since last KRR_CULL_reset_stats()
+///
+extern const KRR_CULL_STATS* KRR_CULL_get_stats(void);
+
+///
+/// Reset counters to zero, i.e. call once at the start of every frame.
+///
+extern void KRR_CULL_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
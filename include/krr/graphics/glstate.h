@@ -0,0 +1,189 @@
+#ifndef KRR_GLSTATE_h_
+#define KRR_GLSTATE_h_
+
+#include "krr/graphics/common.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Shadow copy of GL state to filter out redundant state changes.
+///
+/// Library routes its binding of program, vertex array, buffers, textures, enabling of
+/// capabilities and setting of viewport through these functions. Call is issued to GL only
+/// when it changes state as known by the shadow copy, and state queries are answered from it
+/// without a round trip to GL.
+///
+/// Shadow copy starts as unknown thus first call of each state is always issued.
+/// Code that changes the same state by calling GL directly has to call KRR_GLSTATE_invalidate()
+/// afterwards, otherwise following calls might be wrongly filtered out.
+///
+
+/// maximum number of texture units tracked, binding on units beyond this is always issued
+#define KRR_GLSTATE_MAX_TEXTURE_UNITS 16
+
+///
+/// Number of issued and filtered calls of a kind of state.
+///
+typedef struct
+{
+  /// calls sent to GL
+  int issued;
+  /// calls dropped as state is already set
+  int filtered;
+} KRR_GLSTATE_COUNTER;
+
+///
+/// Counters of calls since last KRR_GLSTATE_reset_stats().
+///
+typedef struct
+{
+  KRR_GLSTATE_COUNTER program;
+  KRR_GLSTATE_COUNTER vertex_array;
+  KRR_GLSTATE_COUNTER buffer;
+  KRR_GLSTATE_COUNTER texture;
+  KRR_GLSTATE_COUNTER capability;
+  KRR_GLSTATE_COUNTER viewport;
+} KRR_GLSTATE_STATS;
+
+///
+/// Use program, similar to glUseProgram().
+///
+/// \param program_id program id, or 0 to use no program
+///
+extern void KRR_GLSTATE_use_program(GLuint program_id);
+
+///
+/// Get program currently in use.
+///
+/// \return program id, queried from GL if not known yet
+///
+extern GLuint KRR_GLSTATE_current_program(void);
+
+///
+/// Bind vertex array, similar to glBindVertexArray().
+/// As GL_ELEMENT_ARRAY_BUFFER binding is part of vertex array, it becomes unknown whenever
+/// vertex array is changed.
+///
+/// \param vao_id vertex array id, or 0 to unbind
+///
+extern void KRR_GLSTATE_bind_vertex_array(GLuint vao_id);
+
+///
+/// Bind buffer, similar to glBindBuffer().
+/// Only GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER and GL_UNIFORM_BUFFER are tracked, other targets
+/// are always issued.
+///
+/// \param target buffer target
+/// \param buffer_id buffer id, or 0 to unbind
+///
+extern void KRR_GLSTATE_bind_buffer(GLenum target, GLuint buffer_id);
+
+///
+/// Set active texture unit, similar to glActiveTexture().
+///
+/// \param texture_unit texture unit i.e. GL_TEXTURE0
+///
+extern void KRR_GLSTATE_active_texture(GLenum texture_unit);
+
+///
+/// Bind texture to active texture unit, similar to glBindTexture().
+/// Only GL_TEXTURE_2D and GL_TEXTURE_CUBE_MAP are tracked, other targets are always issued.
+///
+/// \param target texture target
+/// \param texture_id texture id, or 0 to unbind
+///
+extern void KRR_GLSTATE_bind_texture(GLenum target, GLuint texture_id);
+
+///
+/// Enable capability, similar to glEnable().
+/// Only GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_SCISSOR_TEST, GL_STENCIL_TEST,
+/// GL_POLYGON_OFFSET_FILL and GL_PRIMITIVE_RESTART_FIXED_INDEX are tracked, other capabilities
+/// are always issued.
+///
+/// \param cap capability to enable
+///
+extern void KRR_GLSTATE_enable(GLenum cap);
+
+///
+/// Disable capability, similar to glDisable().
+///
+/// \param cap capability to disable
+///
+extern void KRR_GLSTATE_disable(GLenum cap);
+
+///
+/// Check whether capability is enabled.
+///
+/// \param cap capability to check
+/// \return true if enabled, queried from GL if not known yet or not tracked
+///
+extern bool KRR_GLSTATE_is_enabled(GLenum cap);
+
+///
+/// Set viewport, similar to glViewport().
+///
+/// \param x lower left x position of viewport
+/// \param y lower left y position of viewport
+/// \param width width of viewport
+/// \param height height of viewport
+///
+extern void KRR_GLSTATE_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+///
+/// Get current viewport.
+///
+/// \param viewport returned viewport as of x, y, width, height. Queried from GL if not known yet.
+///
+extern void KRR_GLSTATE_get_viewport(GLint viewport[4]);
+
+///
+/// Delete buffers, and reset binding of any of them to 0 as GL does.
+///
+/// \param n number of buffers
+/// \param buffers buffer ids
+///
+extern void KRR_GLSTATE_delete_buffers(GLsizei n, const GLuint* buffers);
+
+///
+/// Delete vertex arrays, and reset binding of any of them to 0 as GL does.
+///
+/// \param n number of vertex arrays
+/// \param arrays vertex array ids
+///
+extern void KRR_GLSTATE_delete_vertex_arrays(GLsizei n, const GLuint* arrays);
+
+///
+/// Delete textures, and reset binding of any of them to 0 as GL does.
+///
+/// \param n number of textures
+/// \param textures texture ids
+///
+extern void KRR_GLSTATE_delete_textures(GLsizei n, const GLuint* textures);
+
+///
+/// Forget all known state, so following calls are issued and queries go to GL.
+/// Call it after GL state is changed without going through these functions, or GL context
+/// is re-created.
+///
+extern void KRR_GLSTATE_invalidate(void);
+
+///
+/// Get counters of issued and filtered calls.
+///
+/// \return counters since last KRR_GLSTATE_reset_stats()
+///
+extern const KRR_GLSTATE_STATS* KRR_GLSTATE_get_stats(void);
+
+///
+/// Reset counters, call it at the start of every frame to get per-frame counts.
+///
+extern void KRR_GLSTATE_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef KRR_HEIGHTMAP_h_
+#define KRR_HEIGHTMAP_h_
+
+#include "krr/graphics/common.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Grayscale heightmap decoded on CPU.
+///
+/// Unlike KRR_TEXTURE, loading it creates no GL objects, thus it can be loaded on any thread.
+/// Samples are always kept as 16-bit values regardless of precision of source image, 8-bit source
+/// is scaled up to cover the same range i.e. 255 becomes 65535.
+///
+typedef struct
+{
+  int width;
+  int height;
+
+  /// width * height samples row by row, 0 is the lowest and 65535 is the highest
+  GLushort* pixels;
+
+  /// number of bits per sample of source image, either 8 or 16
+  int source_bits;
+} KRR_HEIGHTMAP;
+
+/// maximum number of octaves of KRR_HEIGHTMAP_NOISE
+#define KRR_HEIGHTMAP_MAX_OCTAVES 16
+
+///
+/// Type of fractal noise summed over octaves.
+///
+typedef enum
+{
+  /// fractional brownian motion, rolling hills
+  KRR_HEIGHTMAP_NOISE_FBM,
+
+  /// ridged multifractal, sharp ridges and smooth valleys
+  KRR_HEIGHTMAP_NOISE_RIDGED
+} KRR_HEIGHTMAP_NOISE_TYPE;
+
+///
+/// Parameters of procedural heightmap, see KRR_HEIGHTMAP_generate_noise().
+///
+typedef struct
+{
+  KRR_HEIGHTMAP_NOISE_TYPE type;
+
+  /// the same seed always generates the same heightmap
+  uint32_t seed;
+
+  /// number of octaves, in range [1, KRR_HEIGHTMAP_MAX_OCTAVES]
+  int octaves;
+
+  /// frequency of the first octave in cycles per sample
+  float frequency;
+
+  /// multiplier of frequency from one octave to the next
+  float lacunarity;
+
+  /// multiplier of amplitude from one octave to the next
+  float gain;
+} KRR_HEIGHTMAP_NOISE;
+
+///
+/// Create a new KRR_HEIGHTMAP on heap.
+///
+/// \return Pointer to newly created KRR_HEIGHTMAP.
+///
+extern KRR_HEIGHTMAP* KRR_HEIGHTMAP_new(void);
+
+///
+/// Load heightmap from file.
+///
+/// Supported formats are
+/// - 8 or 16-bit grayscale .png, decoded directly to keep all 16 bits
+/// - any other image SDL_image can load, its red channel is used with 8-bit precision
+/// - .raw or .r16, headerless 16-bit little-endian samples of square heightmap, see KRR_HEIGHTMAP_load_raw16()
+///
+/// \param hm pointer to KRR_HEIGHTMAP
+/// \param path path to heightmap file
+/// \return true if load successfully, otherwise return false.
+///
+extern bool KRR_HEIGHTMAP_load(KRR_HEIGHTMAP* hm, const char* path);
+
+///
+/// Load heightmap from headerless file of 16-bit little-endian samples.
+///
+/// \param hm pointer to KRR_HEIGHTMAP
+/// \param path path to heightmap file
+/// \param width width of heightmap, or 0 along with `height` to treat it as square heightmap sized by file size
+/// \param height height of heightmap
+/// \return true if load successfully, otherwise return false.
+///
+extern bool KRR_HEIGHTMAP_load_raw16(KRR_HEIGHTMAP* hm, const char* path, int width, int height);
+
+///
+/// Set default parameters of procedural heightmap.
+/// It's fBm of 6 octaves with features of 256 samples at largest.
+///
+/// \param params pointer to KRR_HEIGHTMAP_NOISE
+/// \param seed seed of noise
+///
+extern void KRR_HEIGHTMAP_noise_defaults(KRR_HEIGHTMAP_NOISE* params, uint32_t seed);
+
+///
+/// Generate heightmap procedurally from seeded gradient noise.
+///
+/// Rows are split across worker threads. Every sample depends only on its position and `params`,
+/// thus result is identical for the same seed regardless of number of threads.
+/// Samples are stretched to cover the whole 16-bit range.
+///
+/// \param hm pointer to KRR_HEIGHTMAP
+/// \param width width of heightmap
+/// \param height height of heightmap
+/// \param params parameters of noise
+/// \return true if generated successfully, otherwise return false.
+///
+extern bool KRR_HEIGHTMAP_generate_noise(KRR_HEIGHTMAP* hm, int width, int height, const KRR_HEIGHTMAP_NOISE* params);
+
+///
+/// Free internals of heightmap.
+/// This will make it ready for a next loading call.
+///
+/// \param hm pointer to KRR_HEIGHTMAP
+///
+extern void KRR_HEIGHTMAP_free_internals(KRR_HEIGHTMAP* hm);
+
+///
+/// Free heightmap.
+///
+/// \param hm pointer to KRR_HEIGHTMAP
+///
+extern void KRR_HEIGHTMAP_free(KRR_HEIGHTMAP* hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
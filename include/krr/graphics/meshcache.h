@@ -0,0 +1,142 @@
+#ifndef KRR_MESHCACHE_h_
+#define KRR_MESHCACHE_h_
+
+#include "krr/graphics/common.h"
+#include "krr/foundation/filemap.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// current version of .krrmesh format, bump it whenever layout of file changes
+#define KRR_MESHCACHE_VERSION 3
+
+/// file extension appended to source file path to form its cache file path
+#define KRR_MESHCACHE_EXT ".krrmesh"
+
+///
+/// Header of .krrmesh file.
+///
+/// It's followed by `vertices_count` of VERTEXTEXNORM3D, then `indices_count` of indices
+/// each of `index_size` bytes. Vertices start right after header.
+/// All values are in native byte order.
+///
+typedef struct
+{
+  /// "KRRM"
+  char magic[4];
+  uint32_t version;
+
+  /// size in bytes of a single vertex, guard against layout change of VERTEXTEXNORM3D
+  uint32_t vertex_size;
+  /// size in bytes of a single index, 2 if all vertices can be addressed by 16-bit index, otherwise 4
+  uint32_t index_size;
+
+  uint32_t vertices_count;
+  uint32_t indices_count;
+
+  /// hash and size of source file this mesh is generated from
+  uint64_t source_hash;
+  uint64_t source_size;
+
+  /// flags used to load source file, see KRR_OBJLOADER_FLAG
+  uint32_t source_flags;
+
+  /// axis-aligned bounding box of all vertices
+  float aabb_min[3];
+  float aabb_max[3];
+
+  /// bounding sphere of all vertices, centered at center of aabb
+  float sphere_center[3];
+  float sphere_radius;
+
+  /// reserved, always 0. Also keeps size of header a multiple of 8 without implicit padding.
+  uint32_t reserved;
+} KRR_MESHCACHE_HEADER;
+
+///
+/// Mesh data ready to be uploaded to GPU.
+///
+/// Its vertices and indices either point directly into memory-mapped .krrmesh file, or
+/// to heap memory after parsing source file. Either way, they're valid until
+/// KRR_MESHCACHE_close() is called.
+///
+typedef struct
+{
+  KRR_MESHCACHE_HEADER header;
+
+  const VERTEXTEXNORM3D* vertices;
+  /// each index is of `header.index_size` bytes
+  const void* indices;
+  /// GL type of indices, either GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+  GLenum index_type;
+
+  /// (internally used)
+  KRR_FILEMAP fm;
+  VERTEXTEXNORM3D* owned_vertices;
+  GLuint* owned_indices;
+} KRR_MESHCACHE;
+
+///
+/// Compute hash of data as used for `source_hash`.
+///
+/// \param data pointer to data
+/// \param size size in bytes of data
+/// \return 64-bit hash value
+///
+extern uint64_t KRR_MESHCACHE_hash(const void* data, size_t size);
+
+///
+/// Load .krrmesh file.
+///
+/// \param mc pointer to KRR_MESHCACHE to hold the result
+/// \param filepath path to .krrmesh file
+/// \return true if file is valid and successfully loaded, otherwise return false.
+///
+extern bool KRR_MESHCACHE_load(KRR_MESHCACHE* mc, const char* filepath);
+
+///
+/// Load mesh from .obj file through its cache file.
+///
+/// Cache file is at `filepath` appended with KRR_MESHCACHE_EXT. If it exists and was generated
+/// from the same content of source file with the same `flags`, it will be used without parsing
+/// source file. Otherwise source file is parsed, then cache file is (re)written for next time.
+/// Failing to write cache file (i.e. read-only location) is not an error.
+///
+/// \param mc pointer to KRR_MESHCACHE to hold the result
+/// \param filepath path to .obj file
+/// \param flags combination of KRR_OBJLOADER_FLAG, or 0 for defaults
+/// \return true if successfully loaded, otherwise return false.
+///
+extern bool KRR_MESHCACHE_load_objfile(KRR_MESHCACHE* mc, const char* filepath, int flags);
+
+///
+/// Write mesh into .krrmesh file.
+/// Indices are stored as 16-bit when all vertices can be addressed by them.
+///
+/// \param filepath path to .krrmesh file to write
+/// \param source_hash hash of source file computed by KRR_MESHCACHE_hash()
+/// \param source_size size in bytes of source file
+/// \param source_flags flags used to load source file
+/// \param vertices vertices to write
+/// \param vertices_count number of vertices
+/// \param indices indices to write
+/// \param indices_count number of indices
+/// \return true if successfully written, otherwise return false.
+///
+extern bool KRR_MESHCACHE_write(const char* filepath, uint64_t source_hash, uint64_t source_size, int source_flags, const VERTEXTEXNORM3D* vertices, int vertices_count, const GLuint* indices, int indices_count);
+
+///
+/// Release mesh data.
+/// After this call, `mc->vertices` and `mc->indices` cannot be accessed anymore.
+///
+/// \param mc pointer to KRR_MESHCACHE
+///
+extern void KRR_MESHCACHE_close(KRR_MESHCACHE* mc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
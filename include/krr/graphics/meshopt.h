@@ -0,0 +1,122 @@
+#ifndef KRR_MESHOPT_h_
+#define KRR_MESHOPT_h_
+
+#include "krr/graphics/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// size of post-transform vertex cache used in analysis and optimization when not specified
+#define KRR_MESHOPT_CACHE_SIZE 16
+
+/// default threshold for KRR_MESHOPT_optimize_overdraw()
+#define KRR_MESHOPT_OVERDRAW_THRESHOLD 1.05f
+
+///
+/// Result of post-transform vertex cache analysis.
+///
+typedef struct
+{
+  /// number of vertices transformed
+  int misses;
+
+  /// average cache miss ratio, transformed vertices per triangle.
+  /// 3.0 is the worst, 0.5 is the best for a regular grid.
+  float acmr;
+
+  /// average transform to vertex ratio, transformed vertices per referenced vertex.
+  /// 1.0 is the best.
+  float atvr;
+} KRR_MESHOPT_CACHESTATS;
+
+///
+/// Simulate FIFO post-transform vertex cache for indexed triangle list.
+///
+/// \param indices indices of triangle list
+/// \param indices_count number of indices
+/// \param vertices_count number of vertices referenced by `indices`
+/// \param cache_size number of entries of simulated cache
+/// \param stats result of analysis
+///
+extern void KRR_MESHOPT_analyze_vertex_cache(const GLuint* indices, int indices_count, int vertices_count, int cache_size, KRR_MESHOPT_CACHESTATS* stats);
+
+///
+/// Reorder triangles in-place to improve post-transform vertex cache locality.
+///
+/// It uses Tom Forsyth's linear-speed vertex cache optimization which does not depend
+/// on exact cache size of the GPU.
+///
+/// \param indices indices of triangle list to reorder
+/// \param indices_count number of indices
+/// \param vertices_count number of vertices referenced by `indices`
+///
+extern void KRR_MESHOPT_optimize_vertex_cache(GLuint* indices, int indices_count, int vertices_count);
+
+///
+/// Reorder clusters of triangles in-place to reduce overdraw, while keeping vertex cache
+/// locality within each cluster. Call it after KRR_MESHOPT_optimize_vertex_cache().
+///
+/// Triangles are split into clusters where vertex cache efficiency allows, then clusters facing
+/// away from mesh center (thus likely to occlude others) are ordered first.
+///
+/// \param indices indices of triangle list to reorder
+/// \param indices_count number of indices
+/// \param vertices vertices referenced by `indices`
+/// \param vertices_count number of vertices
+/// \param threshold how much ACMR is allowed to get worse, i.e. 1.05 allows 5% worse. See KRR_MESHOPT_OVERDRAW_THRESHOLD.
+///
+extern void KRR_MESHOPT_optimize_overdraw(GLuint* indices, int indices_count, const VERTEXTEXNORM3D* vertices, int vertices_count, float threshold);
+
+///
+/// Reorder vertices in-place in order of their first use by `indices`, then remap `indices` accordingly.
+/// Vertices not referenced by any index are removed.
+///
+/// \param vertices vertices to reorder
+/// \param vertices_count number of vertices
+/// \param indices indices of triangle list to remap
+/// \param indices_count number of indices
+/// \return number of vertices after removing unreferenced ones
+///
+extern int KRR_MESHOPT_optimize_vertex_fetch(VERTEXTEXNORM3D* vertices, int vertices_count, GLuint* indices, int indices_count);
+
+///
+/// Quantize vertices into VERTEXTEXNORM3D_PACKED.
+///
+/// Positions are quantized against bounding box of all vertices, and texcoords against
+/// range of all texcoords, thus texcoords outside of [0,1] (i.e. repeating) are preserved.
+///
+/// \param vertices vertices to pack
+/// \param vertices_count number of vertices
+/// \param dst destination buffer to hold `vertices_count` of packed vertices
+/// \param dequant returned dequantization to be set to shader when rendering packed vertices
+///
+extern void KRR_MESHOPT_pack_vertices(const VERTEXTEXNORM3D* vertices, int vertices_count, VERTEXTEXNORM3D_PACKED* dst, VERTEXDEQUANT* dequant);
+
+///
+/// Quantize vertices into VERTEXTEXNORM3D_PACKED against existing dequantization,
+/// i.e. to update part of vertices packed by KRR_MESHOPT_pack_vertices().
+/// Values outside of range of `dequant` are clamped.
+///
+/// \param vertices vertices to pack
+/// \param vertices_count number of vertices
+/// \param dst destination buffer to hold `vertices_count` of packed vertices
+/// \param dequant dequantization to pack vertices against
+///
+extern void KRR_MESHOPT_pack_vertices_dequant(const VERTEXTEXNORM3D* vertices, int vertices_count, VERTEXTEXNORM3D_PACKED* dst, const VERTEXDEQUANT* dequant);
+
+///
+/// Pack normal into GL_INT_2_10_10_10_REV format.
+///
+/// \param x x component of unit normal
+/// \param y y component of unit normal
+/// \param z z component of unit normal
+/// \return packed normal
+///
+extern GLuint KRR_MESHOPT_pack_normal(float x, float y, float z);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
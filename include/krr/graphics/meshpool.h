@@ -0,0 +1,135 @@
+#ifndef KRR_MESHPOOL_h_
+#define KRR_MESHPOOL_h_
+
+#include "krr/graphics/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Range of elements inside pool's buffer.
+///
+typedef struct
+{
+  /// offset in number of elements
+  int offset;
+  /// number of elements
+  int count;
+} KRR_MESHPOOL_RANGE;
+
+///
+/// Ranges suballocated from pool for a single mesh.
+///
+typedef struct
+{
+  KRR_MESHPOOL_RANGE vertices;
+  KRR_MESHPOOL_RANGE indices;
+} KRR_MESHPOOL_ALLOC;
+
+///
+/// Pool of vertex and index buffers shared by many meshes of the same vertex layout.
+///
+/// Meshes are suballocated from a single vertex buffer and a single index buffer, thus they can
+/// share a single vao and be drawn by offset into index buffer without switching buffers.
+/// As OpenGL ES 3.0 has no draw call with base vertex, indices are rebased by offset of mesh's
+/// vertices when uploaded.
+///
+/// Free space is tracked as free list of ranges sorted by offset. Allocation takes the first range
+/// that fits, and releasing merges range back with its free neighbors.
+///
+typedef struct
+{
+  GLuint vbo_id;
+  GLuint ibo_id;
+
+  /// vao shared by meshes in this pool, 0 until created by the first user of pool i.e. SIMPLEMODEL.
+  /// It's deleted along with pool.
+  GLuint vao_id;
+
+  /// size in bytes of a single vertex
+  GLsizei vertex_size;
+  int vertices_capacity;
+  int indices_capacity;
+
+  /// GL type of indices in index buffer, GL_UNSIGNED_SHORT if all vertices can be addressed by it,
+  /// otherwise GL_UNSIGNED_INT
+  GLenum index_type;
+  /// size in bytes of a single index
+  GLsizei index_size;
+
+  /// (internally used) free ranges of vertices sorted by offset
+  KRR_MESHPOOL_RANGE* free_vertices;
+  int free_vertices_count;
+  int free_vertices_capacity;
+
+  /// (internally used) free ranges of indices sorted by offset
+  KRR_MESHPOOL_RANGE* free_indices;
+  int free_indices_count;
+  int free_indices_capacity;
+} KRR_MESHPOOL;
+
+///
+/// Create a new pool, and allocate its buffers on GPU.
+/// It requires GL context.
+///
+/// \param vertex_size size in bytes of a single vertex
+/// \param vertices_capacity maximum number of vertices in pool
+/// \param indices_capacity maximum number of indices in pool
+/// \return Newly created KRR_MESHPOOL
+///
+extern KRR_MESHPOOL* KRR_MESHPOOL_new(GLsizei vertex_size, int vertices_capacity, int indices_capacity);
+
+///
+/// Free pool and its buffers.
+/// Free all meshes allocated from this pool before freeing pool.
+///
+/// \param pool pointer to KRR_MESHPOOL
+///
+extern void KRR_MESHPOOL_free(KRR_MESHPOOL* pool);
+
+///
+/// Suballocate ranges of vertices and indices from pool.
+///
+/// \param pool pointer to KRR_MESHPOOL
+/// \param vertices_count number of vertices
+/// \param indices_count number of indices
+/// \param out returned ranges
+/// \return true if allocated successfully, otherwise return false if there's not enough free space.
+///
+extern bool KRR_MESHPOOL_alloc(KRR_MESHPOOL* pool, int vertices_count, int indices_count, KRR_MESHPOOL_ALLOC* out);
+
+///
+/// Return ranges back to pool.
+///
+/// \param pool pointer to KRR_MESHPOOL
+/// \param alloc ranges as returned from KRR_MESHPOOL_alloc()
+///
+extern void KRR_MESHPOOL_release(KRR_MESHPOOL* pool, const KRR_MESHPOOL_ALLOC* alloc);
+
+///
+/// Upload vertices into allocated range.
+///
+/// \param pool pointer to KRR_MESHPOOL
+/// \param alloc ranges as returned from KRR_MESHPOOL_alloc()
+/// \param vertices vertices of `vertex_size` bytes each, as many as allocated
+///
+extern void KRR_MESHPOOL_upload_vertices(KRR_MESHPOOL* pool, const KRR_MESHPOOL_ALLOC* alloc, const GLvoid* vertices);
+
+///
+/// Upload indices into allocated range.
+/// Indices are relative to mesh's own vertices, they're rebased by offset of allocated vertices
+/// and converted to pool's index type.
+///
+/// \param pool pointer to KRR_MESHPOOL
+/// \param alloc ranges as returned from KRR_MESHPOOL_alloc()
+/// \param indices indices as many as allocated
+/// \param index_size size in bytes of a single index of `indices`, either 2 or 4
+///
+extern void KRR_MESHPOOL_upload_indices(KRR_MESHPOOL* pool, const KRR_MESHPOOL_ALLOC* alloc, const GLvoid* indices, GLsizei index_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
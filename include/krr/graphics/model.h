@@ -2,11 +2,27 @@
 #define KRR_MODEL_h_
 
 #include "krr/graphics/common.h"
+#include "krr/graphics/meshpool.h"
+#include "krr/graphics/cull.h"
+#include "krr/graphics/occlusion.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+///
+/// Per-instance data for SIMPLEMODEL_render_instanced().
+///
+typedef struct
+{
+  /// model matrix of this instance
+  mat4 model_matrix;
+
+  /// clipped texture coordinate as of (min_u, max_u, min_v, max_v) to render sprite inside
+  /// sprite sheet, or all zeros to use texture coordinate as it is
+  vec4 clipped_texcoord;
+} SIMPLEMODEL_INSTANCE;
+
 typedef struct
 {
   /// (internally used)
@@ -16,10 +32,47 @@ typedef struct
   /// (internally used)
   GLuint* indices;
   int indices_count;
+  /// GL type of indices in index buffer, GL_UNSIGNED_SHORT for models which have fewer than 65536 vertices
+  GLenum index_type;
 
+  /// set to true before loading to upload vertices as VERTEXTEXNORM3D_PACKED, taking half of GPU memory.
+  /// Then set `dequant` to shader via KRR_TEXSHADERPROG3D_update_dequant() before rendering.
+  bool packed;
+  /// dequantization of packed vertices, identity if vertices are not packed
+  VERTEXDEQUANT dequant;
+
+  /// bounding volumes in model space, available after loading
+  KRR_CULL_BOUNDS bounds;
+
+  /// set before loading to suballocate mesh from pool instead of creating its own buffers.
+  /// Pool's vertex size has to match `packed` setting. Models in the same pool share buffers and vao,
+  /// so they can be rendered one after another without binding another vao.
+  /// Free model before freeing pool.
+  KRR_MESHPOOL* pool;
+  /// (internally used) whether mesh is currently allocated from `pool`
+  bool pooled;
+  /// (internally used)
+  KRR_MESHPOOL_ALLOC pool_alloc;
+  /// offset in bytes into index buffer to render from, 0 if model is not pooled
+  GLintptr indices_offset;
+
+  /// buffers and vao, these are of pool if model is pooled.
+  /// Instanced model has its own vao even if pooled.
   GLuint vbo_id;
   GLuint ibo_id;
   GLuint vao_id;
+
+  /// buffer of SIMPLEMODEL_INSTANCE, see SIMPLEMODEL_set_instances()
+  GLuint instance_vbo_id;
+  int instances_count;
+  /// (internally used)
+  int instances_capacity;
+
+  /// (internally used) scratch for SIMPLEMODEL_set_visible_instances()
+  KRR_CULL_SPHERES* cull_spheres;
+  int* visible_indices;
+  SIMPLEMODEL_INSTANCE* visible_instances;
+  int visible_capacity;
 } SIMPLEMODEL;
 
 ///
@@ -39,12 +92,36 @@ extern void SIMPLEMODEL_free_internals(SIMPLEMODEL* sm);
 ///
 /// Load model from .obj file.
 ///
+/// Parsed result is cached next to .obj file (see KRR_MESHCACHE_load_objfile()), and will be used
+/// instead of parsing again as long as .obj file is unchanged.
+/// Mesh is optimized for vertex cache, see KRR_OBJLOADER_FLAG_OPTIMIZE.
+///
 /// \param sm a pointer to SIMPLEMODEL
 /// \param filepath file path to an .obj file to load
 /// \return true if load successfully, otherwise return false.
 ///
 extern bool SIMPLEMODEL_load_objfile(SIMPLEMODEL* sm, const char* filepath);
 
+///
+/// Load model from .obj file with specified loader flags.
+/// See SIMPLEMODEL_load_objfile() for detail.
+///
+/// \param sm a pointer to SIMPLEMODEL
+/// \param filepath file path to an .obj file to load
+/// \param flags combination of KRR_OBJLOADER_FLAG, or 0 to load as-is
+/// \return true if load successfully, otherwise return false.
+///
+extern bool SIMPLEMODEL_load_objfile_ex(SIMPLEMODEL* sm, const char* filepath, int flags);
+
+///
+/// Load model from .krrmesh file.
+///
+/// \param sm a pointer to SIMPLEMODEL
+/// \param filepath file path to a .krrmesh file to load
+/// \return true if load successfully, otherwise return false.
+///
+extern bool SIMPLEMODEL_load_meshfile(SIMPLEMODEL* sm, const char* filepath);
+
 ///
 /// Unload current loaded model.
 /// This will make it ready for a next loading call.
@@ -61,6 +138,53 @@ extern void SIMPLEMODEL_unload(SIMPLEMODEL* sm);
 ///
 extern void SIMPLEMODEL_render(SIMPLEMODEL* sm);
 
+///
+/// Set instances to be rendered by SIMPLEMODEL_render_instanced().
+/// Instance buffer is allocated on first call, and grown when needed. Otherwise data is
+/// updated in-place, thus set only when instances change, not every frame.
+///
+/// \param sm pointer to SIMPLEMODEL
+/// \param instances instances to upload
+/// \param count number of instances
+///
+extern void SIMPLEMODEL_set_instances(SIMPLEMODEL* sm, const SIMPLEMODEL_INSTANCE* instances, int count);
+
+///
+/// Set only instances whose bounds are inside frustum to be rendered by SIMPLEMODEL_render_instanced().
+/// Unlike SIMPLEMODEL_set_instances(), it's meant to be called every frame as camera moves.
+///
+/// \param sm pointer to SIMPLEMODEL
+/// \param frustum frustum in the same space as instances' model matrices
+/// \param instances all instances
+/// \param count number of instances
+/// \return number of visible instances
+///
+extern int SIMPLEMODEL_set_visible_instances(SIMPLEMODEL* sm, const KRR_CULL_FRUSTUM* frustum, const SIMPLEMODEL_INSTANCE* instances, int count);
+
+///
+/// Same as SIMPLEMODEL_set_visible_instances(), then also leave out instances found occluded by
+/// occlusion queries of earlier frames. Instance `i` is object `first_object + i` of `occlusion`.
+///
+/// \param sm pointer to SIMPLEMODEL
+/// \param frustum frustum in the same space as instances' model matrices
+/// \param occlusion pointer to KRR_OCCLUSION, or NULL to skip occlusion culling
+/// \param first_object index of object in `occlusion` for the first instance
+/// \param view_projection matrix which `frustum` is extracted from
+/// \param instances all instances
+/// \param count number of instances
+/// \return number of visible instances
+///
+extern int SIMPLEMODEL_set_visible_instances_ex(SIMPLEMODEL* sm, const KRR_CULL_FRUSTUM* frustum, KRR_OCCLUSION* occlusion, int first_object, mat4 view_projection, const SIMPLEMODEL_INSTANCE* instances, int count);
+
+///
+/// Render all instances as set via SIMPLEMODEL_set_instances() in a single draw call.
+/// Bind instanced variant of shader, i.e. via KRR_TEXSHADERPROG3D_load_instanced_program(), and
+/// call glBindVertexArray(vao) before calling this function.
+///
+/// \param sm pointer to SIMPLEMODEL
+///
+extern void SIMPLEMODEL_render_instanced(SIMPLEMODEL* sm);
+
 ///
 /// Free a simple model.
 ///
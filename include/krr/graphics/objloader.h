@@ -7,10 +7,33 @@
 extern "C" {
 #endif
 
+enum KRR_OBJLOADER_FLAG
+{
+  /// merge v/vt/vn triples whose texcoord and normal values snap to the same point of a 1.0e-5 grid
+  /// even if they reference different vt/vn indices.
+  /// Values are rounded to the nearest multiple of 1.0e-5 and compared exactly, so two values closer than
+  /// that but on either side of a rounding boundary are not merged.
+  /// Without this flag, vertices are deduplicated by exact index triple only.
+  KRR_OBJLOADER_FLAG_MERGE_EPSILON     = 0x1,
+
+  /// reorder triangles for post-transform vertex cache, then reorder vertices in order of use.
+  /// See KRR_MESHOPT_optimize_vertex_cache() and KRR_MESHOPT_optimize_vertex_fetch().
+  KRR_OBJLOADER_FLAG_OPTIMIZE          = 0x2,
+
+  /// same as KRR_OBJLOADER_FLAG_OPTIMIZE, and additionally reorder clusters of triangles to reduce overdraw.
+  /// See KRR_MESHOPT_optimize_overdraw().
+  KRR_OBJLOADER_FLAG_OPTIMIZE_OVERDRAW = 0x4
+};
+
 ///
 /// Load .obj file then return result of formed vertices.
 /// Load vertex, texture coordinate and normals.
 ///
+/// Faces have to be in form of v/vt/vn. Polygon with more than 3 vertices is triangulated as a fan.
+/// Whole file is read at once and parsed in-place, there is no limit on line length.
+/// Large file is split into chunks parsed in parallel on worker threads (up to number of CPU cores),
+/// result is exactly the same as if it's parsed by a single thread.
+///
 /// \param filepath file path of .obj file to parse
 /// \param dst_vertices dynamically created buffer for vertices. You should free it when done using it. The type depends on type flag set.
 /// \param vertices_count number of vertices returned
@@ -20,6 +43,20 @@ extern "C" {
 ///
 extern int KRR_load_objfile(const char* filepath, VERTEXTEXNORM3D** dst_vertices, int* vertices_count, GLuint** dst_indices, int* indices_count);
 
+///
+/// Load .obj file with extra options then return result of formed vertices.
+/// See KRR_load_objfile() for detail.
+///
+/// \param filepath file path of .obj file to parse
+/// \param flags combination of KRR_OBJLOADER_FLAG, or 0 for defaults
+/// \param dst_vertices dynamically created buffer for vertices. You should free it when done using it.
+/// \param vertices_count number of vertices returned
+/// \param dst_indices dynamically created buffer for indices. You should free it when done using it.
+/// \param indices_count returned count of indices
+/// \return return 0 for success. Returned -1 if there's any error occurred.
+///
+extern int KRR_load_objfile_ex(const char* filepath, int flags, VERTEXTEXNORM3D** dst_vertices, int* vertices_count, GLuint** dst_indices, int* indices_count);
+
 #ifdef __cplusplus
 }
 #endif
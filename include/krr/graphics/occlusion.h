@@ -0,0 +1,157 @@
+#ifndef KRR_OCCLUSION_h_
+#define KRR_OCCLUSION_h_
+
+#include "krr/graphics/common.h"
+#include "krr/graphics/cull.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// number of frames a query can be in flight before its result is read
+#define KRR_OCCLUSION_FRAMES_IN_FLIGHT 3
+
+///
+/// Counters of the current frame, reset by KRR_OCCLUSION_begin_frame().
+///
+typedef struct
+{
+  /// queries issued by KRR_OCCLUSION_flush()
+  int issued;
+  /// results read from queries issued in earlier frames
+  int read;
+  /// objects reported as occluded by KRR_OCCLUSION_is_visible(), thus skipped
+  int skipped;
+} KRR_OCCLUSION_STATS;
+
+///
+/// (internally used) Occlusion state of a single object.
+///
+typedef struct
+{
+  /// ring of queries, one for each frame in flight
+  GLuint query_ids[KRR_OCCLUSION_FRAMES_IN_FLIGHT];
+  /// whether query is issued but its result is not read yet
+  bool pending[KRR_OCCLUSION_FRAMES_IN_FLIGHT];
+
+  /// the latest known result
+  bool visible;
+  /// frame object was last queued for query, -1 if never
+  int queued_frame;
+} KRR_OCCLUSION_OBJECT;
+
+///
+/// Occlusion culling by hardware occlusion queries against bounding boxes.
+///
+/// Bounding box of each object is rendered against depth buffer of what has been drawn in the frame
+/// with GL_ANY_SAMPLES_PASSED_CONSERVATIVE query. To not stall the pipeline, result is not waited for
+/// but read when it becomes available in later frames, typically a frame or two later.
+/// Thus visibility of an object lags behind by that many frames. Object which was not queried
+/// in the previous frame, i.e. it has just entered view frustum, is treated as visible.
+///
+/// Usage per frame
+/// 1. KRR_OCCLUSION_begin_frame()
+/// 2. for each object passing frustum culling, KRR_OCCLUSION_query(), then render it only if
+///    KRR_OCCLUSION_is_visible()
+/// 3. KRR_OCCLUSION_flush() after occluders i.e. terrain are rendered
+///
+/// It requires shared_occlusion_shaderprogram to be set.
+///
+typedef struct
+{
+  /// set to false to disable occlusion culling, all objects are visible then
+  bool enabled;
+
+  /// (internally used)
+  KRR_OCCLUSION_OBJECT* objects;
+  int objects_count;
+
+  /// (internally used) boxes queued in the current frame
+  mat4* box_matrices;
+  int* box_objects;
+  int boxes_count;
+
+  /// (internally used)
+  int frame;
+
+  /// unit cube
+  GLuint vbo_id;
+  GLuint ibo_id;
+  GLuint vao_id;
+
+  KRR_OCCLUSION_STATS stats;
+} KRR_OCCLUSION;
+
+///
+/// Create a new KRR_OCCLUSION for fixed number of objects.
+/// It requires GL context.
+///
+/// \param objects_count number of objects, each is referred to by its index
+/// \return Newly created KRR_OCCLUSION
+///
+extern KRR_OCCLUSION* KRR_OCCLUSION_new(int objects_count);
+
+///
+/// Free KRR_OCCLUSION and its queries.
+///
+/// \param occ pointer to KRR_OCCLUSION
+///
+extern void KRR_OCCLUSION_free(KRR_OCCLUSION* occ);
+
+///
+/// Read results of queries which became available, and start a new frame.
+/// It never waits for results.
+///
+/// \param occ pointer to KRR_OCCLUSION
+///
+extern void KRR_OCCLUSION_begin_frame(KRR_OCCLUSION* occ);
+
+///
+/// Queue bounding box of object to be queried by KRR_OCCLUSION_flush().
+/// Object whose box crosses near plane is visible right away without query, as camera is (nearly) inside it.
+///
+/// \param occ pointer to KRR_OCCLUSION
+/// \param object index of object
+/// \param bounds bounds of object in its local space
+/// \param mvp projection * view * model matrix of object
+///
+extern void KRR_OCCLUSION_query(KRR_OCCLUSION* occ, int object, const KRR_CULL_BOUNDS* bounds, mat4 mvp);
+
+///
+/// Get visibility of object as of the latest available result.
+///
+/// \param occ pointer to KRR_OCCLUSION
+/// \param object index of object
+/// \return true if object should be rendered, otherwise return false.
+///
+extern bool KRR_OCCLUSION_is_visible(KRR_OCCLUSION* occ, int object);
+
+///
+/// Query objects then keep only visible ones, see KRR_OCCLUSION_query() and KRR_OCCLUSION_is_visible().
+/// Object of `indices[i]` is `first_object + indices[i]`.
+///
+/// \param occ pointer to KRR_OCCLUSION
+/// \param first_object index of object for transforms[0]
+/// \param bounds bounds shared by all objects in their local space
+/// \param view_projection projection * view matrix
+/// \param transforms array of model matrix
+/// \param transforms_stride bytes between consecutive matrices, i.e. sizeof(SIMPLEMODEL_INSTANCE)
+/// \param indices indices into `transforms` to test, i.e. as returned from KRR_CULL_batch(). It's compacted in-place to visible ones.
+/// \param count number of indices
+/// \return number of visible indices
+///
+extern int KRR_OCCLUSION_cull(KRR_OCCLUSION* occ, int first_object, const KRR_CULL_BOUNDS* bounds, mat4 view_projection, const void* transforms, size_t transforms_stride, int* indices, int count);
+
+///
+/// Issue queries for all queued boxes against the current depth buffer.
+/// Color and depth writes are disabled while rendering boxes, then enabled back.
+///
+/// \param occ pointer to KRR_OCCLUSION
+///
+extern void KRR_OCCLUSION_flush(KRR_OCCLUSION* occ);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
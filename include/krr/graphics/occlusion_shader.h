@@ -0,0 +1,87 @@
+#ifndef KRR_OCCLUSIONSHADERPROG_h_
+#define KRR_OCCLUSIONSHADERPROG_h_
+
+#include "krr/graphics/common.h"
+#include "krr/graphics/shaderprog.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Shader-program to render bounding boxes for occlusion queries, it writes depth only.
+///
+typedef struct KRR_OCCLUSIONSHADERPROG_S
+{
+  // underlying shader program
+  KRR_SHADERPROG* program;
+
+  // attribute location
+  GLint vertex_pos3d_location;
+
+  // matrix to transform unit cube into bounding box in clip space
+  mat4 box_matrix;
+  GLint box_matrix_location;
+
+} KRR_OCCLUSIONSHADERPROG;
+
+/// shared occlusion shader-program
+extern KRR_OCCLUSIONSHADERPROG* shared_occlusion_shaderprogram;
+
+///
+/// Create a new occlusion shader-program
+///
+/// \return newly created occlusion shader-program on heap
+///
+extern KRR_OCCLUSIONSHADERPROG* KRR_OCCLUSIONSHADERPROG_new(void);
+
+///
+/// Free occlusion shader-program.
+///
+/// \param program occlusion shader-program to free
+///
+extern void KRR_OCCLUSIONSHADERPROG_free(KRR_OCCLUSIONSHADERPROG* program);
+
+///
+/// Load occlusion shader-program
+///
+/// \param program occlusion shader-program to load
+/// \return true if load successfully, otherwise return false.
+///
+extern bool KRR_OCCLUSIONSHADERPROG_load_program(KRR_OCCLUSIONSHADERPROG* program);
+
+///
+/// Update box matrix
+/// set box matrix (see header) first then call this function to update to GPU
+///
+/// \param program occlusion shader-program
+///
+extern void KRR_OCCLUSIONSHADERPROG_update_box_matrix(KRR_OCCLUSIONSHADERPROG* program);
+
+///
+/// set vertex pointer
+///
+/// \param program pointer to KRR_OCCLUSIONSHADERPROG
+/// \param stride space in bytes to the next attribute in the next element
+/// \param data opaque pointer to data buffer offset
+///
+extern void KRR_OCCLUSIONSHADERPROG_set_vertex_pointer(KRR_OCCLUSIONSHADERPROG* program, GLsizei stride, const GLvoid* data);
+
+///
+/// enable all attribute pointers
+///
+/// \param program pointer to KRR_OCCLUSIONSHADERPROG
+///
+extern void KRR_OCCLUSIONSHADERPROG_enable_attrib_pointers(KRR_OCCLUSIONSHADERPROG* program);
+
+/// disable all attribute pointers
+///
+/// \param program pointer to KRR_OCCLUSIONSHADERPROG
+///
+extern void KRR_OCCLUSIONSHADERPROG_disable_attrib_pointers(KRR_OCCLUSIONSHADERPROG* program);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef KRR_RENDERQUEUE_h_
+#define KRR_RENDERQUEUE_h_
+
+#include "krr/graphics/common.h"
+#include "krr/graphics/shaderprog.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// maximum number of texture units a single packet can bind
+#define KRR_RENDERQUEUE_MAX_TEXTURES 4
+
+///
+/// Function to set uniforms of a packet after its program is bound.
+///
+/// \param uniforms `uniforms` as set in KRR_RENDERQUEUE_PACKET
+///
+typedef void (*KRR_RENDERQUEUE_UNIFORMS_FUNC)(const void* uniforms);
+
+///
+/// Single draw call to be submitted to KRR_RENDERQUEUE.
+///
+typedef struct
+{
+  /// shader program to use
+  KRR_SHADERPROG* program;
+  /// vao to bind, it should already have index buffer bound to it for indexed drawing
+  GLuint vao_id;
+  /// texture to bind to each texture unit of GL_TEXTURE_2D, 0 to leave such unit as it is
+  GLuint textures[KRR_RENDERQUEUE_MAX_TEXTURES];
+
+  /// function to set uniforms for this packet, or NULL if not needed
+  KRR_RENDERQUEUE_UNIFORMS_FUNC apply_uniforms;
+  /// data passed to `apply_uniforms`, it has to be valid until KRR_RENDERQUEUE_flush() returns
+  const void* uniforms;
+
+  /// primitive mode i.e. GL_TRIANGLES
+  GLenum mode;
+  /// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT for indexed drawing, or 0 for non-indexed drawing
+  GLenum index_type;
+  /// offset in bytes into index buffer for indexed drawing, or first vertex for non-indexed drawing
+  GLsizeiptr offset;
+  /// number of indices (or vertices for non-indexed drawing) to draw
+  int count;
+  /// number of instances to draw, 0 for non-instanced draw call
+  int instances_count;
+
+  /// distance from camera used to order packets, negative value is treated as 0
+  float depth;
+  /// true if packet needs blending thus it will be rendered after all opaque ones in back-to-front order,
+  /// otherwise it's opaque and will be rendered in front-to-back order after grouped by state
+  bool alpha;
+} KRR_RENDERQUEUE_PACKET;
+
+///
+/// Counters of state changes as of latest KRR_RENDERQUEUE_flush().
+///
+typedef struct
+{
+  int draws;
+
+  int program_binds;
+  int vao_binds;
+  int texture_binds;
+
+  /// number of binds skipped as such state is already bound, compared to binding all states for every packet
+  int program_binds_avoided;
+  int vao_binds_avoided;
+  int texture_binds_avoided;
+} KRR_RENDERQUEUE_STATS;
+
+/// (internally used)
+/// sort key of packet at `index`
+typedef struct
+{
+  uint64_t key;
+  int index;
+} KRR_RENDERQUEUE_ITEM;
+
+///
+/// Queue of draw calls sorted to minimize GL state changes.
+///
+/// Each packet is given 64-bit sort key when submitted. Opaque packets are keyed by program,
+/// texture, vao then depth, and alpha packets by inverted depth then program, texture and vao.
+/// All packets are radix sorted by their key when flushed.
+///
+typedef struct
+{
+  KRR_RENDERQUEUE_STATS stats;
+
+  /// (internally used)
+  KRR_RENDERQUEUE_PACKET* packets;
+  /// (internally used)
+  KRR_RENDERQUEUE_ITEM* items;
+  /// (internally used)
+  /// scratch buffer for radix sort
+  KRR_RENDERQUEUE_ITEM* items_temp;
+  /// (internally used)
+  int count;
+  /// (internally used)
+  int capacity;
+} KRR_RENDERQUEUE;
+
+///
+/// Create a new render queue.
+///
+/// \return Newly created KRR_RENDERQUEUE
+///
+extern KRR_RENDERQUEUE* KRR_RENDERQUEUE_new(void);
+
+///
+/// Submit packet to be rendered at next KRR_RENDERQUEUE_flush().
+/// Packet is copied, thus it can be reused after this call.
+///
+/// \param rq pointer to KRR_RENDERQUEUE
+/// \param packet packet to submit
+///
+extern void KRR_RENDERQUEUE_submit(KRR_RENDERQUEUE* rq, const KRR_RENDERQUEUE_PACKET* packet);
+
+///
+/// Sort then render all submitted packets, then clear the queue.
+///
+/// Binding of program, vao and textures are only issued when changed from previous packet.
+/// After this call, vao is unbound and active texture unit is GL_TEXTURE0, but the last program
+/// and textures are left bound.
+///
+/// \param rq pointer to KRR_RENDERQUEUE
+///
+extern void KRR_RENDERQUEUE_flush(KRR_RENDERQUEUE* rq);
+
+///
+/// Remove all submitted packets without rendering them.
+///
+/// \param rq pointer to KRR_RENDERQUEUE
+///
+extern void KRR_RENDERQUEUE_clear(KRR_RENDERQUEUE* rq);
+
+///
+/// Free render queue.
+///
+/// \param rq pointer to KRR_RENDERQUEUE
+///
+extern void KRR_RENDERQUEUE_free(KRR_RENDERQUEUE* rq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
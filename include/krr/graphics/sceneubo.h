@@ -0,0 +1,130 @@
+#ifndef KRR_SCENEUBO_h_
+#define KRR_SCENEUBO_h_
+
+#include "krr/graphics/common.h"
+#include "krr/graphics/shaderprog.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// uniform buffer binding point of `camera_block` in all 3D shaders
+#define KRR_SCENEUBO_CAMERA_BINDING 0
+/// uniform buffer binding point of `lights_block` in all 3D shaders
+#define KRR_SCENEUBO_LIGHTS_BINDING 1
+
+///
+/// Per-frame camera data, laid out as std140 `camera_block` in shaders.
+///
+typedef struct
+{
+  mat4 projection_matrix;
+  mat4 view_matrix;
+
+  /// (computed from view_matrix when updated)
+  /// xyz is camera position in world space
+  vec4 camera_position;
+
+  /// rgb is sky color which fog fades into, default to (0.5, 0.5, 0.5)
+  vec4 sky_color;
+
+  /// 1.0 if fog is enabled, otherwise 0.0. Default to 0.0.
+  /// avoid using boolean type as it's not guarunteed to be supported by graphics card
+  GLfloat fog_enabled;
+  GLfloat fog_density;
+  GLfloat fog_gradient;
+  /// (internally used)
+  GLfloat padding;
+} KRR_SCENEUBO_CAMERA;
+
+///
+/// Light set, laid out as std140 `lights_block` in shaders.
+///
+typedef struct
+{
+  /// xyz is position of light
+  vec4 position[KRR_SHADERPROG_MAX_LIGHTS];
+  /// rgb is color of light, a is its attenuation factor
+  vec4 color[KRR_SHADERPROG_MAX_LIGHTS];
+
+  /// rgb is ambient color, default to (1.0, 1.0, 1.0)
+  vec4 ambient_color;
+
+  /// number of lights to be used by shaders
+  GLint num;
+  /// (internally used)
+  GLint padding[3];
+} KRR_SCENEUBO_LIGHTS;
+
+///
+/// Uniform buffers shared by all 3D shaders.
+///
+/// They are bound to KRR_SCENEUBO_CAMERA_BINDING and KRR_SCENEUBO_LIGHTS_BINDING, and all 3D shaders
+/// read from such binding points. Thus updating it once per frame is enough no matter how many
+/// shaders are used.
+///
+typedef struct
+{
+  KRR_SCENEUBO_CAMERA camera;
+  KRR_SCENEUBO_LIGHTS lights;
+
+  /// (internally used)
+  GLuint camera_buffer_id;
+  /// (internally used)
+  GLuint lights_buffer_id;
+} KRR_SCENEUBO;
+
+///
+/// Create uniform buffers, and bind them to their binding points.
+/// It requires GL context.
+///
+/// \return Newly created KRR_SCENEUBO
+///
+extern KRR_SCENEUBO* KRR_SCENEUBO_new(void);
+
+///
+/// Free uniform buffers.
+///
+/// \param ubo pointer to KRR_SCENEUBO
+///
+extern void KRR_SCENEUBO_free(KRR_SCENEUBO* ubo);
+
+///
+/// Update camera data
+/// set camera data first (see header) then call this function to update to GPU.
+///
+/// \param ubo pointer to KRR_SCENEUBO
+///
+extern void KRR_SCENEUBO_update_camera(KRR_SCENEUBO* ubo);
+
+///
+/// Update light set
+/// set lights first (see header) then call this function to update to GPU.
+///
+/// \param ubo pointer to KRR_SCENEUBO
+///
+extern void KRR_SCENEUBO_update_lights(KRR_SCENEUBO* ubo);
+
+///
+/// Set light at index of light set.
+/// Call KRR_SCENEUBO_update_lights() afterwards to update to GPU.
+///
+/// \param ubo pointer to KRR_SCENEUBO
+/// \param index index of light, from 0 to KRR_SHADERPROG_MAX_LIGHTS-1
+/// \param light light to set
+///
+extern void KRR_SCENEUBO_set_light(KRR_SCENEUBO* ubo, int index, const LIGHT* light);
+
+///
+/// Connect `camera_block` and `lights_block` of linked program to their binding points.
+/// It's called when loading every 3D shader program.
+///
+/// \param program_id program id
+///
+extern void KRR_SCENEUBO_bind_blocks(GLuint program_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
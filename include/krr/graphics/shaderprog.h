@@ -13,10 +13,63 @@ extern "C" {
 ///
 #define KRR_SHADERPROG_MAX_LIGHTS 4
 
+///
+/// Number of uniforms cache of shader program is allocated for at first, it grows as needed.
+///
+#define KRR_SHADERPROG_INITIAL_UNIFORMS 16
+
+///
+/// Maximum size of uniform value in number of floats or ints stored within cache entry, enough for a mat4.
+/// Larger values are stored on heap.
+///
+#define KRR_SHADERPROG_UNIFORM_MAX_COMPONENTS 16
+
+///
+/// Cached value of a uniform.
+///
+typedef struct
+{
+  GLint location;
+  /// one of GL_FLOAT, GL_FLOAT_VEC2, GL_FLOAT_VEC3, GL_FLOAT_VEC4, GL_FLOAT_MAT4 and GL_INT
+  GLenum type;
+  /// number of array elements
+  GLsizei count;
+  /// whether value has to be uploaded on next flush
+  bool dirty;
+
+  union
+  {
+    GLfloat f[KRR_SHADERPROG_UNIFORM_MAX_COMPONENTS];
+    GLint i[KRR_SHADERPROG_UNIFORM_MAX_COMPONENTS];
+  } value;
+  /// value larger than KRR_SHADERPROG_UNIFORM_MAX_COMPONENTS, otherwise NULL
+  GLfloat* large_value;
+} KRR_SHADERPROG_UNIFORM;
+
+///
+/// Number of uniform uploads issued and skipped.
+///
+typedef struct
+{
+  /// uploads sent to GL
+  int uploaded;
+  /// values set but not uploaded as they're the same as already set
+  int skipped;
+} KRR_SHADERPROG_UNIFORM_STATS;
+
 typedef struct
 {
   // program id
   GLuint program_id;
+
+  /// (internally used) cached uniforms
+  KRR_SHADERPROG_UNIFORM* uniforms;
+  /// (internally used) number of cached uniforms
+  int uniforms_count;
+  /// (internally used) number of uniforms `uniforms` is allocated for
+  int uniforms_capacity;
+  /// (internally used) whether any cached uniform is dirty
+  bool dirty;
 } KRR_SHADERPROG;
 
 ///
@@ -64,6 +117,47 @@ extern bool KRR_SHADERPROG_bind(KRR_SHADERPROG* shader_program);
 ///
 extern void KRR_SHADERPROG_unbind(KRR_SHADERPROG* shader_program);
 
+///
+/// Set value of uniform.
+/// Value is cached, and marked dirty only when it's different from what was set before. Dirty
+/// values are uploaded on KRR_SHADERPROG_flush(), on bind and unbind of program, and by library
+/// before it draws. Thus program doesn't need to be bound when calling this function.
+/// Cache grows to hold every uniform set, of any size, so no value is ever uploaded right away.
+///
+/// \param shader_program Pointer to KRR_SHADERPROG
+/// \param location uniform location, -1 is silently ignored as GL does
+/// \param type one of GL_FLOAT, GL_FLOAT_VEC2, GL_FLOAT_VEC3, GL_FLOAT_VEC4, GL_FLOAT_MAT4 and GL_INT
+/// \param count number of array elements
+/// \param value pointer to values of GLfloat, or GLint for GL_INT
+///
+extern void KRR_SHADERPROG_set_uniform(KRR_SHADERPROG* shader_program, GLint location, GLenum type, GLsizei count, const GLvoid* value);
+
+///
+/// Upload dirty uniforms.
+/// Program has to be in use.
+///
+/// \param shader_program Pointer to KRR_SHADERPROG
+///
+extern void KRR_SHADERPROG_flush(KRR_SHADERPROG* shader_program);
+
+///
+/// Upload dirty uniforms of program bound via KRR_SHADERPROG_bind() if it's still in use.
+/// Library calls this before it draws.
+///
+extern void KRR_SHADERPROG_flush_bound(void);
+
+///
+/// Get counters of uniform uploads.
+///
+/// \return counters since last KRR_SHADERPROG_reset_uniform_stats()
+///
+extern const KRR_SHADERPROG_UNIFORM_STATS* KRR_SHADERPROG_get_uniform_stats(void);
+
+///
+/// Reset counters of uniform uploads, call it at the start of every frame to get per-frame counts.
+///
+extern void KRR_SHADERPROG_reset_uniform_stats(void);
+
 ///
 /// Print out log for input program id (or say program name).
 ///
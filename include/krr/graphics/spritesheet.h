@@ -20,6 +20,9 @@ typedef struct
   /// (internal use)
   GLuint* index_buffers;
   /// (internal use)
+  /// GL type of indices in index buffers
+  GLenum index_type;
+  /// (internal use)
   GLuint vao;
 } KRR_SPRITESHEET;
 
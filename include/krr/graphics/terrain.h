@@ -2,11 +2,50 @@
 #define KRR_TERRAIN_h_
 
 #include "krr/graphics/common.h"
+#include "krr/graphics/cull.h"
+#include "krr/graphics/heightmap.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/// number of cells along each side of a chunk, must be power of two
+#define KRR_TERRAIN_CHUNK_CELLS 64
+
+/// number of LOD levels of chunk, level l renders every (1 << l)-th vertex of full resolution
+#define KRR_TERRAIN_LODS 7
+
+/// upper limit of number of levels of min/max height quadtree, enough for any grid addressable by int
+#define KRR_TERRAIN_MINMAX_LEVELS 32
+
+/// (internally used) state of paged terrain, see KRR_TERRAIN_load_paged()
+typedef struct TERRAIN_PAGING TERRAIN_PAGING;
+
+///
+/// Fixed-size square part of terrain, with skirts hanging down along its edges to hide cracks
+/// between neighbouring chunks rendered at different LOD levels.
+/// All chunks share the same index buffer of each LOD level, as their vertices are laid out the same way.
+///
+typedef struct
+{
+  /// vao whose vertex attributes start at first vertex of this chunk
+  GLuint vao_id;
+
+  /// bounding volumes of chunk in terrain's space
+  KRR_CULL_BOUNDS bounds;
+
+  /// first cell of chunk in grid
+  int cell_x;
+  int cell_z;
+  /// how far skirts hang down below edges
+  float skirt_depth;
+
+  /// maximum height error of each LOD level against full resolution, in terrain's space
+  float lod_errors[KRR_TERRAIN_LODS];
+  /// LOD level chunk was rendered with the last time
+  int lod;
+} TERRAIN_CHUNK;
+
 typedef struct
 {
   /// (internally used)
@@ -16,6 +55,62 @@ typedef struct
   /// (internally used)
   GLuint* indices;
   int indices_count;
+  /// GL type of indices in index buffer
+  GLenum index_type;
+
+  /// chunks to be rendered one by one, or NULL if terrain is rendered in one go.
+  /// note: only terrain loaded via KRR_TERRAIN_load_from_generation() is split into chunks.
+  /// For paged terrain, these are chunks currently resident in no particular order.
+  TERRAIN_CHUNK* chunks;
+  int chunks_count;
+
+  /// (internally used) range of each LOD level in index buffer, offset in bytes
+  GLsizeiptr lod_indices_offset[KRR_TERRAIN_LODS];
+  int lod_indices_count[KRR_TERRAIN_LODS];
+  /// (internally used) GL primitive mode indices of LOD levels are drawn with
+  GLenum lod_indices_mode;
+
+  /// set to true before loading via KRR_TERRAIN_load_from_generation() to lay out indices of each LOD level
+  /// as triangle strips, one per row of cells joined by primitive restart index 0xffff,
+  /// taking about a third of index buffer of independent triangles.
+  /// GL_PRIMITIVE_RESTART_FIXED_INDEX is enabled via KRR_GLSTATE_enable() when rendering such terrain.
+  bool strips;
+
+  /// maximum error in pixels on screen allowed when selecting LOD level of chunks, default is 2.
+  /// Larger value renders fewer triangles at the cost of more popping.
+  float max_pixel_error;
+
+  /// number of chunks and triangles rendered by the last render call
+  int rendered_chunks;
+  int rendered_triangles;
+
+  /// set to true before loading to upload vertices as VERTEXTEXNORM3D_PACKED, taking half of GPU memory.
+  /// Then set `dequant` to shader via KRR_TERRAINSHADERPROG3D_update_dequant() before rendering.
+  bool packed;
+  /// dequantization of packed vertices, identity if vertices are not packed
+  VERTEXDEQUANT dequant;
+
+  /// bounding volumes in terrain's space, available after loading
+  KRR_CULL_BOUNDS bounds;
+
+  /// set to true before loading via KRR_TERRAIN_load_from_generation() to keep heights in a texture
+  /// and render one shared grid patch for every chunk, instead of uploading vertices of all chunks.
+  /// Render it with heightfield variant of terrain shader, see KRR_TERRAINSHADERPROG3D_load_heightfield_program(),
+  /// and set `heightfield_params` to shader via KRR_TERRAINSHADERPROG3D_update_heightfield() before rendering.
+  bool heightfield;
+  /// set to true along with `heightfield` to also upload normals as texture,
+  /// otherwise normals are computed from neighbouring heights in vertex shader
+  bool heightfield_normalmap;
+  /// parameters of heightfield, available after loading
+  HEIGHTFIELDPARAMS heightfield_params;
+  /// quantized heights as GL_R16UI, and normals as GL_RGBA8_SNORM if enabled.
+  /// They're bound to KRR_TERRAINSHADERPROG3D_HEIGHTMAP_UNIT and KRR_TERRAINSHADERPROG3D_NORMALMAP_UNIT when rendering.
+  GLuint heightmap_texture_id;
+  GLuint normalmap_texture_id;
+
+  /// (internally used) per-instance patches of visible chunks, grouped by LOD level
+  GLuint patches_vbo_id;
+  float* patches;
 
   // will be set after loading completes
   // note: if load terrain via KRR_TERRAIN_load_objfile() function,
@@ -23,19 +118,54 @@ typedef struct
   int grid_width;
   int grid_height;
 
-  /// height information for terrain
+  /// distance between neighbouring grid vertices
+  float cell_size;
+  /// height factor terrain was generated with, normals are computed against it
+  float height_factor;
+
+  /// height of each grid vertex, (grid_width+1) * (grid_height+1) values row by row along x-axis.
+  /// See KRR_TERRAIN_query() to sample it at arbitrary position.
   /// note: it will be available only when load via KRR_TERRAIN_load_from_generation()
   float* heights;
 
-  /// normals information for terrain
-  /// note: it will be available only when load via KRR_TERRAIN_load_objfile()
-  vec3* normals; 
+  /// normal of each grid vertex, laid out the same as `heights`
+  /// note: it will be available only when load via KRR_TERRAIN_load_from_generation()
+  vec3* normals;
+
+  /// set before loading via KRR_TERRAIN_load_paged().
+  /// Number of tiles around camera's tile along each direction to keep resident, default is 6.
+  int page_radius;
+  /// maximum number of resident tiles, at least (2*page_radius+1)^2. Default is 0 to use (2*page_radius+2)^2,
+  /// leaving room to keep tiles just left behind in case camera comes back.
+  int page_capacity;
+  /// maximum number of tiles uploaded to GPU by each KRR_TERRAIN_update_paging() call, default is 4
+  int page_uploads_per_update;
+  /// (internally used) paging state, or NULL if terrain is not paged
+  TERRAIN_PAGING* paging;
+
+  /// (internally used) min/max height quadtree over cells for ray casting, pairs of min and max height.
+  /// Level 0 holds each cell, and each node of the next level covers 2x2 nodes of the level below
+  /// up to a single node covering the whole terrain.
+  float* minmax_tree;
+  int minmax_levels;
+  int minmax_level_offset[KRR_TERRAIN_MINMAX_LEVELS];
 
   GLuint vbo_id;
   GLuint ibo_id;
   GLuint vao_id;
 } TERRAIN;
 
+///
+/// How KRR_TERRAIN_query() interpolates between grid vertices.
+///
+typedef enum
+{
+  /// on the two triangles of cell exactly as rendered at full resolution
+  KRR_TERRAIN_QUERY_TRIANGLE,
+  /// bilinearly between four corners of cell, smoother across diagonal of cell
+  KRR_TERRAIN_QUERY_BILINEAR
+} KRR_TERRAIN_QUERY_MODE;
+
 ///
 /// Create a new TERRAIN on heap.
 ///
@@ -53,6 +183,8 @@ extern void KRR_TERRAIN_free_internals(TERRAIN* tr);
 ///
 /// Load model from .obj file.
 ///
+/// Parsed result is optimized and cached next to .obj file, see SIMPLEMODEL_load_objfile().
+///
 /// \param tr a pointer to TERRAIN
 /// \param filepath file path to an .obj file to load
 /// \return true if load successfully, otherwise return false.
@@ -63,14 +195,69 @@ extern bool KRR_TERRAIN_load_objfile(TERRAIN* tr, const char* filepath);
 /// Load terrain from generation algorithm from input specifications.
 /// After this call, terrain is ready to be rendered.
 ///
+/// Terrain is split into chunks of KRR_TERRAIN_CHUNK_CELLS^2 cells, each rendered with 16-bit indices.
+/// Index buffers of all LOD levels are precomputed, see KRR_TERRAIN_render_lod(), as triangle strips if `strips` is set.
+///
 /// \param tr pointer to TERRAIN
-/// \param heightmap_path path to heightmap file
+/// \param heightmap_path path to heightmap file, see KRR_HEIGHTMAP_load() for supported formats
 /// \param size distance between slot in pixels
 /// \param hfactor height factor to be multiplied to height value
 /// \return true if load successfully, otherwise return false.
 ///
 extern bool KRR_TERRAIN_load_from_generation(TERRAIN* tr, const char* heightmap_path, float size, float hfactor);
 
+///
+/// Load terrain from generation algorithm from heightmap already in memory.
+/// It's the same as KRR_TERRAIN_load_from_generation() but skips loading heightmap file, i.e. for one
+/// generated by KRR_HEIGHTMAP_generate_noise().
+///
+/// \param tr pointer to TERRAIN
+/// \param heightmap heightmap to generate terrain from, it's not kept after this call
+/// \param size distance between slot in pixels
+/// \param hfactor height factor to be multiplied to height value
+/// \return true if load successfully, otherwise return false.
+///
+extern bool KRR_TERRAIN_load_from_heightmap(TERRAIN* tr, const KRR_HEIGHTMAP* heightmap, float size, float hfactor);
+
+///
+/// Load terrain from tiled heightmap whose tiles are paged in and out around camera.
+///
+/// Heightmap is kept in memory-mapped .krrtiles file, see KRR_TERRAINTILES_build(). Each tile is a chunk,
+/// meshed by worker threads from its samples as camera approaches, uploaded into one of `page_capacity`
+/// preallocated slots of vertex buffer, then evicted by least recently used when slots run out.
+/// Memory taken is fixed by `page_capacity` regardless of size of heightmap.
+///
+/// On platforms where files cannot be memory-mapped (see KRR_FILEMAP_can_map()) i.e. Android, file is
+/// not read as a whole; each worker thread seeks and reads one tile at a time as it meshes it instead,
+/// so memory stays fixed there too at the cost of a file read per tile paged in.
+///
+/// Terrain produced is the same as of KRR_TERRAIN_load_from_generation() with the same heightmap,
+/// but `heights`, `normals` and min/max height quadtree are not available, so querying, ray casting
+/// and deformation are not supported. Vertices are never packed as they span the whole world,
+/// and `heightfield` is not supported.
+///
+/// No chunk is resident after this call, call KRR_TERRAIN_update_paging() every frame before rendering.
+///
+/// \param tr pointer to TERRAIN
+/// \param tiles_path path to .krrtiles file
+/// \param size distance between slot in pixels
+/// \param hfactor height factor to be multiplied to height value
+/// \return true if load successfully, otherwise return false.
+///
+extern bool KRR_TERRAIN_load_paged(TERRAIN* tr, const char* tiles_path, float size, float hfactor);
+
+///
+/// Page tiles of paged terrain in and out around camera.
+///
+/// Missing tiles nearest to camera are requested from worker threads first, then up to
+/// `page_uploads_per_update` tiles meshed so far are uploaded, evicting least recently used tiles if needed.
+/// It does nothing for terrain not loaded via KRR_TERRAIN_load_paged().
+///
+/// \param tr pointer to TERRAIN
+/// \param camera_pos position of camera in terrain's space
+///
+extern void KRR_TERRAIN_update_paging(TERRAIN* tr, vec3 camera_pos);
+
 ///
 /// Unload current loaded model.
 /// This will make it ready for a next loading call.
@@ -82,11 +269,130 @@ extern void KRR_TERRAIN_unload(TERRAIN* tr);
 ///
 /// Render
 /// User needs to call glBindVertexArray(vao) before calling this function, to optimize the batch rendering. As well as necessary binding to relevant stuff before actual rendering.
+/// For terrain split into chunks, vao of each chunk is bound in turn, then `vao_id` is bound back when done.
 ///
 /// \param pointer to TERRAIN
 ///
 extern void KRR_TERRAIN_render(TERRAIN* tr);
 
+///
+/// Render only chunks inside frustum.
+/// Same as KRR_TERRAIN_render() but terrain which is not split into chunks is tested as a whole.
+///
+/// \param tr pointer to TERRAIN
+/// \param frustum frustum in terrain's space, i.e. extracted from projection * view * model matrix of terrain
+///
+extern void KRR_TERRAIN_render_culled(TERRAIN* tr, const KRR_CULL_FRUSTUM* frustum);
+
+///
+/// Render only chunks inside frustum, each at the coarsest LOD level whose error projected on screen
+/// is within `max_pixel_error`.
+/// Terrain which is not split into chunks is rendered as with KRR_TERRAIN_render_culled().
+///
+/// \param tr pointer to TERRAIN
+/// \param frustum frustum in terrain's space, or NULL to not cull
+/// \param camera_pos position of camera in terrain's space
+/// \param error_scale scale from error over distance to pixels, see KRR_TERRAIN_lod_error_scale()
+///
+extern void KRR_TERRAIN_render_lod(TERRAIN* tr, const KRR_CULL_FRUSTUM* frustum, vec3 camera_pos, float error_scale);
+
+///
+/// Compute scale for KRR_TERRAIN_render_lod() from perspective projection.
+///
+/// \param projection perspective projection matrix
+/// \param viewport_height height of viewport in pixels
+/// \return scale which converts error in world unit divided by distance into pixels
+///
+extern float KRR_TERRAIN_lod_error_scale(mat4 projection, float viewport_height);
+
+///
+/// Query height, normal and slope of terrain at many points at once.
+///
+/// Input and output are in structure-of-arrays layout, processed in blocks by a branchless loop
+/// the compiler vectorizes. Points outside of terrain are clamped to its edges.
+/// Any output can be NULL if not needed, skipping its work.
+///
+/// It requires `heights`, and `normals` for normal output, thus terrain loaded via KRR_TERRAIN_load_from_generation().
+///
+/// \param tr pointer to TERRAIN
+/// \param mode interpolation mode
+/// \param xs x positions in terrain's space
+/// \param zs z positions in terrain's space
+/// \param count number of points
+/// \param out_heights result heights, or NULL
+/// \param out_normals_x x component of result unit normals interpolated from `normals`, or NULL
+/// \param out_normals_y y component of result unit normals, or NULL
+/// \param out_normals_z z component of result unit normals, or NULL
+/// \param out_slopes result steepness as rise over run i.e. tangent of slope angle, or NULL
+///
+extern void KRR_TERRAIN_query(const TERRAIN* tr, KRR_TERRAIN_QUERY_MODE mode, const float* xs, const float* zs, int count, float* out_heights, float* out_normals_x, float* out_normals_y, float* out_normals_z, float* out_slopes);
+
+///
+/// Find the nearest intersection of ray with terrain.
+///
+/// Ray is tested against the same triangles as rendered at full resolution, skipping empty space
+/// by min/max height quadtree built along with terrain.
+/// It requires terrain loaded via KRR_TERRAIN_load_from_generation().
+///
+/// \param tr pointer to TERRAIN
+/// \param origin origin of ray in terrain's space
+/// \param direction direction of ray in terrain's space, it doesn't need to be normalized
+/// \param max_t maximum distance along ray in unit of length of `direction`.
+///               For line-of-sight test, set `direction` to target minus origin and `max_t` to 1.
+/// \param out_t returned distance along ray to intersection in unit of length of `direction`, can be NULL.
+///               Intersection point is origin + direction * t.
+/// \return true if ray hits terrain within `max_t`, otherwise return false.
+///
+extern bool KRR_TERRAIN_raycast(const TERRAIN* tr, vec3 origin, vec3 direction, float max_t, float* out_t);
+
+///
+/// Find the nearest intersection of many rays with terrain.
+/// See KRR_TERRAIN_raycast().
+///
+/// \param tr pointer to TERRAIN
+/// \param origins origins of rays in terrain's space
+/// \param directions directions of rays in terrain's space
+/// \param max_t maximum distance along each ray in unit of length of its direction
+/// \param count number of rays
+/// \param out_ts returned distance along each ray to intersection, or -1 if it misses
+/// \return number of rays that hit terrain
+///
+extern int KRR_TERRAIN_raycast_batch(const TERRAIN* tr, const vec3* origins, const vec3* directions, float max_t, int count, float* out_ts);
+
+///
+/// Update terrain after `heights` of grid vertices in region were modified.
+///
+/// Normals around region, LOD errors and bounds of affected chunks, and min/max height quadtree
+/// are recomputed, then only changed vertices are uploaded with glBufferSubData(), or texels with
+/// glTexSubImage2D() for heightfield terrain.
+/// If heights go beyond range of quantization of packed vertices or heightfield, range is widened
+/// and the whole terrain is uploaded again, so set `dequant` and `heightfield_params` to shader
+/// after this call.
+///
+/// It requires terrain loaded via KRR_TERRAIN_load_from_generation(), and GL context.
+///
+/// \param tr pointer to TERRAIN
+/// \param x0 first column of modified grid vertices
+/// \param z0 first row of modified grid vertices
+/// \param x1 last column of modified grid vertices, inclusive
+/// \param z1 last row of modified grid vertices, inclusive
+/// \return true if terrain is updated, otherwise return false.
+///
+extern bool KRR_TERRAIN_update_heights(TERRAIN* tr, int x0, int z0, int x1, int z1);
+
+///
+/// Raise or lower terrain around a point with smooth falloff, then update it.
+/// See KRR_TERRAIN_update_heights().
+///
+/// \param tr pointer to TERRAIN
+/// \param x x position of center of brush in terrain's space
+/// \param z z position of center of brush in terrain's space
+/// \param radius radius of brush in terrain's space
+/// \param amount height added at center, negative to lower terrain
+/// \return true if terrain is updated, otherwise return false.
+///
+extern bool KRR_TERRAIN_brush(TERRAIN* tr, float x, float z, float radius, float amount);
+
 ///
 /// Free a simple model.
 ///
@@ -98,21 +404,35 @@ extern void KRR_TERRAIN_free(TERRAIN* tr);
 /// Generate terrain
 /// Get result for VERTEXTEXNORM3D and its indices.
 ///
-/// \param heightmap_path path to heightmap file.
+/// Heightmap is decoded on CPU and no GL call is made, thus it can be called from any thread.
+/// Use 16-bit heightmap for more than 256 levels of height.
+///
+/// \param heightmap_path path to heightmap file, see KRR_HEIGHTMAP_load() for supported formats.
 /// \param size distance between individual slot in grid to the next, in pixels
 /// \param hfactor height factor to be multiplied with height value
 /// \param dst_vertices dynamically created buffer for vertices. You should free it when done using it. The type depends on type flag set.
+/// Pass NULL to skip generating the flat grid of vertices.
 /// \param vertices_count number of vertices returned
 /// \param dst_indices dynamically created buffer for indices. You should free it when done using it.
+/// Pass NULL to skip generating triangles, they take 6 indices per cell.
 /// \param indices_count returned count of indices
 /// \param rst_grid_width returned grid size in width
 /// \param rst_grid_height returned grid size in height
-/// \param rst_heights returned computed heights information
-/// \param rst_normals returned computed normals information
+/// \param rst_heights returned computed heights information, see `heights` of TERRAIN for its layout
+/// \param rst_normals returned computed normals information, laid out the same as heights. Free it with KRR_MEM_free8().
 /// \return return true for success, otherwise return false.
 ///
 extern bool KRR_TERRAIN_generate(const char* heightmap_path, float size, float hfactor, VERTEXTEXNORM3D** dst_vertices, int* vertices_count, GLuint** dst_indices, int* indices_count, int* rst_grid_width, int* rst_grid_height, float** rst_heights, vec3** rst_normals);
 
+///
+/// Generate terrain from heightmap already in memory.
+/// See KRR_TERRAIN_generate() for the results, any of them can be NULL to skip it.
+///
+/// \param heightmap heightmap to generate terrain from
+/// \return return true for success, otherwise return false.
+///
+extern bool KRR_TERRAIN_generate_from_heightmap(const KRR_HEIGHTMAP* heightmap, float size, float hfactor, VERTEXTEXNORM3D** dst_vertices, int* vertices_count, GLuint** dst_indices, int* indices_count, int* rst_grid_width, int* rst_grid_height, float** rst_heights, vec3** rst_normals);
+
 #ifdef __cplusplus
 }
 #endif
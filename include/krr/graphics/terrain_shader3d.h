@@ -8,6 +8,10 @@
 extern "C" {
 #endif
 
+/// texture units of heightmap and normal map in heightfield variant, next to units used by multitexturing
+#define KRR_TERRAINSHADERPROG3D_HEIGHTMAP_UNIT 5
+#define KRR_TERRAINSHADERPROG3D_NORMALMAP_UNIT 6
+
 typedef struct KRR_TERRAINSHADERPROG3D_
 {
   // underlying shader program
@@ -31,25 +35,12 @@ typedef struct KRR_TERRAINSHADERPROG3D_
   GLint multitexture_texture_b_location;
   GLint multitexture_blendmap_location;
 
-  // projection matrix
-  mat4 projection_matrix;
-  GLint projection_matrix_location;
-
-  // view matrix
-  mat4 view_matrix;
-  GLint view_matrix_location;
+  // camera and lights are shared by all 3D shaders, see KRR_SCENEUBO
 
   // model matrix
   mat4 model_matrix;
   GLint model_matrix_location;
 
-  // light
-  GLint light_position_locations[KRR_SHADERPROG_MAX_LIGHTS];
-  GLint light_color_locations[KRR_SHADERPROG_MAX_LIGHTS];
-  GLint light_attenuation_locations[KRR_SHADERPROG_MAX_LIGHTS];
-  GLint light_num_location;
-  LIGHT lights[KRR_SHADERPROG_MAX_LIGHTS];
-
   // specular
   GLint shine_damper_location;
   GLint reflectivity_location;
@@ -60,21 +51,25 @@ typedef struct KRR_TERRAINSHADERPROG3D_
   GLint texcoord_repeat_location;
   float texcoord_repeat;
 
-  // ambient color
-  GLint ambient_color_location;
-  vec3 ambient_color;
-
-  // fog
-  GLint fog_enabled_location;
-  bool fog_enabled; // default to false
-  GLint fog_density_location;
-  GLint fog_gradient_location;
-  float fog_density;
-  float fog_gradient;
-  
-  // sky color
-  GLint sky_color_location;
-  vec3 sky_color; // default to (0.5, 0.5, 0.5)
+  // dequantization of packed vertices
+  GLint dequant_position_location;
+  GLint dequant_texcoord_location;
+  VERTEXDEQUANT dequant; // default to identity
+
+  // whether heightfield variant of shader is loaded, see KRR_TERRAINSHADERPROG3D_load_heightfield_program()
+  bool heightfield;
+
+  // attribute location of heightfield variant, vertex_pos3d, texcoord and normal are not used
+  GLint grid_vertex_location;
+  GLint patch_location;
+
+  // heightfield textures, set to KRR_TERRAINSHADERPROG3D_HEIGHTMAP_UNIT and KRR_TERRAINSHADERPROG3D_NORMALMAP_UNIT when loaded
+  GLint heightmap_sampler_location;
+  GLint normalmap_sampler_location;
+
+  // parameters to reconstruct vertices of heightfield
+  GLint heightfield_params_location;
+  HEIGHTFIELDPARAMS heightfield_params;
 
 } KRR_TERRAINSHADERPROG3D;
 
@@ -107,19 +102,15 @@ extern void KRR_TERRAINSHADERPROG3D_free(KRR_TERRAINSHADERPROG3D* program);
 extern bool KRR_TERRAINSHADERPROG3D_load_program(KRR_TERRAINSHADERPROG3D* program);
 
 ///
-/// update projection matrix
+/// load heightfield variant of program
 ///
-/// \param program pTERRAINSHADERPROG3DEXSHADERPROG3D
+/// Vertices are reconstructed in vertex shader from a shared grid patch rendered once per instance,
+/// with height fetched from heightmap texture. It's for TERRAIN loaded with `heightfield` set to true.
 ///
-extern void KRR_TERRAINSHADERPROG3D_update_projection_matrix(KRR_TERRAINSHADERPROG3D* program);
-
-///
-/// update view matrix
-/// set view matrix information (see header) first then call this function to update to GPU
-///
-/// \param program pointer to KRR_TRRAINSHADERPROG3DD
+/// \param program pointer to KRR_TERRAINSHADERPROG3D
+/// \return true if load successfully, otherwise retrurn false.
 ///
-extern void KRR_TERRAINSHADERPROG3D_update_view_matrix(KRR_TERRAINSHADERPROG3D* program);
+extern bool KRR_TERRAINSHADERPROG3D_load_heightfield_program(KRR_TERRAINSHADERPROG3D* program);
 
 ///
 /// update model matrix
@@ -138,103 +129,119 @@ extern void KRR_TERRAINSHADERPROG3D_update_model_matrix(KRR_TERRAINSHADERPROG3D*
 extern void KRR_TERRAINSHADERPROG3D_update_shininess(KRR_TERRAINSHADERPROG3D* program);
 
 ///
-/// update light information
-/// this will update all lights up to maximum as defined via `KRR_SHADERPROG_MAX_LIGHTS`.
-/// set light information first (see header) then call this function to update to GPU
-///
-/// It will also automatically update number of lights as will be processed by shader.
-/// For this case, it will use all lights as defined maximally.
+/// update texture coord repeat
+/// set texture coord repeat first (see header) then call this function to update to GPU
 ///
 /// \param program pointer to KRR_TERRAINSHADERPROG3D
 ///
-extern void KRR_TERRAINSHADERPROG3D_update_lights(KRR_TERRAINSHADERPROG3D* program);
+extern void KRR_TERRAINSHADERPROG3D_update_texcoord_repeat(KRR_TERRAINSHADERPROG3D* program);
 
 ///
-/// update light information up to `num_lights`.
-/// set light information first (see header) then call this function to update to GPU
+/// update dequantization of packed vertices
+/// set dequantization first (see header) then call this function to update to GPU.
+/// Set it to dequantization of mesh before rendering mesh with VERTEXTEXNORM3D_PACKED vertices,
+/// and back to identity for mesh with full-float vertices.
 ///
-/// It will also automatically update number of light as will be processed by shader.
-/// For this case, it will set `num_lights` to be used by shader.
-///
-/// \param program pointer to TERRAINSHADERPROG3D
-/// \param num_lights number of lights to update
+/// \param program pointer to KRR_TERRAINSHADERPROG3D
 ///
-extern void KRR_TERRAINSHADERPROG3D_update_lights_num(KRR_TERRAINSHADERPROG3D* program, int num_lights);
+extern void KRR_TERRAINSHADERPROG3D_update_dequant(KRR_TERRAINSHADERPROG3D* program);
 
 ///
-/// update texture coord repeat
-/// set texture coord repeat first (see header) then call this function to update to GPU
+/// update parameters of heightfield
+/// set heightfield parameters first (see header) then call this function to update to GPU.
+/// Set it to `heightfield_params` of TERRAIN before rendering it.
 ///
 /// \param program pointer to KRR_TERRAINSHADERPROG3D
 ///
-extern void KRR_TERRAINSHADERPROG3D_update_texcoord_repeat(KRR_TERRAINSHADERPROG3D* program);
+extern void KRR_TERRAINSHADERPROG3D_update_heightfield(KRR_TERRAINSHADERPROG3D* program);
 
 ///
-/// update ambient color
-/// set ambient color first (see header) then call this function to update to GPU
+/// set vertex pointer
 ///
 /// \param program pointer to KRR_TERRAINSHADERPROG3D
+/// \param stride space in bytes to the next attribute in the next element
+/// \param data opaque pointer to data buffer offset
 ///
-extern void KRR_TERRAINSHADERPROG3D_update_ambient_color(KRR_TERRAINSHADERPROG3D* program);
+extern void KRR_TERRAINSHADERPROG3D_set_vertex_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data);
 
 ///
-/// update fog enabled
-/// set fog enabled first (see header) then call this function to update to GPU
+/// set texcoordinate pointer of attribute vertice
 ///
 /// \param program pointer to KRR_TERRAINSHADERPROG3D
+/// \param stride space in bytes to the next attribute in the next element
+/// \param data opaque pointer to data buffer offset
 ///
-extern void KRR_TERRAINSHADERPROG3D_update_fog_enabled(KRR_TERRAINSHADERPROG3D* program);
+extern void KRR_TERRAINSHADERPROG3D_set_texcoord_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data);
 
 ///
-/// update fog density
-/// set fog density first (see header) then call this function to update to GPU
+/// set normal pointer of attribute vertice
 ///
 /// \param program pointer to KRR_TERRAINSHADERPROG3D
+/// \param stride space in bytes to the next attribute in the next element
+/// \param data opaque pointer to data buffer offset
 ///
-extern void KRR_TERRAINSHADERPROG3D_update_fog_density(KRR_TERRAINSHADERPROG3D* program);
+extern void KRR_TERRAINSHADERPROG3D_set_normal_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data);
 
 ///
-/// update fog gradient
-/// set fog gradient first (see header) then call this function to update to GPU
+/// set vertex pointer for VERTEXTEXNORM3D_PACKED
 ///
-/// \param program poitner to KRR_TERRAINSHADERPROG3D
+/// \param program pointer to KRR_TERRAINSHADERPROG3D
+/// \param stride space in bytes to the next attribute in the next element
+/// \param data opaque pointer to data buffer offset
 ///
-extern void KRR_TERRAINSHADERPROG3D_update_fog_gradient(KRR_TERRAINSHADERPROG3D* program);
+extern void KRR_TERRAINSHADERPROG3D_set_packed_vertex_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data);
 
 ///
-/// update sky color
-/// set sky color first (see header) then call this function to update to GPU
+/// set texcoordinate pointer for VERTEXTEXNORM3D_PACKED
 ///
 /// \param program pointer to KRR_TERRAINSHADERPROG3D
+/// \param stride space in bytes to the next attribute in the next element
+/// \param data opaque pointer to data buffer offset
 ///
-extern void KRR_TERRAINSHADERPROG3D_update_sky_color(KRR_TERRAINSHADERPROG3D* program);
+extern void KRR_TERRAINSHADERPROG3D_set_packed_texcoord_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data);
 
 ///
-/// set vertex pointer
+/// set normal pointer for VERTEXTEXNORM3D_PACKED
 ///
 /// \param program pointer to KRR_TERRAINSHADERPROG3D
 /// \param stride space in bytes to the next attribute in the next element
 /// \param data opaque pointer to data buffer offset
 ///
-extern void KRR_TERRAINSHADERPROG3D_set_vertex_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data);
+extern void KRR_TERRAINSHADERPROG3D_set_packed_normal_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data);
 
 ///
-/// set texcoordinate pointer of attribute vertice
+/// set grid vertex pointer for heightfield variant
 ///
 /// \param program pointer to KRR_TERRAINSHADERPROG3D
 /// \param stride space in bytes to the next attribute in the next element
 /// \param data opaque pointer to data buffer offset
 ///
-extern void KRR_TERRAINSHADERPROG3D_set_texcoord_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data);
+extern void KRR_TERRAINSHADERPROG3D_set_grid_vertex_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data);
 
 ///
-/// set normal pointer of attribute vertice
+/// set per-instance patch pointer for heightfield variant
 ///
 /// \param program pointer to KRR_TERRAINSHADERPROG3D
 /// \param stride space in bytes to the next attribute in the next element
 /// \param data opaque pointer to data buffer offset
 ///
-extern void KRR_TERRAINSHADERPROG3D_set_normal_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data);
+extern void KRR_TERRAINSHADERPROG3D_set_patch_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data);
+
+///
+/// set heightmap sampler to shader
+///
+/// \param program pointer to KRR_TERRAINSHADERPROG3D
+/// \param sampler texture sampler name
+///
+extern void KRR_TERRAINSHADERPROG3D_set_heightmap_sampler(KRR_TERRAINSHADERPROG3D* program, GLuint sampler);
+
+///
+/// set normal map sampler to shader
+///
+/// \param program pointer to KRR_TERRAINSHADERPROG3D
+/// \param sampler texture sampler name
+///
+extern void KRR_TERRAINSHADERPROG3D_set_normalmap_sampler(KRR_TERRAINSHADERPROG3D* program, GLuint sampler);
 
 ///
 /// set texture sampler to shader
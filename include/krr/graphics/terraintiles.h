@@ -0,0 +1,154 @@
+#ifndef KRR_TERRAINTILES_h_
+#define KRR_TERRAINTILES_h_
+
+#include "krr/graphics/common.h"
+#include "krr/foundation/filemap.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// current version of .krrtiles format, bump it whenever layout of file changes
+#define KRR_TERRAINTILES_VERSION 1
+
+/// file extension of tiled heightmap file
+#define KRR_TERRAINTILES_EXT ".krrtiles"
+
+///
+/// Header of .krrtiles file.
+///
+/// Heightmap is split into `tiles_x` * `tiles_z` square tiles of `tile_cells` cells, stored row by row.
+/// Each tile holds (tile_cells+3)^2 samples of 16-bit row by row, covering its (tile_cells+1)^2 grid
+/// vertices plus one more sample on each side, so that a tile is enough to compute its own normals.
+/// Samples outside of heightmap are clamped to its edges. Tiles start right after header.
+/// All values are in native byte order.
+///
+typedef struct
+{
+  /// "KRRT"
+  char magic[4];
+  uint32_t version;
+
+  /// number of cells along each side of a tile
+  uint32_t tile_cells;
+
+  /// size of heightmap, it's also number of cells of terrain grid
+  uint32_t grid_width;
+  uint32_t grid_height;
+
+  uint32_t tiles_x;
+  uint32_t tiles_z;
+
+  /// reserved, always 0. Also keeps size of header a multiple of 8 without implicit padding.
+  uint32_t reserved;
+} KRR_TERRAINTILES_HEADER;
+
+///
+/// Tiled heightmap whose tiles are read on demand.
+///
+/// File is memory-mapped where possible, thus only tiles actually accessed take physical memory and
+/// they can be reclaimed by OS at any time. On platforms without memory mapping (see KRR_FILEMAP_can_map())
+/// i.e. Android, tiles are read one at a time through KRR_TERRAINTILES_READER instead of reading the whole
+/// file, so memory taken doesn't depend on size of file either way.
+///
+typedef struct
+{
+  KRR_TERRAINTILES_HEADER header;
+
+  /// (internally used) mapped file, empty if tiles are read through readers
+  KRR_FILEMAP fm;
+  /// (internally used) path to file for readers to open it, NULL if file is mapped
+  char* path;
+} KRR_TERRAINTILES;
+
+///
+/// Reader of tiles of KRR_TERRAINTILES.
+/// Reading tiles from multiple threads at once is safe as long as each thread uses its own reader.
+///
+typedef struct
+{
+  /// (internally used) file opened for this reader, NULL if file is mapped
+  struct SDL_RWops* file;
+  /// (internally used) samples of the last tile read, NULL if file is mapped
+  GLushort* samples;
+} KRR_TERRAINTILES_READER;
+
+///
+/// Convert heightmap into .krrtiles file.
+///
+/// Headerless 16-bit heightmap (.raw or .r16) is read through memory mapping and converted tile by tile,
+/// so heightmap of any size can be converted with little memory. Other formats are decoded as a whole
+/// via KRR_HEIGHTMAP_load().
+///
+/// \param heightmap_path path to heightmap file
+/// \param width width of headerless heightmap, or 0 along with `height` to treat it as square. Ignored for other formats.
+/// \param height height of headerless heightmap
+/// \param tile_cells number of cells along each side of a tile
+/// \param tiles_path path to .krrtiles file to write
+/// \return true if successfully written, otherwise return false.
+///
+extern bool KRR_TERRAINTILES_build(const char* heightmap_path, int width, int height, int tile_cells, const char* tiles_path);
+
+///
+/// Open .krrtiles file.
+///
+/// \param tt pointer to KRR_TERRAINTILES to hold the result
+/// \param tiles_path path to .krrtiles file
+/// \return true if file is valid and successfully opened, otherwise return false.
+///
+extern bool KRR_TERRAINTILES_open(KRR_TERRAINTILES* tt, const char* tiles_path);
+
+///
+/// Get samples of a tile straight from mapped file.
+///
+/// \param tt pointer to KRR_TERRAINTILES
+/// \param tx tile index along x-axis
+/// \param tz tile index along z-axis
+/// \return (tile_cells+3)^2 samples row by row, starting at grid vertex (tx*tile_cells-1, tz*tile_cells-1).
+/// NULL if file is not mapped, use KRR_TERRAINTILES_read() then.
+///
+extern const GLushort* KRR_TERRAINTILES_tile(const KRR_TERRAINTILES* tt, int tx, int tz);
+
+///
+/// Open reader of tiles.
+///
+/// \param tt pointer to KRR_TERRAINTILES
+/// \param reader pointer to KRR_TERRAINTILES_READER to hold the result
+/// \return true if successfully opened, otherwise return false.
+///
+extern bool KRR_TERRAINTILES_reader_open(const KRR_TERRAINTILES* tt, KRR_TERRAINTILES_READER* reader);
+
+///
+/// Get samples of a tile, reading them from file if it's not mapped.
+///
+/// \param tt pointer to KRR_TERRAINTILES
+/// \param reader reader opened for `tt`
+/// \param tx tile index along x-axis
+/// \param tz tile index along z-axis
+/// \return samples laid out as of KRR_TERRAINTILES_tile(), valid until next read with the same reader.
+/// NULL if reading failed.
+///
+extern const GLushort* KRR_TERRAINTILES_read(const KRR_TERRAINTILES* tt, KRR_TERRAINTILES_READER* reader, int tx, int tz);
+
+///
+/// Close reader of tiles.
+///
+/// \param reader pointer to KRR_TERRAINTILES_READER
+///
+extern void KRR_TERRAINTILES_reader_close(KRR_TERRAINTILES_READER* reader);
+
+///
+/// Close file.
+/// After this call, samples returned by KRR_TERRAINTILES_tile() cannot be accessed anymore.
+/// All readers have to be closed before.
+///
+/// \param tt pointer to KRR_TERRAINTILES
+///
+extern void KRR_TERRAINTILES_close(KRR_TERRAINTILES* tt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
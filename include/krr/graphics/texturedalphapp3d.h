@@ -13,6 +13,9 @@ typedef struct KRR_TEXALPHASHADERPROG3D_
   // underlying shader program
   KRR_SHADERPROG* program;
 
+  // whether instanced variant of shader is loaded, see KRR_TEXALPHASHADERPROG3D_load_instanced_program()
+  bool instanced;
+
   // attribute location
   GLint vertex_pos3d_location;
   GLint texcoord_location;
@@ -21,13 +24,7 @@ typedef struct KRR_TEXALPHASHADERPROG3D_
   // uniform texture
   GLint texture_sampler_location;
 
-  // projection matrix
-  mat4 projection_matrix;
-  GLint projection_matrix_location;
-
-  // view matrix
-  mat4 view_matrix;
-  GLint view_matrix_location;
+  // camera and lights are shared by all 3D shaders, see KRR_SCENEUBO
 
   // model matrix
   mat4 model_matrix;
@@ -37,34 +34,16 @@ typedef struct KRR_TEXALPHASHADERPROG3D_
 	GLint clipped_texcoord_location;
 	vec4 clipped_texcoord;
 
-  // light
-  GLint light_position_locations[KRR_SHADERPROG_MAX_LIGHTS];
-  GLint light_color_locations[KRR_SHADERPROG_MAX_LIGHTS];
-  GLint light_attenuation_locations[KRR_SHADERPROG_MAX_LIGHTS];
-  GLint light_num_location;
-  LIGHT lights[KRR_SHADERPROG_MAX_LIGHTS];
-
   // specular
   GLint shine_damper_location;
   GLint reflectivity_location;
   GLfloat shine_damper;
   GLfloat reflectivity;
 
-  // ambient
-  GLint ambient_color_location;
-  vec3 ambient_color;
-
-  // fog
-  GLint fog_enabled_location;
-  bool fog_enabled; // default to false
-  GLint fog_density_location;
-  GLint fog_gradient_location;
-  float fog_density;
-  float fog_gradient;
-  
-  // sky color
-  GLint sky_color_location;
-  vec3 sky_color; // default to (0.5, 0.5, 0.5)
+  // dequantization of packed vertices
+  GLint dequant_position_location;
+  GLint dequant_texcoord_location;
+  VERTEXDEQUANT dequant; // default to identity
 
 } KRR_TEXALPHASHADERPROG3D;
 
@@ -97,19 +76,16 @@ extern void KRR_TEXALPHASHADERPROG3D_free(KRR_TEXALPHASHADERPROG3D* program);
 extern bool KRR_TEXALPHASHADERPROG3D_load_program(KRR_TEXALPHASHADERPROG3D* program);
 
 ///
-/// update projection matrix
+/// load instanced variant of program
 ///
-/// \param program pointer to KRR_TEXALPHASHADERPROG3D
-///
-extern void KRR_TEXALPHASHADERPROG3D_update_projection_matrix(KRR_TEXALPHASHADERPROG3D* program);
-
-///
-/// update view matrix
-/// set view matrix information (see header) first then call this function to update to GPU
+/// It takes model matrix and clipped texture coordinate per instance from vertex attributes,
+/// see SIMPLEMODEL_render_instanced(). Model matrix uniform is still applied on top of
+/// model matrix of every instance.
 ///
 /// \param program pointer to KRR_TEXALPHASHADERPROG3D
+/// \return true if load successfully, otherwise retrurn false.
 ///
-extern void KRR_TEXALPHASHADERPROG3D_update_view_matrix(KRR_TEXALPHASHADERPROG3D* program);
+extern bool KRR_TEXALPHASHADERPROG3D_load_instanced_program(KRR_TEXALPHASHADERPROG3D* program);
 
 ///
 /// update model matrix
@@ -136,95 +112,68 @@ extern void KRR_TEXALPHASHADERPROG3D_update_shininess(KRR_TEXALPHASHADERPROG3D*
 extern void KRR_TEXALPHASHADERPROG3D_update_clipped_texcoord(KRR_TEXALPHASHADERPROG3D* program);
 
 ///
-/// update light information
-/// this will update all lights up to maximum as defined via `KRR_SHADERPROG_MAX_LIGHTS`.
-/// set light information first (see header) then call this function to update to GPU
-///
-/// It will also automatically update number of lights as will be processed by shader.
-/// For this case, it will use all lights as defined maximally.
+/// update dequantization of packed vertices
+/// set dequantization first (see header) then call this function to update to GPU.
+/// Set it to dequantization of mesh before rendering mesh with VERTEXTEXNORM3D_PACKED vertices,
+/// and back to identity for mesh with full-float vertices.
 ///
 /// \param program pointer to KRR_TEXALPHASHADERPROG3D
 ///
-extern void KRR_TEXALPHASHADERPROG3D_update_lights(KRR_TEXALPHASHADERPROG3D* program);
+extern void KRR_TEXALPHASHADERPROG3D_update_dequant(KRR_TEXALPHASHADERPROG3D* program);
 
 ///
-/// update light information
-/// set light information first (see header) then call this function to update to GPU
-///
-/// It will also automatically update number of light as will be processed by shader.
-/// For this case, it will set `num_lights` to be used by shader.
-///
-/// \param program pointer to KRR_TEXALPHASHADERPROG3D
-/// \param num_lights number of lights
-///
-extern void KRR_TEXALPHASHADERPROG3D_update_lights_num(KRR_TEXALPHASHADERPROG3D* program, int num_lights);
-
-///
-/// update ambient color
-/// set ambient color first (see header) then call this function to update to GPU
-///
-/// \param program pointer to KRR_TEXALPHASHADERPROG3D
-///
-extern void KRR_TEXALPHASHADERPROG3D_update_ambient_color(KRR_TEXALPHASHADERPROG3D* program);
-
-///
-/// update fog enabled
-/// set fog enabled first (see header) then call this function to update to GPU
+/// set vertex pointer
 ///
 /// \param program pointer to KRR_TEXALPHASHADERPROG3D
+/// \param stride space in bytes to the next attribute in the next element
+/// \param data opaque pointer to data buffer offset
 ///
-extern void KRR_TEXALPHASHADERPROG3D_update_fog_enabled(KRR_TEXALPHASHADERPROG3D* program);
+extern void KRR_TEXALPHASHADERPROG3D_set_vertex_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data);
 
 ///
-/// update fog density
-/// set fog density first (see header) then call this function to update to GPU
+/// set texcoordinate pointer of attribute vertice
 ///
 /// \param program pointer to KRR_TEXALPHASHADERPROG3D
+/// \param stride space in bytes to the next attribute in the next element
+/// \param data opaque pointer to data buffer offset
 ///
-extern void KRR_TEXALPHASHADERPROG3D_update_fog_density(KRR_TEXALPHASHADERPROG3D* program);
-
-///
-/// update fog gradient
-/// set fog gradient first (see header) then call this function to update to GPU
-///
-/// \param program poitner to KRR_TEXALPHASHADERPROG3D
-///
-extern void KRR_TEXALPHASHADERPROG3D_update_fog_gradient(KRR_TEXALPHASHADERPROG3D* program);
+extern void KRR_TEXALPHASHADERPROG3D_set_texcoord_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data);
 
 ///
-/// update sky color
-/// set sky color first (see header) then call this function to update to GPU
+/// set normal pointer of attribute vertice
 ///
 /// \param program pointer to KRR_TEXALPHASHADERPROG3D
+/// \param stride space in bytes to the next attribute in the next element
+/// \param data opaque pointer to data buffer offset
 ///
-extern void KRR_TEXALPHASHADERPROG3D_update_sky_color(KRR_TEXALPHASHADERPROG3D* program);
+extern void KRR_TEXALPHASHADERPROG3D_set_normal_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data);
 
 ///
-/// set vertex pointer
+/// set vertex pointer for VERTEXTEXNORM3D_PACKED
 ///
 /// \param program pointer to KRR_TEXALPHASHADERPROG3D
 /// \param stride space in bytes to the next attribute in the next element
 /// \param data opaque pointer to data buffer offset
 ///
-extern void KRR_TEXALPHASHADERPROG3D_set_vertex_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data);
+extern void KRR_TEXALPHASHADERPROG3D_set_packed_vertex_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data);
 
 ///
-/// set texcoordinate pointer of attribute vertice
+/// set texcoordinate pointer for VERTEXTEXNORM3D_PACKED
 ///
 /// \param program pointer to KRR_TEXALPHASHADERPROG3D
 /// \param stride space in bytes to the next attribute in the next element
 /// \param data opaque pointer to data buffer offset
 ///
-extern void KRR_TEXALPHASHADERPROG3D_set_texcoord_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data);
+extern void KRR_TEXALPHASHADERPROG3D_set_packed_texcoord_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data);
 
 ///
-/// set normal pointer of attribute vertice
+/// set normal pointer for VERTEXTEXNORM3D_PACKED
 ///
 /// \param program pointer to KRR_TEXALPHASHADERPROG3D
 /// \param stride space in bytes to the next attribute in the next element
 /// \param data opaque pointer to data buffer offset
 ///
-extern void KRR_TEXALPHASHADERPROG3D_set_normal_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data);
+extern void KRR_TEXALPHASHADERPROG3D_set_packed_normal_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data);
 
 ///
 /// set texture sampler to shader
@@ -72,6 +72,61 @@ typedef struct
   NORMAL normal;
 } VERTEXTEXNORM3D;
 
+///
+/// Packed form of VERTEXTEXNORM3D, 16 bytes instead of 32 bytes.
+///
+/// - position is 16-bit unsigned normalized against bounding box of mesh
+/// - texcoord is 16-bit unsigned normalized against range of texcoords of mesh
+/// - normal is GL_INT_2_10_10_10_REV, signed normalized
+///
+/// Use VERTEXDEQUANT to get back actual position and texcoord.
+///
+typedef struct
+{
+  GLushort position[3];
+  /// (unused) keep texcoord 4-byte aligned
+  GLushort padding;
+  GLushort texcoord[2];
+  GLuint normal;
+} VERTEXTEXNORM3D_PACKED;
+
+///
+/// Dequantization of VERTEXTEXNORM3D_PACKED, value = offset + packed value * scale
+/// where packed value is in [0,1].
+///
+/// Offset of 0 and scale of 1 is identity, it leaves full-float vertices as they are.
+///
+typedef struct
+{
+  VERTEXPOS3D position_offset;
+  VERTEXPOS3D position_scale;
+  TEXCOORD2D texcoord_offset;
+  TEXCOORD2D texcoord_scale;
+} VERTEXDEQUANT;
+
+///
+/// Parameters to reconstruct vertices of heightfield terrain in vertex shader.
+/// Laid out as sent to shader, see KRR_TERRAINSHADERPROG3D_update_heightfield().
+///
+typedef struct
+{
+  /// height = offset + quantized height * scale
+  GLfloat height_offset;
+  GLfloat height_scale;
+  /// distance between neighbouring grid vertices
+  GLfloat cell_size;
+  /// height factor terrain is generated with, normals are computed from heights before applying it
+  GLfloat height_factor;
+
+  /// number of cells along each side of grid
+  GLfloat grid_width;
+  GLfloat grid_height;
+  /// 1 if normals are read from normal map, 0 if computed from neighbouring heights
+  GLfloat normalmap_enabled;
+  /// unused, pads to a whole vec4
+  GLfloat reserved;
+} HEIGHTFIELDPARAMS;
+
 typedef struct
 {
   GLfloat r;
@@ -123,6 +123,37 @@ extern void KRR_gputil_generate_mipmaps(GLenum target, int min_lod, int max_lod)
 ///
 extern int KRR_gputil_load_cubemap(const char* right, const char* left, const char* top, const char* bottom, const char* back, const char* front);
 
+///
+/// Get the smallest index type which can address all of `vertices_count` vertices.
+///
+/// GL_UNSIGNED_BYTE is never returned, some drivers convert such indices on CPU at draw time
+/// which costs more than the memory it saves.
+/// 16-bit indices never address vertex 0xffff, it's left for primitive restart.
+///
+/// \param vertices_count number of vertices to be addressed
+/// \return GL_UNSIGNED_SHORT if `vertices_count` is less than 65536, otherwise GL_UNSIGNED_INT.
+///
+extern GLenum KRR_gputil_index_type_for(int vertices_count);
+
+///
+/// Get size in bytes of index type.
+///
+/// \param type one of GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, or GL_UNSIGNED_INT
+/// \return size in bytes of a single index of `type`
+///
+extern int KRR_gputil_index_size(GLenum type);
+
+///
+/// Narrow GLuint indices in-place into `type`.
+/// After this call, `indices` holds `count` indices of `type` packed from its beginning.
+/// All indices need to fit in `type`.
+///
+/// \param indices indices as of GLuint to be narrowed
+/// \param count number of indices
+/// \param type target index type, one of GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, or GL_UNSIGNED_INT
+///
+extern void KRR_gputil_narrow_indices(void* indices, int count, GLenum type);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,11 @@
+#version 300 es
+
+precision lowp float;
+
+out vec4 out_color;
+
+void main()
+{
+  // color writes are masked off, only depth test matters
+  out_color = vec4(1.0f);
+}
@@ -0,0 +1,11 @@
+#version 300 es
+
+// transforms unit cube into bounding box in clip space
+uniform mat4 box_matrix;
+
+in vec3 vertex_pos3d;
+
+void main()
+{
+  gl_Position = box_matrix * vec4(vertex_pos3d, 1.0f);
+}
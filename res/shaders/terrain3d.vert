@@ -1,14 +1,32 @@
 #version 300 es
 
-uniform mat4 projection_matrix;
-uniform mat4 view_matrix;
+// camera and lights are shared by all 3D shaders, see KRR_SCENEUBO
+// precision is explicit as blocks have to match between vertex and fragment shader
+layout(std140) uniform camera_block
+{
+  highp mat4 projection_matrix;
+  highp mat4 view_matrix;
+  // xyz is camera position in world space
+  highp vec4 camera_position;
+  highp vec4 sky_color;
+  highp float fog_enabled;
+  highp float fog_density;
+  highp float fog_gradient;
+};
+layout(std140) uniform lights_block
+{
+  highp vec4 light_position[4];
+  // rgb is color, a is attenuation factor
+  highp vec4 light_color[4];
+  highp vec4 ambient_color;
+  highp int light_num;
+};
 uniform mat4 model_matrix;
-uniform lowp int light_num;
-uniform vec3 light_position[4];
 uniform float texcoord_repeat;
-uniform lowp float fog_enabled;
-uniform float fog_density;
-uniform float fog_gradient;
+// dequantization of packed vertices, [0] is offset and [1] is scale
+// it's identity for full-float vertices
+uniform vec3 dequant_position[2];
+uniform vec2 dequant_texcoord[2];
 
 in vec3 vertex_pos3d;
 in vec2 texcoord;
@@ -23,20 +41,24 @@ out float visibility;
 
 void main()
 {
-  vec4 world_position = model_matrix * vec4(vertex_pos3d, 1.0f);
+  // dequantize attributes
+  vec3 position = dequant_position[0] + vertex_pos3d * dequant_position[1];
+  vec2 uv = dequant_texcoord[0] + texcoord * dequant_texcoord[1];
+
+  vec4 world_position = model_matrix * vec4(position, 1.0f);
 
   // process texcoord
-  outin_texcoord = texcoord;
-  tiled_texcoord = texcoord * texcoord_repeat;
+  outin_texcoord = uv;
+  tiled_texcoord = uv * texcoord_repeat;
   surface_normal = (model_matrix * vec4(normal, 0.0f)).xyz;
 
   for (int i=0; i<light_num; ++i)
   {
-    tolight_dir[i] = light_position[i] - world_position.xyz;
+    tolight_dir[i] = light_position[i].xyz - world_position.xyz;
   }
 
   // calculate direction to camera
-  tocam_dir = (inverse(view_matrix) * vec4(0.0f, 0.0f, 0.0f, 1.0f)).xyz - world_position.xyz;
+  tocam_dir = camera_position.xyz - world_position.xyz;
 
   // calculate fog
   // from eqaution e^(-((distance*density)^gradient)) 
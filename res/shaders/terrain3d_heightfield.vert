@@ -0,0 +1,103 @@
+#version 300 es
+
+// camera and lights are shared by all 3D shaders, see KRR_SCENEUBO
+// precision is explicit as blocks have to match between vertex and fragment shader
+layout(std140) uniform camera_block
+{
+  highp mat4 projection_matrix;
+  highp mat4 view_matrix;
+  // xyz is camera position in world space
+  highp vec4 camera_position;
+  highp vec4 sky_color;
+  highp float fog_enabled;
+  highp float fog_density;
+  highp float fog_gradient;
+};
+layout(std140) uniform lights_block
+{
+  highp vec4 light_position[4];
+  // rgb is color, a is attenuation factor
+  highp vec4 light_color[4];
+  highp vec4 ambient_color;
+  highp int light_num;
+};
+uniform mat4 model_matrix;
+uniform float texcoord_repeat;
+// [0] is (height offset, height scale, cell size, height factor)
+// [1] is (grid width, grid height, whether normal map is enabled, unused)
+uniform vec4 heightfield_params[2];
+// quantized heights, one texel per grid vertex
+uniform highp usampler2D heightmap_sampler;
+uniform mediump sampler2D normalmap_sampler;
+
+// x and z in cells relative to patch, then 1 for skirt vertex, otherwise 0
+in vec3 grid_vertex;
+// per-instance, origin of patch in cells then depth of its skirts
+in vec3 patch;
+
+out vec2 outin_texcoord;
+out vec2 tiled_texcoord;
+out vec3 surface_normal;
+out vec3 tocam_dir;
+out vec3 tolight_dir[4];
+out float visibility;
+
+float height_at(ivec2 texel, ivec2 grid_size)
+{
+  texel = clamp(texel, ivec2(0), grid_size);
+  return heightfield_params[0].x + float(texelFetch(heightmap_sampler, texel, 0).r) * heightfield_params[0].y;
+}
+
+void main()
+{
+  ivec2 grid_size = ivec2(heightfield_params[1].xy);
+  float cell_size = heightfield_params[0].z;
+
+  // patches at far edges are padded by repeating the last row and column of grid
+  ivec2 texel = min(ivec2(patch.xy + grid_vertex.xy), grid_size);
+  float h = height_at(texel, grid_size) - grid_vertex.z * patch.z;
+  vec3 position = vec3(float(texel.x) * cell_size, h, float(texel.y) * cell_size);
+  vec2 uv = vec2(texel) / vec2(grid_size);
+
+  vec3 n;
+  if (heightfield_params[1].z == 1.0f)
+  {
+    n = texelFetch(normalmap_sampler, texel, 0).xyz;
+  }
+  else
+  {
+    float hL = height_at(texel - ivec2(1, 0), grid_size);
+    float hR = height_at(texel + ivec2(1, 0), grid_size);
+    float hD = height_at(texel - ivec2(0, 1), grid_size);
+    float hU = height_at(texel + ivec2(0, 1), grid_size);
+    // central differences on heights before applying height factor, as on CPU
+    n = normalize(vec3(hL - hR, 2.0f * heightfield_params[0].w, hD - hU));
+  }
+
+  vec4 world_position = model_matrix * vec4(position, 1.0f);
+
+  // process texcoord
+  outin_texcoord = uv;
+  tiled_texcoord = uv * texcoord_repeat;
+  surface_normal = (model_matrix * vec4(n, 0.0f)).xyz;
+
+  for (int i=0; i<light_num; ++i)
+  {
+    tolight_dir[i] = light_position[i].xyz - world_position.xyz;
+  }
+
+  // calculate direction to camera
+  tocam_dir = camera_position.xyz - world_position.xyz;
+
+  // calculate fog
+  // from eqaution e^(-((distance*density)^gradient)) 
+  if (fog_enabled == 1.0f)
+  {
+    vec4 position_rel_to_cam = view_matrix * world_position;
+    float dst = length(position_rel_to_cam.xyz);
+    visibility = exp(-pow(dst*fog_density, fog_gradient));
+  }
+
+  // process vertex
+  gl_Position = projection_matrix * view_matrix * world_position;
+}
@@ -0,0 +1,93 @@
+#version 300 es
+
+// camera and lights are shared by all 3D shaders, see KRR_SCENEUBO
+// precision is explicit as blocks have to match between vertex and fragment shader
+layout(std140) uniform camera_block
+{
+  highp mat4 projection_matrix;
+  highp mat4 view_matrix;
+  // xyz is camera position in world space
+  highp vec4 camera_position;
+  highp vec4 sky_color;
+  highp float fog_enabled;
+  highp float fog_density;
+  highp float fog_gradient;
+};
+layout(std140) uniform lights_block
+{
+  highp vec4 light_position[4];
+  // rgb is color, a is attenuation factor
+  highp vec4 light_color[4];
+  highp vec4 ambient_color;
+  highp int light_num;
+};
+uniform mat4 model_matrix;
+// dequantization of packed vertices, [0] is offset and [1] is scale
+// it's identity for full-float vertices
+uniform vec3 dequant_position[2];
+uniform vec2 dequant_texcoord[2];
+
+// locations are fixed so vao can be shared with non-instanced variant of this shader
+layout(location = 0) in vec3 vertex_pos3d;
+layout(location = 1) in vec2 texcoord;
+layout(location = 2) in vec3 normal;
+// per-instance attributes, model matrix takes 4 locations
+layout(location = 3) in mat4 instance_model_matrix;
+// packed x-axis in first two vecs, and y-axis for second two vecs
+// format is (min_u, max_u), (min_v, max_v)
+layout(location = 7) in vec4 instance_clip_texture_uv;
+
+out vec2 outin_texcoord;
+out vec3 surface_normal;
+out vec3 tocam_dir;
+out vec3 tolight_dir[4];
+out float visibility;
+
+void main()
+{
+  // dequantize attributes
+  vec3 position = dequant_position[0] + vertex_pos3d * dequant_position[1];
+  vec2 uv = dequant_texcoord[0] + texcoord * dequant_texcoord[1];
+
+  // model_matrix is applied on top of every instance
+  mat4 instance_matrix = model_matrix * instance_model_matrix;
+  vec4 world_position = instance_matrix * vec4(position, 1.0f);
+
+  // process texcoord
+	if (instance_clip_texture_uv.x == 0.0 &&
+			instance_clip_texture_uv.y == 0.0 &&
+			instance_clip_texture_uv.z == 0.0 &&
+			instance_clip_texture_uv.w == 0.0)
+	{
+		outin_texcoord = uv;
+	}
+	// this is sprite inside the sheet
+	else
+	{
+		// calculate result texcoord xy
+		outin_texcoord.x = (instance_clip_texture_uv.y - instance_clip_texture_uv.x) * uv.x + instance_clip_texture_uv.x;
+		outin_texcoord.y = (instance_clip_texture_uv.w - instance_clip_texture_uv.z) * uv.y + instance_clip_texture_uv.z;
+	}
+
+  surface_normal = (instance_matrix * vec4(normal, 0.0f)).xyz;
+
+  for (int i=0; i<light_num; ++i)
+  {
+    tolight_dir[i] = light_position[i].xyz - world_position.xyz;
+  }
+
+  // calculate direction to camera
+  tocam_dir = camera_position.xyz - world_position.xyz;
+
+  // calculate fog
+  // from eqaution e^(-((distance*density)^gradient)) 
+  if (fog_enabled == 1.0f)
+  {
+    vec4 position_rel_to_cam = view_matrix * world_position;
+    float dst = length(position_rel_to_cam.xyz);
+    visibility = exp(-pow(dst*fog_density, fog_gradient));
+  }
+
+  // process vertex
+  gl_Position = projection_matrix * view_matrix * world_position;
+}
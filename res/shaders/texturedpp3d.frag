@@ -3,14 +3,29 @@
 precision mediump float;
 
 uniform sampler2D texture_sampler;
-uniform lowp int light_num;
-uniform float light_attenuation[4];
-uniform vec3 light_color[4];
+// camera and lights are shared by all 3D shaders, see KRR_SCENEUBO
+// precision is explicit as blocks have to match between vertex and fragment shader
+layout(std140) uniform camera_block
+{
+  highp mat4 projection_matrix;
+  highp mat4 view_matrix;
+  // xyz is camera position in world space
+  highp vec4 camera_position;
+  highp vec4 sky_color;
+  highp float fog_enabled;
+  highp float fog_density;
+  highp float fog_gradient;
+};
+layout(std140) uniform lights_block
+{
+  highp vec4 light_position[4];
+  // rgb is color, a is attenuation factor
+  highp vec4 light_color[4];
+  highp vec4 ambient_color;
+  highp int light_num;
+};
 uniform float shine_damper;
 uniform float reflectivity;
-uniform vec3 ambient_color;
-uniform vec3 sky_color;
-uniform lowp float fog_enabled;
 
 // texture coordinate
 in vec2 outin_texcoord;
@@ -33,11 +48,11 @@ void main()
   {
     // use equation attenuation_factor = 1 + c*(d^2)
     float dist_sq = pow(tolight_dir[i].x, 2.0f) + pow(tolight_dir[i].y, 2.0f) + pow(tolight_dir[i].z, 2.0f);
-    float attenuation_denom = 1.0f + light_attenuation[i]*dist_sq;
+    float attenuation_denom = 1.0f + light_color[i].a*dist_sq;
     
     vec3 light_dir = normalize(tolight_dir[i]);
     float brightness = max(dot(unit_normal, light_dir), 0.0f);
-    total_diffuse = total_diffuse + (brightness * light_color[i] + ambient_color) / attenuation_denom;
+    total_diffuse = total_diffuse + (brightness * light_color[i].rgb + ambient_color.rgb) / attenuation_denom;
 
     // calculate specular
     // note: normalize tocam_dir here as there's no guaruntee it will be unit vector after interpolation resulting from vertex shader
@@ -45,12 +60,12 @@ void main()
     vec3 reflected_light_dir = reflect(fromlight_dir, unit_normal);
     float specular_factor = max(dot(reflected_light_dir, normalize(tocam_dir)), 0.0f);
     float damped_factor = pow(specular_factor, shine_damper);
-    total_specular = total_specular + (damped_factor * light_color[i] * reflectivity) / attenuation_denom;
+    total_specular = total_specular + (damped_factor * light_color[i].rgb * reflectivity) / attenuation_denom;
   }
 
   final_color = vec4(total_diffuse, 1.0f) * texture(texture_sampler, outin_texcoord) + vec4(total_specular, 1.0f);
   if (fog_enabled == 1.0f)
   {
-    final_color = mix(vec4(sky_color,1.0f), final_color, visibility);
+    final_color = mix(vec4(sky_color.rgb, 1.0f), final_color, visibility);
   }
 }
@@ -5,6 +5,7 @@
 #include "krr/foundation/util.h"
 #include "krr/foundation/cam.h"
 #include "krr/graphics/util.h"
+#include "krr/graphics/glstate.h"
 #include "krr/graphics/texturedpp2d.h"
 #include "krr/graphics/font.h"
 #include "krr/graphics/fontpp2d.h"
@@ -99,19 +100,19 @@ bool usercode_init(int screen_width, int screen_height, int logical_width, int l
 
   // initialize the viewport
   // define the area where to render, for now full screen
-  glViewport(0, 0, g_screen_width, g_screen_height);
+  KRR_GLSTATE_viewport(0, 0, g_screen_width, g_screen_height);
 
   // initialize clear color
   glClearColor(0.f, 0.f, 0.f, 1.f);
 
   // enable blending with default blend function
-  glEnable(GL_BLEND);
+  KRR_GLSTATE_enable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
   // enable face culling
-  glEnable(GL_CULL_FACE);
+  KRR_GLSTATE_enable(GL_CULL_FACE);
   // enable depth test
-  glEnable(GL_DEPTH_TEST);
+  KRR_GLSTATE_enable(GL_DEPTH_TEST);
 
   // initially start user's camera looking at -z, and up with +y
   glm_vec3_copy((vec3){0.0f, 0.0f, -1.0f}, cam.forward);
@@ -311,7 +312,7 @@ void usercode_render()
   if (g_need_clipping)
   {
     // clear color for content area
-    glEnable(GL_SCISSOR_TEST);
+    KRR_GLSTATE_enable(GL_SCISSOR_TEST);
     glScissor(g_offset_x, g_offset_y, g_ri_view_width, g_ri_view_height);
     glClearColor(CONTENT_BG_COLOR);
     glClear(GL_COLOR_BUFFER_BIT);
@@ -333,7 +334,7 @@ void usercode_render()
   // disable scissor (if needed)
   if (g_need_clipping)
   {
-    glDisable(GL_SCISSOR_TEST);
+    KRR_GLSTATE_disable(GL_SCISSOR_TEST);
   }
 }
 
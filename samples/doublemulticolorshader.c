@@ -9,6 +9,7 @@
 #include "krr/foundation/util.h"
 #include "krr/foundation/cam.h"
 #include "krr/graphics/util.h"
+#include "krr/graphics/glstate.h"
 #include "krr/graphics/texturedpp2d.h"
 #include "krr/graphics/font.h"
 #include "krr/graphics/fontpp2d.h"
@@ -457,17 +458,17 @@ bool usercode_init(int screen_width, int screen_height, int logical_width, int l
 
   // initialize the viewport
   // define the area where to render, for now full screen
-  glViewport(0, 0, g_screen_width, g_screen_height);
+  KRR_GLSTATE_viewport(0, 0, g_screen_width, g_screen_height);
 
   // initialize clear color
   glClearColor(0.f, 0.f, 0.f, 1.f);
 
   // enable blending with default blend function
-  glEnable(GL_BLEND);
+  KRR_GLSTATE_enable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
   // enable face culling
-  glEnable(GL_CULL_FACE);
+  KRR_GLSTATE_enable(GL_CULL_FACE);
 
   // initially start user's camera looking at -z, and up with +y
   glm_vec3_copy((vec3){0.0f, 0.0f, -1.0f}, cam.forward);
@@ -591,68 +592,68 @@ bool usercode_loadmedia()
 
   // create VBOs
   glGenBuffers(1, &vertex_vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, vertex_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, vertex_vbo);
   glBufferData(GL_ARRAY_BUFFER, 4 * sizeof(VERTEXPOS2D), quad_pos, GL_STATIC_DRAW);
 
   glGenBuffers(1, &rgby_vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, rgby_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, rgby_vbo);
   glBufferData(GL_ARRAY_BUFFER, 4 * sizeof(COLOR32), quad_color_rgby, GL_STATIC_DRAW);
 
   glGenBuffers(1, &cymw_vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, cymw_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, cymw_vbo);
   glBufferData(GL_ARRAY_BUFFER, 4 * sizeof(COLOR32), quad_color_cymw, GL_STATIC_DRAW);
 
   glGenBuffers(1, &gray_vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, gray_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, gray_vbo);
   glBufferData(GL_ARRAY_BUFFER, 4 * sizeof(COLOR32), quad_color_gray, GL_STATIC_DRAW);
 
   glGenBuffers(1, &ibo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+  KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, 4 * sizeof(GLuint), indices, GL_STATIC_DRAW);
 
   // left vao
   glGenVertexArrays(1, &left_vao);
 
   // bind vertex array
-  glBindVertexArray(left_vao);
+  KRR_GLSTATE_bind_vertex_array(left_vao);
   // enable vertex attributes
   KRR_DMULTICSHADERPROG2D_enable_all_vertex_attrib_pointers(multicolor_shader);
 
   // set vertex data
-  glBindBuffer(GL_ARRAY_BUFFER, vertex_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, vertex_vbo);
   KRR_DMULTICSHADERPROG2D_set_attrib_vertex_pos2d_pointer_packed(multicolor_shader, NULL);
 
-  glBindBuffer(GL_ARRAY_BUFFER, rgby_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, rgby_vbo);
   KRR_DMULTICSHADERPROG2D_set_attrib_multicolor_pointer_packed(multicolor_shader, 1, NULL);
 
-  glBindBuffer(GL_ARRAY_BUFFER, gray_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, gray_vbo);
   KRR_DMULTICSHADERPROG2D_set_attrib_multicolor_pointer_packed(multicolor_shader, 2, NULL);
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+  KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 
   // (note: not neccessary to unbin vao as setting a new one will overwrite the active vao, reduce cost in swithing vao)
   // right vao
   glGenVertexArrays(1, &right_vao);
 
   // bind vertex array
-  glBindVertexArray(right_vao);
+  KRR_GLSTATE_bind_vertex_array(right_vao);
   // enable vertex attributes
   KRR_DMULTICSHADERPROG2D_enable_all_vertex_attrib_pointers(multicolor_shader);
 
   // set vertex data
-  glBindBuffer(GL_ARRAY_BUFFER, vertex_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, vertex_vbo);
   KRR_DMULTICSHADERPROG2D_set_attrib_vertex_pos2d_pointer_packed(multicolor_shader, NULL);
 
-  glBindBuffer(GL_ARRAY_BUFFER, cymw_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, cymw_vbo);
   KRR_DMULTICSHADERPROG2D_set_attrib_multicolor_pointer_packed(multicolor_shader, 1, NULL);
 
-  glBindBuffer(GL_ARRAY_BUFFER, gray_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, gray_vbo);
   KRR_DMULTICSHADERPROG2D_set_attrib_multicolor_pointer_packed(multicolor_shader, 2, NULL);
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+  KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 
   // unbind vao
-  glBindVertexArray(0);
+  KRR_GLSTATE_bind_vertex_array(0);
 
   return true;
 }
@@ -766,7 +767,7 @@ void usercode_render()
   if (g_need_clipping)
   {
     // clear color for content area
-    glEnable(GL_SCISSOR_TEST);
+    KRR_GLSTATE_enable(GL_SCISSOR_TEST);
     glScissor(g_offset_x, g_offset_y, g_ri_view_width, g_ri_view_height);
     glClearColor(CONTENT_BG_COLOR);
     glClear(GL_COLOR_BUFFER_BIT);
@@ -774,7 +775,7 @@ void usercode_render()
 
   // TODO: render code goes here...
   // bind left vao
-  glBindVertexArray(left_vao);
+  KRR_GLSTATE_bind_vertex_array(left_vao);
     // bind shader
     KRR_SHADERPROG_bind(multicolor_shader->program);
 
@@ -790,7 +791,7 @@ void usercode_render()
     glDrawElements(GL_TRIANGLE_FAN, 4, GL_UNSIGNED_INT, NULL);
 
   // bind right vao
-  glBindVertexArray(right_vao);
+  KRR_GLSTATE_bind_vertex_array(right_vao);
     // start fresh
     glm_mat4_copy(g_base_ui_model_matrix, multicolor_shader->model_matrix);
     // transform matrix for right quad
@@ -803,12 +804,12 @@ void usercode_render()
     // unbind shader
     KRR_SHADERPROG_unbind(multicolor_shader->program);
   // unbind vao
-  glBindVertexArray(0);
+  KRR_GLSTATE_bind_vertex_array(0);
 
   // disable scissor (if needed)
   if (g_need_clipping)
   {
-    glDisable(GL_SCISSOR_TEST);
+    KRR_GLSTATE_disable(GL_SCISSOR_TEST);
   }
 }
 
@@ -867,17 +868,17 @@ void usercode_close()
   }
 
   if (vertex_vbo != 0)
-    glDeleteBuffers(1, &vertex_vbo);
+    KRR_GLSTATE_delete_buffers(1, &vertex_vbo);
   if (rgby_vbo != 0)
-    glDeleteBuffers(1, &rgby_vbo);
+    KRR_GLSTATE_delete_buffers(1, &rgby_vbo);
   if (cymw_vbo != 0)
-    glDeleteBuffers(1, &cymw_vbo);
+    KRR_GLSTATE_delete_buffers(1, &cymw_vbo);
   if (gray_vbo != 0)
-    glDeleteBuffers(1, &gray_vbo);
+    KRR_GLSTATE_delete_buffers(1, &gray_vbo);
   if (ibo != 0)
-    glDeleteBuffers(1, &ibo);
+    KRR_GLSTATE_delete_buffers(1, &ibo);
   if (left_vao != 0)
-    glDeleteVertexArrays(1, &left_vao);
+    KRR_GLSTATE_delete_vertex_arrays(1, &left_vao);
   if (right_vao != 0)
-    glDeleteVertexArrays(1, &right_vao);
+    KRR_GLSTATE_delete_vertex_arrays(1, &right_vao);
 }
@@ -5,6 +5,7 @@
 #include "krr/graphics/terrain_shader3d.h"
 #include "krr/graphics/skybox_shader.h"
 #include "krr/graphics/fontpp2d.h"
+#include "krr/graphics/sceneubo.h"
 #include "krr/foundation/log.h"
 
 mat4 g_ui_projection_matrix;
@@ -12,6 +13,7 @@ mat4 g_projection_matrix;
 mat4 g_view_matrix;
 mat4 g_base_ui_model_matrix;
 mat4 g_base_model_matrix;
+KRR_SCENEUBO* g_scene_ubo = NULL;
 
 void usercode_set_matrix_then_update_to_shader(enum USERCODE_MATRIXTYPE matrix_type, enum USERCODE_SHADERTYPE shader_program, void* program)
 {
@@ -25,26 +27,13 @@ void usercode_set_matrix_then_update_to_shader(enum USERCODE_MATRIXTYPE matrix_t
       glm_mat4_copy(g_ui_projection_matrix, shader_ptr->projection_matrix);
       KRR_TEXSHADERPROG2D_update_projection_matrix(shader_ptr);
     }
-    // texture3d shader
-    else if (shader_program == USERCODE_SHADERTYPE_TEXTURE3D_SHADER)
-    {
-      KRR_TEXSHADERPROG3D* shader_ptr = (KRR_TEXSHADERPROG3D*)program;
-      glm_mat4_copy(g_projection_matrix, shader_ptr->projection_matrix);
-      KRR_TEXSHADERPROG3D_update_projection_matrix(shader_ptr);
-    }
-    // texture alpha 3d shader
-    else if (shader_program == USERCODE_SHADERTYPE_TEXTUREALPHA3D_SHADER)
-    {
-      KRR_TEXALPHASHADERPROG3D* shader_ptr = (KRR_TEXALPHASHADERPROG3D*)program;
-      glm_mat4_copy(g_projection_matrix, shader_ptr->projection_matrix);
-      KRR_TEXALPHASHADERPROG3D_update_projection_matrix(shader_ptr);
-    }
-    // terrain shader
-    else if (shader_program == USERCODE_SHADERTYPE_TERRAIN_SHADER)
+    // 3d shaders share camera through g_scene_ubo
+    else if (shader_program == USERCODE_SHADERTYPE_TEXTURE3D_SHADER ||
+             shader_program == USERCODE_SHADERTYPE_TEXTUREALPHA3D_SHADER ||
+             shader_program == USERCODE_SHADERTYPE_TERRAIN_SHADER)
     {
-      KRR_TERRAINSHADERPROG3D* shader_ptr = (KRR_TERRAINSHADERPROG3D*)program;
-      glm_mat4_copy(g_projection_matrix, shader_ptr->projection_matrix);
-      KRR_TERRAINSHADERPROG3D_update_projection_matrix(shader_ptr);
+      glm_mat4_copy(g_projection_matrix, g_scene_ubo->camera.projection_matrix);
+      KRR_SCENEUBO_update_camera(g_scene_ubo);
     }
     // skybox shader
     else if (shader_program == USERCODE_SHADERTYPE_SKYBOX_SHADER)
@@ -71,26 +60,13 @@ void usercode_set_matrix_then_update_to_shader(enum USERCODE_MATRIXTYPE matrix_t
       glm_mat4_copy(g_view_matrix, shader_ptr->view_matrix);
       KRR_TEXSHADERPROG2D_update_view_matrix(shader_ptr);
     }
-    // texture 3d shader
-    else if (shader_program == USERCODE_SHADERTYPE_TEXTURE3D_SHADER)
-    {
-      KRR_TEXSHADERPROG3D* shader_ptr = (KRR_TEXSHADERPROG3D*)program;
-      glm_mat4_copy(g_view_matrix, shader_ptr->view_matrix);
-      KRR_TEXSHADERPROG3D_update_view_matrix(shader_ptr);
-    }
-    // texture alpha 3d shader
-    else if (shader_program == USERCODE_SHADERTYPE_TEXTUREALPHA3D_SHADER)
+    // 3d shaders share camera through g_scene_ubo
+    else if (shader_program == USERCODE_SHADERTYPE_TEXTURE3D_SHADER ||
+             shader_program == USERCODE_SHADERTYPE_TEXTUREALPHA3D_SHADER ||
+             shader_program == USERCODE_SHADERTYPE_TERRAIN_SHADER)
     {
-      KRR_TEXALPHASHADERPROG3D* shader_ptr = (KRR_TEXALPHASHADERPROG3D*)program;
-      glm_mat4_copy(g_view_matrix, shader_ptr->view_matrix);
-      KRR_TEXALPHASHADERPROG3D_update_view_matrix(shader_ptr);
-    }
-    // terrain shader
-    else if (shader_program == USERCODE_SHADERTYPE_TERRAIN_SHADER)
-    {
-      KRR_TERRAINSHADERPROG3D* shader_ptr = (KRR_TERRAINSHADERPROG3D*)program;
-      glm_mat4_copy(g_view_matrix, shader_ptr->view_matrix);
-      KRR_TERRAINSHADERPROG3D_update_view_matrix(shader_ptr);
+      glm_mat4_copy(g_view_matrix, g_scene_ubo->camera.view_matrix);
+      KRR_SCENEUBO_update_camera(g_scene_ubo);
     }
     // skybox shader
     else if (shader_program == USERCODE_SHADERTYPE_SKYBOX_SHADER)
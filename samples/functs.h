@@ -2,6 +2,7 @@
 #define KRR_TEST_FUNCTS_h_
 
 #include "krr/foundation/common.h"
+#include "krr/graphics/sceneubo.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -62,6 +63,8 @@ extern mat4 g_projection_matrix;
 extern mat4 g_view_matrix;
 extern mat4 g_base_ui_model_matrix;
 extern mat4 g_base_model_matrix;
+/// camera and lights shared by all 3d shaders, created by sample that uses 3d shaders
+extern KRR_SCENEUBO* g_scene_ubo;
 
 ///
 /// set matrix then update to shader
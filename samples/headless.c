@@ -1,4 +1,6 @@
-// similar to readobjfile sample, but headless and write frame snapshot to .tga file after 1st frame drew
+// similar to readobjfile sample, but headless and write frame snapshot to .tga file after 1st frame drew.
+// It also checks occlusion culling, i.e. under software GL (Mesa llvmpipe): a box hidden behind an occluder
+// has to be reported as occluded within the frames before snapshot, otherwise it exits with failure.
 
 #include "usercode.h"
 #include "functs.h"
@@ -7,12 +9,15 @@
 #include "krr/foundation/util.h"
 #include "krr/foundation/cam.h"
 #include "krr/graphics/util.h"
+#include "krr/graphics/glstate.h"
 #include "krr/graphics/texturedpp2d.h"
 #include "krr/graphics/texturedpp3d.h"
 #include "krr/graphics/model.h"
 #include "krr/graphics/font.h"
 #include "krr/graphics/fontpp2d.h"
 #include "krr/graphics/objloader.h"
+#include "krr/graphics/occlusion.h"
+#include "krr/graphics/occlusion_shader.h"
 
 // don't use this elsewhere
 #define CONTENT_BG_COLOR 0.f, 0.f, 0.f, 1.f
@@ -62,6 +67,13 @@ static SIMPLEMODEL* sm = NULL;
 static int num_frame = 0;
 static bool took_snapshot = false;
 
+// occlusion culling check, wall in front of camera hides box at origin
+static KRR_OCCLUSIONSHADERPROG* occlusion_shader = NULL;
+static KRR_OCCLUSION* occlusion = NULL;
+static const KRR_CULL_BOUNDS occluder_bounds = { {-50.0f, -50.0f, 39.0f}, {50.0f, 50.0f, 40.0f} };
+static const KRR_CULL_BOUNDS hidden_bounds = { {-1.0f, -1.0f, -1.0f}, {1.0f, 1.0f, 1.0f} };
+static bool occlusion_passed = false;
+
 static bool take_frame_snapshot_tofile(const char* dst_filepath)
 {
   const int number_of_pixels = g_logical_width * g_logical_height * 4;
@@ -127,6 +139,29 @@ static bool take_frame_snapshot_tofile(const char* dst_filepath)
   return true;
 }
 
+// render box of bounds into depth buffer only, so it occludes what's behind without showing up in snapshot
+static void render_occluder(const KRR_CULL_BOUNDS* bounds, mat4 view_projection)
+{
+  vec3 extent;
+  glm_vec3_sub((float*)bounds->aabb_max, (float*)bounds->aabb_min, extent);
+
+  KRR_SHADERPROG_bind(occlusion_shader->program);
+    glm_translate_to(view_projection, (float*)bounds->aabb_min, occlusion_shader->box_matrix);
+    glm_scale(occlusion_shader->box_matrix, extent);
+    KRR_OCCLUSIONSHADERPROG_update_box_matrix(occlusion_shader);
+    KRR_SHADERPROG_flush(occlusion_shader->program);
+
+    // unit cube of KRR_OCCLUSION has no consistent winding
+    KRR_GLSTATE_disable(GL_CULL_FACE);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    KRR_GLSTATE_bind_vertex_array(occlusion->vao_id);
+    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, NULL);
+    KRR_GLSTATE_bind_vertex_array(0);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    KRR_GLSTATE_enable(GL_CULL_FACE);
+  KRR_SHADERPROG_unbind(occlusion_shader->program);
+}
+
 void usercode_app_went_windowed_mode()
 {
   SU_BEGIN(texture_shader)
@@ -175,20 +210,20 @@ bool usercode_init(int screen_width, int screen_height, int logical_width, int l
 
   // initialize the viewport
   // define the area where to render, for now full screen
-  glViewport(0, 0, g_screen_width, g_screen_height);
+  KRR_GLSTATE_viewport(0, 0, g_screen_width, g_screen_height);
 
   // initialize clear color
   glClearColor(0.f, 0.f, 0.f, 1.f);
 
   // enable blending with default blend function
-  glEnable(GL_BLEND);
+  KRR_GLSTATE_enable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
   // enable face culling
-  glEnable(GL_CULL_FACE);
+  KRR_GLSTATE_enable(GL_CULL_FACE);
 
   // enable depth test
-  glEnable(GL_DEPTH_TEST);
+  KRR_GLSTATE_enable(GL_DEPTH_TEST);
 
   // initially start user's camera looking at -z, and up with +y
   glm_vec3_copy((vec3){0.0f, 0.0f, -1.0f}, cam.forward);
@@ -219,6 +254,9 @@ bool usercode_loadmedia()
   // set texture shader to all KRR_TEXTURE as active
   shared_textured_shaderprogram = texture_shader;
 
+  // create camera and lights shared by all 3d shaders
+  g_scene_ubo = KRR_SCENEUBO_new();
+
   // load texture3d shader
   texture3d_shader = KRR_TEXSHADERPROG3D_new();
   if (!KRR_TEXSHADERPROG3D_load_program(texture3d_shader))
@@ -239,6 +277,16 @@ bool usercode_loadmedia()
   // set font shader to all KRR_FONT as active
   shared_font_shaderprogram = font_shader;
 
+  // load occlusion shader
+  occlusion_shader = KRR_OCCLUSIONSHADERPROG_new();
+  if (!KRR_OCCLUSIONSHADERPROG_load_program(occlusion_shader))
+  {
+    KRR_LOGE("Error loading occlusion shader");
+    return false;
+  }
+  // set occlusion shader
+  shared_occlusion_shaderprogram = occlusion_shader;
+
 #ifndef DISABLE_FPS_CALC
   // load font to render framerate
   {
@@ -275,25 +323,21 @@ bool usercode_loadmedia()
 
   SU_BEGIN(texture3d_shader)
     SU_TEXSHADERPROG3D(texture3d_shader)
-    // update ambient color
-    glm_vec3_copy((vec3){0.0f, 0.0f, 0.0f}, texture3d_shader->ambient_color);
-    KRR_TEXSHADERPROG3D_update_ambient_color(texture3d_shader);
     // set texture unit
     KRR_TEXSHADERPROG3D_set_texture_sampler(texture3d_shader, 0);
-    // set lighting
-    vec3 light_pos = {0.0f, 6.0f, 10.0f};
-    vec3 light_color = {1.0f, 1.f, 1.f};
-    memcpy(&texture3d_shader->lights[0].pos, &light_pos, sizeof(VERTEXPOS3D));
-    memcpy(&texture3d_shader->lights[0].color, &light_color, sizeof(COLOR3F));
-    // update lights we have
-    KRR_TEXSHADERPROG3D_update_lights_num(texture3d_shader, 1);
+    // set lighting, and ambient color
+    LIGHT light = { {0.0f, 6.0f, 10.0f}, {1.0f, 1.f, 1.f}, 0.0f };
+    KRR_SCENEUBO_set_light(g_scene_ubo, 0, &light);
+    g_scene_ubo->lights.num = 1;
+    glm_vec4_copy((vec4){0.0f, 0.0f, 0.0f, 1.0f}, g_scene_ubo->lights.ambient_color);
+    KRR_SCENEUBO_update_lights(g_scene_ubo);
     // set specular lighting
     texture3d_shader->shine_damper = 10.0f;
     texture3d_shader->reflectivity = 0.1f;
     KRR_TEXSHADERPROG3D_update_shininess(texture3d_shader);
     // disable fog
-    texture3d_shader->fog_enabled = false;
-    KRR_TEXSHADERPROG3D_update_fog_enabled(texture3d_shader);
+    g_scene_ubo->camera.fog_enabled = 0.0f;
+    KRR_SCENEUBO_update_camera(g_scene_ubo);
     
   SU_BEGIN(font_shader)
     SU_FONTSHADER(font_shader)
@@ -309,6 +353,9 @@ bool usercode_loadmedia()
     return false;
   }
 
+  // occlusion queries for hidden box
+  occlusion = KRR_OCCLUSION_new(1);
+
   return true;
 }
 
@@ -410,6 +457,13 @@ void usercode_render()
   {
     took_snapshot = true;
 
+    if (!occlusion_passed)
+    {
+      KRR_LOGE("Hidden box was not reported as occluded within %d frames", num_frame);
+      exit(EXIT_FAILURE);
+    }
+    KRR_LOG("Occlusion culling reported hidden box as occluded");
+
     if (take_frame_snapshot_tofile("headless-snapshot.tga"))
     {
       KRR_LOG("Successfully took snapshot and wrote into .tga file");
@@ -435,7 +489,7 @@ void usercode_render()
   if (g_need_clipping)
   {
     // clear color for content area
-    glEnable(GL_SCISSOR_TEST);
+    KRR_GLSTATE_enable(GL_SCISSOR_TEST);
     glScissor(g_offset_x, g_offset_y, g_ri_view_width, g_ri_view_height);
     glClearColor(CONTENT_BG_COLOR);
     glClear(GL_COLOR_BUFFER_BIT);
@@ -445,10 +499,10 @@ void usercode_render()
   // bind shader
   KRR_SHADERPROG_bind(texture3d_shader->program);
     // bind vao
-    glBindVertexArray(sm->vao_id);
+    KRR_GLSTATE_bind_vertex_array(sm->vao_id);
 
     // bind texture
-    glBindTexture(GL_TEXTURE_2D, texture->texture_id);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, texture->texture_id);
 
     // transform model matrix
     glm_mat4_copy(g_base_model_matrix, texture3d_shader->model_matrix);
@@ -459,15 +513,33 @@ void usercode_render()
     SIMPLEMODEL_render(sm);
 
     // unbind vao
-    glBindVertexArray(0);
+    KRR_GLSTATE_bind_vertex_array(0);
 
   // unbind shader
   KRR_SHADERPROG_unbind(texture3d_shader->program);
 
+  // occlusion culling check
+  // results lag behind by a frame or more, so box is queried every frame until it's reported as occluded
+  {
+    CGLM_ALIGN_MAT mat4 view_projection;
+    glm_mat4_mul(g_projection_matrix, g_view_matrix, view_projection);
+
+    KRR_OCCLUSION_begin_frame(occlusion);
+    render_occluder(&occluder_bounds, view_projection);
+
+    KRR_OCCLUSION_query(occlusion, 0, &hidden_bounds, view_projection);
+    // box would be rendered here if it's visible
+    KRR_OCCLUSION_is_visible(occlusion, 0);
+    KRR_OCCLUSION_flush(occlusion);
+
+    if (occlusion->stats.issued > 0 && occlusion->stats.skipped == 1)
+      occlusion_passed = true;
+  }
+
   // disable scissor (if needed)
   if (g_need_clipping)
   {
-    glDisable(GL_SCISSOR_TEST);
+    KRR_GLSTATE_disable(GL_SCISSOR_TEST);
   }
 
   ++num_frame;
@@ -521,11 +593,26 @@ void usercode_close()
     KRR_TEXSHADERPROG2D_free(texture_shader);
     texture_shader = NULL;
   }
+  if (g_scene_ubo != NULL)
+  {
+    KRR_SCENEUBO_free(g_scene_ubo);
+    g_scene_ubo = NULL;
+  }
   if (texture3d_shader != NULL)
   {
     KRR_TEXSHADERPROG3D_free(texture3d_shader);
     texture3d_shader = NULL;
   }
+  if (occlusion != NULL)
+  {
+    KRR_OCCLUSION_free(occlusion);
+    occlusion = NULL;
+  }
+  if (occlusion_shader != NULL)
+  {
+    KRR_OCCLUSIONSHADERPROG_free(occlusion_shader);
+    occlusion_shader = NULL;
+  }
 
   if (sm != NULL)
   {
@@ -17,6 +17,9 @@
 #include "krr/graphics/texture.h"
 #include "krr/graphics/spritesheet.h"
 #include "krr/graphics/font.h"
+#include "krr/graphics/glstate.h"
+#include "krr/graphics/shaderprog.h"
+#include "krr/graphics/cull.h"
 
 #include "usercode.h"
 
@@ -228,6 +231,11 @@ void render()
 {
   if (!gWindow->is_minimized)
   {
+    // count GL calls issued and filtered, uniform uploads, and culled objects per frame
+    KRR_GLSTATE_reset_stats();
+    KRR_SHADERPROG_reset_uniform_stats();
+    KRR_CULL_reset_stats();
+
     // relay call to user's code in separate file
     usercode_render();
     usercode_render_ui_text();
@@ -9,6 +9,7 @@
 #include "krr/foundation/util.h"
 #include "krr/foundation/cam.h"
 #include "krr/graphics/util.h"
+#include "krr/graphics/glstate.h"
 #include "krr/graphics/texturedpp2d.h"
 #include "krr/graphics/texturedpp3d.h"
 #include "krr/graphics/model.h"
@@ -111,20 +112,20 @@ bool usercode_init(int screen_width, int screen_height, int logical_width, int l
 
   // initialize the viewport
   // define the area where to render, for now full screen
-  glViewport(0, 0, g_screen_width, g_screen_height);
+  KRR_GLSTATE_viewport(0, 0, g_screen_width, g_screen_height);
 
   // initialize clear color
   glClearColor(0.f, 0.f, 0.f, 1.f);
 
   // enable blending with default blend function
-  glEnable(GL_BLEND);
+  KRR_GLSTATE_enable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
   // enable face culling
-  glEnable(GL_CULL_FACE);
+  KRR_GLSTATE_enable(GL_CULL_FACE);
 
   // enable depth test
-  glEnable(GL_DEPTH_TEST);
+  KRR_GLSTATE_enable(GL_DEPTH_TEST);
 
   // initially start user's camera looking at -z, and up with +y
   glm_vec3_copy((vec3){0.0f, 0.0f, -1.0f}, cam.forward);
@@ -155,6 +156,9 @@ bool usercode_loadmedia()
   // set texture shader to all KRR_TEXTURE as active
   shared_textured_shaderprogram = texture_shader;
 
+  // create camera and lights shared by all 3d shaders
+  g_scene_ubo = KRR_SCENEUBO_new();
+
   // load texture3d shader
   texture3d_shader = KRR_TEXSHADERPROG3D_new();
   if (!KRR_TEXSHADERPROG3D_load_program(texture3d_shader))
@@ -214,11 +218,10 @@ bool usercode_loadmedia()
     // set texture unit
     KRR_TEXSHADERPROG3D_set_texture_sampler(texture3d_shader, 0);
     // set lighting
-    vec3 light_pos = {0.0f, 5.0f, 10.0f};
-    vec3 light_color = {1.0f, 1.f, 1.f};
-    memcpy(&texture3d_shader->light.pos, &light_pos, sizeof(VERTEXPOS3D));
-    memcpy(&texture3d_shader->light.color, &light_color, sizeof(COLOR3F));
-    KRR_TEXSHADERPROG3D_update_light(texture3d_shader);
+    LIGHT light = { {0.0f, 5.0f, 10.0f}, {1.0f, 1.f, 1.f}, 0.0f };
+    KRR_SCENEUBO_set_light(g_scene_ubo, 0, &light);
+    g_scene_ubo->lights.num = 1;
+    KRR_SCENEUBO_update_lights(g_scene_ubo);
     // set specular lighting
     texture3d_shader->shine_damper = 10.0f;
     texture3d_shader->reflectivity = 0.05f;
@@ -357,7 +360,7 @@ void usercode_render()
   if (g_need_clipping)
   {
     // clear color for content area
-    glEnable(GL_SCISSOR_TEST);
+    KRR_GLSTATE_enable(GL_SCISSOR_TEST);
     glScissor(g_offset_x, g_offset_y, g_ri_view_width, g_ri_view_height);
     glClearColor(CONTENT_BG_COLOR);
     glClear(GL_COLOR_BUFFER_BIT);
@@ -365,12 +368,12 @@ void usercode_render()
 
   // TODO: render code goes here...
   // bind vao
-  glBindVertexArray(sm->vao_id);
+  KRR_GLSTATE_bind_vertex_array(sm->vao_id);
     // bind shader
     KRR_SHADERPROG_bind(texture3d_shader->program);
 
     // bind texture
-    glBindTexture(GL_TEXTURE_2D, texture->texture_id);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, texture->texture_id);
 
     // instance 1
     // transform model matrix
@@ -397,12 +400,12 @@ void usercode_render()
     // unbind shader
     KRR_SHADERPROG_unbind(texture3d_shader->program);
   // unbind vao
-  glBindVertexArray(0);
+  KRR_GLSTATE_bind_vertex_array(0);
 
   // disable scissor (if needed)
   if (g_need_clipping)
   {
-    glDisable(GL_SCISSOR_TEST);
+    KRR_GLSTATE_disable(GL_SCISSOR_TEST);
   }
 }
 
@@ -454,6 +457,11 @@ void usercode_close()
     KRR_TEXSHADERPROG2D_free(texture_shader);
     texture_shader = NULL;
   }
+  if (g_scene_ubo != NULL)
+  {
+    KRR_SCENEUBO_free(g_scene_ubo);
+    g_scene_ubo = NULL;
+  }
   if (texture3d_shader != NULL)
   {
     KRR_TEXSHADERPROG3D_free(texture3d_shader);
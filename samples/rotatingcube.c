@@ -9,6 +9,7 @@
 #include "krr/foundation/util.h"
 #include "krr/foundation/cam.h"
 #include "krr/graphics/util.h"
+#include "krr/graphics/glstate.h"
 #include "krr/graphics/texturedpp2d.h"
 #include "krr/graphics/texturedpp3d.h"
 #include "krr/graphics/font.h"
@@ -117,18 +118,18 @@ bool usercode_init(int screen_width, int screen_height, int logical_width, int l
 
   // initialize the viewport
   // define the area where to render, for now full screen
-  glViewport(0, 0, g_screen_width, g_screen_height);
+  KRR_GLSTATE_viewport(0, 0, g_screen_width, g_screen_height);
 
   // initialize clear color
   glClearColor(0.f, 0.f, 0.f, 1.f);
 
   // enable blending with default blend function
-  glEnable(GL_BLEND);
+  KRR_GLSTATE_enable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
   // enable cull face, and depth test
-  glEnable(GL_CULL_FACE);
-  glEnable(GL_DEPTH_TEST);
+  KRR_GLSTATE_enable(GL_CULL_FACE);
+  KRR_GLSTATE_enable(GL_DEPTH_TEST);
 
   // initially start user's camera looking at -z, and up with +y
   glm_vec3_copy((vec3){0.0f, 0.0f, -1.0f}, cam.forward);
@@ -158,6 +159,9 @@ bool usercode_loadmedia()
   }
   shared_textured_shaderprogram = texture_shader;
 
+  // create camera and lights shared by all 3d shaders
+  g_scene_ubo = KRR_SCENEUBO_new();
+
   // load texture3d shader
   texture3d_shader = KRR_TEXSHADERPROG3D_new();
   if (!KRR_TEXSHADERPROG3D_load_program(texture3d_shader))
@@ -217,11 +221,10 @@ bool usercode_loadmedia()
     // set texture unit
     KRR_TEXSHADERPROG3D_set_texture_sampler(texture3d_shader, 0);
     // set lighting
-    vec3 light_pos = {0.0f, 2.0f, 6.0f};
-    vec3 light_color = {1.0f, 1.f, 1.f};
-    memcpy(&texture3d_shader->lights[0].pos, &light_pos, sizeof(VERTEXPOS3D));
-    memcpy(&texture3d_shader->lights[0].color, &light_color, sizeof(COLOR3F));
-    KRR_TEXSHADERPROG3D_update_lights(texture3d_shader);
+    LIGHT light = { {0.0f, 2.0f, 6.0f}, {1.0f, 1.f, 1.f}, 0.0f };
+    KRR_SCENEUBO_set_light(g_scene_ubo, 0, &light);
+    g_scene_ubo->lights.num = 1;
+    KRR_SCENEUBO_update_lights(g_scene_ubo);
     // set specular lighting
     texture3d_shader->shine_damper = 10.0f;
     texture3d_shader->reflectivity = 0.5f;
@@ -401,45 +404,45 @@ bool usercode_loadmedia()
 
   // create VBOs
   glGenBuffers(1, &vertex_vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, vertex_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, vertex_vbo);
   glBufferData(GL_ARRAY_BUFFER, 24 * sizeof(VERTEXPOS3D), quad_pos, GL_STATIC_DRAW);
 
   glGenBuffers(1, &texcoord_vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, texcoord_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, texcoord_vbo);
   glBufferData(GL_ARRAY_BUFFER, 24 * sizeof(TEXCOORD2D), texcoord, GL_STATIC_DRAW);
 
   glGenBuffers(1, &normal_vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, normal_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, normal_vbo);
   glBufferData(GL_ARRAY_BUFFER, 24 * sizeof(NORMAL), normals, GL_STATIC_DRAW);
 
   glGenBuffers(1, &ibo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+  KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, 36 * sizeof(GLuint), indices, GL_STATIC_DRAW);
 
   // vao, then bind
   glGenVertexArrays(1, &vao);
-  glBindVertexArray(vao);
+  KRR_GLSTATE_bind_vertex_array(vao);
 
   // enable vertex attributes
   KRR_TEXSHADERPROG3D_enable_attrib_pointers(texture3d_shader);
 
   // set vertex data
-  glBindBuffer(GL_ARRAY_BUFFER, vertex_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, vertex_vbo);
   KRR_TEXSHADERPROG3D_set_vertex_pointer(texture3d_shader, sizeof(VERTEXPOS3D), NULL);
 
   // set texcoord data
-  glBindBuffer(GL_ARRAY_BUFFER, texcoord_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, texcoord_vbo);
   KRR_TEXSHADERPROG3D_set_texcoord_pointer(texture3d_shader, sizeof(TEXCOORD2D), NULL);
 
   // set normal data
-  glBindBuffer(GL_ARRAY_BUFFER, normal_vbo);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, normal_vbo);
   KRR_TEXSHADERPROG3D_set_normal_pointer(texture3d_shader, sizeof(NORMAL), NULL);
 
   // ibo
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+  KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 
   // unbind vao
-  glBindVertexArray(0);
+  KRR_GLSTATE_bind_vertex_array(0);
 
   return true;
 }
@@ -566,7 +569,7 @@ void usercode_render()
   if (g_need_clipping)
   {
     // clear color for content area
-    glEnable(GL_SCISSOR_TEST);
+    KRR_GLSTATE_enable(GL_SCISSOR_TEST);
     glScissor(g_offset_x, g_offset_y, g_ri_view_width, g_ri_view_height);
     glClearColor(CONTENT_BG_COLOR);
     glClear(GL_COLOR_BUFFER_BIT);
@@ -577,12 +580,12 @@ void usercode_render()
 
   // TODO: render code goes here...
   // bind vao
-  glBindVertexArray(vao);
+  KRR_GLSTATE_bind_vertex_array(vao);
     // bind shader
     KRR_SHADERPROG_bind(texture3d_shader->program);
 
     // bind texture
-    glBindTexture(GL_TEXTURE_2D, texture->texture_id);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, texture->texture_id);
 
     // rotate
     glm_mat4_copy(g_base_model_matrix, texture3d_shader->model_matrix);
@@ -594,18 +597,20 @@ void usercode_render()
     KRR_TEXSHADERPROG3D_update_model_matrix(texture3d_shader);
 
     // render quad
+    // drawing directly, upload uniforms set so far
+    KRR_SHADERPROG_flush(texture3d_shader->program);
     glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, NULL);
 
     // unbind shader
     KRR_SHADERPROG_unbind(texture3d_shader->program);
 
   // unbind vao
-  glBindVertexArray(0);
+  KRR_GLSTATE_bind_vertex_array(0);
 
   // disable scissor (if needed)
   if (g_need_clipping)
   {
-    glDisable(GL_SCISSOR_TEST);
+    KRR_GLSTATE_disable(GL_SCISSOR_TEST);
   }
 }
 
@@ -657,6 +662,11 @@ void usercode_close()
     KRR_TEXSHADERPROG2D_free(texture_shader);
     texture_shader = NULL;
   }
+  if (g_scene_ubo != NULL)
+  {
+    KRR_SCENEUBO_free(g_scene_ubo);
+    g_scene_ubo = NULL;
+  }
   if (texture3d_shader != NULL)
   {
     KRR_TEXSHADERPROG3D_free(texture3d_shader);
@@ -670,13 +680,13 @@ void usercode_close()
   }
 
   if (vertex_vbo != 0)
-    glDeleteBuffers(1, &vertex_vbo);
+    KRR_GLSTATE_delete_buffers(1, &vertex_vbo);
   if (texcoord_vbo != 0) 
-    glDeleteBuffers(1, &texcoord_vbo);
+    KRR_GLSTATE_delete_buffers(1, &texcoord_vbo);
   if (normal_vbo != 0)
-    glDeleteBuffers(1, &normal_vbo);
+    KRR_GLSTATE_delete_buffers(1, &normal_vbo);
   if (ibo != 0)
-    glDeleteBuffers(1, &ibo);
+    KRR_GLSTATE_delete_buffers(1, &ibo);
   if (vao != 0)
-    glDeleteVertexArrays(1, &vao);
+    KRR_GLSTATE_delete_vertex_arrays(1, &vao);
 }
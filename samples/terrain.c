@@ -7,6 +7,8 @@
  Key Control
  - TAB - to show/hide debugging text on the left
  - z - to switch between fixed moselook and freelook mode
+ - o - to toggle occlusion culling of stall, trees, and lamps
+ - b/v - to raise/lower terrain around player, hold to keep sculpting
  - w/s/a/d and q/e to move foward/backward/strafe-left/strafe-right and move-down/move-up
  - enter switch between fullscreen and windowed mode
 
@@ -22,12 +24,18 @@
 #include "krr/foundation/cam.h"
 #include "krr/foundation/math.h"
 #include "krr/graphics/util.h"
+#include "krr/graphics/glstate.h"
 #include "krr/graphics/texturedpp2d.h"
 #include "krr/graphics/texturedpp3d.h"
 #include "krr/graphics/texturedalphapp3d.h"
 #include "krr/graphics/terrain_shader3d.h"
 #include "krr/graphics/terrain.h"
 #include "krr/graphics/model.h"
+#include "krr/graphics/meshpool.h"
+#include "krr/graphics/cull.h"
+#include "krr/graphics/occlusion.h"
+#include "krr/graphics/occlusion_shader.h"
+#include "krr/graphics/renderqueue.h"
 #include "krr/graphics/font.h"
 #include "krr/graphics/fontpp2d.h"
 #include "krr/graphics/skybox.h"
@@ -44,6 +52,9 @@
 #define TEXT_RES_FREELOOK_DISABLED "Freelook mode: disabled"
 #define TEXT_RES_FREELOOK_ENABLED "Freelook mode: enabled"
 
+#define DEBUG_TEXT_BUFFER 255+1
+static char debug_text[DEBUG_TEXT_BUFFER];
+
 #ifndef DISABLE_FPS_CALC
 #define FPS_BUFFER 7+1
 char fps_text[FPS_BUFFER];
@@ -82,11 +93,27 @@ static void handle_fullscreen_mode();
 static KRR_TEXSHADERPROG2D* texture_shader = NULL;
 static KRR_TEXSHADERPROG3D* texture3d_shader = NULL;
 static KRR_TEXALPHASHADERPROG3D* texturealpha3d_shader = NULL;
+static KRR_TEXSHADERPROG3D* texture3d_instanced_shader = NULL;
+static KRR_TEXALPHASHADERPROG3D* texturealpha3d_instanced_shader = NULL;
 static KRR_TERRAINSHADERPROG3D* terrain3d_shader = NULL;
 static KRR_SKYBOXSHADERPROG* skybox_shader = NULL;
+static KRR_OCCLUSIONSHADERPROG* occlusion_shader = NULL;
 static KRR_FONTSHADERPROG2D* font_shader = NULL;
 static KRR_FONT* font = NULL;
 
+// models are rendered through render queue to minimize state changes
+static KRR_RENDERQUEUE* render_queue = NULL;
+
+// uniforms of each model submitted to render queue
+typedef struct
+{
+  KRR_TEXSHADERPROG3D* shader;
+  CGLM_ALIGN_MAT mat4 model_matrix;
+} TEXTURE3D_UNIFORMS;
+
+static void apply_texture3d_uniforms(const void* uniforms);
+static void submit_model(SIMPLEMODEL* model, KRR_TEXTURE* texture, const TEXTURE3D_UNIFORMS* uniforms, vec3 pos);
+
 // TODO: define variables here
 static KRR_TEXTURE* terrain_texture = NULL;
 static KRR_TEXTURE* stall_texture = NULL;
@@ -105,8 +132,16 @@ static SIMPLEMODEL* tree = NULL;
 static SIMPLEMODEL* fern = NULL;
 static SIMPLEMODEL* player = NULL;
 static SIMPLEMODEL* lamp = NULL;
+// props share buffers of this pool
+static KRR_MESHPOOL* model_pool = NULL;
 static TERRAIN* tr = NULL;
 static KRR_SKYBOX* skybox = NULL;
+// occlusion culling of props, objects are stall, then trees, then lamps
+static KRR_OCCLUSION* occlusion = NULL;
+#define OCCLUSION_STALL 0
+#define OCCLUSION_TREES 1
+#define OCCLUSION_LAMPS (OCCLUSION_TREES + NUM_TREE)
+#define OCCLUSION_COUNT (OCCLUSION_LAMPS + NUM_LAMP)
 
 static KRR_CAM cam;
 static float roty = 0.0f;
@@ -153,8 +188,24 @@ static CGLM_ALIGN(16) versor fern_rots[NUM_FERN];
 static CGLM_ALIGN(8) vec4 fern_clipped_texcoords[4];
 static int fern_texcoord_is[NUM_FERN];
 
+// all instances, only visible ones are uploaded every frame
+static SIMPLEMODEL_INSTANCE tree_instances[NUM_TREE];
+static SIMPLEMODEL_INSTANCE lamp_instances[NUM_LAMP];
+static SIMPLEMODEL_INSTANCE fern_instances[NUM_FERN];
+
 #define TERRAIN_SLOT_SIZE 10
 #define TERRAIN_HFACTOR 3.0f
+// radius and height of terrain brush per key press
+#define TERRAIN_BRUSH_RADIUS 60.0f
+#define TERRAIN_BRUSH_AMOUNT 4.0f
+// uncomment to render terrain as heightfield, its vertices are reconstructed on GPU from heightmap texture
+//#define TERRAIN_HEIGHTFIELD
+// comment out to render terrain as independent triangles instead of triangle strips, to compare index memory and frame time
+#define TERRAIN_STRIPS
+// uncomment to generate terrain procedurally from seeded ridged noise instead of loading heightmap image
+//#define TERRAIN_NOISE
+#define TERRAIN_NOISE_SEED 1337
+#define TERRAIN_NOISE_SIZE 512
 
 // all in per second
 #define MOVE_SPEED 120.f
@@ -177,6 +228,10 @@ void usercode_app_went_windowed_mode()
     SU_TEXSHADERPROG3D(texture3d_shader)
   SU_BEGIN(texturealpha3d_shader)
     SU_TEXALPHASHADERPROG3D(texturealpha3d_shader)
+  SU_BEGIN(texture3d_instanced_shader)
+    SU_TEXSHADERPROG3D(texture3d_instanced_shader)
+  SU_BEGIN(texturealpha3d_instanced_shader)
+    SU_TEXALPHASHADERPROG3D(texturealpha3d_instanced_shader)
   SU_BEGIN(terrain3d_shader)
     SU_TERRAINSHADER(terrain3d_shader)
   SU_BEGIN(skybox_shader)
@@ -194,6 +249,10 @@ void usercode_app_went_fullscreen()
     SU_TEXSHADERPROG3D(texture3d_shader)
   SU_BEGIN(texturealpha3d_shader)
     SU_TEXALPHASHADERPROG3D(texturealpha3d_shader)
+  SU_BEGIN(texture3d_instanced_shader)
+    SU_TEXSHADERPROG3D(texture3d_instanced_shader)
+  SU_BEGIN(texturealpha3d_instanced_shader)
+    SU_TEXALPHASHADERPROG3D(texturealpha3d_instanced_shader)
   SU_BEGIN(terrain3d_shader)
     SU_TERRAINSHADER(terrain3d_shader)
   SU_BEGIN(skybox_shader)
@@ -232,16 +291,16 @@ bool usercode_init(int screen_width, int screen_height, int logical_width, int l
 
   // initialize the viewport
   // define the area where to render, for now full screen
-  glViewport(0, 0, g_screen_width, g_screen_height);
+  KRR_GLSTATE_viewport(0, 0, g_screen_width, g_screen_height);
 
   // initialize clear color
   glClearColor(0.f, 0.f, 0.f, 1.f);
 
   // enable face culling
-  glEnable(GL_CULL_FACE);
+  KRR_GLSTATE_enable(GL_CULL_FACE);
 
   // enable depth test
-  glEnable(GL_DEPTH_TEST);
+  KRR_GLSTATE_enable(GL_DEPTH_TEST);
 
   // initially start user's camera looking at -z, and up with +y
   glm_vec3_copy((vec3){0.0f, 0.0f, -1.0f}, cam.forward);
@@ -289,6 +348,9 @@ bool usercode_loadmedia()
   // set texture shader to all KRR_TEXTURE as active
   shared_textured_shaderprogram = texture_shader;
 
+  // create camera and lights shared by all 3d shaders
+  g_scene_ubo = KRR_SCENEUBO_new();
+
   // load texture3d shader
   texture3d_shader = KRR_TEXSHADERPROG3D_new();
   if (!KRR_TEXSHADERPROG3D_load_program(texture3d_shader))
@@ -309,9 +371,29 @@ bool usercode_loadmedia()
   // set texture alpha 3d shader
   shared_texturedalpha3d_shaderprogram = texturealpha3d_shader;
 
+  render_queue = KRR_RENDERQUEUE_new();
+
+  // load instanced variants to render many copies of the same model in one draw call
+  texture3d_instanced_shader = KRR_TEXSHADERPROG3D_new();
+  if (!KRR_TEXSHADERPROG3D_load_instanced_program(texture3d_instanced_shader))
+  {
+    KRR_LOGE("Error loading texture3d instanced shader");
+    return false;
+  }
+  texturealpha3d_instanced_shader = KRR_TEXALPHASHADERPROG3D_new();
+  if (!KRR_TEXALPHASHADERPROG3D_load_instanced_program(texturealpha3d_instanced_shader))
+  {
+    KRR_LOGE("Error loading texturealpha3d instanced shader");
+    return false;
+  }
+
   // load terrain3d shader
   terrain3d_shader = KRR_TERRAINSHADERPROG3D_new();
+#ifdef TERRAIN_HEIGHTFIELD
+  if (!KRR_TERRAINSHADERPROG3D_load_heightfield_program(terrain3d_shader))
+#else
   if (!KRR_TERRAINSHADERPROG3D_load_program(terrain3d_shader))
+#endif
   {
     KRR_LOGE("Error loading terrain3d shader");
     return false;
@@ -328,6 +410,16 @@ bool usercode_loadmedia()
   }
   // set skybox shader
   shared_skybox_shaderprogram = skybox_shader;
+
+  // load occlusion shader
+  occlusion_shader = KRR_OCCLUSIONSHADERPROG_new();
+  if (!KRR_OCCLUSIONSHADERPROG_load_program(occlusion_shader))
+  {
+    KRR_LOGE("Error loading occlusion shader");
+    return false;
+  }
+  // set occlusion shader
+  shared_occlusion_shaderprogram = occlusion_shader;
   
   // load font shader
   font_shader = KRR_FONTSHADERPROG2D_new();
@@ -366,7 +458,7 @@ bool usercode_loadmedia()
     KRR_LOGE("Error loading terrain's texture");
     return false;
   }
-  glBindTexture(GL_TEXTURE_2D, terrain_texture->texture_id);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, terrain_texture->texture_id);
   KRR_gputil_generate_mipmaps(GL_TEXTURE_2D, -1000, 1000);
 
   // stall texture
@@ -446,7 +538,7 @@ bool usercode_loadmedia()
     KRR_LOGE("Error loading multitexture r texture");
     return false;
   }
-  glBindTexture(GL_TEXTURE_2D, mt_r_texture->texture_id);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, mt_r_texture->texture_id);
   KRR_gputil_generate_mipmaps(GL_TEXTURE_2D, -1000, 1000);
 
   // multitexture g
@@ -456,7 +548,7 @@ bool usercode_loadmedia()
     KRR_LOGE("Error loading multitexture g texture");
     return false;
   }
-  glBindTexture(GL_TEXTURE_2D, mt_g_texture->texture_id);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, mt_g_texture->texture_id);
   KRR_gputil_generate_mipmaps(GL_TEXTURE_2D, -1000, 1000);
 
   // multitexture b
@@ -468,7 +560,7 @@ bool usercode_loadmedia()
   }
   // generate mipmap stack for multitexture b
   // note: bind texture first, then call util function
-  glBindTexture(GL_TEXTURE_2D, mt_b_texture->texture_id);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, mt_b_texture->texture_id);
   // FIXME: might have to adjust this lod values
   KRR_gputil_generate_mipmaps(GL_TEXTURE_2D, -1000, 4);
 
@@ -494,9 +586,31 @@ bool usercode_loadmedia()
     return false;
   }
 
+  // occlusion queries
+  occlusion = KRR_OCCLUSION_new(OCCLUSION_COUNT);
+
   // load from generation of terrain
   tr = KRR_TERRAIN_new();
-  if (!KRR_TERRAIN_load_from_generation(tr, "res/models/heightmap-taranaki.png", TERRAIN_SLOT_SIZE, TERRAIN_HFACTOR))
+  // upload quantized vertices, half the size of full-float ones
+  tr->packed = true;
+#ifdef TERRAIN_HEIGHTFIELD
+  tr->heightfield = true;
+#endif
+#ifdef TERRAIN_STRIPS
+  tr->strips = true;
+#endif
+#ifdef TERRAIN_NOISE
+  KRR_HEIGHTMAP_NOISE noise;
+  KRR_HEIGHTMAP_noise_defaults(&noise, TERRAIN_NOISE_SEED);
+  noise.type = KRR_HEIGHTMAP_NOISE_RIDGED;
+  KRR_HEIGHTMAP* heightmap = KRR_HEIGHTMAP_new();
+  bool terrain_loaded = KRR_HEIGHTMAP_generate_noise(heightmap, TERRAIN_NOISE_SIZE, TERRAIN_NOISE_SIZE, &noise) &&
+    KRR_TERRAIN_load_from_heightmap(tr, heightmap, TERRAIN_SLOT_SIZE, TERRAIN_HFACTOR);
+  KRR_HEIGHTMAP_free(heightmap);
+#else
+  bool terrain_loaded = KRR_TERRAIN_load_from_generation(tr, "res/models/heightmap-taranaki.png", TERRAIN_SLOT_SIZE, TERRAIN_HFACTOR);
+#endif
+  if (!terrain_loaded)
   {
     KRR_LOGE("Error loading terrain from generation");
     return false;
@@ -530,81 +644,61 @@ bool usercode_loadmedia()
     0.0025f     // point light
   };
 
+  // lights, ambient color and fog are shared by all 3d shaders
+  for (int i=0; i<NUM_LIGHTS; ++i)
+  {
+    LIGHT light = { light_poss[i], light_colors[i], light_attenuation_factors[i] };
+    KRR_SCENEUBO_set_light(g_scene_ubo, i, &light);
+  }
+  g_scene_ubo->lights.num = NUM_LIGHTS;
+  glm_vec4_copy((vec4){0.4f, 0.4f, 0.4f, 1.0f}, g_scene_ubo->lights.ambient_color);
+  KRR_SCENEUBO_update_lights(g_scene_ubo);
+  // sky color (affect to fog)
+  glm_vec4(SKY_COLOR_INIT, 1.0f, g_scene_ubo->camera.sky_color);
+  // disable fog initially, and configure it
+  g_scene_ubo->camera.fog_enabled = 0.0f;
+  g_scene_ubo->camera.fog_density = 0.0025f;
+  g_scene_ubo->camera.fog_gradient = 20.0f;
+  KRR_SCENEUBO_update_camera(g_scene_ubo);
+
   // initially update all related matrices and related graphics stuff for both basic shaders
   SU_BEGIN(texture_shader)
     SU_TEXSHADERPROG2D(texture_shader)
     // set texture unit
     KRR_TEXSHADERPROG2D_set_texture_sampler(texture_shader, 0);
 
-  SU_BEGIN(texture3d_shader)
-    SU_TEXSHADERPROG3D(texture3d_shader)
-    // update ambient color
-    glm_vec3_copy((vec3){0.4f, 0.4f, 0.4f}, texture3d_shader->ambient_color);
-    KRR_TEXSHADERPROG3D_update_ambient_color(texture3d_shader);
-    // set texture unit
-    KRR_TEXSHADERPROG3D_set_texture_sampler(texture3d_shader, 0);
-    // set specular lighting
-    texture3d_shader->shine_damper = 10.0f;
-    texture3d_shader->reflectivity = 0.2f;
-    KRR_TEXSHADERPROG3D_update_shininess(texture3d_shader);
-    // set lights info
-    for (int i=0; i<NUM_LIGHTS; ++i)
-    {
-      memcpy(&texture3d_shader->lights[i].pos, &light_poss[i], sizeof(VERTEXPOS3D));
-      memcpy(&texture3d_shader->lights[i].color, &light_colors[i], sizeof(COLOR3F));
-      texture3d_shader->lights[i].attenuation_factor = light_attenuation_factors[i];
-    }
-    // update lights we have
-    KRR_TEXSHADERPROG3D_update_lights_num(texture3d_shader, NUM_LIGHTS);
-    // sky color (affect to fog)
-    glm_vec3_copy(SKY_COLOR_INIT, texture3d_shader->sky_color);
-    KRR_TEXSHADERPROG3D_update_sky_color(texture3d_shader);
-    // enable fog
-    texture3d_shader->fog_enabled = false;
-    KRR_TEXSHADERPROG3D_update_fog_enabled(texture3d_shader);
-    // configure fog
-    texture3d_shader->fog_density = 0.0025f;
-    texture3d_shader->fog_gradient = 20.0f;
-    KRR_TEXSHADERPROG3D_update_fog_density(texture3d_shader);
-    KRR_TEXSHADERPROG3D_update_fog_gradient(texture3d_shader);
+  // both non-instanced and instanced variant share the same settings
+  KRR_TEXSHADERPROG3D* texture3d_variants[2] = {texture3d_shader, texture3d_instanced_shader};
+  for (int v=0; v<2; ++v)
+  {
+    KRR_TEXSHADERPROG3D* shader = texture3d_variants[v];
+    SU_BEGIN(shader)
+      SU_TEXSHADERPROG3D(shader)
+      // set texture unit
+      KRR_TEXSHADERPROG3D_set_texture_sampler(shader, 0);
+      // set specular lighting
+      shader->shine_damper = 10.0f;
+      shader->reflectivity = 0.2f;
+      KRR_TEXSHADERPROG3D_update_shininess(shader);
+  }
 
-  SU_BEGIN(texturealpha3d_shader)
-    SU_TEXALPHASHADERPROG3D(texturealpha3d_shader)
-    // update ambient color
-    glm_vec3_copy((vec3){0.4f, 0.4f, 0.4f}, texturealpha3d_shader->ambient_color);
-    KRR_TEXALPHASHADERPROG3D_update_ambient_color(texturealpha3d_shader);
-    // set texture unit
-    KRR_TEXALPHASHADERPROG3D_set_texture_sampler(texturealpha3d_shader, 0);
-    // set specular lighting
-    texturealpha3d_shader->shine_damper = 10.0f;
-    texturealpha3d_shader->reflectivity = 0.2f;
-    KRR_TEXALPHASHADERPROG3D_update_shininess(texturealpha3d_shader);
-    // set light info - 1st
-    for (int i=0; i<NUM_LIGHTS; ++i)
-    {
-      memcpy(&texturealpha3d_shader->lights[i].pos, &light_poss[i], sizeof(VERTEXPOS3D));
-      memcpy(&texturealpha3d_shader->lights[i].color, &light_colors[i], sizeof(COLOR3F));
-      texturealpha3d_shader->lights[i].attenuation_factor = light_attenuation_factors[i];
-    }
-    // update lights
-    KRR_TEXALPHASHADERPROG3D_update_lights_num(texturealpha3d_shader, NUM_LIGHTS);
-    // sky color (affect to fog)
-    glm_vec3_copy(SKY_COLOR_INIT, texturealpha3d_shader->sky_color);
-    KRR_TEXALPHASHADERPROG3D_update_sky_color(texturealpha3d_shader);
-    // enable fog
-    texturealpha3d_shader->fog_enabled = false;
-    KRR_TEXALPHASHADERPROG3D_update_fog_enabled(texturealpha3d_shader);
-    // configure fog
-    texturealpha3d_shader->fog_density = 0.0025f;
-    texturealpha3d_shader->fog_gradient = 20.0f;
-    KRR_TEXALPHASHADERPROG3D_update_fog_density(texturealpha3d_shader);
-    KRR_TEXALPHASHADERPROG3D_update_fog_gradient(texturealpha3d_shader);
+  // both non-instanced and instanced variant share the same settings
+  KRR_TEXALPHASHADERPROG3D* texturealpha3d_variants[2] = {texturealpha3d_shader, texturealpha3d_instanced_shader};
+  for (int v=0; v<2; ++v)
+  {
+    KRR_TEXALPHASHADERPROG3D* shader = texturealpha3d_variants[v];
+    SU_BEGIN(shader)
+      SU_TEXALPHASHADERPROG3D(shader)
+      // set texture unit
+      KRR_TEXALPHASHADERPROG3D_set_texture_sampler(shader, 0);
+      // set specular lighting
+      shader->shine_damper = 10.0f;
+      shader->reflectivity = 0.2f;
+      KRR_TEXALPHASHADERPROG3D_update_shininess(shader);
+  }
 
   SU_BEGIN(terrain3d_shader)
     SU_TERRAINSHADER(terrain3d_shader)
-    // set ambient color
-    glm_vec3_copy((vec3){0.4f, 0.4f, 0.4f}, terrain3d_shader->ambient_color);
-    KRR_TERRAINSHADERPROG3D_update_ambient_color(terrain3d_shader);
     // set texture unit (at the same time this is multiteture background texture)
     KRR_TERRAINSHADERPROG3D_set_texture_sampler(terrain3d_shader, 0);
     // enabled multitexture
@@ -622,25 +716,6 @@ bool usercode_loadmedia()
     // set repeatness over texture coord
     terrain3d_shader->texcoord_repeat = 30.0f;
     KRR_TERRAINSHADERPROG3D_update_texcoord_repeat(terrain3d_shader);
-    // set light info - 1st
-    for (int i=0; i<NUM_LIGHTS; ++i) {
-      memcpy(&terrain3d_shader->lights[i].pos, &light_poss[i], sizeof(VERTEXPOS3D));
-      memcpy(&terrain3d_shader->lights[i].color, &light_colors[i], sizeof(COLOR3F));
-      terrain3d_shader->lights[i].attenuation_factor = light_attenuation_factors[i];
-    }
-    // update light to GPU
-    KRR_TERRAINSHADERPROG3D_update_lights_num(terrain3d_shader, NUM_LIGHTS);
-    // sky color (affect to fog)
-    glm_vec3_copy(SKY_COLOR_INIT, terrain3d_shader->sky_color);
-    KRR_TERRAINSHADERPROG3D_update_sky_color(terrain3d_shader);
-    // enable fog
-    terrain3d_shader->fog_enabled = false;
-    KRR_TERRAINSHADERPROG3D_update_fog_enabled(terrain3d_shader);
-    // configure fog
-    terrain3d_shader->fog_density = 0.0025f;
-    terrain3d_shader->fog_gradient = 20.0f;
-    KRR_TERRAINSHADERPROG3D_update_fog_density(terrain3d_shader);
-    KRR_TERRAINSHADERPROG3D_update_fog_gradient(terrain3d_shader);
 
   SU_BEGIN(skybox_shader)
     SU_SKYBOXSHADER(skybox_shader)
@@ -662,8 +737,12 @@ bool usercode_loadmedia()
     KRR_FONTSHADERPROG2D_set_texture_sampler(font_shader, 0);
   SU_END(font_shader)
 
+  // pool for all props, capacity of vertices is kept to be addressable by 16-bit indices
+  model_pool = KRR_MESHPOOL_new(sizeof(VERTEXTEXNORM3D), 65536, 65536 * 3);
+
   // load .obj model
   stall = SIMPLEMODEL_new();
+  stall->pool = model_pool;
   if (!SIMPLEMODEL_load_objfile(stall, "res/models/stall.obj"))
   {
     KRR_LOGE("Error loading stall model file");
@@ -672,6 +751,7 @@ bool usercode_loadmedia()
 
   // load tree model
   tree = SIMPLEMODEL_new();
+  tree->pool = model_pool;
   if (!SIMPLEMODEL_load_objfile(tree, "res/models/lowPolyTree.obj"))
   {
     KRR_LOGE("Error loading tree model file");
@@ -680,6 +760,7 @@ bool usercode_loadmedia()
   
   // load fern model
   fern = SIMPLEMODEL_new();
+  fern->pool = model_pool;
   if (!SIMPLEMODEL_load_objfile(fern, "res/models/fern.obj"))
   {
     KRR_LOGE("Error loading fern model");
@@ -688,6 +769,7 @@ bool usercode_loadmedia()
 
   // load player model
   player = SIMPLEMODEL_new();
+  player->pool = model_pool;
   if (!SIMPLEMODEL_load_objfile(player, "res/models/person.obj"))
   {
     KRR_LOGE("Error loading player model");
@@ -696,6 +778,7 @@ bool usercode_loadmedia()
 
   // load lamp model
   lamp = SIMPLEMODEL_new();
+  lamp->pool = model_pool;
   if (!SIMPLEMODEL_load_objfile(lamp, "res/models/lamp.obj"))
   {
     KRR_LOGE("Error loading lamp model");
@@ -806,6 +889,33 @@ bool usercode_loadmedia()
     glm_vec3_copy((vec3){light_poss[i+1].x, light_poss[i+1].y - light_yoffsets[i+1] - 2.0f, light_poss[i+1].z}, lamp_pos[i]);
   }
 
+  // form instances once as they don't move, visible ones are uploaded at render time
+  // (model matrix set to shader at render time is applied on top of every instance)
+  CGLM_ALIGN_MAT mat4 t_mat;
+  for (int i=0; i<NUM_TREE; ++i)
+  {
+    glm_translate_make(tree_instances[i].model_matrix, randomized_tree_pos[i]);
+    // convert from quaternion to matrix
+    glm_quat_mat4(tree_rots[i], t_mat);
+    // (t_mat must be on the right of multiplication as we want it to happen first!)
+    glm_mat4_mul(tree_instances[i].model_matrix, t_mat, tree_instances[i].model_matrix);
+    glm_vec4_zero(tree_instances[i].clipped_texcoord);
+  }
+
+  for (int i=0; i<NUM_LAMP; ++i)
+  {
+    glm_translate_make(lamp_instances[i].model_matrix, lamp_pos[i]);
+    glm_vec4_zero(lamp_instances[i].clipped_texcoord);
+  }
+
+  for (int i=0; i<NUM_FERN; ++i)
+  {
+    glm_translate_make(fern_instances[i].model_matrix, randomized_fern_pos[i]);
+    glm_quat_mat4(fern_rots[i], t_mat);
+    glm_mat4_mul(fern_instances[i].model_matrix, t_mat, fern_instances[i].model_matrix);
+    glm_vec4_copy(fern_clipped_texcoords[fern_texcoord_is[i]], fern_instances[i].clipped_texcoord);
+  }
+
   // we have no need to continue using sheetmeta for fern anymore
   texpackr_sheetmeta_free(fern_sheetmeta);
   fern_sheetmeta = NULL;
@@ -876,6 +986,32 @@ void handle_fullscreen_mode()
   usercode_app_went_fullscreen();
 }
 
+void apply_texture3d_uniforms(const void* uniforms)
+{
+  const TEXTURE3D_UNIFORMS* u = uniforms;
+  memcpy(u->shader->model_matrix, u->model_matrix, sizeof(mat4));
+  KRR_TEXSHADERPROG3D_update_model_matrix(u->shader);
+}
+
+void submit_model(SIMPLEMODEL* model, KRR_TEXTURE* texture, const TEXTURE3D_UNIFORMS* uniforms, vec3 pos)
+{
+  KRR_RENDERQUEUE_PACKET packet;
+  memset(&packet, 0, sizeof(packet));
+  packet.program = uniforms->shader->program;
+  packet.vao_id = model->vao_id;
+  packet.textures[0] = texture->texture_id;
+  packet.apply_uniforms = apply_texture3d_uniforms;
+  packet.uniforms = uniforms;
+  packet.mode = GL_TRIANGLES;
+  packet.index_type = model->index_type;
+  packet.count = model->indices_count;
+  packet.offset = model->indices_offset;
+  packet.instances_count = model->instances_count;
+  packet.depth = glm_vec3_distance(cam.pos, pos);
+
+  KRR_RENDERQUEUE_submit(render_queue, &packet);
+}
+
 void usercode_handle_event(SDL_Event *e, float delta_time)
 {
   if (e->type == SDL_KEYDOWN)
@@ -903,6 +1039,15 @@ void usercode_handle_event(SDL_Event *e, float delta_time)
     {
       is_freelook_mode_enabled = !is_freelook_mode_enabled;
     }
+    else if (k == SDLK_o)
+    {
+      occlusion->enabled = !occlusion->enabled;
+    }
+    else if (k == SDLK_b || k == SDLK_v)
+    {
+      // sculpt terrain around player, converted into terrain's space
+      KRR_TERRAIN_brush(tr, player_position[0] + tr->grid_width*TERRAIN_SLOT_SIZE/2, player_position[2] + tr->grid_height*TERRAIN_SLOT_SIZE/2, TERRAIN_BRUSH_RADIUS, k == SDLK_b ? TERRAIN_BRUSH_AMOUNT : -TERRAIN_BRUSH_AMOUNT);
+    }
     else if (k == SDLK_SPACE)
     {
       if (!is_player_inair)
@@ -918,11 +1063,11 @@ void usercode_handle_event(SDL_Event *e, float delta_time)
     else if (k == SDLK_f)
     {
       // toggle fog
-      texture3d_shader->fog_enabled = !texture3d_shader->fog_enabled;
-      texturealpha3d_shader->fog_enabled = !texturealpha3d_shader->fog_enabled;
-      terrain3d_shader->fog_enabled = !terrain3d_shader->fog_enabled;
+      g_scene_ubo->camera.fog_enabled = g_scene_ubo->camera.fog_enabled == 1.0f ? 0.0f : 1.0f;
+      // single update serves all 3d shaders
+      KRR_SCENEUBO_update_camera(g_scene_ubo);
 
-      if (terrain3d_shader->fog_enabled)
+      if (g_scene_ubo->camera.fog_enabled == 1.0f)
       {
         skybox_shader->ctrans_limits[0] = -300.0f;
         skybox_shader->ctrans_limits[1] = 100.0f;
@@ -934,12 +1079,6 @@ void usercode_handle_event(SDL_Event *e, float delta_time)
       }
       
       
-      SU_BEGIN(texture3d_shader)
-        KRR_TEXSHADERPROG3D_update_fog_enabled(texture3d_shader);
-      SU_BEGIN(texturealpha3d_shader)
-        KRR_TEXALPHASHADERPROG3D_update_fog_enabled(texturealpha3d_shader);
-      SU_BEGIN(terrain3d_shader)
-        KRR_TERRAINSHADERPROG3D_update_fog_enabled(terrain3d_shader);
       SU_BEGIN(skybox_shader)
         KRR_SKYBOXSHADERPROG_update_ctrans_limits(skybox_shader);
       SU_END(skybox_shader)
@@ -1075,200 +1214,24 @@ void usercode_handle_event(SDL_Event *e, float delta_time)
 
 void compute_terrain_normal(float x, float y, float z, vec3 dest)
 {
-  // compute offset from terrain's position (world space)
+  // convert to terrain's space
   // this depends on how we translate such terrain in render() function
   float adjusted_x = x + tr->grid_width*TERRAIN_SLOT_SIZE/2;
   float adjusted_z = z + tr->grid_height*TERRAIN_SLOT_SIZE/2;
 
-  int index_i = (int)floor(adjusted_x / TERRAIN_SLOT_SIZE);
-  int index_z = (int)floor(adjusted_z / TERRAIN_SLOT_SIZE);
-
-  // check if indexes are in the range of terrain
-  // it might be player is outside of terrain area
-  if (index_i < 0 || index_i >= tr->grid_width ||
-      index_z < 0 || index_z >= tr->grid_height)
-  {
-    KRR_LOGI("return zero vector as result");
-    glm_vec3_copy(GLM_VEC3_ZERO, dest);
-    return;
-  }
-
-  // determine which triangle input position will be in
-  //
-  // ref from terrain which bases on this in its implementation,
-  // with index denoted to work with barycentric coordinate
-  //
-  // ^
-  // | Z-Axis
-  //
-  // A(0,0) ---- B(1,0)
-  // |          /   |
-  // |        /     |
-  // |      /       |
-  // |    /         |
-  // |  /           |
-  // C(0,1) ---- D(1,1)  --> X-Axis
-  //
-  // first get the unit coordinate of input position for that terrain slot
-  float x_coord = (((int)adjusted_x) % tr->grid_width) * 1.0f / tr->grid_width;
-  float z_coord = (((int)adjusted_z) % tr->grid_height) * 1.0f / tr->grid_height;
-
-  // set next indexes, and bound them for this triangle
-  int next_index_i = index_i+1; if (next_index_i > tr->grid_width) next_index_i = tr->grid_width;
-  int next_index_z = index_z+1; if (next_index_z > tr->grid_height) next_index_z = tr->grid_height;
-
-  // grab normal
-  CGLM_ALIGN(8) vec3 n_topleft;
-  CGLM_ALIGN(8) vec3 n_topright;
-  CGLM_ALIGN(8) vec3 n_bottomleft;
-  CGLM_ALIGN(8) vec3 n_bottomright;
-
-  glm_vec3_copy(tr->normals[index_z*(tr->grid_width) + index_i], n_topleft);
-  glm_vec3_copy(tr->normals[index_z*(tr->grid_width) + next_index_i], n_topright);
-  glm_vec3_copy(tr->normals[next_index_z*(tr->grid_width) + index_i], n_bottomleft);
-  glm_vec3_copy(tr->normals[next_index_z*(tr->grid_width) + next_index_i], n_bottomright);
-
-  // determine which triangle of such slot input position is in
-  if (x_coord <= 1.0f - z_coord)
-  {
-    // left triangle
-    CGLM_ALIGN(8) vec3 p1;
-    CGLM_ALIGN(8) vec3 p2;
-    CGLM_ALIGN(8) vec3 p3;
-    vec2 p;
-    p[0] = x_coord;
-    p[1] = z_coord;
-
-    // x
-    glm_vec3_copy((vec3){0.0f, n_topleft[0], 0.0f}, p1);
-    glm_vec3_copy((vec3){1.0f, n_topright[0], 0.0f}, p2);
-    glm_vec3_copy((vec3){0.0f, n_bottomleft[0], 1.0f}, p3);
-    float normal_x = KRR_math_barycentric_xz(p1, p2, p3, p);
-
-    // y
-    glm_vec3_copy((vec3){0.0f, n_topleft[1], 0.0f}, p1);
-    glm_vec3_copy((vec3){1.0f, n_topright[1], 0.0f}, p2);
-    glm_vec3_copy((vec3){0.0f, n_bottomleft[1], 1.0f}, p3);
-    float normal_y = KRR_math_barycentric_xz(p1, p2, p3, p);
-
-    // z
-    glm_vec3_copy((vec3){0.0f, n_topleft[2], 0.0f}, p1);
-    glm_vec3_copy((vec3){1.0f, n_topright[2], 0.0f}, p2);
-    glm_vec3_copy((vec3){0.0f, n_bottomleft[2], 1.0f}, p3);
-    float normal_z = KRR_math_barycentric_xz(p1, p2, p3, p);
-
-    // fill in result
-    glm_vec3_copy((vec3){normal_x, normal_y, normal_z}, dest);
-  }
-  else
-  {
-    // right triangle
-    CGLM_ALIGN(8) vec3 p1;
-    CGLM_ALIGN(8) vec3 p2;
-    CGLM_ALIGN(8) vec3 p3;
-    vec2 p;
-    p[0] = x_coord;
-    p[1] = z_coord;
-
-    // x
-    glm_vec3_copy((vec3){1.0f, n_topright[0], 0.0f}, p1);
-    glm_vec3_copy((vec3){0.0f, n_bottomleft[0], 1.0f}, p2);
-    glm_vec3_copy((vec3){1.0f, n_bottomright[0], 1.0f}, p3);
-    float normal_x = KRR_math_barycentric_xz(p1, p2, p3, p);
-
-    // y
-    glm_vec3_copy((vec3){1.0f, n_topright[1], 0.0f}, p1);
-    glm_vec3_copy((vec3){0.0f, n_bottomleft[1], 1.0f}, p2);
-    glm_vec3_copy((vec3){1.0f, n_bottomright[1], 1.0f}, p3);
-    float normal_y = KRR_math_barycentric_xz(p1, p2, p3, p);
-
-    // z
-    glm_vec3_copy((vec3){1.0f, n_topright[2], 0.0f}, p1);
-    glm_vec3_copy((vec3){0.0f, n_bottomleft[2], 1.0f}, p2);
-    glm_vec3_copy((vec3){1.0f, n_bottomright[2], 1.0f}, p3);
-    float normal_z = KRR_math_barycentric_xz(p1, p2, p3, p);
-
-    // fill in result
-    glm_vec3_copy((vec3){normal_x, normal_y, normal_z}, dest);
-  }
+  KRR_TERRAIN_query(tr, KRR_TERRAIN_QUERY_TRIANGLE, &adjusted_x, &adjusted_z, 1, NULL, &dest[0], &dest[1], &dest[2], NULL);
 }
 
 float compute_posy(float x, float z)
 {
-  // compute offset from terrain's position (world space)
+  // convert to terrain's space
   // this depends on how we translate such terrain in render() function
   float adjusted_x = x + tr->grid_width*TERRAIN_SLOT_SIZE/2;
   float adjusted_z = z + tr->grid_height*TERRAIN_SLOT_SIZE/2;
 
-  int index_i = (int)floor(adjusted_x / TERRAIN_SLOT_SIZE);
-  int index_z = (int)floor(adjusted_z / TERRAIN_SLOT_SIZE);
-
-  // check if indexes are in the range of terrain
-  // it might be player is outside of terrain area
-  if (index_i < 0 || index_i >= tr->grid_width ||
-      index_z < 0 || index_z >= tr->grid_height)
-  {
-    KRR_LOGI("return 0.0f");
-    return 0.0f;
-  }
-
-  // determine which triangle input position will be in
-  //
-  // ref from terrain which bases on this in its implementation,
-  // with index denoted to work with barycentric coordinate
-  //
-  // ^
-  // | Z-Axis
-  //
-  // A(0,0) ---- B(1,0)
-  // |          /   |
-  // |        /     |
-  // |      /       |
-  // |    /         |
-  // |  /           |
-  // C(0,1) ---- D(1,1)  --> X-Axis
-  //
-  // first get the unit coordinate of input position for that terrain slot
-  float x_coord = (((int)adjusted_x) % tr->grid_width) * 1.0f / tr->grid_width;
-  float z_coord = (((int)adjusted_z) % tr->grid_height) * 1.0f / tr->grid_height;
-
-  // set next indexes, and bound them for this triangle
-  int next_index_i = index_i+1; if (next_index_i > tr->grid_width) next_index_i = tr->grid_width;
-  int next_index_z = index_z+1; if (next_index_z > tr->grid_height) next_index_z = tr->grid_height;
-
-  // determine which triangle of such slot input position is in
-  if (x_coord <= 1.0f - z_coord)
-  {
-    // left triangle
-    CGLM_ALIGN(8) vec3 p1;
-    CGLM_ALIGN(8) vec3 p2;
-    CGLM_ALIGN(8) vec3 p3;
-    vec2 p;
-    p[0] = x_coord;
-    p[1] = z_coord;
-
-    glm_vec3_copy((vec3){0.0f, tr->heights[index_z*(tr->grid_width) + index_i], 0.0f}, p1);
-    glm_vec3_copy((vec3){1.0f, tr->heights[index_z*(tr->grid_width) + next_index_i], 0.0f}, p2);
-    glm_vec3_copy((vec3){0.0f, tr->heights[next_index_z*(tr->grid_width) + index_i], 1.0f}, p3);
-
-    return KRR_math_barycentric_xz(p1, p2, p3, p);
-  }
-  else
-  {
-    // right triangle
-    CGLM_ALIGN(8) vec3 p1;
-    CGLM_ALIGN(8) vec3 p2;
-    CGLM_ALIGN(8) vec3 p3;
-    vec2 p;
-    p[0] = x_coord;
-    p[1] = z_coord;
-
-    glm_vec3_copy((vec3){1.0f, tr->heights[index_z*(tr->grid_width) + next_index_i], 0.0f}, p1);
-    glm_vec3_copy((vec3){0.0f, tr->heights[next_index_z*(tr->grid_width) + index_i], 1.0f}, p2);
-    glm_vec3_copy((vec3){1.0f, tr->heights[next_index_z*(tr->grid_width) + next_index_i], 1.0f}, p3);
-
-    return KRR_math_barycentric_xz(p1, p2, p3, p);
-  }
+  float y;
+  KRR_TERRAIN_query(tr, KRR_TERRAIN_QUERY_TRIANGLE, &adjusted_x, &adjusted_z, 1, &y, NULL, NULL, NULL, NULL);
+  return y;
 }
 
 void update_camera(float delta_time)
@@ -1341,18 +1304,10 @@ void update_camera(float delta_time)
     glm_lookat(cam.pos, lookat_pos, GLM_YUP, g_view_matrix);
   }
 
-  // texture 3d
-  KRR_SHADERPROG_bind(texture3d_shader->program);
+  // all 3d shaders (texture 3d, texture alpha 3d, their instanced variants, and terrain)
+  // share view matrix through scene uniform buffer, one update is enough
   usercode_set_matrix_then_update_to_shader(USERCODE_MATRIXTYPE_VIEW_MATRIX, USERCODE_SHADERTYPE_TEXTURE3D_SHADER, texture3d_shader);
 
-  // texture alpha 3d
-  KRR_SHADERPROG_bind(texturealpha3d_shader->program);
-  usercode_set_matrix_then_update_to_shader(USERCODE_MATRIXTYPE_VIEW_MATRIX, USERCODE_SHADERTYPE_TEXTUREALPHA3D_SHADER, texturealpha3d_shader);
-
-  // terrain 3d
-  KRR_SHADERPROG_bind(terrain3d_shader->program);
-  usercode_set_matrix_then_update_to_shader(USERCODE_MATRIXTYPE_VIEW_MATRIX, USERCODE_SHADERTYPE_TERRAIN_SHADER, terrain3d_shader);
-
   // skybox
   KRR_SHADERPROG_bind(skybox_shader->program);
   usercode_set_matrix_then_update_to_shader(USERCODE_MATRIXTYPE_VIEW_MATRIX, USERCODE_SHADERTYPE_SKYBOX_SHADER, skybox_shader);
@@ -1581,7 +1536,7 @@ void usercode_render(void)
   if (g_need_clipping)
   {
     // clear color for content area
-    glEnable(GL_SCISSOR_TEST);
+    KRR_GLSTATE_enable(GL_SCISSOR_TEST);
     glScissor(g_offset_x, g_offset_y, g_ri_view_width, g_ri_view_height);
     glClearColor(CONTENT_BG_COLOR);
     glClear(GL_COLOR_BUFFER_BIT);
@@ -1591,32 +1546,47 @@ void usercode_render(void)
   CGLM_ALIGN_MAT mat4 t_mat;  // for temp converted from quaternion, rotate object according
                               // to current terrain's normal
 
+  // read results of occlusion queries issued in earlier frames
+  KRR_OCCLUSION_begin_frame(occlusion);
+
+  // frustum in world space to cull objects against their model matrix
+  CGLM_ALIGN_MAT mat4 view_projection;
+  glm_mat4_mul(g_projection_matrix, g_view_matrix, view_projection);
+  KRR_CULL_FRUSTUM frustum;
+  KRR_CULL_extract_frustum(view_projection, &frustum);
+  // and in space of base model matrix which instances are relative to
+  glm_mat4_mul(view_projection, g_base_model_matrix, t_mat);
+  KRR_CULL_FRUSTUM instance_frustum;
+  KRR_CULL_extract_frustum(t_mat, &instance_frustum);
+  CGLM_ALIGN_MAT mat4 instance_view_projection;
+  glm_mat4_copy(t_mat, instance_view_projection);
+
   // TERRAIN
   KRR_SHADERPROG_bind(terrain3d_shader->program);
   // render terrain
-  glBindVertexArray(tr->vao_id);
+  KRR_GLSTATE_bind_vertex_array(tr->vao_id);
     // bind background texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, terrain_texture->texture_id);
+    KRR_GLSTATE_active_texture(GL_TEXTURE0);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, terrain_texture->texture_id);
     // wrap texture
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
 
     // multitexture r
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, mt_r_texture->texture_id);
+    KRR_GLSTATE_active_texture(GL_TEXTURE1);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, mt_r_texture->texture_id);
 
     // multitexture g
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, mt_g_texture->texture_id);
+    KRR_GLSTATE_active_texture(GL_TEXTURE2);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, mt_g_texture->texture_id);
 
     // multitexture b
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, mt_b_texture->texture_id);
+    KRR_GLSTATE_active_texture(GL_TEXTURE3);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, mt_b_texture->texture_id);
 
     // blendmap
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_2D, mt_blendmap->texture_id);
+    KRR_GLSTATE_active_texture(GL_TEXTURE4);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, mt_blendmap->texture_id);
 
     // transform model matrix
     glm_mat4_copy(g_base_model_matrix, terrain3d_shader->model_matrix);
@@ -1625,134 +1595,113 @@ void usercode_render(void)
     glm_translate(terrain3d_shader->model_matrix, (vec3){-tr->grid_width*TERRAIN_SLOT_SIZE/2, 0.0f, -tr->grid_height*TERRAIN_SLOT_SIZE/2});
     //update model matrix
     KRR_TERRAINSHADERPROG3D_update_model_matrix(terrain3d_shader);
+    // frustum in terrain's space to cull its chunks
+    glm_mat4_mul(view_projection, terrain3d_shader->model_matrix, t_mat);
+    KRR_CULL_FRUSTUM terrain_frustum;
+    KRR_CULL_extract_frustum(t_mat, &terrain_frustum);
+    // dequantize packed vertices
+    terrain3d_shader->dequant = tr->dequant;
+    KRR_TERRAINSHADERPROG3D_update_dequant(terrain3d_shader);
+#ifdef TERRAIN_HEIGHTFIELD
+    terrain3d_shader->heightfield_params = tr->heightfield_params;
+    KRR_TERRAINSHADERPROG3D_update_heightfield(terrain3d_shader);
+#endif
+
+    // camera in terrain's space to select LOD level of chunks
+    CGLM_ALIGN(16) vec4 terrain_cam_pos;
+    glm_mat4_inv(terrain3d_shader->model_matrix, t_mat);
+    glm_mat4_mulv(t_mat, (vec4){cam.pos[0], cam.pos[1], cam.pos[2], 1.0f}, terrain_cam_pos);
 
     // render
-    KRR_TERRAIN_render(tr);
+    KRR_TERRAIN_render_lod(tr, &terrain_frustum, terrain_cam_pos, KRR_TERRAIN_lod_error_scale(g_projection_matrix, g_ri_view_height));
 
     // set back to default texture
-    glActiveTexture(GL_TEXTURE0);
+    KRR_GLSTATE_active_texture(GL_TEXTURE0);
   
-  // STALL & TREE & PLAYER
-  KRR_SHADERPROG_bind(texture3d_shader->program);
-  // render stall
-  glBindVertexArray(stall->vao_id);
-    // bind texture
-    glBindTexture(GL_TEXTURE_2D, stall_texture->texture_id);
-
-    // transform model matrix
-    glm_mat4_copy(g_base_model_matrix, texture3d_shader->model_matrix);
-    glm_translate(texture3d_shader->model_matrix, stall_pos);
-
-    // convert from quaternion to matrix
-    glm_quat_mat4(stall_rot, t_mat);
-    // (t_mat must be on the right of multiplication as we want it to happen first!)
-    glm_mat4_mul(texture3d_shader->model_matrix, t_mat, texture3d_shader->model_matrix);
-
-    //update model matrix
-    KRR_TEXSHADERPROG3D_update_model_matrix(texture3d_shader);
-
-    // render
-    SIMPLEMODEL_render(stall);
-
-  // render tree
-  glBindVertexArray(tree->vao_id);
-    // bind texture
-    glBindTexture(GL_TEXTURE_2D, tree_texture->texture_id);
-
-    for (int i=0; i<NUM_TREE; ++i)
-    {
-      // transform model matrix
-      glm_mat4_copy(g_base_model_matrix, texture3d_shader->model_matrix);
-      glm_translate(texture3d_shader->model_matrix, randomized_tree_pos[i]);
-      
-      // convert from quaternion to matrix
-      glm_quat_mat4(tree_rots[i], t_mat);
-      // (t_mat must be on the right of multiplication as we want it to happen first!)
-      glm_mat4_mul(texture3d_shader->model_matrix, t_mat, texture3d_shader->model_matrix);
-      
-      // update model matrix to GPU
-      KRR_TEXSHADERPROG3D_update_model_matrix(texture3d_shader);
-
-      // render
-      SIMPLEMODEL_render(tree);
-    }
-
-  // render lamp
-  glBindVertexArray(lamp->vao_id);
-    glBindTexture(GL_TEXTURE_2D, lamp_texture->texture_id);
-
-    for (int i=0; i<NUM_LAMP; ++i)
+  // STALL & TREE & LAMP & PLAYER
+  // submit in any order, render queue sorts them by shader, texture and vao
+  TEXTURE3D_UNIFORMS stall_uniforms;
+  stall_uniforms.shader = texture3d_shader;
+  // transform model matrix
+  glm_mat4_copy(g_base_model_matrix, stall_uniforms.model_matrix);
+  glm_translate(stall_uniforms.model_matrix, stall_pos);
+  // convert from quaternion to matrix
+  glm_quat_mat4(stall_rot, t_mat);
+  // (t_mat must be on the right of multiplication as we want it to happen first!)
+  glm_mat4_mul(stall_uniforms.model_matrix, t_mat, stall_uniforms.model_matrix);
+  if (KRR_CULL_test_bounds(&frustum, &stall->bounds, stall_uniforms.model_matrix))
+  {
+    glm_mat4_mul(view_projection, stall_uniforms.model_matrix, t_mat);
+    KRR_OCCLUSION_query(occlusion, OCCLUSION_STALL, &stall->bounds, t_mat);
+    if (KRR_OCCLUSION_is_visible(occlusion, OCCLUSION_STALL))
     {
-      glm_mat4_copy(g_base_model_matrix, texture3d_shader->model_matrix);
-      glm_translate(texture3d_shader->model_matrix, lamp_pos[i]);
-      KRR_TEXSHADERPROG3D_update_model_matrix(texture3d_shader);
-      SIMPLEMODEL_render(lamp);
+      submit_model(stall, stall_texture, &stall_uniforms, stall_pos);
     }
+  }
 
-  // render player
-  glBindVertexArray(player->vao_id);
-    // bind texture
-    glBindTexture(GL_TEXTURE_2D, player_texture->texture_id);
+  // every instance is relative to base model matrix
+  TEXTURE3D_UNIFORMS instanced_uniforms;
+  instanced_uniforms.shader = texture3d_instanced_shader;
+  glm_mat4_copy(g_base_model_matrix, instanced_uniforms.model_matrix);
+  // render visible trees, and visible lamps in one draw call each
+  if (SIMPLEMODEL_set_visible_instances_ex(tree, &instance_frustum, occlusion, OCCLUSION_TREES, instance_view_projection, tree_instances, NUM_TREE) > 0)
+  {
+    submit_model(tree, tree_texture, &instanced_uniforms, GLM_VEC3_ZERO);
+  }
+  if (SIMPLEMODEL_set_visible_instances_ex(lamp, &instance_frustum, occlusion, OCCLUSION_LAMPS, instance_view_projection, lamp_instances, NUM_LAMP) > 0)
+  {
+    submit_model(lamp, lamp_texture, &instanced_uniforms, GLM_VEC3_ZERO);
+  }
 
-    // transform
-    glm_mat4_copy(g_base_model_matrix, texture3d_shader->model_matrix);
-    glm_translate(texture3d_shader->model_matrix, player_position);
-    glm_rotate(texture3d_shader->model_matrix, glm_rad(player_forward_rotation), GLM_YUP);
-    // update model matrix
-    KRR_TEXSHADERPROG3D_update_model_matrix(texture3d_shader);
+  TEXTURE3D_UNIFORMS player_uniforms;
+  player_uniforms.shader = texture3d_shader;
+  glm_mat4_copy(g_base_model_matrix, player_uniforms.model_matrix);
+  glm_translate(player_uniforms.model_matrix, player_position);
+  glm_rotate(player_uniforms.model_matrix, glm_rad(player_forward_rotation), GLM_YUP);
+  if (KRR_CULL_test_bounds(&frustum, &player->bounds, player_uniforms.model_matrix))
+  {
+    submit_model(player, player_texture, &player_uniforms, player_position);
+  }
 
-    // render
-    SIMPLEMODEL_render(player);
+  KRR_RENDERQUEUE_flush(render_queue);
 
   // TEXTURE ALPHA fern
-  KRR_SHADERPROG_bind(texturealpha3d_shader->program);
+  KRR_SHADERPROG_bind(texturealpha3d_instanced_shader->program);
+  glm_mat4_copy(g_base_model_matrix, texturealpha3d_instanced_shader->model_matrix);
+  KRR_TEXALPHASHADERPROG3D_update_model_matrix(texturealpha3d_instanced_shader);
   // disable backface culling as fern made up of crossing polygon
-  glDisable(GL_CULL_FACE);
-
-  // render fern
-  glBindVertexArray(fern->vao_id);
-    // bind texture
-    glBindTexture(GL_TEXTURE_2D, fern_texture->texture_id);
-
-    for (int i=0; i<NUM_FERN; ++i)
-    {
-      // set computed result to shader
-      glm_vec4_copy(fern_clipped_texcoords[fern_texcoord_is[i]], texturealpha3d_shader->clipped_texcoord);
-      // update to GPU
-      KRR_TEXALPHASHADERPROG3D_update_clipped_texcoord(texturealpha3d_shader);
-      
-      glm_mat4_copy(g_base_model_matrix, texturealpha3d_shader->model_matrix);
-      glm_translate(texturealpha3d_shader->model_matrix, randomized_fern_pos[i]);
-
-      // convert from quaternion to matrix
-      glm_quat_mat4(fern_rots[i], t_mat);
-      // t_mat must be on the right!
-      glm_mat4_mul(texturealpha3d_shader->model_matrix, t_mat, texturealpha3d_shader->model_matrix);
+  KRR_GLSTATE_disable(GL_CULL_FACE);
 
-      // update matrix to GPU
-      KRR_TEXALPHASHADERPROG3D_update_model_matrix(texturealpha3d_shader);
-
-      SIMPLEMODEL_render(fern);
-    }
+  // render visible fern, each instance has its own clipped texcoord
+  if (SIMPLEMODEL_set_visible_instances(fern, &instance_frustum, fern_instances, NUM_FERN) > 0)
+  {
+    KRR_GLSTATE_bind_vertex_array(fern->vao_id);
+      // bind texture
+      KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, fern_texture->texture_id);
+      SIMPLEMODEL_render_instanced(fern);
+  }
 
   // enable backface culling again
-  glEnable(GL_CULL_FACE);
+  KRR_GLSTATE_enable(GL_CULL_FACE);
+
+  // test bounding boxes of props against depth of the opaque scene, results are used in later frames
+  KRR_OCCLUSION_flush(occlusion);
 
   // SKYBOX
   KRR_SHADERPROG_bind(skybox_shader->program);
   // render skybox
-  glBindVertexArray(skybox->vao_id);
+  KRR_GLSTATE_bind_vertex_array(skybox->vao_id);
     // render
     KRR_SKYBOX_render(skybox);
   // unbind vao
-  glBindVertexArray(0);
+  KRR_GLSTATE_bind_vertex_array(0);
   // unbind shader
   KRR_SHADERPROG_unbind(skybox_shader->program);
 
   // disable scissor (if needed)
   if (g_need_clipping)
   {
-    glDisable(GL_SCISSOR_TEST);
+    KRR_GLSTATE_disable(GL_SCISSOR_TEST);
   }
 }
 
@@ -1764,7 +1713,7 @@ void usercode_render_ui_text(void)
     KRR_FONT_bind_vao(font);
     
       // enable blending with default blend function
-      glEnable(GL_BLEND);
+      KRR_GLSTATE_enable(GL_BLEND);
       glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
       // transform
@@ -1772,10 +1721,12 @@ void usercode_render_ui_text(void)
       KRR_FONTSHADERPROG2D_update_model_matrix(shared_font_shaderprogram);
 
       // render starting at top left corner
-      KRR_FONT_render_textex(font, is_freelook_mode_enabled ? TEXT_RES_FREELOOK_ENABLED : TEXT_RES_FREELOOK_DISABLED, 4.f, 4.0f, &(SIZE){g_logical_width, g_logical_height}, KRR_FONT_TEXTALIGNMENT_LEFT | KRR_FONT_TEXTALIGNMENT_TOP);
+      const KRR_CULL_STATS* cull_stats = KRR_CULL_get_stats();
+      snprintf(debug_text, DEBUG_TEXT_BUFFER-1, "%s\nVisible: %d, Culled: %d\nQueries: %d, Occluded: %d\nTerrain chunks: %d, Triangles: %d\nTerrain indices: %d KB", is_freelook_mode_enabled ? TEXT_RES_FREELOOK_ENABLED : TEXT_RES_FREELOOK_DISABLED, cull_stats->visible, cull_stats->culled, occlusion->stats.issued, occlusion->stats.skipped, tr->rendered_chunks, tr->rendered_triangles, (int)(tr->indices_count * sizeof(GLushort) / 1024));
+      KRR_FONT_render_textex(font, debug_text, 4.f, 4.0f, &(SIZE){g_logical_width, g_logical_height}, KRR_FONT_TEXTALIGNMENT_LEFT | KRR_FONT_TEXTALIGNMENT_TOP);
 
       // disable blending
-      glDisable(GL_BLEND);
+      KRR_GLSTATE_disable(GL_BLEND);
       
     KRR_FONT_unbind_vao(font);
     KRR_SHADERPROG_unbind(shared_font_shaderprogram->program);
@@ -1794,7 +1745,7 @@ void usercode_render_fps(int avg_fps)
   KRR_FONT_bind_vao(fps_font);
 
     // enable blending with default blend function
-    glEnable(GL_BLEND);
+    KRR_GLSTATE_enable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     // start with clean state of model matrix
@@ -1805,7 +1756,7 @@ void usercode_render_fps(int avg_fps)
     KRR_FONT_render_textex(fps_font, fps_text, 0.f, 4.f, &(SIZE){g_logical_width, g_logical_height}, KRR_FONT_TEXTALIGNMENT_RIGHT | KRR_FONT_TEXTALIGNMENT_TOP);
 
     // disable blending
-    glDisable(GL_BLEND);
+    KRR_GLSTATE_disable(GL_BLEND);
 
   // unbind fps-vao
   KRR_FONT_unbind_vao(fps_font);
@@ -1815,6 +1766,11 @@ void usercode_render_fps(int avg_fps)
 
 void usercode_close()
 {
+  if (render_queue != NULL)
+  {
+    KRR_RENDERQUEUE_free(render_queue);
+    render_queue = NULL;
+  }
 #ifndef DISABLE_FPS_CALC
   if (fps_font != NULL)
   {
@@ -1837,6 +1793,11 @@ void usercode_close()
     KRR_TEXSHADERPROG2D_free(texture_shader);
     texture_shader = NULL;
   }
+  if (g_scene_ubo != NULL)
+  {
+    KRR_SCENEUBO_free(g_scene_ubo);
+    g_scene_ubo = NULL;
+  }
   if (texture3d_shader != NULL)
   {
     KRR_TEXSHADERPROG3D_free(texture3d_shader);
@@ -1847,6 +1808,16 @@ void usercode_close()
     KRR_TEXALPHASHADERPROG3D_free(texturealpha3d_shader);
     texturealpha3d_shader = NULL;
   }
+  if (texture3d_instanced_shader != NULL)
+  {
+    KRR_TEXSHADERPROG3D_free(texture3d_instanced_shader);
+    texture3d_instanced_shader = NULL;
+  }
+  if (texturealpha3d_instanced_shader != NULL)
+  {
+    KRR_TEXALPHASHADERPROG3D_free(texturealpha3d_instanced_shader);
+    texturealpha3d_instanced_shader = NULL;
+  }
   if (terrain3d_shader != NULL)
   {
     KRR_TERRAINSHADERPROG3D_free(terrain3d_shader);
@@ -1857,6 +1828,11 @@ void usercode_close()
     KRR_SKYBOXSHADERPROG_free(skybox_shader);
     skybox_shader = NULL;
   }
+  if (occlusion_shader != NULL)
+  {
+    KRR_OCCLUSIONSHADERPROG_free(occlusion_shader);
+    occlusion_shader = NULL;
+  }
 
   if (terrain_texture != NULL)
   {
@@ -1934,6 +1910,12 @@ void usercode_close()
     SIMPLEMODEL_free(lamp);
     lamp = NULL;
   }
+  // free after all models allocated from it
+  if (model_pool != NULL)
+  {
+    KRR_MESHPOOL_free(model_pool);
+    model_pool = NULL;
+  }
   if (tr != NULL)
   {
     KRR_TERRAIN_free(tr);
@@ -1944,4 +1926,9 @@ void usercode_close()
     KRR_SKYBOX_free(skybox);
     skybox = NULL;
   }
+  if (occlusion != NULL)
+  {
+    KRR_OCCLUSION_free(occlusion);
+    occlusion = NULL;
+  }
 }
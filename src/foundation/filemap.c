@@ -0,0 +1,158 @@
+// mmap() and friends are POSIX, not part of c99
+#define _POSIX_C_SOURCE 200809L
+
+#include "krr/foundation/filemap.h"
+#include "krr/platforms/platforms_config.h"
+#include <stdlib.h>
+#include <SDL2/SDL_rwops.h>
+
+#if (defined __APPLE__ || defined __linux__) && defined(KRR_TARGET_PLATFORM_CATEGORY_PC)
+#define HAS_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef HAS_MMAP
+static bool map_file(KRR_FILEMAP* fm, const char* filepath)
+{
+  int fd = open(filepath, O_RDONLY);
+  if (fd == -1)
+  {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1)
+  {
+    close(fd);
+    return false;
+  }
+
+  // mmap() doesn't accept zero length
+  if (st.st_size == 0)
+  {
+    close(fd);
+    fm->data = NULL;
+    fm->size = 0;
+    fm->mapped = false;
+    return true;
+  }
+
+  void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // mapping stays valid after closing its file descriptor
+  close(fd);
+
+  if (data == MAP_FAILED)
+  {
+    return false;
+  }
+
+  fm->data = data;
+  fm->size = (size_t)st.st_size;
+  fm->mapped = true;
+  return true;
+}
+#endif
+
+static bool read_file(KRR_FILEMAP* fm, const char* filepath)
+{
+  SDL_RWops* file = SDL_RWFromFile(filepath, "rb");
+  if (file == NULL)
+  {
+    return false;
+  }
+
+  Sint64 size = SDL_RWsize(file);
+  if (size < 0)
+  {
+    SDL_RWclose(file);
+    return false;
+  }
+
+  void* data = NULL;
+  if (size > 0)
+  {
+    data = malloc((size_t)size);
+    if (data == NULL)
+    {
+      SDL_RWclose(file);
+      return false;
+    }
+
+    // read in one go, SDL_RWread() may return less than requested thus loop until done
+    size_t read = 0;
+    while (read < (size_t)size)
+    {
+      size_t n = SDL_RWread(file, (char*)data + read, 1, (size_t)size - read);
+      if (n == 0)
+      {
+        break;
+      }
+      read += n;
+    }
+
+    if (read != (size_t)size)
+    {
+      free(data);
+      SDL_RWclose(file);
+      return false;
+    }
+  }
+
+  SDL_RWclose(file);
+
+  fm->data = data;
+  fm->size = (size_t)size;
+  fm->mapped = false;
+  return true;
+}
+
+bool KRR_FILEMAP_can_map(void)
+{
+#ifdef HAS_MMAP
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool KRR_FILEMAP_open(KRR_FILEMAP* fm, const char* filepath)
+{
+  fm->data = NULL;
+  fm->size = 0;
+  fm->mapped = false;
+
+#ifdef HAS_MMAP
+  if (map_file(fm, filepath))
+  {
+    return true;
+  }
+#endif
+
+  return read_file(fm, filepath);
+}
+
+void KRR_FILEMAP_close(KRR_FILEMAP* fm)
+{
+  if (fm->data != NULL)
+  {
+#ifdef HAS_MMAP
+    if (fm->mapped)
+    {
+      munmap((void*)fm->data, fm->size);
+    }
+    else
+    {
+      free((void*)fm->data);
+    }
+#else
+    free((void*)fm->data);
+#endif
+  }
+
+  fm->data = NULL;
+  fm->size = 0;
+  fm->mapped = false;
+}
@@ -0,0 +1,252 @@
+#include "krr/graphics/cull.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// number of spheres tested at once before compacting visible indices
+#define BATCH_SIZE 64
+
+static KRR_CULL_STATS stats;
+
+static void add_stats(int tested, int visible)
+{
+  stats.tested += tested;
+  stats.visible += visible;
+  stats.culled += tested - visible;
+}
+
+void KRR_CULL_bounds_from_vertices(const VERTEXTEXNORM3D* vertices, int count, KRR_CULL_BOUNDS* out)
+{
+  memset(out, 0, sizeof(KRR_CULL_BOUNDS));
+  if (count <= 0)
+    return;
+
+  glm_vec3_copy((vec3){vertices[0].position.x, vertices[0].position.y, vertices[0].position.z}, out->aabb_min);
+  glm_vec3_copy(out->aabb_min, out->aabb_max);
+  for (int i=1; i<count; ++i)
+  {
+    const VERTEXPOS3D* v = &vertices[i].position;
+    if (v->x < out->aabb_min[0]) out->aabb_min[0] = v->x;
+    if (v->y < out->aabb_min[1]) out->aabb_min[1] = v->y;
+    if (v->z < out->aabb_min[2]) out->aabb_min[2] = v->z;
+    if (v->x > out->aabb_max[0]) out->aabb_max[0] = v->x;
+    if (v->y > out->aabb_max[1]) out->aabb_max[1] = v->y;
+    if (v->z > out->aabb_max[2]) out->aabb_max[2] = v->z;
+  }
+
+  // sphere around center of aabb, radius from the farthest vertex is tighter than half diagonal of aabb
+  glm_vec3_center(out->aabb_min, out->aabb_max, out->center);
+  float max_dist2 = 0.0f;
+  for (int i=0; i<count; ++i)
+  {
+    const VERTEXPOS3D* v = &vertices[i].position;
+    float dx = v->x - out->center[0];
+    float dy = v->y - out->center[1];
+    float dz = v->z - out->center[2];
+    float dist2 = dx*dx + dy*dy + dz*dz;
+    if (dist2 > max_dist2) max_dist2 = dist2;
+  }
+  out->radius = sqrtf(max_dist2);
+}
+
+void KRR_CULL_extract_frustum(mat4 m, KRR_CULL_FRUSTUM* out)
+{
+  // matrix is column-major, row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+  for (int i=0; i<3; ++i)
+  {
+    for (int c=0; c<4; ++c)
+    {
+      out->planes[i*2][c] = m[c][3] + m[c][i];
+      out->planes[i*2+1][c] = m[c][3] - m[c][i];
+    }
+  }
+
+  for (int i=0; i<6; ++i)
+  {
+    float* p = out->planes[i];
+    float len = sqrtf(p[0]*p[0] + p[1]*p[1] + p[2]*p[2]);
+    if (len > 0.0f)
+    {
+      glm_vec4_scale(p, 1.0f / len, p);
+    }
+  }
+}
+
+static bool sphere_visible(const KRR_CULL_FRUSTUM* frustum, const float* center, float radius)
+{
+  for (int i=0; i<6; ++i)
+  {
+    const float* p = frustum->planes[i];
+    if (p[0]*center[0] + p[1]*center[1] + p[2]*center[2] + p[3] < -radius)
+      return false;
+  }
+  return true;
+}
+
+bool KRR_CULL_test_sphere(const KRR_CULL_FRUSTUM* frustum, vec3 center, float radius)
+{
+  bool visible = sphere_visible(frustum, center, radius);
+  add_stats(1, visible ? 1 : 0);
+  return visible;
+}
+
+bool KRR_CULL_test_aabb(const KRR_CULL_FRUSTUM* frustum, vec3 aabb_min, vec3 aabb_max)
+{
+  bool visible = true;
+  for (int i=0; i<6 && visible; ++i)
+  {
+    // test only the corner farthest along plane's normal
+    const float* p = frustum->planes[i];
+    float x = p[0] >= 0.0f ? aabb_max[0] : aabb_min[0];
+    float y = p[1] >= 0.0f ? aabb_max[1] : aabb_min[1];
+    float z = p[2] >= 0.0f ? aabb_max[2] : aabb_min[2];
+    if (p[0]*x + p[1]*y + p[2]*z + p[3] < 0.0f)
+      visible = false;
+  }
+
+  add_stats(1, visible ? 1 : 0);
+  return visible;
+}
+
+/// transform bounding sphere, radius is scaled by the largest scale of matrix
+static void transform_sphere(const KRR_CULL_BOUNDS* bounds, const float (*m)[4], float* center, float* radius)
+{
+  const float* c = bounds->center;
+  for (int i=0; i<3; ++i)
+  {
+    center[i] = m[0][i]*c[0] + m[1][i]*c[1] + m[2][i]*c[2] + m[3][i];
+  }
+
+  float sx = m[0][0]*m[0][0] + m[0][1]*m[0][1] + m[0][2]*m[0][2];
+  float sy = m[1][0]*m[1][0] + m[1][1]*m[1][1] + m[1][2]*m[1][2];
+  float sz = m[2][0]*m[2][0] + m[2][1]*m[2][1] + m[2][2]*m[2][2];
+  float s = sx > sy ? sx : sy;
+  s = s > sz ? s : sz;
+  *radius = bounds->radius * sqrtf(s);
+}
+
+bool KRR_CULL_test_bounds(const KRR_CULL_FRUSTUM* frustum, const KRR_CULL_BOUNDS* bounds, mat4 transform)
+{
+  vec3 center;
+  float radius;
+  transform_sphere(bounds, (const float (*)[4])transform, center, &radius);
+  return KRR_CULL_test_sphere(frustum, center, radius);
+}
+
+KRR_CULL_SPHERES* KRR_CULL_SPHERES_new(void)
+{
+  KRR_CULL_SPHERES* out = malloc(sizeof(KRR_CULL_SPHERES));
+  out->x = NULL;
+  out->y = NULL;
+  out->z = NULL;
+  out->radius = NULL;
+  out->count = 0;
+  out->capacity = 0;
+
+  return out;
+}
+
+void KRR_CULL_SPHERES_resize(KRR_CULL_SPHERES* spheres, int count)
+{
+  if (count > spheres->capacity)
+  {
+    free(spheres->x);
+    free(spheres->y);
+    free(spheres->z);
+    free(spheres->radius);
+
+    spheres->x = malloc(sizeof(float) * count);
+    spheres->y = malloc(sizeof(float) * count);
+    spheres->z = malloc(sizeof(float) * count);
+    spheres->radius = malloc(sizeof(float) * count);
+    spheres->capacity = count;
+  }
+  spheres->count = count;
+}
+
+void KRR_CULL_SPHERES_free(KRR_CULL_SPHERES* spheres)
+{
+  free(spheres->x);
+  free(spheres->y);
+  free(spheres->z);
+  free(spheres->radius);
+
+  free(spheres);
+  spheres = NULL;
+}
+
+void KRR_CULL_SPHERES_transform(KRR_CULL_SPHERES* spheres, const KRR_CULL_BOUNDS* bounds, size_t bounds_stride, const void* transforms, size_t transforms_stride, int count)
+{
+  KRR_CULL_SPHERES_resize(spheres, count);
+
+  for (int i=0; i<count; ++i)
+  {
+    const KRR_CULL_BOUNDS* b = (const KRR_CULL_BOUNDS*)((const char*)bounds + i*bounds_stride);
+    const float (*m)[4] = (const float (*)[4])((const char*)transforms + i*transforms_stride);
+
+    vec3 center;
+    transform_sphere(b, m, center, &spheres->radius[i]);
+    spheres->x[i] = center[0];
+    spheres->y[i] = center[1];
+    spheres->z[i] = center[2];
+  }
+}
+
+int KRR_CULL_spheres(const KRR_CULL_FRUSTUM* frustum, const KRR_CULL_SPHERES* spheres, int* out_visible)
+{
+  const float* restrict xs = spheres->x;
+  const float* restrict ys = spheres->y;
+  const float* restrict zs = spheres->z;
+  const float* restrict rs = spheres->radius;
+
+  int visible = 0;
+  for (int base=0; base<spheres->count; base+=BATCH_SIZE)
+  {
+    const int n = spheres->count - base < BATCH_SIZE ? spheres->count - base : BATCH_SIZE;
+
+    // test a batch against all planes without branching, this loop is vectorizable
+    int inside[BATCH_SIZE];
+    for (int i=0; i<n; ++i)
+    {
+      inside[i] = 1;
+    }
+    for (int p=0; p<6; ++p)
+    {
+      const float a = frustum->planes[p][0];
+      const float b = frustum->planes[p][1];
+      const float c = frustum->planes[p][2];
+      const float d = frustum->planes[p][3];
+      for (int i=0; i<n; ++i)
+      {
+        const int j = base + i;
+        inside[i] &= (a*xs[j] + b*ys[j] + c*zs[j] + d >= -rs[j]);
+      }
+    }
+
+    // compact visible indices, also without branching
+    for (int i=0; i<n; ++i)
+    {
+      out_visible[visible] = base + i;
+      visible += inside[i];
+    }
+  }
+
+  add_stats(spheres->count, visible);
+  return visible;
+}
+
+int KRR_CULL_batch(const KRR_CULL_FRUSTUM* frustum, KRR_CULL_SPHERES* scratch, const KRR_CULL_BOUNDS* bounds, size_t bounds_stride, const void* transforms, size_t transforms_stride, int count, int* out_visible)
+{
+  KRR_CULL_SPHERES_transform(scratch, bounds, bounds_stride, transforms, transforms_stride, count);
+  return KRR_CULL_spheres(frustum, scratch, out_visible);
+}
+
+const KRR_CULL_STATS* KRR_CULL_get_stats(void)
+{
+  return &stats;
+}
+
+void KRR_CULL_reset_stats(void)
+{
+  memset(&stats, 0, sizeof(stats));
+}
@@ -1,4 +1,5 @@
 #include "krr/graphics/font.h"
+#include "krr/graphics/glstate.h"
 #include <stdlib.h>
 #include <stddef.h>
 #include <SDL2/SDL_rwops.h>
@@ -259,7 +260,7 @@ bool KRR_FONT_load_bitmap(KRR_FONT* font, const char* path)
   }
 
   // set texture wrap
-  glBindTexture(GL_TEXTURE_2D, texture->texture_id);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, texture->texture_id);
 
 #ifdef GL_NV_texture_border_clamp
   // nvidia extension
@@ -274,18 +275,18 @@ bool KRR_FONT_load_bitmap(KRR_FONT* font, const char* path)
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER_OES);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER_OES);
 #endif
-  glBindTexture(GL_TEXTURE_2D, 0);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, 0);
 
   // setup vao's binding
   //  use vao of spritesheet as KRR_FONT relies on it
   KRR_SPRITESHEET* ss = font->spritesheet;
-  glBindVertexArray(ss->vao);
+  KRR_GLSTATE_bind_vertex_array(ss->vao);
 
     // enable all attribute pointers
     KRR_FONTSHADERPROG2D_enable_attrib_pointers(shared_font_shaderprogram);
 
     // bind vertex data
-    glBindBuffer(GL_ARRAY_BUFFER, ss->vertex_data_buffer);
+    KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, ss->vertex_data_buffer);
 
     // set texture coordinate attrib pointer
     KRR_FONTSHADERPROG2D_set_texcoord_pointer(shared_font_shaderprogram, sizeof(VERTEXTEX2D), (GLvoid*)offsetof(VERTEXTEX2D, texcoord));
@@ -294,7 +295,7 @@ bool KRR_FONT_load_bitmap(KRR_FONT* font, const char* path)
 
     // note: binding ibo will be done at rendering time depends on which character to render at that time
 
-  glBindVertexArray(0);
+  KRR_GLSTATE_bind_vertex_array(0);
 
   // set spacing variables
   font->space = cell_width / 2.f;
@@ -485,7 +486,7 @@ bool KRR_FONT_load_freetype(KRR_FONT* font, const char* path, GLuint pixel_size)
   }
 
   // set texture wrap
-  glBindTexture(GL_TEXTURE_2D, font->spritesheet->ltexture->texture_id);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, font->spritesheet->ltexture->texture_id);
 #ifdef GL_NV_texture_border_clamp
   // nvidia extension
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER_NV);
@@ -499,18 +500,18 @@ bool KRR_FONT_load_freetype(KRR_FONT* font, const char* path, GLuint pixel_size)
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER_OES);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER_OES);
 #endif
-  glBindTexture(GL_TEXTURE_2D, 0);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, 0);
 
   // setup vao's binding
   //  use vao of spritesheet as KRR_FONT relies on it
   KRR_SPRITESHEET* ss = font->spritesheet;
-  glBindVertexArray(ss->vao);
+  KRR_GLSTATE_bind_vertex_array(ss->vao);
 
     // enable all attribute pointers
     KRR_FONTSHADERPROG2D_enable_attrib_pointers(shared_font_shaderprogram);
 
     // bind vertex data
-    glBindBuffer(GL_ARRAY_BUFFER, ss->vertex_data_buffer);
+    KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, ss->vertex_data_buffer);
 
     // set texture coordinate attrib pointer
     KRR_FONTSHADERPROG2D_set_texcoord_pointer(shared_font_shaderprogram, sizeof(VERTEXTEX2D), (GLvoid*)offsetof(VERTEXTEX2D, texcoord));
@@ -519,7 +520,7 @@ bool KRR_FONT_load_freetype(KRR_FONT* font, const char* path, GLuint pixel_size)
 
     // note: binding ibo will be done at rendering time depends on which character to render at that time
 
-  glBindVertexArray(0);
+  KRR_GLSTATE_bind_vertex_array(0);
 
   // set spacing variables
   font->space = cell_width / 2.0f;
@@ -555,10 +556,10 @@ void KRR_FONT_bind_vao(KRR_FONT* font)
   KRR_SPRITESHEET* ss = font->spritesheet;
 
   // as KRR_FONT relies on KRR_SPRITESHEET, thus we bind KRR_SPRITESHEET's vao
-  glBindVertexArray(ss->vao);
+  KRR_GLSTATE_bind_vertex_array(ss->vao);
 
   // bind texture
-  glBindTexture(GL_TEXTURE_2D, ss->ltexture->texture_id);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, ss->ltexture->texture_id);
 }
 
 void KRR_FONT_render_text(KRR_FONT* font, const char* text, GLfloat x, GLfloat y)
@@ -581,7 +582,7 @@ void KRR_FONT_render_text(KRR_FONT* font, const char* text, GLfloat x, GLfloat y
     KRR_FONTSHADERPROG2D_update_model_matrix(shared_font_shaderprogram);
 
     // set texture
-    glBindTexture(GL_TEXTURE_2D, texture_id);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, texture_id);
 
     // go through string
     int text_length = strlen(text);
@@ -611,8 +612,9 @@ void KRR_FONT_render_text(KRR_FONT* font, const char* text, GLfloat x, GLfloat y
         GLuint ascii = (unsigned char)text[i];
 
         // draw quad using vertex data and index data
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ss->index_buffers[ascii]);
-        glDrawElements(GL_TRIANGLE_FAN, 4, GL_UNSIGNED_INT, NULL);
+        KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ss->index_buffers[ascii]);
+        KRR_SHADERPROG_flush(shared_font_shaderprogram->program);
+        glDrawElements(GL_TRIANGLE_FAN, 4, ss->index_type, NULL);
 
         // get clip
         RECT* clip = (RECT*)vector_get(ss->clips, ascii);
@@ -673,7 +675,7 @@ void KRR_FONT_render_textex(KRR_FONT* font, const char* text, GLfloat x, GLfloat
   KRR_FONTSHADERPROG2D_update_model_matrix(shared_font_shaderprogram);
 
   // set texture
-  glBindTexture(GL_TEXTURE_2D, texture_id);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, texture_id);
 
   // go through string
   int text_length = strlen(text);
@@ -719,8 +721,9 @@ void KRR_FONT_render_textex(KRR_FONT* font, const char* text, GLfloat x, GLfloat
       GLuint ascii = (unsigned char)text[i];
 
       // draw quad using vertex data and index data
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ss->index_buffers[ascii]);
-      glDrawElements(GL_TRIANGLE_FAN, 4, GL_UNSIGNED_INT, NULL);
+      KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ss->index_buffers[ascii]);
+      KRR_SHADERPROG_flush(shared_font_shaderprogram->program);
+      glDrawElements(GL_TRIANGLE_FAN, 4, ss->index_type, NULL);
 
       // get clip
       RECT* clip = (RECT*)vector_get(ss->clips, ascii);
@@ -735,7 +738,7 @@ void KRR_FONT_render_textex(KRR_FONT* font, const char* text, GLfloat x, GLfloat
 
 void KRR_FONT_unbind_vao(KRR_FONT* font)
 {
-  glBindVertexArray(0);
+  KRR_GLSTATE_bind_vertex_array(0);
 }
 
 GLfloat KRR_FONT_string_width(KRR_FONT* font, const char* string)
@@ -196,12 +196,12 @@ bool KRR_FONTSHADERPROG2D_load_program(KRR_FONTSHADERPROG2D* program)
 
 void KRR_FONTSHADERPROG2D_update_projection_matrix(KRR_FONTSHADERPROG2D* program)
 {
-  glUniformMatrix4fv(program->projection_matrix_location, 1, GL_FALSE, program->projection_matrix[0]);
+  KRR_SHADERPROG_set_uniform(program->program, program->projection_matrix_location, GL_FLOAT_MAT4, 1, program->projection_matrix[0]);
 }
 
 void KRR_FONTSHADERPROG2D_update_model_matrix(KRR_FONTSHADERPROG2D* program)
 {
-  glUniformMatrix4fv(program->model_matrix_location, 1, GL_FALSE, program->model_matrix[0]);
+  KRR_SHADERPROG_set_uniform(program->program, program->model_matrix_location, GL_FLOAT_MAT4, 1, program->model_matrix[0]);
 }
 
 void KRR_FONTSHADERPROG2D_set_vertex_pointer(KRR_FONTSHADERPROG2D* program, GLsizei stride, const GLvoid* data)
@@ -216,12 +216,13 @@ void KRR_FONTSHADERPROG2D_set_texcoord_pointer(KRR_FONTSHADERPROG2D* program, GL
 
 void KRR_FONTSHADERPROG2D_set_texture_sampler(KRR_FONTSHADERPROG2D* program, GLuint sampler)
 {
-  glUniform1i(program->texture_sampler_location, sampler);
+  GLint unit = sampler;
+  KRR_SHADERPROG_set_uniform(program->program, program->texture_sampler_location, GL_INT, 1, &unit);
 }
 
 void KRR_FONTSHADERPROG2D_set_text_color(KRR_FONTSHADERPROG2D* program, COLOR32 color)
 {
-  glUniform4f(program->text_color_location, color.r, color.g, color.b, color.a);
+  KRR_SHADERPROG_set_uniform(program->program, program->text_color_location, GL_FLOAT_VEC4, 1, &color.r);
 }
 
 void KRR_FONTSHADERPROG2D_enable_attrib_pointers(KRR_FONTSHADERPROG2D* program)
@@ -0,0 +1,356 @@
+#include "krr/graphics/glstate.h"
+#include <string.h>
+
+// tracked buffer targets
+enum
+{
+  BUFFER_ARRAY,
+  BUFFER_ELEMENT_ARRAY,
+  BUFFER_UNIFORM,
+  BUFFER_TARGETS_COUNT
+};
+
+// tracked texture targets
+enum
+{
+  TEXTURE_2D,
+  TEXTURE_CUBE_MAP,
+  TEXTURE_TARGETS_COUNT
+};
+
+// tracked capabilities
+enum
+{
+  CAP_BLEND,
+  CAP_CULL_FACE,
+  CAP_DEPTH_TEST,
+  CAP_SCISSOR_TEST,
+  CAP_STENCIL_TEST,
+  CAP_POLYGON_OFFSET_FILL,
+  CAP_PRIMITIVE_RESTART_FIXED_INDEX,
+  CAPS_COUNT
+};
+
+/// name bound to a binding point, it's unknown until first set or queried
+typedef struct
+{
+  bool known;
+  GLuint name;
+} BINDING;
+
+// all zeros means all state is unknown
+static struct
+{
+  BINDING program;
+  BINDING vertex_array;
+  BINDING buffers[BUFFER_TARGETS_COUNT];
+
+  BINDING active_texture;
+  BINDING textures[KRR_GLSTATE_MAX_TEXTURE_UNITS][TEXTURE_TARGETS_COUNT];
+
+  bool caps_known[CAPS_COUNT];
+  bool caps[CAPS_COUNT];
+
+  bool viewport_known;
+  GLint viewport[4];
+} state;
+
+static KRR_GLSTATE_STATS stats;
+
+static int buffer_index(GLenum target)
+{
+  switch (target)
+  {
+    case GL_ARRAY_BUFFER: return BUFFER_ARRAY;
+    case GL_ELEMENT_ARRAY_BUFFER: return BUFFER_ELEMENT_ARRAY;
+    case GL_UNIFORM_BUFFER: return BUFFER_UNIFORM;
+    default: return -1;
+  }
+}
+
+static int texture_index(GLenum target)
+{
+  switch (target)
+  {
+    case GL_TEXTURE_2D: return TEXTURE_2D;
+    case GL_TEXTURE_CUBE_MAP: return TEXTURE_CUBE_MAP;
+    default: return -1;
+  }
+}
+
+static int cap_index(GLenum cap)
+{
+  switch (cap)
+  {
+    case GL_BLEND: return CAP_BLEND;
+    case GL_CULL_FACE: return CAP_CULL_FACE;
+    case GL_DEPTH_TEST: return CAP_DEPTH_TEST;
+    case GL_SCISSOR_TEST: return CAP_SCISSOR_TEST;
+    case GL_STENCIL_TEST: return CAP_STENCIL_TEST;
+    case GL_POLYGON_OFFSET_FILL: return CAP_POLYGON_OFFSET_FILL;
+    case GL_PRIMITIVE_RESTART_FIXED_INDEX: return CAP_PRIMITIVE_RESTART_FIXED_INDEX;
+    default: return -1;
+  }
+}
+
+/// set binding, return true if it has changed thus caller needs to issue the call
+static bool set_binding(BINDING* b, GLuint name, KRR_GLSTATE_COUNTER* counter)
+{
+  if (b->known && b->name == name)
+  {
+    ++counter->filtered;
+    return false;
+  }
+
+  b->known = true;
+  b->name = name;
+  ++counter->issued;
+  return true;
+}
+
+/// reset binding to 0 if it's any of deleted names
+static void reset_if_deleted(BINDING* b, GLsizei n, const GLuint* names)
+{
+  if (!b->known)
+  {
+    return;
+  }
+
+  for (GLsizei i=0; i<n; ++i)
+  {
+    if (names[i] != 0 && b->name == names[i])
+    {
+      b->name = 0;
+      return;
+    }
+  }
+}
+
+/// index of active texture unit, or -1 if not known or not tracked
+static int active_unit(void)
+{
+  if (!state.active_texture.known)
+  {
+    return -1;
+  }
+
+  int unit = (int)(state.active_texture.name - GL_TEXTURE0);
+  return unit >= 0 && unit < KRR_GLSTATE_MAX_TEXTURE_UNITS ? unit : -1;
+}
+
+void KRR_GLSTATE_use_program(GLuint program_id)
+{
+  if (set_binding(&state.program, program_id, &stats.program))
+  {
+    glUseProgram(program_id);
+  }
+}
+
+GLuint KRR_GLSTATE_current_program(void)
+{
+  if (!state.program.known)
+  {
+    GLint id;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &id);
+    state.program.known = true;
+    state.program.name = (GLuint)id;
+  }
+  return state.program.name;
+}
+
+void KRR_GLSTATE_bind_vertex_array(GLuint vao_id)
+{
+  if (set_binding(&state.vertex_array, vao_id, &stats.vertex_array))
+  {
+    glBindVertexArray(vao_id);
+    // element array buffer is part of vao state
+    state.buffers[BUFFER_ELEMENT_ARRAY].known = false;
+  }
+}
+
+void KRR_GLSTATE_bind_buffer(GLenum target, GLuint buffer_id)
+{
+  int i = buffer_index(target);
+  if (i == -1)
+  {
+    ++stats.buffer.issued;
+    glBindBuffer(target, buffer_id);
+    return;
+  }
+
+  // element array buffer of unknown vao is unknown too
+  if (i == BUFFER_ELEMENT_ARRAY && !state.vertex_array.known)
+  {
+    state.buffers[i].known = false;
+  }
+
+  if (set_binding(&state.buffers[i], buffer_id, &stats.buffer))
+  {
+    glBindBuffer(target, buffer_id);
+  }
+}
+
+void KRR_GLSTATE_active_texture(GLenum texture_unit)
+{
+  // it's not counted separately, binding texture is what matters
+  if (!state.active_texture.known || state.active_texture.name != texture_unit)
+  {
+    state.active_texture.known = true;
+    state.active_texture.name = texture_unit;
+    ++stats.texture.issued;
+    glActiveTexture(texture_unit);
+  }
+  else
+  {
+    ++stats.texture.filtered;
+  }
+}
+
+void KRR_GLSTATE_bind_texture(GLenum target, GLuint texture_id)
+{
+  int unit = active_unit();
+  int i = texture_index(target);
+  if (unit == -1 || i == -1)
+  {
+    ++stats.texture.issued;
+    glBindTexture(target, texture_id);
+    return;
+  }
+
+  if (set_binding(&state.textures[unit][i], texture_id, &stats.texture))
+  {
+    glBindTexture(target, texture_id);
+  }
+}
+
+void KRR_GLSTATE_enable(GLenum cap)
+{
+  int i = cap_index(cap);
+  if (i != -1 && state.caps_known[i] && state.caps[i])
+  {
+    ++stats.capability.filtered;
+    return;
+  }
+
+  if (i != -1)
+  {
+    state.caps_known[i] = true;
+    state.caps[i] = true;
+  }
+  ++stats.capability.issued;
+  glEnable(cap);
+}
+
+void KRR_GLSTATE_disable(GLenum cap)
+{
+  int i = cap_index(cap);
+  if (i != -1 && state.caps_known[i] && !state.caps[i])
+  {
+    ++stats.capability.filtered;
+    return;
+  }
+
+  if (i != -1)
+  {
+    state.caps_known[i] = true;
+    state.caps[i] = false;
+  }
+  ++stats.capability.issued;
+  glDisable(cap);
+}
+
+bool KRR_GLSTATE_is_enabled(GLenum cap)
+{
+  int i = cap_index(cap);
+  if (i == -1)
+  {
+    return glIsEnabled(cap) == GL_TRUE;
+  }
+
+  if (!state.caps_known[i])
+  {
+    state.caps_known[i] = true;
+    state.caps[i] = glIsEnabled(cap) == GL_TRUE;
+  }
+  return state.caps[i];
+}
+
+void KRR_GLSTATE_viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+  if (state.viewport_known &&
+      state.viewport[0] == x &&
+      state.viewport[1] == y &&
+      state.viewport[2] == width &&
+      state.viewport[3] == height)
+  {
+    ++stats.viewport.filtered;
+    return;
+  }
+
+  state.viewport_known = true;
+  state.viewport[0] = x;
+  state.viewport[1] = y;
+  state.viewport[2] = width;
+  state.viewport[3] = height;
+  ++stats.viewport.issued;
+  glViewport(x, y, width, height);
+}
+
+void KRR_GLSTATE_get_viewport(GLint viewport[4])
+{
+  if (!state.viewport_known)
+  {
+    glGetIntegerv(GL_VIEWPORT, state.viewport);
+    state.viewport_known = true;
+  }
+  memcpy(viewport, state.viewport, sizeof(GLint) * 4);
+}
+
+void KRR_GLSTATE_delete_buffers(GLsizei n, const GLuint* buffers)
+{
+  glDeleteBuffers(n, buffers);
+  for (int i=0; i<BUFFER_TARGETS_COUNT; ++i)
+  {
+    reset_if_deleted(&state.buffers[i], n, buffers);
+  }
+}
+
+void KRR_GLSTATE_delete_vertex_arrays(GLsizei n, const GLuint* arrays)
+{
+  glDeleteVertexArrays(n, arrays);
+
+  GLuint before = state.vertex_array.name;
+  reset_if_deleted(&state.vertex_array, n, arrays);
+  // falls back to default vao which has its own element array buffer
+  if (state.vertex_array.name != before)
+  {
+    state.buffers[BUFFER_ELEMENT_ARRAY].known = false;
+  }
+}
+
+void KRR_GLSTATE_delete_textures(GLsizei n, const GLuint* textures)
+{
+  glDeleteTextures(n, textures);
+  for (int u=0; u<KRR_GLSTATE_MAX_TEXTURE_UNITS; ++u)
+  {
+    for (int i=0; i<TEXTURE_TARGETS_COUNT; ++i)
+    {
+      reset_if_deleted(&state.textures[u][i], n, textures);
+    }
+  }
+}
+
+void KRR_GLSTATE_invalidate(void)
+{
+  memset(&state, 0, sizeof(state));
+}
+
+const KRR_GLSTATE_STATS* KRR_GLSTATE_get_stats(void)
+{
+  return &stats;
+}
+
+void KRR_GLSTATE_reset_stats(void)
+{
+  memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,606 @@
+#include "krr/graphics/heightmap.h"
+#include "krr/foundation/filemap.h"
+#include "krr/foundation/log.h"
+#include <SDL2/SDL_image.h>
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_cpuinfo.h>
+#include <SDL2/SDL_error.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <zlib.h>
+
+static const GLubyte png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+// png color type of grayscale without alpha
+#define PNG_COLOR_GRAY 0
+
+// minimum number of rows worth generating by an additional thread
+#define MIN_NOISE_BAND_ROWS 32
+// upper limit of number of threads generating noise
+#define MAX_NOISE_BANDS 16
+
+// large odd constants to spread lattice coordinates over hash input
+#define NOISE_PRIME_X 0x8da6b343u
+#define NOISE_PRIME_Y 0xd8163841u
+#define NOISE_PRIME_OCTAVE 0x9e3779b9u
+
+// rows of procedural heightmap generated by a single thread
+typedef struct
+{
+  const KRR_HEIGHTMAP_NOISE* params;
+  int width;
+  int row_begin;
+  int row_end;
+
+  /// noise of all rows before being quantized, shared by all bands
+  float* values;
+
+  /// range of values in this band
+  float min;
+  float max;
+} NOISE_BAND;
+
+static void init_defaults(KRR_HEIGHTMAP* hm)
+{
+  hm->width = 0;
+  hm->height = 0;
+  hm->pixels = NULL;
+  hm->source_bits = 0;
+}
+
+static GLuint read_be32(const GLubyte* p)
+{
+  return ((GLuint)p[0] << 24) | ((GLuint)p[1] << 16) | ((GLuint)p[2] << 8) | (GLuint)p[3];
+}
+
+static bool has_extension(const char* path, const char* ext)
+{
+  size_t path_len = strlen(path);
+  size_t ext_len = strlen(ext);
+  return path_len >= ext_len && SDL_strcasecmp(path + path_len - ext_len, ext) == 0;
+}
+
+static int paeth(int a, int b, int c)
+{
+  int p = a + b - c;
+  int pa = abs(p - a);
+  int pb = abs(p - b);
+  int pc = abs(p - c);
+  if (pa <= pb && pa <= pc)
+    return a;
+  return pb <= pc ? b : c;
+}
+
+// reverse filter of each scanline in-place, `bpp` is bytes per pixel
+static bool unfilter_png(GLubyte* data, int height, size_t stride, int bpp)
+{
+  const GLubyte* prev = NULL;
+  for (int y=0; y<height; ++y)
+  {
+    GLubyte* row = data + y * (stride + 1);
+    const int filter = row[0];
+    GLubyte* cur = row + 1;
+
+    for (size_t i=0; i<stride; ++i)
+    {
+      const int a = i >= (size_t)bpp ? cur[i - bpp] : 0;
+      const int b = prev != NULL ? prev[i] : 0;
+      const int c = (prev != NULL && i >= (size_t)bpp) ? prev[i - bpp] : 0;
+      switch (filter)
+      {
+        case 0: break;
+        case 1: cur[i] += a; break;
+        case 2: cur[i] += b; break;
+        case 3: cur[i] += (a + b) / 2; break;
+        case 4: cur[i] += paeth(a, b, c); break;
+        default:
+          KRR_LOGE("Invalid png filter type %d", filter);
+          return false;
+      }
+    }
+    prev = cur;
+  }
+  return true;
+}
+
+// decode non-interlaced grayscale png with full precision
+// return 1 on success, 0 if png is valid but not supported here thus should be decoded by other means, -1 on error
+static int decode_gray_png(KRR_HEIGHTMAP* hm, const GLubyte* data, size_t size)
+{
+  if (size < 8 + 25 || memcmp(data, png_signature, 8) != 0)
+    return 0;
+
+  // IHDR is always the first chunk
+  const GLubyte* ihdr = data + 8;
+  if (read_be32(ihdr) != 13 || memcmp(ihdr + 4, "IHDR", 4) != 0)
+    return -1;
+
+  const int width = (int)read_be32(ihdr + 8);
+  const int height = (int)read_be32(ihdr + 12);
+  const int bit_depth = ihdr[16];
+  const int color_type = ihdr[17];
+  const int interlace = ihdr[20];
+  if (color_type != PNG_COLOR_GRAY || (bit_depth != 8 && bit_depth != 16) || interlace != 0)
+    return 0;
+  if (width <= 0 || height <= 0)
+    return -1;
+
+  const int bpp = bit_depth / 8;
+  const size_t stride = (size_t)width * bpp;
+  const size_t raw_size = (stride + 1) * height;
+  GLubyte* raw = malloc(raw_size);
+
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  if (inflateInit(&zs) != Z_OK)
+  {
+    free(raw);
+    return -1;
+  }
+  zs.next_out = raw;
+  zs.avail_out = (uInt)raw_size;
+
+  // inflate content of all IDAT chunks as a single stream
+  int zresult = Z_OK;
+  const GLubyte* chunk = ihdr + 8 + 13 + 4;
+  while (chunk + 12 <= data + size && zresult != Z_STREAM_END)
+  {
+    const GLuint length = read_be32(chunk);
+    if (length > (size_t)(data + size - chunk) - 12)
+      break;
+
+    if (memcmp(chunk + 4, "IDAT", 4) == 0)
+    {
+      zs.next_in = (Bytef*)(chunk + 8);
+      zs.avail_in = length;
+      zresult = inflate(&zs, Z_NO_FLUSH);
+      if (zresult != Z_OK && zresult != Z_STREAM_END)
+        break;
+    }
+    else if (memcmp(chunk + 4, "IEND", 4) == 0)
+    {
+      break;
+    }
+    chunk += 12 + length;
+  }
+  inflateEnd(&zs);
+
+  if (zs.avail_out != 0 || (zresult != Z_OK && zresult != Z_STREAM_END))
+  {
+    KRR_LOGE("Corrupted png image data");
+    free(raw);
+    return -1;
+  }
+
+  if (!unfilter_png(raw, height, stride, bpp))
+  {
+    free(raw);
+    return -1;
+  }
+
+  hm->width = width;
+  hm->height = height;
+  hm->source_bits = bit_depth;
+  hm->pixels = malloc(sizeof(GLushort) * width * height);
+  for (int y=0; y<height; ++y)
+  {
+    const GLubyte* restrict src = raw + y * (stride + 1) + 1;
+    GLushort* restrict dst = hm->pixels + y * width;
+    if (bit_depth == 16)
+    {
+      // png stores samples in big-endian
+      for (int x=0; x<width; ++x)
+      {
+        dst[x] = (GLushort)((src[x*2] << 8) | src[x*2 + 1]);
+      }
+    }
+    else
+    {
+      for (int x=0; x<width; ++x)
+      {
+        dst[x] = (GLushort)(src[x] * 257);
+      }
+    }
+  }
+
+  free(raw);
+  return 1;
+}
+
+// decode any image SDL_image supports, taking its red channel
+static bool decode_image(KRR_HEIGHTMAP* hm, const void* data, size_t size, const char* path)
+{
+  SDL_Surface* loaded_surface = IMG_Load_RW(SDL_RWFromConstMem(data, (int)size), 1);
+  if (loaded_surface == NULL)
+  {
+    KRR_LOGE("Unable to load image %s! SDL_image error: %s", path, IMG_GetError());
+    return false;
+  }
+
+  // grayscale image is usually loaded as indexed color, look up its palette for gray level
+  // otherwise convert to known format to read red channel from
+  const SDL_Palette* palette = NULL;
+  if (loaded_surface->format->BytesPerPixel == 1)
+  {
+    palette = loaded_surface->format->palette;
+  }
+  else
+  {
+    SDL_Surface* converted_surface = SDL_ConvertSurfaceFormat(loaded_surface, SDL_PIXELFORMAT_ABGR8888, 0);
+    SDL_FreeSurface(loaded_surface);
+    loaded_surface = converted_surface;
+    if (loaded_surface == NULL)
+    {
+      KRR_LOGE("Cannot convert to ABGR8888 format");
+      return false;
+    }
+  }
+
+  const int width = loaded_surface->w;
+  const int height = loaded_surface->h;
+  hm->width = width;
+  hm->height = height;
+  hm->source_bits = 8;
+  hm->pixels = malloc(sizeof(GLushort) * width * height);
+
+  SDL_LockSurface(loaded_surface);
+  for (int y=0; y<height; ++y)
+  {
+    const GLubyte* src = (const GLubyte*)loaded_surface->pixels + y * loaded_surface->pitch;
+    GLushort* dst = hm->pixels + y * width;
+    for (int x=0; x<width; ++x)
+    {
+      if (palette != NULL)
+        dst[x] = (GLushort)(palette->colors[src[x]].r * 257);
+      else if (loaded_surface->format->BytesPerPixel == 1)
+        dst[x] = (GLushort)(src[x] * 257);
+      else
+        dst[x] = (GLushort)(src[x*4] * 257);
+    }
+  }
+  SDL_UnlockSurface(loaded_surface);
+
+  SDL_FreeSurface(loaded_surface);
+  loaded_surface = NULL;
+
+  return true;
+}
+
+KRR_HEIGHTMAP* KRR_HEIGHTMAP_new(void)
+{
+  KRR_HEIGHTMAP* out = malloc(sizeof(KRR_HEIGHTMAP));
+  init_defaults(out);
+  return out;
+}
+
+bool KRR_HEIGHTMAP_load(KRR_HEIGHTMAP* hm, const char* path)
+{
+  if (has_extension(path, ".raw") || has_extension(path, ".r16"))
+  {
+    return KRR_HEIGHTMAP_load_raw16(hm, path, 0, 0);
+  }
+
+  KRR_HEIGHTMAP_free_internals(hm);
+
+  KRR_FILEMAP fm;
+  if (!KRR_FILEMAP_open(&fm, path))
+  {
+    KRR_LOGE("Cannot read heightmap file %s", path);
+    return false;
+  }
+
+  int result = decode_gray_png(hm, fm.data, fm.size);
+  if (result == 0)
+  {
+    result = decode_image(hm, fm.data, fm.size, path) ? 1 : -1;
+  }
+  KRR_FILEMAP_close(&fm);
+
+  if (result < 0)
+  {
+    KRR_LOGE("Error decoding heightmap %s", path);
+    return false;
+  }
+
+  KRR_LOGI("load heightmap %dx%d %d-bit from %s", hm->width, hm->height, hm->source_bits, path);
+  return true;
+}
+
+bool KRR_HEIGHTMAP_load_raw16(KRR_HEIGHTMAP* hm, const char* path, int width, int height)
+{
+  KRR_HEIGHTMAP_free_internals(hm);
+
+  KRR_FILEMAP fm;
+  if (!KRR_FILEMAP_open(&fm, path))
+  {
+    KRR_LOGE("Cannot read heightmap file %s", path);
+    return false;
+  }
+
+  const size_t samples = fm.size / sizeof(GLushort);
+  if (width == 0 && height == 0)
+  {
+    width = (int)sqrt((double)samples);
+    height = width;
+  }
+  if (width <= 0 || height <= 0 || (size_t)width * height * sizeof(GLushort) != fm.size)
+  {
+    KRR_LOGE("Size of raw heightmap %s doesn't match its dimensions", path);
+    KRR_FILEMAP_close(&fm);
+    return false;
+  }
+
+  hm->width = width;
+  hm->height = height;
+  hm->source_bits = 16;
+  hm->pixels = malloc(fm.size);
+
+  // read byte by byte as samples are little-endian regardless of platform
+  const GLubyte* restrict src = fm.data;
+  GLushort* restrict dst = hm->pixels;
+  for (size_t i=0; i<samples; ++i)
+  {
+    dst[i] = (GLushort)(src[i*2] | (src[i*2 + 1] << 8));
+  }
+
+  KRR_FILEMAP_close(&fm);
+
+  KRR_LOGI("load heightmap %dx%d 16-bit from %s", width, height, path);
+  return true;
+}
+
+void KRR_HEIGHTMAP_noise_defaults(KRR_HEIGHTMAP_NOISE* params, uint32_t seed)
+{
+  params->type = KRR_HEIGHTMAP_NOISE_FBM;
+  params->seed = seed;
+  params->octaves = 6;
+  params->frequency = 1.0f / 256.0f;
+  params->lacunarity = 2.0f;
+  params->gain = 0.5f;
+}
+
+/// mix bits of lattice point into well distributed 32-bit hash
+static inline uint32_t noise_hash(uint32_t h)
+{
+  h ^= h >> 15;
+  h *= 0x2c1b3c6du;
+  h ^= h >> 12;
+  h *= 0x297a2d39u;
+  h ^= h >> 15;
+  return h;
+}
+
+/// dot product of offset (dx, dy) with gradient taken from bits of hash
+static inline float noise_gradient(uint32_t h, float dx, float dy)
+{
+  const float gx = (float)(int)(h & 0xffffu) * (2.0f / 65535.0f) - 1.0f;
+  const float gy = (float)(int)(h >> 16) * (2.0f / 65535.0f) - 1.0f;
+  return gx*dx + gy*dy;
+}
+
+/// quintic fade curve, its first and second derivatives are zero at 0 and 1
+static inline float noise_fade(float t)
+{
+  return t*t*t*(t*(t*6.0f - 15.0f) + 10.0f);
+}
+
+/// write gradient noise of one octave along row y into dst
+/// loop has no branch nor table lookup, so that compiler can vectorize it
+static void noise_octave_row(uint32_t seed, float frequency, float offset, int y, int width, float* restrict dst)
+{
+  // coordinates are never negative, thus truncation is floor
+  const float fy = y * frequency + offset;
+  const int iy = (int)fy;
+  const float dy0 = fy - iy;
+  const float dy1 = dy0 - 1.0f;
+  const float v = noise_fade(dy0);
+  const uint32_t hy0 = (uint32_t)iy * NOISE_PRIME_Y ^ seed;
+  const uint32_t hy1 = hy0 + NOISE_PRIME_Y;
+
+  for (int i=0; i<width; ++i)
+  {
+    const float fx = i * frequency + offset;
+    const int ix = (int)fx;
+    const float dx0 = fx - ix;
+    const float dx1 = dx0 - 1.0f;
+    const uint32_t hx0 = (uint32_t)ix * NOISE_PRIME_X;
+    const uint32_t hx1 = hx0 + NOISE_PRIME_X;
+
+    const float n00 = noise_gradient(noise_hash(hx0 ^ hy0), dx0, dy0);
+    const float n10 = noise_gradient(noise_hash(hx1 ^ hy0), dx1, dy0);
+    const float n01 = noise_gradient(noise_hash(hx0 ^ hy1), dx0, dy1);
+    const float n11 = noise_gradient(noise_hash(hx1 ^ hy1), dx1, dy1);
+
+    const float u = noise_fade(dx0);
+    const float nx0 = n00 + u*(n10 - n00);
+    const float nx1 = n01 + u*(n11 - n01);
+    dst[i] = nx0 + v*(nx1 - nx0);
+  }
+}
+
+static void noise_band(NOISE_BAND* b)
+{
+  const KRR_HEIGHTMAP_NOISE* params = b->params;
+  const int w = b->width;
+
+  // noise of current octave, then weight of ridged noise carried to the next octave
+  float* scratch = malloc(sizeof(float) * w * 2);
+  float* restrict octave = scratch;
+  float* restrict weight = scratch + w;
+
+  float min = FLT_MAX;
+  float max = -FLT_MAX;
+
+  for (int j=b->row_begin; j<b->row_end; ++j)
+  {
+    float* restrict sum = b->values + (size_t)j * w;
+    for (int i=0; i<w; ++i)
+    {
+      sum[i] = 0.0f;
+      weight[i] = 1.0f;
+    }
+
+    float frequency = params->frequency;
+    float amplitude = 1.0f;
+    for (int o=0; o<params->octaves; ++o)
+    {
+      // each octave has its own lattice, shifted to not line up with the others at origin
+      const uint32_t seed = noise_hash(params->seed + (uint32_t)o * NOISE_PRIME_OCTAVE);
+      const float offset = (float)(int)(noise_hash(seed) & 0xffffu) * (1.0f / 65536.0f);
+      noise_octave_row(seed, frequency, offset, j, w, octave);
+
+      if (params->type == KRR_HEIGHTMAP_NOISE_RIDGED)
+      {
+        // sharper ridges where the previous octave is high, smoother valleys where it's low
+        for (int i=0; i<w; ++i)
+        {
+          float signal = 1.0f - fabsf(octave[i]);
+          signal *= signal * weight[i];
+          weight[i] = fminf(fmaxf(signal * 2.0f, 0.0f), 1.0f);
+          sum[i] += signal * amplitude;
+        }
+      }
+      else
+      {
+        for (int i=0; i<w; ++i)
+        {
+          sum[i] += octave[i] * amplitude;
+        }
+      }
+
+      frequency *= params->lacunarity;
+      amplitude *= params->gain;
+    }
+
+    for (int i=0; i<w; ++i)
+    {
+      min = fminf(min, sum[i]);
+      max = fmaxf(max, sum[i]);
+    }
+  }
+
+  b->min = min;
+  b->max = max;
+  free(scratch);
+}
+
+static int noise_band_thread(void* data)
+{
+  noise_band(data);
+  return 0;
+}
+
+bool KRR_HEIGHTMAP_generate_noise(KRR_HEIGHTMAP* hm, int width, int height, const KRR_HEIGHTMAP_NOISE* params)
+{
+  KRR_HEIGHTMAP_free_internals(hm);
+
+  if (width <= 0 || height <= 0)
+  {
+    KRR_LOGE("Invalid size of procedural heightmap %dx%d", width, height);
+    return false;
+  }
+  if (params->octaves < 1 || params->octaves > KRR_HEIGHTMAP_MAX_OCTAVES || params->frequency <= 0.0f || params->lacunarity <= 0.0f)
+  {
+    KRR_LOGE("Invalid parameters of procedural heightmap");
+    return false;
+  }
+
+  const size_t samples = (size_t)width * height;
+  float* values = malloc(sizeof(float) * samples);
+  if (values == NULL)
+  {
+    KRR_LOGE("Cannot allocate memory for procedural heightmap %dx%d", width, height);
+    return false;
+  }
+
+  // split rows into bands, each sample only depends on its position so bands are independent
+  int bands_count = SDL_GetCPUCount();
+  if (bands_count > height / MIN_NOISE_BAND_ROWS)
+    bands_count = height / MIN_NOISE_BAND_ROWS;
+  if (bands_count > MAX_NOISE_BANDS)
+    bands_count = MAX_NOISE_BANDS;
+  if (bands_count < 1)
+    bands_count = 1;
+
+  NOISE_BAND bands[MAX_NOISE_BANDS];
+  for (int i=0; i<bands_count; ++i)
+  {
+    NOISE_BAND* b = &bands[i];
+    b->params = params;
+    b->width = width;
+    b->row_begin = height * i / bands_count;
+    b->row_end = height * (i + 1) / bands_count;
+    b->values = values;
+  }
+
+  // the first band is generated on this thread, others on worker threads
+  SDL_Thread* threads[MAX_NOISE_BANDS];
+  for (int i=1; i<bands_count; ++i)
+  {
+    threads[i] = SDL_CreateThread(noise_band_thread, "heightmapnoise", &bands[i]);
+    // fallback to generate it later on this thread
+    if (threads[i] == NULL)
+    {
+      KRR_LOGW("Warning: Cannot create thread to generate heightmap, %s", SDL_GetError());
+    }
+  }
+  noise_band(&bands[0]);
+  for (int i=1; i<bands_count; ++i)
+  {
+    if (threads[i] != NULL)
+    {
+      SDL_WaitThread(threads[i], NULL);
+    }
+    else
+    {
+      noise_band(&bands[i]);
+    }
+  }
+
+  // min and max are exact, so the range is the same however rows are split
+  float min = bands[0].min;
+  float max = bands[0].max;
+  for (int i=1; i<bands_count; ++i)
+  {
+    min = fminf(min, bands[i].min);
+    max = fmaxf(max, bands[i].max);
+  }
+
+  hm->width = width;
+  hm->height = height;
+  hm->source_bits = 16;
+  hm->pixels = malloc(sizeof(GLushort) * samples);
+
+  // stretch to the whole 16-bit range
+  const float scale = max > min ? 65535.0f / (max - min) : 0.0f;
+  const float* restrict src = values;
+  GLushort* restrict dst = hm->pixels;
+  for (size_t i=0; i<samples; ++i)
+  {
+    dst[i] = (GLushort)((src[i] - min) * scale + 0.5f);
+  }
+
+  free(values);
+
+  KRR_LOGI("generate %s heightmap %dx%d with seed %u, %d octaves, %d threads", params->type == KRR_HEIGHTMAP_NOISE_RIDGED ? "ridged" : "fBm", width, height, (unsigned int)params->seed, params->octaves, bands_count);
+  return true;
+}
+
+void KRR_HEIGHTMAP_free_internals(KRR_HEIGHTMAP* hm)
+{
+  if (hm->pixels != NULL)
+  {
+    free(hm->pixels);
+  }
+  init_defaults(hm);
+}
+
+void KRR_HEIGHTMAP_free(KRR_HEIGHTMAP* hm)
+{
+  KRR_HEIGHTMAP_free_internals(hm);
+
+  free(hm);
+  hm = NULL;
+}
@@ -0,0 +1,246 @@
+#include "krr/graphics/meshcache.h"
+#include "krr/graphics/cull.h"
+#include "krr/graphics/objloader.h"
+#include "krr/graphics/util.h"
+#include "krr/foundation/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MESHCACHE_MAGIC "KRRM"
+
+static void init_defaults(KRR_MESHCACHE* mc)
+{
+  memset(&mc->header, 0, sizeof(mc->header));
+  mc->vertices = NULL;
+  mc->indices = NULL;
+  mc->index_type = GL_UNSIGNED_INT;
+
+  mc->fm.data = NULL;
+  mc->fm.size = 0;
+  mc->fm.mapped = false;
+  mc->owned_vertices = NULL;
+  mc->owned_indices = NULL;
+}
+
+/// form cache file path from source file path, returned string should be freed after use
+static char* cache_path_of(const char* filepath)
+{
+  size_t len = strlen(filepath);
+  char* out = malloc(len + sizeof(KRR_MESHCACHE_EXT));
+  memcpy(out, filepath, len);
+  memcpy(out + len, KRR_MESHCACHE_EXT, sizeof(KRR_MESHCACHE_EXT));
+  return out;
+}
+
+static void fill_header(KRR_MESHCACHE_HEADER* h, uint64_t source_hash, uint64_t source_size, int source_flags, const VERTEXTEXNORM3D* vertices, int vertices_count, int indices_count, int index_size)
+{
+  memset(h, 0, sizeof(KRR_MESHCACHE_HEADER));
+  memcpy(h->magic, MESHCACHE_MAGIC, 4);
+  h->version = KRR_MESHCACHE_VERSION;
+  h->vertex_size = sizeof(VERTEXTEXNORM3D);
+  h->index_size = index_size;
+  h->vertices_count = vertices_count;
+  h->indices_count = indices_count;
+  h->source_hash = source_hash;
+  h->source_size = source_size;
+  h->source_flags = source_flags;
+
+  // compute bounds
+  KRR_CULL_BOUNDS bounds;
+  KRR_CULL_bounds_from_vertices(vertices, vertices_count, &bounds);
+  memcpy(h->aabb_min, bounds.aabb_min, sizeof(h->aabb_min));
+  memcpy(h->aabb_max, bounds.aabb_max, sizeof(h->aabb_max));
+  memcpy(h->sphere_center, bounds.center, sizeof(h->sphere_center));
+  h->sphere_radius = bounds.radius;
+}
+
+static bool write_file(const char* filepath, const KRR_MESHCACHE_HEADER* h, const VERTEXTEXNORM3D* vertices, const void* indices)
+{
+  // write into temporary file first, then replace the target
+  // thus a reader never sees partially written file
+  size_t len = strlen(filepath);
+  char* tmp_path = malloc(len + sizeof(".tmp"));
+  memcpy(tmp_path, filepath, len);
+  memcpy(tmp_path + len, ".tmp", sizeof(".tmp"));
+
+  FILE* file = fopen(tmp_path, "wb");
+  if (file == NULL)
+  {
+    free(tmp_path);
+    return false;
+  }
+
+  bool ok = fwrite(h, sizeof(KRR_MESHCACHE_HEADER), 1, file) == 1 &&
+    fwrite(vertices, sizeof(VERTEXTEXNORM3D), h->vertices_count, file) == h->vertices_count &&
+    fwrite(indices, h->index_size, h->indices_count, file) == h->indices_count;
+  ok = fclose(file) == 0 && ok;
+
+  if (ok)
+  {
+    // rename() doesn't replace existing file on Windows
+    remove(filepath);
+    ok = rename(tmp_path, filepath) == 0;
+  }
+  if (!ok)
+  {
+    remove(tmp_path);
+  }
+
+  free(tmp_path);
+  return ok;
+}
+
+uint64_t KRR_MESHCACHE_hash(const void* data, size_t size)
+{
+  // process 8 bytes at a time, it's mostly bound by memory bandwidth
+  const unsigned char* p = data;
+  uint64_t h = 0x9E3779B97F4A7C15ULL ^ (uint64_t)size;
+
+  size_t words = size / 8;
+  for (size_t i=0; i<words; ++i)
+  {
+    uint64_t w;
+    memcpy(&w, p + i*8, 8);
+    h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 32;
+  }
+
+  for (size_t i=words*8; i<size; ++i)
+  {
+    h = (h ^ p[i]) * 0x100000001B3ULL;
+  }
+
+  // final mix
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+bool KRR_MESHCACHE_load(KRR_MESHCACHE* mc, const char* filepath)
+{
+  init_defaults(mc);
+
+  if (!KRR_FILEMAP_open(&mc->fm, filepath))
+  {
+    return false;
+  }
+
+  const KRR_MESHCACHE_HEADER* h = mc->fm.data;
+
+  // validate before trusting any value from file
+  if (mc->fm.size < sizeof(KRR_MESHCACHE_HEADER) ||
+      memcmp(h->magic, MESHCACHE_MAGIC, 4) != 0 ||
+      h->version != KRR_MESHCACHE_VERSION ||
+      h->vertex_size != sizeof(VERTEXTEXNORM3D) ||
+      (h->index_size != sizeof(GLuint) && h->index_size != sizeof(GLushort)) ||
+      (h->index_size == sizeof(GLushort) && h->vertices_count >= 65536) ||
+      mc->fm.size != sizeof(KRR_MESHCACHE_HEADER) + (uint64_t)h->vertices_count * h->vertex_size + (uint64_t)h->indices_count * h->index_size)
+  {
+    KRR_LOGW("Invalid or outdated mesh file %s", filepath);
+    KRR_MESHCACHE_close(mc);
+    return false;
+  }
+
+  // point directly into file content, no copy
+  mc->header = *h;
+  mc->vertices = (const VERTEXTEXNORM3D*)(h + 1);
+  mc->indices = mc->vertices + h->vertices_count;
+  mc->index_type = h->index_size == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+  return true;
+}
+
+bool KRR_MESHCACHE_load_objfile(KRR_MESHCACHE* mc, const char* filepath, int flags)
+{
+  init_defaults(mc);
+
+  // identify content of source file
+  KRR_FILEMAP src;
+  if (!KRR_FILEMAP_open(&src, filepath))
+  {
+    KRR_LOGE("Cannot read .obj file");
+    return false;
+  }
+  uint64_t source_hash = KRR_MESHCACHE_hash(src.data, src.size);
+  uint64_t source_size = src.size;
+  KRR_FILEMAP_close(&src);
+
+  char* cache_path = cache_path_of(filepath);
+
+  // use cache if it's generated from exactly the same source
+  if (KRR_MESHCACHE_load(mc, cache_path))
+  {
+    if (mc->header.source_hash == source_hash &&
+        mc->header.source_size == source_size &&
+        mc->header.source_flags == (uint32_t)flags)
+    {
+      free(cache_path);
+      return true;
+    }
+    KRR_MESHCACHE_close(mc);
+  }
+
+  // otherwise parse source file
+  int vertices_count = 0;
+  int indices_count = 0;
+  if (KRR_load_objfile_ex(filepath, flags, &mc->owned_vertices, &vertices_count, &mc->owned_indices, &indices_count) != 0)
+  {
+    free(cache_path);
+    return false;
+  }
+
+  // narrow indices in-place if possible, memory is shrunk along the way
+  mc->index_type = KRR_gputil_index_type_for(vertices_count);
+  KRR_gputil_narrow_indices(mc->owned_indices, indices_count, mc->index_type);
+
+  fill_header(&mc->header, source_hash, source_size, flags, mc->owned_vertices, vertices_count, indices_count, KRR_gputil_index_size(mc->index_type));
+  mc->vertices = mc->owned_vertices;
+  mc->indices = mc->owned_indices;
+
+  // write cache for next time
+  if (!write_file(cache_path, &mc->header, mc->owned_vertices, mc->owned_indices))
+  {
+    KRR_LOGW("Cannot write mesh cache file %s", cache_path);
+  }
+
+  free(cache_path);
+  return true;
+}
+
+bool KRR_MESHCACHE_write(const char* filepath, uint64_t source_hash, uint64_t source_size, int source_flags, const VERTEXTEXNORM3D* vertices, int vertices_count, const GLuint* indices, int indices_count)
+{
+  GLenum index_type = KRR_gputil_index_type_for(vertices_count);
+
+  KRR_MESHCACHE_HEADER h;
+  fill_header(&h, source_hash, source_size, source_flags, vertices, vertices_count, indices_count, KRR_gputil_index_size(index_type));
+
+  if (index_type == GL_UNSIGNED_INT)
+  {
+    return write_file(filepath, &h, vertices, indices);
+  }
+
+  // input is const, narrow on a copy
+  GLuint* narrowed = malloc(sizeof(GLuint) * indices_count);
+  if (narrowed == NULL)
+  {
+    return false;
+  }
+  memcpy(narrowed, indices, sizeof(GLuint) * indices_count);
+  KRR_gputil_narrow_indices(narrowed, indices_count, index_type);
+
+  bool ok = write_file(filepath, &h, vertices, narrowed);
+  free(narrowed);
+  return ok;
+}
+
+void KRR_MESHCACHE_close(KRR_MESHCACHE* mc)
+{
+  KRR_FILEMAP_close(&mc->fm);
+
+  free(mc->owned_vertices);
+  free(mc->owned_indices);
+
+  init_defaults(mc);
+}
@@ -0,0 +1,514 @@
+#include "krr/graphics/meshopt.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// parameters of Forsyth's algorithm
+// see https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRI_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+// valence beyond this gets the same (tiny) boost
+#define FORSYTH_MAX_VALENCE 32
+
+/// cluster of triangles used in overdraw optimization
+typedef struct
+{
+  /// range in triangles
+  int start;
+  int count;
+  /// sort key, the higher the earlier it's drawn
+  float key;
+} CLUSTER;
+
+void KRR_MESHOPT_analyze_vertex_cache(const GLuint* indices, int indices_count, int vertices_count, int cache_size, KRR_MESHOPT_CACHESTATS* stats)
+{
+  // FIFO cache is simulated by time at which vertex entered the cache
+  // 0 means never entered
+  unsigned int* entered = calloc(vertices_count > 0 ? vertices_count : 1, sizeof(unsigned int));
+  unsigned int time = 0;
+  int misses = 0;
+  int referenced = 0;
+
+  for (int i=0; i<indices_count; ++i)
+  {
+    GLuint v = indices[i];
+    if (entered[v] == 0)
+    {
+      ++referenced;
+    }
+    if (entered[v] == 0 || time - entered[v] >= (unsigned int)cache_size)
+    {
+      entered[v] = ++time;
+      ++misses;
+    }
+  }
+
+  free(entered);
+
+  stats->misses = misses;
+  stats->acmr = indices_count > 0 ? (float)misses / (indices_count / 3) : 0.0f;
+  stats->atvr = referenced > 0 ? (float)misses / referenced : 0.0f;
+}
+
+void KRR_MESHOPT_optimize_vertex_cache(GLuint* indices, int indices_count, int vertices_count)
+{
+  const int tris_count = indices_count / 3;
+  if (tris_count == 0 || vertices_count == 0)
+  {
+    return;
+  }
+
+  // score tables
+  float cache_scores[FORSYTH_CACHE_SIZE];
+  for (int i=0; i<FORSYTH_CACHE_SIZE; ++i)
+  {
+    // the last triangle's vertices get a fixed score to not favor any particular one of them
+    if (i < 3)
+      cache_scores[i] = FORSYTH_LAST_TRI_SCORE;
+    else
+      cache_scores[i] = powf(1.0f - (float)(i - 3) / (FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+  }
+  float valence_scores[FORSYTH_MAX_VALENCE + 1];
+  valence_scores[0] = 0.0f;
+  for (int i=1; i<=FORSYTH_MAX_VALENCE; ++i)
+  {
+    valence_scores[i] = FORSYTH_VALENCE_BOOST_SCALE * powf((float)i, -FORSYTH_VALENCE_BOOST_POWER);
+  }
+
+  // triangles adjacent to each vertex, live (not yet emitted) ones are kept at the front of its range
+  int* adj_offsets = calloc(vertices_count + 1, sizeof(int));
+  int* live = calloc(vertices_count, sizeof(int));
+  int* adj = malloc(sizeof(int) * tris_count * 3);
+
+  for (int i=0; i<indices_count; ++i)
+  {
+    ++live[indices[i]];
+  }
+  for (int v=0; v<vertices_count; ++v)
+  {
+    adj_offsets[v+1] = adj_offsets[v] + live[v];
+    live[v] = 0;
+  }
+  for (int t=0; t<tris_count; ++t)
+  {
+    for (int k=0; k<3; ++k)
+    {
+      GLuint v = indices[t*3 + k];
+      adj[adj_offsets[v] + live[v]++] = t;
+    }
+  }
+
+  int* cache_pos = malloc(sizeof(int) * vertices_count);
+  float* scores = malloc(sizeof(float) * vertices_count);
+  for (int v=0; v<vertices_count; ++v)
+  {
+    cache_pos[v] = -1;
+    scores[v] = live[v] > 0 ? valence_scores[live[v] < FORSYTH_MAX_VALENCE ? live[v] : FORSYTH_MAX_VALENCE] : -1.0f;
+  }
+
+  bool* emitted = calloc(tris_count, sizeof(bool));
+  GLuint* out = malloc(sizeof(GLuint) * indices_count);
+
+  // current cache, plus room for 3 vertices pushed out by a new triangle
+  int cache[FORSYTH_CACHE_SIZE + 3];
+  int cache_count = 0;
+  int new_cache[FORSYTH_CACHE_SIZE + 3];
+
+  // start with the best triangle overall
+  int best_tri = 0;
+  float best_score = -1.0f;
+  for (int t=0; t<tris_count; ++t)
+  {
+    const GLuint* tri = indices + t*3;
+    float score = scores[tri[0]] + scores[tri[1]] + scores[tri[2]];
+    if (score > best_score)
+    {
+      best_score = score;
+      best_tri = t;
+    }
+  }
+
+  // cursor to find next triangle in input order when cache yields none
+  int input_cursor = 0;
+
+  for (int out_tris = 0; out_tris < tris_count; ++out_tris)
+  {
+    if (best_tri < 0)
+    {
+      while (emitted[input_cursor])
+        ++input_cursor;
+      best_tri = input_cursor;
+    }
+
+    const GLuint* tri = indices + best_tri*3;
+    memcpy(out + out_tris*3, tri, sizeof(GLuint) * 3);
+    emitted[best_tri] = true;
+
+    // remove triangle from live adjacency of its vertices
+    for (int k=0; k<3; ++k)
+    {
+      GLuint v = tri[k];
+      int* range = adj + adj_offsets[v];
+      for (int j=0; j<live[v]; ++j)
+      {
+        if (range[j] == best_tri)
+        {
+          range[j] = range[live[v] - 1];
+          range[live[v] - 1] = best_tri;
+          --live[v];
+          break;
+        }
+      }
+    }
+
+    // triangle's vertices go to front of cache, followed by the rest of previous cache
+    int new_count = 0;
+    new_cache[new_count++] = tri[0];
+    new_cache[new_count++] = tri[1];
+    new_cache[new_count++] = tri[2];
+    for (int i=0; i<cache_count; ++i)
+    {
+      int v = cache[i];
+      if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2])
+        new_cache[new_count++] = v;
+    }
+
+    // update scores of all vertices in cache, including ones just pushed out of it
+    for (int i=0; i<new_count; ++i)
+    {
+      int v = new_cache[i];
+      cache_pos[v] = i < FORSYTH_CACHE_SIZE ? i : -1;
+
+      if (live[v] == 0)
+      {
+        scores[v] = -1.0f;
+      }
+      else
+      {
+        scores[v] = valence_scores[live[v] < FORSYTH_MAX_VALENCE ? live[v] : FORSYTH_MAX_VALENCE];
+        if (cache_pos[v] >= 0)
+          scores[v] += cache_scores[cache_pos[v]];
+      }
+    }
+
+    // find the best triangle among ones touching the cache
+    best_tri = -1;
+    best_score = -1.0f;
+    for (int i=0; i<new_count; ++i)
+    {
+      int v = new_cache[i];
+      const int* range = adj + adj_offsets[v];
+      for (int j=0; j<live[v]; ++j)
+      {
+        const GLuint* candidate = indices + range[j]*3;
+        float score = scores[candidate[0]] + scores[candidate[1]] + scores[candidate[2]];
+        if (score > best_score)
+        {
+          best_score = score;
+          best_tri = range[j];
+        }
+      }
+    }
+
+    cache_count = new_count < FORSYTH_CACHE_SIZE ? new_count : FORSYTH_CACHE_SIZE;
+    memcpy(cache, new_cache, sizeof(int) * cache_count);
+  }
+
+  memcpy(indices, out, sizeof(GLuint) * tris_count * 3);
+
+  free(out);
+  free(emitted);
+  free(scores);
+  free(cache_pos);
+  free(adj);
+  free(live);
+  free(adj_offsets);
+}
+
+/// simulate FIFO cache for a triangle, return number of misses
+static inline int simulate_triangle(const GLuint* tri, unsigned int* entered, unsigned int* time)
+{
+  int misses = 0;
+  for (int k=0; k<3; ++k)
+  {
+    GLuint v = tri[k];
+    if (entered[v] == 0 || *time - entered[v] >= KRR_MESHOPT_CACHE_SIZE)
+    {
+      entered[v] = ++(*time);
+      ++misses;
+    }
+  }
+  return misses;
+}
+
+static int compare_clusters(const void* a, const void* b)
+{
+  const CLUSTER* ca = a;
+  const CLUSTER* cb = b;
+
+  // higher key first, tie break by original order to be deterministic
+  if (ca->key != cb->key)
+    return ca->key > cb->key ? -1 : 1;
+  return ca->start - cb->start;
+}
+
+void KRR_MESHOPT_optimize_overdraw(GLuint* indices, int indices_count, const VERTEXTEXNORM3D* vertices, int vertices_count, float threshold)
+{
+  const int tris_count = indices_count / 3;
+  if (tris_count == 0 || vertices_count == 0)
+  {
+    return;
+  }
+
+  // FIFO cache is simulated by time at which vertex entered the cache
+  // advancing time by cache size flushes the whole cache
+  unsigned int* entered = calloc(vertices_count, sizeof(unsigned int));
+  unsigned int time = 0;
+
+  // hard boundaries: triangles with all vertices missed start over the cache anyway
+  bool* hard = malloc(sizeof(bool) * tris_count);
+  for (int t=0; t<tris_count; ++t)
+  {
+    hard[t] = t == 0 || simulate_triangle(indices + t*3, entered, &time) == 3;
+  }
+
+  // soft boundaries: split hard cluster further whenever ACMR so far (from a flushed cache) is
+  // within threshold of ACMR of the whole hard cluster
+  CLUSTER* clusters = malloc(sizeof(CLUSTER) * tris_count);
+  int clusters_count = 0;
+
+  for (int start=0; start<tris_count; )
+  {
+    int end = start + 1;
+    while (end < tris_count && !hard[end])
+    {
+      ++end;
+    }
+
+    time += KRR_MESHOPT_CACHE_SIZE + 1;
+    int cluster_misses = 0;
+    for (int t=start; t<end; ++t)
+    {
+      cluster_misses += simulate_triangle(indices + t*3, entered, &time);
+    }
+    float cluster_threshold = threshold * cluster_misses / (end - start);
+
+    time += KRR_MESHOPT_CACHE_SIZE + 1;
+    int soft_start = start;
+    int accum_misses = 0;
+    for (int t=start; t<end; ++t)
+    {
+      accum_misses += simulate_triangle(indices + t*3, entered, &time);
+      int accum_count = t - soft_start + 1;
+      if (t == end - 1 || (float)accum_misses / accum_count <= cluster_threshold)
+      {
+        clusters[clusters_count].start = soft_start;
+        clusters[clusters_count].count = accum_count;
+        ++clusters_count;
+
+        soft_start = t + 1;
+        accum_misses = 0;
+        time += KRR_MESHOPT_CACHE_SIZE + 1;
+      }
+    }
+
+    start = end;
+  }
+
+  free(hard);
+  free(entered);
+
+  // area-weighted centroid and normal of each cluster, and of the whole mesh
+  vec3 mesh_centroid = {0.0f, 0.0f, 0.0f};
+  float mesh_area = 0.0f;
+  vec3* centroids = malloc(sizeof(vec3) * clusters_count);
+  vec3* normals = malloc(sizeof(vec3) * clusters_count);
+
+  for (int c=0; c<clusters_count; ++c)
+  {
+    vec3 centroid = {0.0f, 0.0f, 0.0f};
+    vec3 normal = {0.0f, 0.0f, 0.0f};
+    float area = 0.0f;
+
+    for (int t=clusters[c].start; t<clusters[c].start + clusters[c].count; ++t)
+    {
+      const VERTEXPOS3D* p0 = &vertices[indices[t*3 + 0]].position;
+      const VERTEXPOS3D* p1 = &vertices[indices[t*3 + 1]].position;
+      const VERTEXPOS3D* p2 = &vertices[indices[t*3 + 2]].position;
+
+      vec3 e1 = {p1->x - p0->x, p1->y - p0->y, p1->z - p0->z};
+      vec3 e2 = {p2->x - p0->x, p2->y - p0->y, p2->z - p0->z};
+      vec3 n;
+      glm_vec3_cross(e1, e2, n);
+      // length of cross product is twice the area
+      float tri_area = glm_vec3_norm(n);
+
+      centroid[0] += (p0->x + p1->x + p2->x) * tri_area;
+      centroid[1] += (p0->y + p1->y + p2->y) * tri_area;
+      centroid[2] += (p0->z + p1->z + p2->z) * tri_area;
+      glm_vec3_add(normal, n, normal);
+      area += tri_area;
+    }
+
+    glm_vec3_add(mesh_centroid, centroid, mesh_centroid);
+    mesh_area += area;
+
+    glm_vec3_scale(centroid, area > 0.0f ? 1.0f / (3.0f * area) : 0.0f, centroids[c]);
+    glm_vec3_normalize_to(normal, normals[c]);
+  }
+
+  glm_vec3_scale(mesh_centroid, mesh_area > 0.0f ? 1.0f / (3.0f * mesh_area) : 0.0f, mesh_centroid);
+
+  // clusters facing away from center are likely in front of others, draw them first
+  for (int c=0; c<clusters_count; ++c)
+  {
+    vec3 d;
+    glm_vec3_sub(centroids[c], mesh_centroid, d);
+    clusters[c].key = glm_vec3_dot(d, normals[c]);
+  }
+  free(centroids);
+  free(normals);
+
+  qsort(clusters, clusters_count, sizeof(CLUSTER), compare_clusters);
+
+  GLuint* out = malloc(sizeof(GLuint) * tris_count * 3);
+  int out_tris = 0;
+  for (int c=0; c<clusters_count; ++c)
+  {
+    memcpy(out + out_tris*3, indices + clusters[c].start*3, sizeof(GLuint) * 3 * clusters[c].count);
+    out_tris += clusters[c].count;
+  }
+  memcpy(indices, out, sizeof(GLuint) * tris_count * 3);
+
+  free(out);
+  free(clusters);
+}
+
+int KRR_MESHOPT_optimize_vertex_fetch(VERTEXTEXNORM3D* vertices, int vertices_count, GLuint* indices, int indices_count)
+{
+  // new index of each vertex in order of first use, -1 if not yet used
+  int* remap = malloc(sizeof(int) * (vertices_count > 0 ? vertices_count : 1));
+  memset(remap, -1, sizeof(int) * vertices_count);
+
+  VERTEXTEXNORM3D* out = malloc(sizeof(VERTEXTEXNORM3D) * (vertices_count > 0 ? vertices_count : 1));
+  int out_count = 0;
+
+  for (int i=0; i<indices_count; ++i)
+  {
+    GLuint v = indices[i];
+    if (remap[v] < 0)
+    {
+      remap[v] = out_count;
+      out[out_count++] = vertices[v];
+    }
+    indices[i] = remap[v];
+  }
+
+  memcpy(vertices, out, sizeof(VERTEXTEXNORM3D) * out_count);
+
+  free(out);
+  free(remap);
+
+  return out_count;
+}
+
+/// quantize `v` to 16-bit unsigned normalized, `inv_scale` is 65535 over range of values
+static inline GLushort quantize_unorm16(float v, float offset, float inv_scale)
+{
+  float q = (v - offset) * inv_scale + 0.5f;
+  if (q <= 0.0f) return 0;
+  if (q >= 65535.0f) return 65535;
+  return (GLushort)q;
+}
+
+/// quantize `v` in range of [-1,1] to 10-bit signed normalized, returned as unsigned bits
+static inline GLuint quantize_snorm10(float v)
+{
+  if (v < -1.0f) v = -1.0f;
+  if (v > 1.0f) v = 1.0f;
+  int q = (int)lroundf(v * 511.0f);
+  return (GLuint)q & 0x3FF;
+}
+
+GLuint KRR_MESHOPT_pack_normal(float x, float y, float z)
+{
+  // w is left as 0
+  return quantize_snorm10(x) | (quantize_snorm10(y) << 10) | (quantize_snorm10(z) << 20);
+}
+
+void KRR_MESHOPT_pack_vertices(const VERTEXTEXNORM3D* vertices, int vertices_count, VERTEXTEXNORM3D_PACKED* dst, VERTEXDEQUANT* dequant)
+{
+  float pmin[3] = {0.0f, 0.0f, 0.0f};
+  float pmax[3] = {0.0f, 0.0f, 0.0f};
+  float tmin[2] = {0.0f, 0.0f};
+  float tmax[2] = {0.0f, 0.0f};
+
+  if (vertices_count > 0)
+  {
+    pmin[0] = pmax[0] = vertices[0].position.x;
+    pmin[1] = pmax[1] = vertices[0].position.y;
+    pmin[2] = pmax[2] = vertices[0].position.z;
+    tmin[0] = tmax[0] = vertices[0].texcoord.s;
+    tmin[1] = tmax[1] = vertices[0].texcoord.t;
+  }
+  for (int i=1; i<vertices_count; ++i)
+  {
+    const VERTEXTEXNORM3D* v = &vertices[i];
+    pmin[0] = fminf(pmin[0], v->position.x); pmax[0] = fmaxf(pmax[0], v->position.x);
+    pmin[1] = fminf(pmin[1], v->position.y); pmax[1] = fmaxf(pmax[1], v->position.y);
+    pmin[2] = fminf(pmin[2], v->position.z); pmax[2] = fmaxf(pmax[2], v->position.z);
+    tmin[0] = fminf(tmin[0], v->texcoord.s); tmax[0] = fmaxf(tmax[0], v->texcoord.s);
+    tmin[1] = fminf(tmin[1], v->texcoord.t); tmax[1] = fmaxf(tmax[1], v->texcoord.t);
+  }
+
+  // scale maps [0,1] as normalized by GPU back to the range
+  // zero range is kept as zero scale, all values then dequantize to offset
+  dequant->position_offset.x = pmin[0];
+  dequant->position_offset.y = pmin[1];
+  dequant->position_offset.z = pmin[2];
+  dequant->position_scale.x = pmax[0] - pmin[0];
+  dequant->position_scale.y = pmax[1] - pmin[1];
+  dequant->position_scale.z = pmax[2] - pmin[2];
+  dequant->texcoord_offset.s = tmin[0];
+  dequant->texcoord_offset.t = tmin[1];
+  dequant->texcoord_scale.s = tmax[0] - tmin[0];
+  dequant->texcoord_scale.t = tmax[1] - tmin[1];
+
+  KRR_MESHOPT_pack_vertices_dequant(vertices, vertices_count, dst, dequant);
+}
+
+void KRR_MESHOPT_pack_vertices_dequant(const VERTEXTEXNORM3D* vertices, int vertices_count, VERTEXTEXNORM3D_PACKED* dst, const VERTEXDEQUANT* dequant)
+{
+  const float pmin[3] = {dequant->position_offset.x, dequant->position_offset.y, dequant->position_offset.z};
+  const float pscale[3] = {dequant->position_scale.x, dequant->position_scale.y, dequant->position_scale.z};
+  const float tmin[2] = {dequant->texcoord_offset.s, dequant->texcoord_offset.t};
+  const float tscale[2] = {dequant->texcoord_scale.s, dequant->texcoord_scale.t};
+
+  float pinv[3];
+  for (int k=0; k<3; ++k)
+  {
+    pinv[k] = pscale[k] > 0.0f ? 65535.0f / pscale[k] : 0.0f;
+  }
+  float tinv[2];
+  for (int k=0; k<2; ++k)
+  {
+    tinv[k] = tscale[k] > 0.0f ? 65535.0f / tscale[k] : 0.0f;
+  }
+
+  for (int i=0; i<vertices_count; ++i)
+  {
+    const VERTEXTEXNORM3D* v = &vertices[i];
+    VERTEXTEXNORM3D_PACKED* out = &dst[i];
+
+    out->position[0] = quantize_unorm16(v->position.x, pmin[0], pinv[0]);
+    out->position[1] = quantize_unorm16(v->position.y, pmin[1], pinv[1]);
+    out->position[2] = quantize_unorm16(v->position.z, pmin[2], pinv[2]);
+    out->padding = 0;
+    out->texcoord[0] = quantize_unorm16(v->texcoord.s, tmin[0], tinv[0]);
+    out->texcoord[1] = quantize_unorm16(v->texcoord.t, tmin[1], tinv[1]);
+    out->normal = KRR_MESHOPT_pack_normal(v->normal.x, v->normal.y, v->normal.z);
+  }
+}
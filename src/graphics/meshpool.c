@@ -0,0 +1,214 @@
+#include "krr/graphics/meshpool.h"
+#include "krr/graphics/glstate.h"
+#include "krr/foundation/log.h"
+#include <stdlib.h>
+#include <string.h>
+
+/// insert range at index, growing array if needed
+static void insert_range(KRR_MESHPOOL_RANGE** ranges, int* count, int* capacity, int index, KRR_MESHPOOL_RANGE range)
+{
+  if (*count >= *capacity)
+  {
+    *capacity = *capacity == 0 ? 8 : *capacity * 2;
+    *ranges = realloc(*ranges, sizeof(KRR_MESHPOOL_RANGE) * *capacity);
+  }
+
+  memmove(*ranges + index + 1, *ranges + index, sizeof(KRR_MESHPOOL_RANGE) * (*count - index));
+  (*ranges)[index] = range;
+  (*count)++;
+}
+
+static void remove_range(KRR_MESHPOOL_RANGE* ranges, int* count, int index)
+{
+  memmove(ranges + index, ranges + index + 1, sizeof(KRR_MESHPOOL_RANGE) * (*count - index - 1));
+  (*count)--;
+}
+
+/// find the first free range that fits, return its index or -1 if not found
+static int find_fit(const KRR_MESHPOOL_RANGE* ranges, int count, int size)
+{
+  for (int i=0; i<count; ++i)
+  {
+    if (ranges[i].count >= size)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/// take size elements from front of free range at index
+static int take_range(KRR_MESHPOOL_RANGE* ranges, int* count, int index, int size)
+{
+  int offset = ranges[index].offset;
+  ranges[index].offset += size;
+  ranges[index].count -= size;
+  if (ranges[index].count == 0)
+  {
+    remove_range(ranges, count, index);
+  }
+  return offset;
+}
+
+/// put range back into free list, merge with adjacent free ranges
+static void give_range(KRR_MESHPOOL_RANGE** ranges, int* count, int* capacity, KRR_MESHPOOL_RANGE range)
+{
+  if (range.count <= 0)
+    return;
+
+  // find position to keep list sorted by offset
+  int i = 0;
+  while (i < *count && (*ranges)[i].offset < range.offset)
+    ++i;
+
+  KRR_MESHPOOL_RANGE* r = *ranges;
+  bool merge_prev = i > 0 && r[i-1].offset + r[i-1].count == range.offset;
+  bool merge_next = i < *count && range.offset + range.count == r[i].offset;
+
+  if (merge_prev && merge_next)
+  {
+    r[i-1].count += range.count + r[i].count;
+    remove_range(r, count, i);
+  }
+  else if (merge_prev)
+  {
+    r[i-1].count += range.count;
+  }
+  else if (merge_next)
+  {
+    r[i].offset = range.offset;
+    r[i].count += range.count;
+  }
+  else
+  {
+    insert_range(ranges, count, capacity, i, range);
+  }
+}
+
+KRR_MESHPOOL* KRR_MESHPOOL_new(GLsizei vertex_size, int vertices_capacity, int indices_capacity)
+{
+  KRR_MESHPOOL* out = malloc(sizeof(KRR_MESHPOOL));
+  out->vertex_size = vertex_size;
+  out->vertices_capacity = vertices_capacity;
+  out->indices_capacity = indices_capacity;
+
+  // rebased indices address the whole vertex buffer, so index type depends on pool's capacity
+  if (vertices_capacity < 65536)
+  {
+    out->index_type = GL_UNSIGNED_SHORT;
+    out->index_size = sizeof(GLushort);
+  }
+  else
+  {
+    out->index_type = GL_UNSIGNED_INT;
+    out->index_size = sizeof(GLuint);
+  }
+
+  out->free_vertices = NULL;
+  out->free_vertices_count = 0;
+  out->free_vertices_capacity = 0;
+  out->free_indices = NULL;
+  out->free_indices_count = 0;
+  out->free_indices_capacity = 0;
+
+  // whole buffers are free initially
+  insert_range(&out->free_vertices, &out->free_vertices_count, &out->free_vertices_capacity, 0, (KRR_MESHPOOL_RANGE){0, vertices_capacity});
+  insert_range(&out->free_indices, &out->free_indices_count, &out->free_indices_capacity, 0, (KRR_MESHPOOL_RANGE){0, indices_capacity});
+
+  // allocate storage on GPU, filled later per mesh
+  glGenBuffers(1, &out->vbo_id);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, out->vbo_id);
+  glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertices_capacity * vertex_size, NULL, GL_STATIC_DRAW);
+
+  // bind ibo outside of any vao, so it won't change element array binding of currently bound vao
+  KRR_GLSTATE_bind_vertex_array(0);
+  glGenBuffers(1, &out->ibo_id);
+  KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, out->ibo_id);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indices_capacity * out->index_size, NULL, GL_STATIC_DRAW);
+
+  out->vao_id = 0;
+
+  return out;
+}
+
+void KRR_MESHPOOL_free(KRR_MESHPOOL* pool)
+{
+  if (pool->vao_id != 0)
+  {
+    KRR_GLSTATE_delete_vertex_arrays(1, &pool->vao_id);
+    pool->vao_id = 0;
+  }
+  if (pool->vbo_id != 0)
+  {
+    KRR_GLSTATE_delete_buffers(1, &pool->vbo_id);
+    pool->vbo_id = 0;
+  }
+  if (pool->ibo_id != 0)
+  {
+    KRR_GLSTATE_delete_buffers(1, &pool->ibo_id);
+    pool->ibo_id = 0;
+  }
+
+  free(pool->free_vertices);
+  pool->free_vertices = NULL;
+  free(pool->free_indices);
+  pool->free_indices = NULL;
+
+  free(pool);
+  pool = NULL;
+}
+
+bool KRR_MESHPOOL_alloc(KRR_MESHPOOL* pool, int vertices_count, int indices_count, KRR_MESHPOOL_ALLOC* out)
+{
+  // find both first so failing doesn't leave pool half-allocated
+  int vi = find_fit(pool->free_vertices, pool->free_vertices_count, vertices_count);
+  int ii = find_fit(pool->free_indices, pool->free_indices_count, indices_count);
+  if (vi < 0 || ii < 0)
+  {
+    KRR_LOGW("Mesh pool has no free space for %d vertices and %d indices", vertices_count, indices_count);
+    return false;
+  }
+
+  out->vertices.offset = take_range(pool->free_vertices, &pool->free_vertices_count, vi, vertices_count);
+  out->vertices.count = vertices_count;
+  out->indices.offset = take_range(pool->free_indices, &pool->free_indices_count, ii, indices_count);
+  out->indices.count = indices_count;
+
+  return true;
+}
+
+void KRR_MESHPOOL_release(KRR_MESHPOOL* pool, const KRR_MESHPOOL_ALLOC* alloc)
+{
+  give_range(&pool->free_vertices, &pool->free_vertices_count, &pool->free_vertices_capacity, alloc->vertices);
+  give_range(&pool->free_indices, &pool->free_indices_count, &pool->free_indices_capacity, alloc->indices);
+}
+
+void KRR_MESHPOOL_upload_vertices(KRR_MESHPOOL* pool, const KRR_MESHPOOL_ALLOC* alloc, const GLvoid* vertices)
+{
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, pool->vbo_id);
+  glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)alloc->vertices.offset * pool->vertex_size, (GLsizeiptr)alloc->vertices.count * pool->vertex_size, vertices);
+}
+
+void KRR_MESHPOOL_upload_indices(KRR_MESHPOOL* pool, const KRR_MESHPOOL_ALLOC* alloc, const GLvoid* indices, GLsizei index_size)
+{
+  // rebase and convert into pool's index type
+  void* rebased = malloc((size_t)alloc->indices.count * pool->index_size);
+  GLuint base = (GLuint)alloc->vertices.offset;
+
+  for (int i=0; i<alloc->indices.count; ++i)
+  {
+    GLuint index = index_size == sizeof(GLushort) ? ((const GLushort*)indices)[i] : ((const GLuint*)indices)[i];
+    index += base;
+
+    if (pool->index_type == GL_UNSIGNED_SHORT)
+      ((GLushort*)rebased)[i] = (GLushort)index;
+    else
+      ((GLuint*)rebased)[i] = index;
+  }
+
+  KRR_GLSTATE_bind_vertex_array(0);
+  KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, pool->ibo_id);
+  glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (GLintptr)alloc->indices.offset * pool->index_size, (GLsizeiptr)alloc->indices.count * pool->index_size, rebased);
+
+  free(rebased);
+}
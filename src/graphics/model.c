@@ -1,8 +1,21 @@
 #include "krr/graphics/model.h"
+#include "krr/graphics/glstate.h"
+#include "krr/graphics/meshcache.h"
+#include "krr/graphics/meshopt.h"
 #include "krr/graphics/objloader.h"
 #include "krr/graphics/texturedpp3d.h"
+#include "krr/foundation/log.h"
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
+
+static void reset_dequant(SIMPLEMODEL* sm)
+{
+  sm->dequant.position_offset = (VERTEXPOS3D){0.0f, 0.0f, 0.0f};
+  sm->dequant.position_scale = (VERTEXPOS3D){1.0f, 1.0f, 1.0f};
+  sm->dequant.texcoord_offset = (TEXCOORD2D){0.0f, 0.0f};
+  sm->dequant.texcoord_scale = (TEXCOORD2D){1.0f, 1.0f};
+}
 
 static void init_defaults(SIMPLEMODEL* sm)
 {
@@ -11,10 +24,28 @@ static void init_defaults(SIMPLEMODEL* sm)
 
   sm->indices = NULL;
   sm->indices_count = 0;
+  sm->index_type = GL_UNSIGNED_INT;
+
+  sm->packed = false;
+  reset_dequant(sm);
+
+  sm->pool = NULL;
+  sm->pooled = false;
+  sm->indices_offset = 0;
 
   sm->vbo_id = 0;
   sm->ibo_id = 0;
   sm->vao_id = 0;
+
+  sm->instance_vbo_id = 0;
+  sm->instances_count = 0;
+  sm->instances_capacity = 0;
+
+  memset(&sm->bounds, 0, sizeof(sm->bounds));
+  sm->cull_spheres = NULL;
+  sm->visible_indices = NULL;
+  sm->visible_instances = NULL;
+  sm->visible_capacity = 0;
 }
 
 SIMPLEMODEL* SIMPLEMODEL_new()
@@ -41,72 +72,302 @@ void SIMPLEMODEL_free_internals(SIMPLEMODEL* sm)
     sm->indices_count = 0;
   }
 
+  // `packed` is kept as it's user's setting for next loading
+  reset_dequant(sm);
+
+  if (sm->pooled)
+  {
+    // return range to pool, buffers are owned by pool
+    // `pool` is kept as it's user's setting for next loading
+    KRR_MESHPOOL_release(sm->pool, &sm->pool_alloc);
+    sm->pooled = false;
+    sm->indices_offset = 0;
+    sm->vbo_id = 0;
+    sm->ibo_id = 0;
+
+    // shared vao is owned by pool as well, but instanced model has its own
+    if (sm->vao_id == sm->pool->vao_id)
+    {
+      sm->vao_id = 0;
+    }
+  }
+
   if (sm->vbo_id != 0)
   {
-    glDeleteBuffers(1, &sm->vbo_id);
+    KRR_GLSTATE_delete_buffers(1, &sm->vbo_id);
     sm->vbo_id = 0;
   }
   if (sm->ibo_id != 0)
   {
-    glDeleteBuffers(1, &sm->ibo_id);
+    KRR_GLSTATE_delete_buffers(1, &sm->ibo_id);
     sm->ibo_id = 0;
   }
   if (sm->vao_id != 0)
   {
-    glDeleteBuffers(1, &sm->vao_id);
+    KRR_GLSTATE_delete_vertex_arrays(1, &sm->vao_id);
     sm->vao_id = 0;
   }
+  if (sm->instance_vbo_id != 0)
+  {
+    KRR_GLSTATE_delete_buffers(1, &sm->instance_vbo_id);
+    sm->instance_vbo_id = 0;
+    sm->instances_count = 0;
+    sm->instances_capacity = 0;
+  }
+
+  memset(&sm->bounds, 0, sizeof(sm->bounds));
+  if (sm->cull_spheres != NULL)
+  {
+    KRR_CULL_SPHERES_free(sm->cull_spheres);
+    sm->cull_spheres = NULL;
+  }
+  free(sm->visible_indices);
+  sm->visible_indices = NULL;
+  free(sm->visible_instances);
+  sm->visible_instances = NULL;
+  sm->visible_capacity = 0;
 }
 
-bool SIMPLEMODEL_load_objfile(SIMPLEMODEL* sm, const char* filepath)
+/// create vao sourcing vertices from vbo and indices from ibo
+static GLuint create_vao(GLuint vbo_id, GLuint ibo_id, bool packed)
 {
-  // unload first
-  SIMPLEMODEL_unload(sm);
+  GLuint vao_id;
+  glGenVertexArrays(1, &vao_id);
+  KRR_GLSTATE_bind_vertex_array(vao_id);
+
+    // enable vertex attributes
+    // as all models use the same shader, we operate on shared shader here
+    KRR_TEXSHADERPROG3D_enable_attrib_pointers(shared_textured3d_shaderprogram);
+
+    // set vertex data
+    KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, vbo_id);
+    if (packed)
+    {
+      KRR_TEXSHADERPROG3D_set_packed_vertex_pointer(shared_textured3d_shaderprogram, sizeof(VERTEXTEXNORM3D_PACKED), (GLvoid*)offsetof(VERTEXTEXNORM3D_PACKED, position));
+      KRR_TEXSHADERPROG3D_set_packed_texcoord_pointer(shared_textured3d_shaderprogram, sizeof(VERTEXTEXNORM3D_PACKED), (GLvoid*)offsetof(VERTEXTEXNORM3D_PACKED, texcoord));
+      KRR_TEXSHADERPROG3D_set_packed_normal_pointer(shared_textured3d_shaderprogram, sizeof(VERTEXTEXNORM3D_PACKED), (GLvoid*)offsetof(VERTEXTEXNORM3D_PACKED, normal));
+    }
+    else
+    {
+      KRR_TEXSHADERPROG3D_set_vertex_pointer(shared_textured3d_shaderprogram, sizeof(VERTEXTEXNORM3D), (GLvoid*)offsetof(VERTEXTEXNORM3D, position));
+      KRR_TEXSHADERPROG3D_set_texcoord_pointer(shared_textured3d_shaderprogram, sizeof(VERTEXTEXNORM3D), (GLvoid*)offsetof(VERTEXTEXNORM3D, texcoord));
+      KRR_TEXSHADERPROG3D_set_normal_pointer(shared_textured3d_shaderprogram, sizeof(VERTEXTEXNORM3D), (GLvoid*)offsetof(VERTEXTEXNORM3D, normal));
+    }
+
+    // ibo
+    KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo_id);
 
-  // load .obj file
-  KRR_load_objfile(filepath, &sm->vertices, &sm->vertices_count, &sm->indices, &sm->indices_count);
+  // unbind vao
+  KRR_GLSTATE_bind_vertex_array(0);
+
+  return vao_id;
+}
+
+/// suballocate mesh from model's pool, return false if it cannot be pooled
+static bool upload_mesh_pooled(SIMPLEMODEL* sm, const KRR_MESHCACHE* mc, const GLvoid* vertices)
+{
+  KRR_MESHPOOL* pool = sm->pool;
+  GLsizei vertex_size = sm->packed ? sizeof(VERTEXTEXNORM3D_PACKED) : sizeof(VERTEXTEXNORM3D);
+  if (pool->vertex_size != vertex_size)
+  {
+    KRR_LOGW("Mesh pool's vertex size %d doesn't match model's vertex size %d", pool->vertex_size, vertex_size);
+    return false;
+  }
+
+  if (!KRR_MESHPOOL_alloc(pool, sm->vertices_count, sm->indices_count, &sm->pool_alloc))
+  {
+    return false;
+  }
+
+  KRR_MESHPOOL_upload_vertices(pool, &sm->pool_alloc, vertices);
+  KRR_MESHPOOL_upload_indices(pool, &sm->pool_alloc, mc->indices, mc->header.index_size);
+
+  // vao is shared by all models in pool
+  if (pool->vao_id == 0)
+  {
+    pool->vao_id = create_vao(pool->vbo_id, pool->ibo_id, sm->packed);
+  }
+
+  sm->pooled = true;
+  sm->index_type = pool->index_type;
+  sm->indices_offset = (GLintptr)sm->pool_alloc.indices.offset * pool->index_size;
+  sm->vbo_id = pool->vbo_id;
+  sm->ibo_id = pool->ibo_id;
+  sm->vao_id = pool->vao_id;
+
+  return true;
+}
+
+/// create buffers and vao from mesh data, data is uploaded directly from wherever it is unless vertices need packing
+static void upload_mesh(SIMPLEMODEL* sm, const KRR_MESHCACHE* mc)
+{
+  sm->vertices_count = mc->header.vertices_count;
+  sm->indices_count = mc->header.indices_count;
+  sm->index_type = mc->index_type;
+
+  // bounds as computed when mesh was cached
+  memcpy(sm->bounds.aabb_min, mc->header.aabb_min, sizeof(sm->bounds.aabb_min));
+  memcpy(sm->bounds.aabb_max, mc->header.aabb_max, sizeof(sm->bounds.aabb_max));
+  memcpy(sm->bounds.center, mc->header.sphere_center, sizeof(sm->bounds.center));
+  sm->bounds.radius = mc->header.sphere_radius;
+
+  const GLvoid* vertices = mc->vertices;
+  VERTEXTEXNORM3D_PACKED* packed = NULL;
+  if (sm->packed)
+  {
+    packed = malloc(sizeof(VERTEXTEXNORM3D_PACKED) * sm->vertices_count);
+    KRR_MESHOPT_pack_vertices(mc->vertices, sm->vertices_count, packed, &sm->dequant);
+    vertices = packed;
+  }
+
+  // fall back to model's own buffers if it cannot be pooled
+  if (sm->pool != NULL && upload_mesh_pooled(sm, mc, vertices))
+  {
+    free(packed);
+    return;
+  }
 
   // create vbo
   glGenBuffers(1, &sm->vbo_id);
-  glBindBuffer(GL_ARRAY_BUFFER, sm->vbo_id);
-  glBufferData(GL_ARRAY_BUFFER, sm->vertices_count * sizeof(VERTEXTEXNORM3D), sm->vertices, GL_STATIC_DRAW);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, sm->vbo_id);
+  glBufferData(GL_ARRAY_BUFFER, sm->vertices_count * (sm->packed ? sizeof(VERTEXTEXNORM3D_PACKED) : sizeof(VERTEXTEXNORM3D)), vertices, GL_STATIC_DRAW);
+  free(packed);
 
+  // create ibo outside of any vao, so it won't change element array binding of currently bound vao
+  KRR_GLSTATE_bind_vertex_array(0);
   glGenBuffers(1, &sm->ibo_id);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sm->ibo_id);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sm->indices_count * sizeof(GLuint), sm->indices, GL_STATIC_DRAW);
-
-  // free vertices and indices as we loaded into opengl buffer now
-  free(sm->vertices);
-  sm->vertices = NULL;
-  free(sm->indices);
-  sm->indices = NULL;
+  KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, sm->ibo_id);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sm->indices_count * mc->header.index_size, mc->indices, GL_STATIC_DRAW);
 
   // vao
-  glGenVertexArrays(1, &sm->vao_id);
-  glBindVertexArray(sm->vao_id);
+  sm->vao_id = create_vao(sm->vbo_id, sm->ibo_id, sm->packed);
+}
 
-    // enable vertex attributes
-    // as all models use the same shader, we operate on shared shader here
-    KRR_TEXSHADERPROG3D_enable_attrib_pointers(shared_textured3d_shaderprogram);
+bool SIMPLEMODEL_load_objfile(SIMPLEMODEL* sm, const char* filepath)
+{
+  return SIMPLEMODEL_load_objfile_ex(sm, filepath, KRR_OBJLOADER_FLAG_OPTIMIZE);
+}
 
-    // set vertex data
-    glBindBuffer(GL_ARRAY_BUFFER, sm->vbo_id);
-    KRR_TEXSHADERPROG3D_set_vertex_pointer(shared_textured3d_shaderprogram, sizeof(VERTEXTEXNORM3D), (GLvoid*)offsetof(VERTEXTEXNORM3D, position));
-    KRR_TEXSHADERPROG3D_set_texcoord_pointer(shared_textured3d_shaderprogram, sizeof(VERTEXTEXNORM3D), (GLvoid*)offsetof(VERTEXTEXNORM3D, texcoord));
-    KRR_TEXSHADERPROG3D_set_normal_pointer(shared_textured3d_shaderprogram, sizeof(VERTEXTEXNORM3D), (GLvoid*)offsetof(VERTEXTEXNORM3D, normal));
+bool SIMPLEMODEL_load_objfile_ex(SIMPLEMODEL* sm, const char* filepath, int flags)
+{
+  // unload first
+  SIMPLEMODEL_unload(sm);
 
-    // ibo
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sm->ibo_id);
+  // load .obj file, or its cache if source file is unchanged
+  KRR_MESHCACHE mc;
+  if (!KRR_MESHCACHE_load_objfile(&mc, filepath, flags))
+  {
+    return false;
+  }
 
-  // unbind vao
-  glBindVertexArray(0);
+  upload_mesh(sm, &mc);
+
+  // release mesh data as we loaded into opengl buffer now
+  KRR_MESHCACHE_close(&mc);
+
+  return true;
+}
+
+bool SIMPLEMODEL_load_meshfile(SIMPLEMODEL* sm, const char* filepath)
+{
+  // unload first
+  SIMPLEMODEL_unload(sm);
+
+  // map .krrmesh file
+  KRR_MESHCACHE mc;
+  if (!KRR_MESHCACHE_load(&mc, filepath))
+  {
+    return false;
+  }
+
+  upload_mesh(sm, &mc);
+
+  // unmap as we loaded into opengl buffer now
+  KRR_MESHCACHE_close(&mc);
 
   return true;
 }
 
 void SIMPLEMODEL_render(SIMPLEMODEL* sm)
 {
-  glDrawElements(GL_TRIANGLES, sm->indices_count, GL_UNSIGNED_INT, NULL);
+  KRR_SHADERPROG_flush_bound();
+  glDrawElements(GL_TRIANGLES, sm->indices_count, sm->index_type, (const GLvoid*)sm->indices_offset);
+}
+
+void SIMPLEMODEL_set_instances(SIMPLEMODEL* sm, const SIMPLEMODEL_INSTANCE* instances, int count)
+{
+  if (sm->instance_vbo_id == 0)
+  {
+    glGenBuffers(1, &sm->instance_vbo_id);
+
+    // shared vao of pool can't hold per-instance attributes of every model, so have its own
+    // sourcing from the same pool's buffers
+    if (sm->pooled && sm->vao_id == sm->pool->vao_id)
+    {
+      sm->vao_id = create_vao(sm->vbo_id, sm->ibo_id, sm->packed);
+    }
+
+    // add per-instance attributes to model's vao
+    KRR_GLSTATE_bind_vertex_array(sm->vao_id);
+      KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, sm->instance_vbo_id);
+      KRR_TEXSHADERPROG3D_set_instance_model_matrix_pointer(shared_textured3d_shaderprogram, sizeof(SIMPLEMODEL_INSTANCE), (GLvoid*)offsetof(SIMPLEMODEL_INSTANCE, model_matrix));
+      KRR_TEXSHADERPROG3D_set_instance_clipped_texcoord_pointer(shared_textured3d_shaderprogram, sizeof(SIMPLEMODEL_INSTANCE), (GLvoid*)offsetof(SIMPLEMODEL_INSTANCE, clipped_texcoord));
+    KRR_GLSTATE_bind_vertex_array(0);
+  }
+
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, sm->instance_vbo_id);
+  if (count > sm->instances_capacity)
+  {
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(SIMPLEMODEL_INSTANCE), instances, GL_DYNAMIC_DRAW);
+    sm->instances_capacity = count;
+  }
+  else if (count > 0)
+  {
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(SIMPLEMODEL_INSTANCE), instances);
+  }
+  sm->instances_count = count;
+}
+
+int SIMPLEMODEL_set_visible_instances(SIMPLEMODEL* sm, const KRR_CULL_FRUSTUM* frustum, const SIMPLEMODEL_INSTANCE* instances, int count)
+{
+  return SIMPLEMODEL_set_visible_instances_ex(sm, frustum, NULL, 0, NULL, instances, count);
+}
+
+int SIMPLEMODEL_set_visible_instances_ex(SIMPLEMODEL* sm, const KRR_CULL_FRUSTUM* frustum, KRR_OCCLUSION* occlusion, int first_object, mat4 view_projection, const SIMPLEMODEL_INSTANCE* instances, int count)
+{
+  if (sm->cull_spheres == NULL)
+  {
+    sm->cull_spheres = KRR_CULL_SPHERES_new();
+  }
+  if (count > sm->visible_capacity)
+  {
+    free(sm->visible_indices);
+    free(sm->visible_instances);
+    sm->visible_indices = malloc(sizeof(int) * count);
+    sm->visible_instances = malloc(sizeof(SIMPLEMODEL_INSTANCE) * count);
+    sm->visible_capacity = count;
+  }
+
+  // all instances share bounds of model
+  int visible = KRR_CULL_batch(frustum, sm->cull_spheres, &sm->bounds, 0, instances, sizeof(SIMPLEMODEL_INSTANCE), count, sm->visible_indices);
+  if (occlusion != NULL)
+  {
+    visible = KRR_OCCLUSION_cull(occlusion, first_object, &sm->bounds, view_projection, instances, sizeof(SIMPLEMODEL_INSTANCE), sm->visible_indices, visible);
+  }
+
+  for (int i=0; i<visible; ++i)
+  {
+    memcpy(&sm->visible_instances[i], &instances[sm->visible_indices[i]], sizeof(SIMPLEMODEL_INSTANCE));
+  }
+  SIMPLEMODEL_set_instances(sm, sm->visible_instances, visible);
+
+  return visible;
+}
+
+void SIMPLEMODEL_render_instanced(SIMPLEMODEL* sm)
+{
+  KRR_SHADERPROG_flush_bound();
+  glDrawElementsInstanced(GL_TRIANGLES, sm->indices_count, sm->index_type, (const GLvoid*)sm->indices_offset, sm->instances_count);
 }
 
 void SIMPLEMODEL_unload(SIMPLEMODEL* sm)
@@ -1,14 +1,18 @@
 #include "krr/graphics/objloader.h"
+#include "krr/graphics/meshopt.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <math.h>
-#include <SDL2/SDL_system.h>
-#include "krr/platforms/platforms_config.h"
+#include <limits.h>
+#include <stdint.h>
 #include "krr/foundation/log.h"
-#include "krr/foundation/util.h"
+#include "krr/foundation/filemap.h"
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_cpuinfo.h>
+#include <SDL2/SDL_error.h>
 
 // start with 100 empty space to hold elements
 #define INITIAL_ELEM_COUNT 100
@@ -16,276 +20,883 @@
 // use the same factor as C++ stl uses in vector
 #define INCREASE_ELEM_FACTOR 1.5
 
-typedef struct DUP DUP;
-struct DUP
+// epsilon used to snap texcoord and normal values when KRR_OBJLOADER_FLAG_MERGE_EPSILON is set
+#define MERGE_EPSILON 1.0e-5
+
+// minimum size in bytes of .obj file to be worth parsing by an additional thread
+#define MIN_CHUNK_SIZE (1 << 20)
+
+// upper limit of number of threads parsing .obj file
+#define MAX_CHUNKS 16
+
+// sentinel for an empty slot in VHASH
+#define VHASH_EMPTY -1
+
+/// slot of VHASH
+/// key and value are kept together so a lookup touches a single cache line
+typedef struct
 {
-  VERTEXTEXNORM3D v;
-  int idx;
-  DUP* next;
-};
+  /// key, v is VHASH_EMPTY for an empty slot
+  int v;
+  int vt;
+  int vn;
+  /// final vertex index
+  int value;
+} VHASH_SLOT;
+
+/// open-addressing (linear probing) hash of v/vt/vn index triples to final vertex index
+/// all storage is a single flat array, thus no per-entry allocation
+typedef struct
+{
+  VHASH_SLOT* slots;
+  /// always power of two
+  int capacity;
+  int count;
+} VHASH;
+
+/// part of .obj file parsed independently of others
+/// indices in `corners` are resolved against elements found so far in this chunk only
+typedef struct
+{
+  /// range of text, always at line boundaries
+  const char* begin;
+  const char* end;
+
+  VERTEXPOS3D* vertices;
+  TEXCOORD2D* texcoords;
+  NORMAL* normals;
+  /// zero-based v/vt/vn triple (3 ints) of each corner of triangles from 'f '
+  int* corners;
+  /// offsets into `corners` of indices which were negative (relative) in .obj
+  /// they need to be offset by number of such elements in preceding chunks
+  int* relatives;
+
+  /// number of v, vt, and vn
+  int counts[3];
+  int corners_count;
+  int relatives_count;
+
+  // keep track of current allocated count for all buffer
+  int v_alloc_count;
+  int vt_alloc_count;
+  int vn_alloc_count;
+  int c_alloc_count;
+  int r_alloc_count;
+
+  /// line number is counted from beginning of chunk
+  int lines_count;
+  int malformed_count;
+  int first_malformed_line;
+} PARSE_CHUNK;
+
+/// resolve final vertex index of v/vt/vn triple from 'f ', new vertex is appended into `out_vertices` if needed
+static int handle_f_v(int v_index, int vt_index, int vn_index, VERTEXTEXNORM3D** out_vertices, int* final_vertices_count, int* latest_used_vertices_index, const VERTEXPOS3D* vertices, const TEXCOORD2D* texcoords, const NORMAL* normals, int* primary_table, VHASH* vhash);
+
+static inline unsigned int vhash_hash(int v, int vt, int vn)
+{
+  unsigned int h = (unsigned int)v * 0x9E3779B1u;
+  h ^= (unsigned int)vt * 0x85EBCA77u;
+  h ^= (unsigned int)vn * 0xC2B2AE3Du;
+  h ^= h >> 16;
+  h *= 0x7FEB352Du;
+  h ^= h >> 15;
+  return h;
+}
+
+static void vhash_init(VHASH* vh, int expected_count)
+{
+  // keep load factor at most 0.5
+  int capacity = 16;
+  while (capacity < expected_count * 2)
+    capacity <<= 1;
+
+  vh->slots = malloc(sizeof(VHASH_SLOT) * capacity);
+  vh->capacity = capacity;
+  vh->count = 0;
+
+  for (int i=0; i<capacity; ++i)
+  {
+    vh->slots[i].v = VHASH_EMPTY;
+  }
+}
+
+static void vhash_free(VHASH* vh)
+{
+  free(vh->slots);
+  vh->slots = NULL;
+  vh->capacity = 0;
+  vh->count = 0;
+}
+
+/// return slot of the key, or the empty slot in which such key should be inserted
+static inline int vhash_probe(const VHASH* vh, int v, int vt, int vn)
+{
+  const int mask = vh->capacity - 1;
+  int slot = vhash_hash(v, vt, vn) & mask;
+
+  for (;;)
+  {
+    const VHASH_SLOT* s = vh->slots + slot;
+    if (s->v == VHASH_EMPTY ||
+        (s->v == v && s->vt == vt && s->vn == vn))
+    {
+      return slot;
+    }
+    slot = (slot + 1) & mask;
+  }
+}
+
+static void vhash_grow(VHASH* vh)
+{
+  VHASH_SLOT* old_slots = vh->slots;
+  int old_capacity = vh->capacity;
+
+  vhash_init(vh, old_capacity);
+
+  for (int i=0; i<old_capacity; ++i)
+  {
+    const VHASH_SLOT* s = old_slots + i;
+    if (s->v != VHASH_EMPTY)
+    {
+      vh->slots[vhash_probe(vh, s->v, s->vt, s->vn)] = *s;
+      ++vh->count;
+    }
+  }
+
+  free(old_slots);
+}
 
+/// slot of table used by build_epsilon_remap(), keyed on quantized components
 typedef struct
 {
-  bool set;
-  DUP* dup;
-} DUPS;
+  int64_t q[3];
+  /// index of first element with such key, -1 for an empty slot
+  int first;
+} EREMAP_SLOT;
 
-/// handle vertex for 'f '
-static void handle_f_v(int v_index, int vt_index, int vn_index, int* final_vertices_count, int* final_indices_count, VERTEXTEXNORM3D** out_vertices, GLuint** out_indices, int* latest_used_vertices_index, int* indices_index, VERTEXPOS3D* vertices, TEXCOORD2D* texcoords, NORMAL* normals, DUPS* dup_table);
+static inline unsigned int eremap_hash(const int64_t* q)
+{
+  uint64_t h = (uint64_t)q[0] * 0x9E3779B97F4A7C15ull;
+  h ^= (uint64_t)q[1] * 0xC2B2AE3D27D4EB4Full;
+  h ^= (uint64_t)q[2] * 0x165667B19E3779F9ull;
+  h ^= h >> 29;
+  h *= 0xBF58476D1CE4E5B9ull;
+  h ^= h >> 32;
+  return (unsigned int)h;
+}
 
-static void free_dup_recur(DUP* dup_ptr)
+/// map each of `count` elements (`dim` floats each) in `values` to index of its first
+/// occurrence after snapping to MERGE_EPSILON grid, result is written into `dst_remap`
+static void build_epsilon_remap(const GLfloat* values, int count, int dim, int* dst_remap)
 {
-  if (dup_ptr == NULL)
+  // quantized components take 64-bit as large texcoords i.e. tiled or atlas ones overflow 32-bit
+  // all elements fit with load factor at most 0.5, unused component stays 0
+  int capacity = 16;
+  while (capacity < count * 2)
+    capacity <<= 1;
+  const int mask = capacity - 1;
+
+  EREMAP_SLOT* slots = malloc(sizeof(EREMAP_SLOT) * capacity);
+  for (int i=0; i<capacity; ++i)
   {
-    return;
+    slots[i].first = -1;
   }
-  else
+
+  for (int i=0; i<count; ++i)
   {
-    free_dup_recur(dup_ptr->next);
-    dup_ptr->next = NULL;
+    int64_t q[3] = {0, 0, 0};
+    for (int c=0; c<dim; ++c)
+    {
+      q[c] = (int64_t)llrint(values[i*dim + c] / MERGE_EPSILON);
+    }
 
-    // free this node
-    free(dup_ptr);
+    int slot = eremap_hash(q) & mask;
+    EREMAP_SLOT* s = slots + slot;
+    while (s->first != -1 && (s->q[0] != q[0] || s->q[1] != q[1] || s->q[2] != q[2]))
+    {
+      slot = (slot + 1) & mask;
+      s = slots + slot;
+    }
+
+    if (s->first == -1)
+    {
+      memcpy(s->q, q, sizeof(q));
+      s->first = i;
+    }
+    dst_remap[i] = s->first;
   }
+
+  free(slots);
 }
 
-static void free_dups(DUPS** dups_table, int count)
+/// powers of ten which are exactly representable in double
+static const double pow10_table[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool is_blank(char c)
 {
-  // get value pointed to by double pointer
-  DUPS* dups_table_v = *dups_table;
+  return c == ' ' || c == '\t' || c == '\r';
+}
 
-  // free each element of dups table
-  for (int i=0; i<count; i++)
+static inline bool is_digit(char c)
+{
+  return (unsigned char)(c - '0') < 10;
+}
+
+/// skip spaces, tabs, and carriage return
+static inline const char* skip_blanks(const char* p, const char* end)
+{
+  while (p < end && is_blank(*p))
+    ++p;
+  return p;
+}
+
+/// parse decimal floating-point number after optional leading blanks, not reading past `end`.
+/// It doesn't depend on current locale unlike strtof() or sscanf().
+/// Return pointer past the number, or NULL if there's no number.
+static const char* parse_float(const char* p, const char* end, GLfloat* dst)
+{
+  p = skip_blanks(p, end);
+
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+'))
+  {
+    negative = *p == '-';
+    ++p;
+  }
+
+  // 19 significant digits always fit in uint64_t, and are way more than float can hold
+  uint64_t mantissa = 0;
+  int sig_digits = 0;
+  int exponent = 0;
+  bool has_digits = false;
+
+  for (; p < end && is_digit(*p); ++p)
   {
-    free_dup_recur(dups_table_v[i].dup);
-    dups_table_v[i].dup = NULL;
+    has_digits = true;
+    if (sig_digits < 19)
+    {
+      mantissa = mantissa * 10 + (*p - '0');
+      // leading zeros are not significant
+      if (mantissa != 0)
+        ++sig_digits;
+    }
+    else
+    {
+      ++exponent;
+    }
   }
 
-  // free dups table itself
-  free(dups_table_v);
-  *dups_table = NULL;
+  if (p < end && *p == '.')
+  {
+    for (++p; p < end && is_digit(*p); ++p)
+    {
+      has_digits = true;
+      if (sig_digits < 19)
+      {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa != 0)
+          ++sig_digits;
+        --exponent;
+      }
+    }
+  }
+
+  if (!has_digits)
+    return NULL;
+
+  if (p < end && (*p == 'e' || *p == 'E'))
+  {
+    const char* e = p + 1;
+    bool exp_negative = false;
+    if (e < end && (*e == '-' || *e == '+'))
+    {
+      exp_negative = *e == '-';
+      ++e;
+    }
+
+    // only consume exponent part if it has digits
+    if (e < end && is_digit(*e))
+    {
+      int exp_value = 0;
+      for (; e < end && is_digit(*e); ++e)
+      {
+        // anything beyond this is out of range for float anyway
+        if (exp_value < 10000)
+          exp_value = exp_value * 10 + (*e - '0');
+      }
+      exponent += exp_negative ? -exp_value : exp_value;
+      p = e;
+    }
+  }
+
+  double value = (double)mantissa;
+  if (mantissa != 0)
+  {
+    if (exponent < 0)
+    {
+      for (; exponent < -22; exponent += 22)
+        value /= pow10_table[22];
+      value /= pow10_table[-exponent];
+    }
+    else
+    {
+      for (; exponent > 22; exponent -= 22)
+        value *= pow10_table[22];
+      value *= pow10_table[exponent];
+    }
+  }
+
+  *dst = (GLfloat)(negative ? -value : value);
+  return p;
 }
 
-int KRR_load_objfile(const char* filepath, VERTEXTEXNORM3D** dst_vertices, int* vertices_count, GLuint** dst_indices, int* indices_count)
+/// parse decimal integer after optional leading blanks, not reading past `end`.
+/// Return pointer past the number, or NULL if there's no number.
+static const char* parse_int(const char* p, const char* end, int* dst)
 {
-#if KRR_TARGET_PLATFORM == KRR_PLATFORM_ANDROID
-  SDL_RWops* file = SDL_RWFromFile(filepath, "rb");
-  if (file == NULL)
+  p = skip_blanks(p, end);
+
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+'))
   {
-    KRR_LOGE("Error opening %s file", filepath);
-    return -1;
+    negative = *p == '-';
+    ++p;
   }
-#else
-  FILE* file = fopen(filepath, "rb");
-#endif
-  if (file == NULL)
+
+  if (p >= end || !is_digit(*p))
+    return NULL;
+
+  // saturate instead of overflow, such value will be rejected as out of range later
+  int value = 0;
+  for (; p < end && is_digit(*p); ++p)
   {
-    KRR_LOGE("Cannot read .obj file");
-    return -1;
+    if (value <= (INT_MAX - 9) / 10)
+      value = value * 10 + (*p - '0');
+    else
+      value = INT_MAX;
   }
 
-  // define line buffer to read from file
-  char line[256];
-  
-  // collect all meta vertex array info before we finally form final vertices and indices
-  VERTEXPOS3D* vertices = NULL; 
-  TEXCOORD2D* texcoords = NULL;
-  NORMAL* normals = NULL;
+  *dst = negative ? -value : value;
+  return p;
+}
 
-  // keep track of current allocated count for all buffer
-  int v_alloc_count = INITIAL_ELEM_COUNT;
-  int vt_alloc_count = INITIAL_ELEM_COUNT;
-  int vn_alloc_count = INITIAL_ELEM_COUNT;
-  // running indexes for all data
-  int vertices_i = 0;
-  int texcoords_i = 0;
-  int normals_i = 0;
+/// parse "v/vt/vn" of 'f ' then convert each element into zero-based index.
+/// Negative index refers relatively to the end of data read so far, bit i of `relative_mask` is set
+/// for such element i.
+/// Return pointer past the parsed text, or NULL if it's malformed.
+static const char* parse_f_v(const char* p, const char* end, const int* counts, int* dst, int* relative_mask)
+{
+  if ((p = parse_int(p, end, &dst[0])) == NULL || p >= end || *p != '/')
+    return NULL;
+  if ((p = parse_int(p + 1, end, &dst[1])) == NULL || p >= end || *p != '/')
+    return NULL;
+  if ((p = parse_int(p + 1, end, &dst[2])) == NULL)
+    return NULL;
+
+  *relative_mask = 0;
+  for (int i=0; i<3; ++i)
+  {
+    // 0 is not a valid index in .obj
+    if (dst[i] == 0)
+      return NULL;
+
+    if (dst[i] > 0)
+    {
+      dst[i] = dst[i] - 1;
+    }
+    else
+    {
+      dst[i] = counts[i] + dst[i];
+      *relative_mask |= 1 << i;
+    }
+  }
+
+  return p;
+}
+
+/// start with lowest enough space to hold elements
+/// the true number of element is tracked along the way
+static void parse_chunk_init(PARSE_CHUNK* c, const char* begin, const char* end)
+{
+  c->begin = begin;
+  c->end = end;
+
+  c->vertices = malloc(sizeof(VERTEXPOS3D) * INITIAL_ELEM_COUNT);
+  c->texcoords = malloc(sizeof(TEXCOORD2D) * INITIAL_ELEM_COUNT);
+  c->normals = malloc(sizeof(NORMAL) * INITIAL_ELEM_COUNT);
+  c->corners = malloc(sizeof(int) * 3 * INITIAL_ELEM_COUNT * 3);
+  c->relatives = NULL;
+  c->v_alloc_count = INITIAL_ELEM_COUNT;
+  c->vt_alloc_count = INITIAL_ELEM_COUNT;
+  c->vn_alloc_count = INITIAL_ELEM_COUNT;
+  c->c_alloc_count = INITIAL_ELEM_COUNT * 3;
+  c->r_alloc_count = 0;
+
+  c->counts[0] = 0;
+  c->counts[1] = 0;
+  c->counts[2] = 0;
+  c->corners_count = 0;
+  c->relatives_count = 0;
+
+  c->lines_count = 0;
+  c->malformed_count = 0;
+  c->first_malformed_line = 0;
+}
+
+static void parse_chunk_free(PARSE_CHUNK* c)
+{
+  free(c->vertices);
+  c->vertices = NULL;
+  free(c->texcoords);
+  c->texcoords = NULL;
+  free(c->normals);
+  c->normals = NULL;
+  free(c->corners);
+  c->corners = NULL;
+  free(c->relatives);
+  c->relatives = NULL;
+}
 
-  // start with lowest enough space to hold elements
-  // the true number of element is tracked along the way, and
-  // we will adjust the number of space later at the end to reduce un-needed memory usage
-  vertices = calloc(1, sizeof(VERTEXPOS3D) * v_alloc_count);
-  texcoords = calloc(1, sizeof(TEXCOORD2D) * vt_alloc_count);
-  normals = calloc(1, sizeof(NORMAL) * vn_alloc_count);
-
-  // flag checking whether it has been entered into 'f ' case
-  bool entered_f = false;
-
-  // variables related to 'f ' section
-  // this will be defered in allocation later after we entered into 'f ' section after we know exact number of elements to allocate
-  // from those vertex data
-  VERTEXTEXNORM3D* out_vertices = NULL;
-  int final_vertices_count = 0;
-  int static_vertices_count = 0;
-
-  // same for indices
-  GLuint* out_indices = NULL; 
-  int final_indices_count = 0;
-  
-  // latest used vertices index, default to -1
-  int latest_used_vertices_index = -1;
-  // index for indices, support only for triangle-face for now
-  int i_i = 0;
-
-  // duplicate table
-  // when such vertex is found, then set this table for such element
-  // as well as add duplicated element in the list for future checking
-  // in order to give us a correct indice value
-  DUPS* v_set_table = NULL;
-
-  // read file line by line
-  GLfloat temp_v[3];
-  int idx[9];
-#if KRR_TARGET_PLATFORM == KRR_PLATFORM_ANDROID
-  while (KRR_util_rwopsgets(file, line, sizeof(line)))
-#else
-  while (fgets(line, sizeof(line), file))
-#endif
-  {
-    if (strncmp(line, "v ", strlen("v ")) == 0)
+static inline void mark_malformed(PARSE_CHUNK* c)
+{
+  if (c->malformed_count++ == 0)
+  {
+    c->first_malformed_line = c->lines_count;
+  }
+}
+
+/// emit triangle of 3 corners into `c`, along with offsets of its relative indices
+static void emit_triangle(PARSE_CHUNK* c, const int* a, int a_mask, const int* b, int b_mask, const int* d, int d_mask)
+{
+  // check if need to expand the memory space 
+  if (c->corners_count + 3 > c->c_alloc_count)
+  {
+    c->c_alloc_count += c->c_alloc_count * INCREASE_ELEM_FACTOR;
+    c->corners = realloc(c->corners, sizeof(int) * 3 * c->c_alloc_count);
+  }
+
+  int* dst = c->corners + c->corners_count * 3;
+  memcpy(dst, a, sizeof(int) * 3);
+  memcpy(dst + 3, b, sizeof(int) * 3);
+  memcpy(dst + 6, d, sizeof(int) * 3);
+
+  // relative indices are rare, only track them if there's any
+  const int masks[3] = { a_mask, b_mask, d_mask };
+  for (int k=0; k<3; ++k)
+  {
+    for (int i=0; i<3 && masks[k] != 0; ++i)
     {
-      // start at offset 2 as we don't need to pay attention to prefix "v "
-      // the same for others
-      if (sscanf(line + 2, "%f %f %f", &temp_v[0], &temp_v[1], &temp_v[2]) == 3)
+      if ((masks[k] & (1 << i)) == 0)
+        continue;
+
+      if (c->relatives_count >= c->r_alloc_count)
       {
-        // check if need to expand the memory space 
-        if (vertices_i >= v_alloc_count)
-        {
-          // expand with pre-set value
-          v_alloc_count += v_alloc_count * INCREASE_ELEM_FACTOR;
-          vertices = realloc(vertices, sizeof(VERTEXPOS3D) * v_alloc_count);
-        }
+        c->r_alloc_count = c->r_alloc_count == 0 ? INITIAL_ELEM_COUNT : c->r_alloc_count + c->r_alloc_count * INCREASE_ELEM_FACTOR;
+        c->relatives = realloc(c->relatives, sizeof(int) * c->r_alloc_count);
+      }
+      c->relatives[c->relatives_count++] = c->corners_count * 3 + k * 3 + i;
+    }
+  }
+
+  c->corners_count += 3;
+}
+
+/// parse all lines in range of `c`
+static void parse_chunk(PARSE_CHUNK* c)
+{
+  const char* p = c->begin;
+  const char* end = c->end;
+
+  // go through line by line, there is no limit on line length
+  while (p < end)
+  {
+    const char* eol = memchr(p, '\n', end - p);
+    if (eol == NULL)
+    {
+      eol = end;
+    }
+    ++c->lines_count;
+
+    const char* s = skip_blanks(p, eol);
+    p = eol < end ? eol + 1 : end;
 
-        // copy by values
-        vertices[vertices_i].x = temp_v[0];
-        vertices[vertices_i].y = temp_v[1];
-        vertices[vertices_i++].z = temp_v[2];
+    // need at least 2 characters to be any of interested lines
+    if (eol - s < 2)
+    {
+      continue;
+    }
+
+    if (s[0] == 'v' && is_blank(s[1]))
+    {
+      // check if need to expand the memory space 
+      if (c->counts[0] >= c->v_alloc_count)
+      {
+        // expand with pre-set value
+        c->v_alloc_count += c->v_alloc_count * INCREASE_ELEM_FACTOR;
+        c->vertices = realloc(c->vertices, sizeof(VERTEXPOS3D) * c->v_alloc_count);
+      }
+
+      // write directly into its slot, only count it if all components are read
+      VERTEXPOS3D* v = c->vertices + c->counts[0];
+      if ((s = parse_float(s + 2, eol, &v->x)) != NULL &&
+          (s = parse_float(s, eol, &v->y)) != NULL &&
+          (s = parse_float(s, eol, &v->z)) != NULL)
+      {
+        ++c->counts[0];
       }
       else
       {
-        KRR_LOGW("Warning: Failed attempt to read vertex data for 'v ' format");
+        mark_malformed(c);
       }
     }
-    else if (strncmp(line, "vt ", strlen("vt ")) == 0)
+    else if (s[0] == 'v' && s[1] == 't' && eol - s > 2 && is_blank(s[2]))
     {
-      if (sscanf(line + 3, "%f %f", &temp_v[0], &temp_v[1]) == 2)
+      // check if need to expand the memory space 
+      if (c->counts[1] >= c->vt_alloc_count)
       {
-        // check if need to expand the memory space 
-        if (texcoords_i >= vt_alloc_count)
-        {
-          // expand with pre-set value
-          vt_alloc_count += vt_alloc_count * INCREASE_ELEM_FACTOR;
-          texcoords = realloc(texcoords, sizeof(TEXCOORD2D) * vt_alloc_count);
-        }
+        // expand with pre-set value
+        c->vt_alloc_count += c->vt_alloc_count * INCREASE_ELEM_FACTOR;
+        c->texcoords = realloc(c->texcoords, sizeof(TEXCOORD2D) * c->vt_alloc_count);
+      }
 
-        texcoords[texcoords_i].s = temp_v[0];
-        texcoords[texcoords_i++].t = temp_v[1];
+      TEXCOORD2D* vt = c->texcoords + c->counts[1];
+      if ((s = parse_float(s + 3, eol, &vt->s)) != NULL &&
+          (s = parse_float(s, eol, &vt->t)) != NULL)
+      {
+        ++c->counts[1];
       }
       else
       {
-        KRR_LOGW("Warning: Failed attempt to read vertex data for 'vt ' format");
+        mark_malformed(c);
       }
     }
-    else if (strncmp(line, "vn ", strlen("vn ")) == 0)
+    else if (s[0] == 'v' && s[1] == 'n' && eol - s > 2 && is_blank(s[2]))
     {
-      if (sscanf(line + 3, "%f %f %f", &temp_v[0], &temp_v[1], &temp_v[2]) == 3)
+      // check if need to expand the memory space 
+      if (c->counts[2] >= c->vn_alloc_count)
       {
-        // check if need to expand the memory space 
-        if (normals_i >= vn_alloc_count)
-        {
-          // expand with pre-set value
-          vn_alloc_count += vn_alloc_count * INCREASE_ELEM_FACTOR;
-          normals = realloc(normals, sizeof(NORMAL) * vn_alloc_count);
-        }
+        // expand with pre-set value
+        c->vn_alloc_count += c->vn_alloc_count * INCREASE_ELEM_FACTOR;
+        c->normals = realloc(c->normals, sizeof(NORMAL) * c->vn_alloc_count);
+      }
 
-        normals[normals_i].x = temp_v[0];
-        normals[normals_i].y = temp_v[1];
-        normals[normals_i++].z = temp_v[2];
+      NORMAL* vn = c->normals + c->counts[2];
+      if ((s = parse_float(s + 3, eol, &vn->x)) != NULL &&
+          (s = parse_float(s, eol, &vn->y)) != NULL &&
+          (s = parse_float(s, eol, &vn->z)) != NULL)
+      {
+        ++c->counts[2];
       }
       else
       {
-        KRR_LOGW("Warning: Failed attempt to read vertex data for 'vn ' format");
+        mark_malformed(c);
       }
     }
-    else if (strncmp(line, "f ", strlen("f ")) == 0)
+    else if (s[0] == 'f' && is_blank(s[1]))
     {
-      if (!entered_f)
+      // polygon is triangulated as a fan around its first corner
+      // roll back all of its triangles if any of its corner is malformed
+      int line_corners_count = c->corners_count;
+      int line_relatives_count = c->relatives_count;
+      int first[3], first_mask = 0;
+      int prev[3], prev_mask = 0;
+      int n = 0;
+      bool ok = true;
+
+      s += 2;
+      for (;;)
       {
-        // set flag
-        entered_f = true;
-
-        // shrink memory space previously allocated for all 3 buffers
-        vertices = realloc(vertices, sizeof(VERTEXPOS3D) * vertices_i);
-        texcoords = realloc(texcoords, sizeof(TEXCOORD2D) * texcoords_i);
-        normals = realloc(normals, sizeof(NORMAL) * normals_i);
-
-        // set number of elements for final vertices as well
-        // differentiate from v_count to give us info later how many actual 'v ' is
-        final_vertices_count = vertices_i;
-        // initially set latest vertices used for duplicated vertex item later used in handle_f_v
-        latest_used_vertices_index = final_vertices_count;
-
-        // allocate memory space
-        // allocate vertices enough space initially
-        out_vertices = calloc(1, sizeof(VERTEXTEXNORM3D) * final_vertices_count);
-        // allocate with initial guess space
-        final_indices_count = INITIAL_ELEM_COUNT * 3;
-        out_indices = calloc(1, sizeof(GLuint) * final_indices_count);
-
-        // allocate memory space for dup table
-        // number of element for table won't grow as each element might maintain its own duplicate list
-        v_set_table = calloc(1, sizeof(DUPS) * final_vertices_count);
-
-        // save vertices count for later use
-        // this value won't be modified by handle_f_v() function
-        static_vertices_count = final_vertices_count;
+        s = skip_blanks(s, eol);
+        if (s >= eol || *s == '#')
+        {
+          break;
+        }
+
+        int v[3], v_mask;
+        if ((s = parse_f_v(s, eol, c->counts, v, &v_mask)) == NULL)
+        {
+          ok = false;
+          break;
+        }
+
+        if (n == 0)
+        {
+          memcpy(first, v, sizeof(first));
+          first_mask = v_mask;
+        }
+        else if (n >= 2)
+        {
+          emit_triangle(c, first, first_mask, prev, prev_mask, v, v_mask);
+        }
+
+        memcpy(prev, v, sizeof(prev));
+        prev_mask = v_mask;
+        ++n;
       }
 
-      if (sscanf(line + 2, "%d/%d/%d %d/%d/%d %d/%d/%d", &idx[0], &idx[1], &idx[2], &idx[3], &idx[4], &idx[5], &idx[6], &idx[7], &idx[8]) == 9)
+      if (!ok || n < 3)
       {
-        // vertex 1
-        handle_f_v(idx[0]-1, idx[1]-1, idx[2]-1, &final_vertices_count, &final_indices_count, &out_vertices, &out_indices, &latest_used_vertices_index, &i_i, vertices, texcoords, normals, v_set_table);
-        // vertex 2
-        handle_f_v(idx[3]-1, idx[4]-1, idx[5]-1, &final_vertices_count, &final_indices_count, &out_vertices, &out_indices, &latest_used_vertices_index, &i_i, vertices, texcoords, normals, v_set_table);
-        // vertex 3
-        handle_f_v(idx[6]-1, idx[7]-1, idx[8]-1, &final_vertices_count, &final_indices_count, &out_vertices, &out_indices, &latest_used_vertices_index, &i_i, vertices, texcoords, normals, v_set_table);
+        c->corners_count = line_corners_count;
+        c->relatives_count = line_relatives_count;
+        mark_malformed(c);
       }
-      else
+    }
+  }
+}
+
+static int parse_chunk_thread(void* data)
+{
+  parse_chunk(data);
+  return 0;
+}
+
+/// decide number of chunks to parse `size` bytes with
+static int chunks_count_for(size_t size)
+{
+  size_t n = size / MIN_CHUNK_SIZE;
+  int cpus = SDL_GetCPUCount();
+
+  if (n > (size_t)cpus)
+    n = cpus;
+  if (n > MAX_CHUNKS)
+    n = MAX_CHUNKS;
+  return n < 1 ? 1 : (int)n;
+}
+
+int KRR_load_objfile(const char* filepath, VERTEXTEXNORM3D** dst_vertices, int* vertices_count, GLuint** dst_indices, int* indices_count)
+{
+  return KRR_load_objfile_ex(filepath, 0, dst_vertices, vertices_count, dst_indices, indices_count);
+}
+
+int KRR_load_objfile_ex(const char* filepath, int flags, VERTEXTEXNORM3D** dst_vertices, int* vertices_count, GLuint** dst_indices, int* indices_count)
+{
+  // have whole file in memory, then parse it in-place without copying any line
+  KRR_FILEMAP fm;
+  if (!KRR_FILEMAP_open(&fm, filepath))
+  {
+    KRR_LOGE("Cannot read .obj file");
+    return -1;
+  }
+
+  const char* data = fm.data;
+  const size_t size = fm.size;
+
+  // split file into chunks at line boundaries, each one is parsed independently
+  int chunks_count = chunks_count_for(size);
+  PARSE_CHUNK chunks[MAX_CHUNKS];
+  const char* begin = data;
+  for (int i=0; i<chunks_count; ++i)
+  {
+    const char* end = data + size;
+    if (i < chunks_count - 1)
+    {
+      end = data + size / chunks_count * (i + 1);
+      if (end < begin)
       {
-        KRR_LOGW("Warning: Failed attempt to read vertex data for 'f ' format");
+        end = begin;
       }
+      // extend to include the whole of last line
+      const char* eol = memchr(end, '\n', data + size - end);
+      end = eol != NULL ? eol + 1 : data + size;
+    }
+
+    parse_chunk_init(&chunks[i], begin, end);
+    begin = end;
+  }
+
+  // the first chunk is parsed on this thread, others on worker threads
+  SDL_Thread* threads[MAX_CHUNKS];
+  for (int i=1; i<chunks_count; ++i)
+  {
+    threads[i] = SDL_CreateThread(parse_chunk_thread, "objloader", &chunks[i]);
+    // fallback to parse it later on this thread
+    if (threads[i] == NULL)
+    {
+      KRR_LOGW("Warning: Cannot create thread to parse .obj file, %s", SDL_GetError());
+    }
+  }
+  parse_chunk(&chunks[0]);
+  for (int i=1; i<chunks_count; ++i)
+  {
+    if (threads[i] != NULL)
+    {
+      SDL_WaitThread(threads[i], NULL);
+    }
+    else
+    {
+      parse_chunk(&chunks[i]);
     }
   }
 
-#if KRR_TARGET_PLATFORM == KRR_PLATFORM_ANDROID
-  // close file
-  SDL_RWclose(file);
-  file = NULL;
-#else
-  // close file
-  fclose(file);
-  file = NULL;
-#endif
+  // done with file content
+  KRR_FILEMAP_close(&fm);
+
+  // prefix sum of element counts of preceding chunks
+  // they're offsets of each chunk's elements in the whole data
+  int bases[MAX_CHUNKS][3];
+  int corners_bases[MAX_CHUNKS];
+  int lines_base = 0;
+  int vertices_i = 0;
+  int texcoords_i = 0;
+  int normals_i = 0;
+  int corners_i = 0;
+  for (int i=0; i<chunks_count; ++i)
+  {
+    const PARSE_CHUNK* c = &chunks[i];
+    bases[i][0] = vertices_i;
+    bases[i][1] = texcoords_i;
+    bases[i][2] = normals_i;
+    corners_bases[i] = corners_i;
+
+    if (c->malformed_count > 0)
+    {
+      KRR_LOGW("Warning: Failed attempt to read %d line(s) of unsupported or malformed data, first at line %d", c->malformed_count, lines_base + c->first_malformed_line);
+    }
+
+    vertices_i += c->counts[0];
+    texcoords_i += c->counts[1];
+    normals_i += c->counts[2];
+    corners_i += c->corners_count;
+    lines_base += c->lines_count;
+  }
+
+  // merge all chunks into the first one
+  PARSE_CHUNK* whole = &chunks[0];
+  if (chunks_count > 1)
+  {
+    whole->vertices = realloc(whole->vertices, sizeof(VERTEXPOS3D) * vertices_i);
+    whole->texcoords = realloc(whole->texcoords, sizeof(TEXCOORD2D) * texcoords_i);
+    whole->normals = realloc(whole->normals, sizeof(NORMAL) * normals_i);
+    whole->corners = realloc(whole->corners, sizeof(int) * 3 * corners_i);
+
+    for (int i=1; i<chunks_count; ++i)
+    {
+      PARSE_CHUNK* c = &chunks[i];
+      memcpy(whole->vertices + bases[i][0], c->vertices, sizeof(VERTEXPOS3D) * c->counts[0]);
+      memcpy(whole->texcoords + bases[i][1], c->texcoords, sizeof(TEXCOORD2D) * c->counts[1]);
+      memcpy(whole->normals + bases[i][2], c->normals, sizeof(NORMAL) * c->counts[2]);
+
+      int* corners = whole->corners + corners_bases[i] * 3;
+      memcpy(corners, c->corners, sizeof(int) * 3 * c->corners_count);
+
+      // relative indices are resolved against chunk's own elements, offset them to the whole
+      for (int r=0; r<c->relatives_count; ++r)
+      {
+        int offset = c->relatives[r];
+        corners[offset] += bases[i][offset % 3];
+      }
+
+      parse_chunk_free(c);
+    }
+  }
+
+  VERTEXPOS3D* vertices = whole->vertices;
+  TEXCOORD2D* texcoords = whole->texcoords;
+  NORMAL* normals = whole->normals;
+  int* corners = whole->corners;
+
+  // make sure every corner refers to existing data before forming vertices
+  for (int i=0; i<corners_i; ++i)
+  {
+    const int* c = corners + i*3;
+    if (c[0] < 0 || c[0] >= vertices_i ||
+        c[1] < 0 || c[1] >= texcoords_i ||
+        c[2] < 0 || c[2] >= normals_i)
+    {
+      KRR_LOGE("Face refers to non-existing vertex data (v/vt/vn = %d/%d/%d)", c[0]+1, c[1]+1, c[2]+1);
+
+      parse_chunk_free(whole);
+      return -1;
+    }
+  }
+
+  // set number of elements for final vertices
+  // each position takes its own slot, duplicated vertex item (split) is appended after them in handle_f_v
+  int final_vertices_count = vertices_i;
+  int latest_used_vertices_index = final_vertices_count;
+  VERTEXTEXNORM3D* out_vertices = calloc(1, sizeof(VERTEXTEXNORM3D) * final_vertices_count);
+
+  // exact number of indices is known, support only for triangle-face
+  GLuint* out_indices = malloc(sizeof(GLuint) * corners_i);
+
+  // vt/vn pair (2 ints per position) of the first triple referencing such position, -1 if not yet referenced
+  // such triple takes the same slot as its position in final vertices, others are splits and get appended
+  int* primary_table = malloc(sizeof(int) * 2 * final_vertices_count);
+  memset(primary_table, -1, sizeof(int) * 2 * final_vertices_count);
+
+  // split v/vt/vn triple to final vertex index, it grows as splits are found
+  VHASH vhash;
+  vhash_init(&vhash, INITIAL_ELEM_COUNT);
+
+  // remap of texcoord and normal indices to their first element snapping to the same grid point
+  // only used with KRR_OBJLOADER_FLAG_MERGE_EPSILON, otherwise NULL
+  int* vt_remap = NULL;
+  int* vn_remap = NULL;
+  if (flags & KRR_OBJLOADER_FLAG_MERGE_EPSILON)
+  {
+    vt_remap = malloc(sizeof(int) * texcoords_i);
+    vn_remap = malloc(sizeof(int) * normals_i);
+    build_epsilon_remap(&texcoords[0].s, texcoords_i, 2, vt_remap);
+    build_epsilon_remap(&normals[0].x, normals_i, 3, vn_remap);
+  }
+
+  for (int i=0; i<corners_i; ++i)
+  {
+    const int* c = corners + i*3;
+    int vt_index = c[1];
+    int vn_index = c[2];
+    if (vt_remap != NULL)
+    {
+      vt_index = vt_remap[vt_index];
+      vn_index = vn_remap[vn_index];
+    }
+    out_indices[i] = handle_f_v(c[0], vt_index, vn_index, &out_vertices, &final_vertices_count, &latest_used_vertices_index, vertices, texcoords, normals, primary_table, &vhash);
+  }
 
   // free un-needed anymore vertex data
-  free(vertices);
+  parse_chunk_free(whole);
   vertices = NULL;
-  free(texcoords);
   texcoords = NULL;
-  free(normals);
   normals = NULL;
+  corners = NULL;
+
+  // free dedup states
+  free(primary_table);
+  primary_table = NULL;
+  vhash_free(&vhash);
+  free(vt_remap);
+  vt_remap = NULL;
+  free(vn_remap);
+  vn_remap = NULL;
+
+  // reorder for GPU, fetch optimization also drops unreferenced vertices
+  if (flags & (KRR_OBJLOADER_FLAG_OPTIMIZE | KRR_OBJLOADER_FLAG_OPTIMIZE_OVERDRAW))
+  {
+    KRR_MESHOPT_CACHESTATS before;
+    KRR_MESHOPT_CACHESTATS after;
+    KRR_MESHOPT_analyze_vertex_cache(out_indices, corners_i, latest_used_vertices_index, KRR_MESHOPT_CACHE_SIZE, &before);
 
-  // free dups table
-  free_dups(&v_set_table, static_vertices_count);
+    KRR_MESHOPT_optimize_vertex_cache(out_indices, corners_i, latest_used_vertices_index);
+    if (flags & KRR_OBJLOADER_FLAG_OPTIMIZE_OVERDRAW)
+    {
+      KRR_MESHOPT_optimize_overdraw(out_indices, corners_i, out_vertices, latest_used_vertices_index, KRR_MESHOPT_OVERDRAW_THRESHOLD);
+    }
+    latest_used_vertices_index = KRR_MESHOPT_optimize_vertex_fetch(out_vertices, latest_used_vertices_index, out_indices, corners_i);
+
+    KRR_MESHOPT_analyze_vertex_cache(out_indices, corners_i, latest_used_vertices_index, KRR_MESHOPT_CACHE_SIZE, &after);
+    KRR_LOGI("optimized for vertex cache (size %d): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", KRR_MESHOPT_CACHE_SIZE, before.acmr, after.acmr, before.atvr, after.atvr);
+  }
 
-  // shrink dowm memory of out_vertices, and out_indices
-  int total_real_vertices_count = static_vertices_count + (latest_used_vertices_index - static_vertices_count);
+  // shrink dowm memory of out_vertices
+  int total_real_vertices_count = latest_used_vertices_index;
   out_vertices = realloc(out_vertices, sizeof(VERTEXTEXNORM3D) * total_real_vertices_count);
-  out_indices = realloc(out_indices, sizeof(GLuint) * (i_i+1));
   KRR_LOGI("final shrink vertices output down to = %d", total_real_vertices_count);
 
-  KRR_LOGI("total vertices: %d, texcoords: %d, normals: %d, final vertices: %d, indices count: %d", vertices_i, texcoords_i, normals_i, total_real_vertices_count, i_i+1);
-  KRR_LOGI("calculated (as expanded) vertices count: %d, calculated indices count: %d", final_vertices_count, final_indices_count);
+  KRR_LOGI("total vertices: %d, texcoords: %d, normals: %d, final vertices: %d, indices count: %d", vertices_i, texcoords_i, normals_i, total_real_vertices_count, corners_i);
+  KRR_LOGI("calculated (as expanded) vertices count: %d", final_vertices_count);
 
   // set results
   if (dst_vertices != NULL)
@@ -302,185 +913,73 @@ int KRR_load_objfile(const char* filepath, VERTEXTEXNORM3D** dst_vertices, int*
   }
   if (indices_count != NULL)
   {
-    *indices_count = i_i+1;
+    *indices_count = corners_i;
   }
 
   return 0;
 }
 
+int handle_f_v(int v_index, int vt_index, int vn_index, VERTEXTEXNORM3D** out_vertices, int* final_vertices_count, int* latest_used_vertices_index, const VERTEXPOS3D* vertices, const TEXCOORD2D* texcoords, const NORMAL* normals, int* primary_table, VHASH* vhash)
+{
+  int* primary = primary_table + v_index*2;
 
+  // most positions are referenced by a single vt/vn pair, check against it first
+  // without touching vhash
+  if (primary[0] == vt_index && primary[1] == vn_index)
+  {
+    return v_index;
+  }
 
-void handle_f_v(int v_index, int vt_index, int vn_index, int* final_vertices_count, int* final_indices_count, VERTEXTEXNORM3D** out_vertices, GLuint** out_indices, int* latest_used_vertices_index, int* indices_index, VERTEXPOS3D* vertices, TEXCOORD2D* texcoords, NORMAL* normals, DUPS* dup_table)
-{
-  // get the pointer to vertices and indices to work with
-  VERTEXTEXNORM3D* out_vertices_v = *out_vertices;
-  GLuint* out_indices_v = *out_indices;
+  // first use of this position takes its own slot
+  if (primary[0] == -1)
+  {
+    primary[0] = vt_index;
+    primary[1] = vn_index;
+
+    VERTEXTEXNORM3D* dst = *out_vertices + v_index;
+    dst->position = vertices[v_index];
+    dst->texcoord = texcoords[vt_index];
+    dst->normal = normals[vn_index];
+    return v_index;
+  }
 
-  if (!dup_table[v_index].set)
+  // otherwise it's a split (i.e. uv seam)
+  // keep load factor of vhash at most 0.5
+  if ((vhash->count + 1) * 2 > vhash->capacity)
   {
-    out_vertices_v[v_index].position = vertices[v_index];
-    out_vertices_v[v_index].texcoord = texcoords[vt_index];
-    out_vertices_v[v_index].normal = normals[vn_index];
+    vhash_grow(vhash);
+  }
 
-    // expand memory space for indices (if need)
-    if (*indices_index >= *final_indices_count)
-    {
-      *final_indices_count = *final_indices_count + *final_indices_count * INCREASE_ELEM_FACTOR;
-      *out_indices = realloc(out_indices_v, sizeof(GLuint) * *final_indices_count);
-      // update out_indices_v pointer
-      out_indices_v = *out_indices;
-    }
-    // update indices
-    out_indices_v[*indices_index] = v_index;
-    *indices_index = *indices_index + 1;
+  VHASH_SLOT* s = vhash->slots + vhash_probe(vhash, v_index, vt_index, vn_index);
 
-    dup_table[v_index].set = true;
+  // seen this exact triple before, just reference it
+  if (s->v != VHASH_EMPTY)
+  {
+    return s->value;
   }
-  else
+
+  // append as a new vertex
+  // expand memory space for vertices (if need)
+  if (*latest_used_vertices_index >= *final_vertices_count)
   {
-    // early check against root if it matches or not
-    // so later we can skip checking aginst root
-    if (fabs(out_vertices_v[v_index].texcoord.s - texcoords[vt_index].s) < 1.0e-5 &&
-        fabs(out_vertices_v[v_index].texcoord.t - texcoords[vt_index].t) < 1.0e-5 &&
-        fabs(out_vertices_v[v_index].normal.x - normals[vn_index].x) < 1.0e-5 &&
-        fabs(out_vertices_v[v_index].normal.y - normals[vn_index].y) < 1.0e-5 &&
-        fabs(out_vertices_v[v_index].normal.z - normals[vn_index].z) < 1.0e-5)
-    {
-      // expand memory space for indices (if need)
-      if (*indices_index >= *final_indices_count)
-      {
-        *final_indices_count = *final_indices_count + *final_indices_count * INCREASE_ELEM_FACTOR;
-        *out_indices = realloc(out_indices_v, sizeof(GLuint) * *final_indices_count);
-        // update out_indices_v pointer
-        out_indices_v = *out_indices;
-      }
-      // update indices
-      out_indices_v[*indices_index] = v_index;
-      *indices_index = *indices_index + 1;
-    }
-    else
-    {
-      // if no duplicate, then add itself into the list
-      if (dup_table[v_index].dup == NULL)
-      {
-        // expand memory space for vertices (if need)
-        // note: always expand for the first time check
-        if (*latest_used_vertices_index >= *final_vertices_count)
-        {
-          // update vertices count
-          *final_vertices_count = *final_vertices_count + *final_vertices_count * INCREASE_ELEM_FACTOR;
-          *out_vertices = realloc(out_vertices_v, sizeof(VERTEXTEXNORM3D) * *final_vertices_count);
-          // update out_vertices_v pointer
-          out_vertices_v = *out_vertices;
-        }
+    *final_vertices_count = *final_vertices_count + *final_vertices_count * INCREASE_ELEM_FACTOR + 1;
+    *out_vertices = realloc(*out_vertices, sizeof(VERTEXTEXNORM3D) * *final_vertices_count);
+  }
 
-        // add into result vertices
-        out_vertices_v[*latest_used_vertices_index].position = vertices[v_index];
-        out_vertices_v[*latest_used_vertices_index].texcoord = texcoords[vt_index];
-        out_vertices_v[*latest_used_vertices_index].normal = normals[vn_index];
+  int final_index = *latest_used_vertices_index;
+  *latest_used_vertices_index = *latest_used_vertices_index + 1;
 
-        // expand memory space for indices (if need)
-        if (*indices_index >= *final_indices_count)
-        {
-          *final_indices_count = *final_indices_count + *final_indices_count * INCREASE_ELEM_FACTOR;
-          *out_indices = realloc(out_indices_v, sizeof(GLuint) * *final_indices_count);
-          // update out_indices_v pointer
-          out_indices_v = *out_indices;
-        }
-        // update indices
-        out_indices_v[*indices_index] = *latest_used_vertices_index;
-        *indices_index = *indices_index + 1;
-
-        // add into duplicate list
-        dup_table[v_index].dup = malloc(sizeof(DUP));
-        dup_table[v_index].dup->v = out_vertices_v[*latest_used_vertices_index];
-        dup_table[v_index].dup->idx = *latest_used_vertices_index;
-        dup_table[v_index].dup->next = NULL;
-
-        // update vertices index
-        *latest_used_vertices_index = *latest_used_vertices_index + 1;
-      }
-      // check against duplicate list
-      else
-      {
-        DUP* prev_dup = NULL;
-        DUP* dup = dup_table[v_index].dup;
-        bool unique = true;
+  VERTEXTEXNORM3D* dst = *out_vertices + final_index;
+  dst->position = vertices[v_index];
+  dst->texcoord = texcoords[vt_index];
+  dst->normal = normals[vn_index];
 
-        while ( dup != NULL)
-        {
-          VERTEXTEXNORM3D v = dup->v;
-          // check for duplicate to finish the job earlier
-          if (fabs(v.texcoord.s - texcoords[vt_index].s) < 1.0e-5 &&
-              fabs(v.texcoord.t - texcoords[vt_index].t) < 1.0e-5 &&
-              fabs(v.normal.x - normals[vn_index].x) < 1.0e-5 &&
-              fabs(v.normal.y - normals[vn_index].y) < 1.0e-5 &&
-              fabs(v.normal.z - normals[vn_index].z) < 1.0e-5)
-          {
-            unique = false;
-
-            // expand memory space for indices (if need)
-            if (*indices_index >= *final_indices_count)
-            {
-              *final_indices_count = *final_indices_count + *final_indices_count * INCREASE_ELEM_FACTOR;
-              *out_indices = realloc(out_indices_v, sizeof(GLuint) * *final_indices_count);
-              // update out_indices_v pointer
-              out_indices_v = *out_indices;
-            }
-            // update indices
-            out_indices_v[*indices_index] = dup->idx;
-            *indices_index = *indices_index + 1;
-            break;
-          }
-
-          // update previous pointer
-          prev_dup = dup;
-
-          // update dup pointer
-          dup = dup->next;
-        }
+  // add into vhash
+  s->v = v_index;
+  s->vt = vt_index;
+  s->vn = vn_index;
+  s->value = final_index;
+  ++vhash->count;
 
-        // if still unique, then add into final vertices & duplicate list
-        if (unique)
-        {
-          // expand memory space for vertices (if need)
-          // note: always expand for the first time check
-          if (*latest_used_vertices_index >= *final_vertices_count)
-          {
-            // update vertices count
-            *final_vertices_count = *final_vertices_count + *final_vertices_count * INCREASE_ELEM_FACTOR;
-            *out_vertices = realloc(out_vertices_v, sizeof(VERTEXTEXNORM3D) * *final_vertices_count);
-            // update out_vertices_v pointer
-            out_vertices_v = *out_vertices;
-          }
-
-          // add into result vertices
-          out_vertices_v[*latest_used_vertices_index].position = vertices[v_index];
-          out_vertices_v[*latest_used_vertices_index].texcoord = texcoords[vt_index];
-          out_vertices_v[*latest_used_vertices_index].normal = normals[vn_index];
-
-          // expand memory space for indices (if need)
-          if (*indices_index >= *final_indices_count)
-          {
-            *final_indices_count = *final_indices_count + *final_indices_count * INCREASE_ELEM_FACTOR;
-            *out_indices = realloc(out_indices_v, sizeof(GLuint) * *final_indices_count); 
-            // update out_indices_v pointer
-            out_indices_v = *out_indices;
-          }
-          // update indices
-          out_indices_v[*indices_index] = *latest_used_vertices_index;
-          *indices_index = *indices_index + 1;
-
-          // add into duplicate list
-          prev_dup->next = malloc(sizeof(DUP));
-          prev_dup->next->v = out_vertices_v[*latest_used_vertices_index];
-          prev_dup->next->idx = *latest_used_vertices_index;
-          prev_dup->next->next = NULL;
-
-          // update vertices index
-          *latest_used_vertices_index = *latest_used_vertices_index + 1;
-        }
-      }
-    }
-  }
+  return final_index;
 }
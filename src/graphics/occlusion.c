@@ -0,0 +1,272 @@
+#include "krr/graphics/occlusion.h"
+#include "krr/graphics/occlusion_shader.h"
+#include "krr/graphics/glstate.h"
+#include <stdlib.h>
+#include <string.h>
+
+// smallest extent of box, so flat mesh still has its box rasterized
+#define MIN_EXTENT 0.001f
+
+static const GLfloat cube_vertices[] = {
+  0.0f, 0.0f, 0.0f,
+  1.0f, 0.0f, 0.0f,
+  1.0f, 1.0f, 0.0f,
+  0.0f, 1.0f, 0.0f,
+  0.0f, 0.0f, 1.0f,
+  1.0f, 0.0f, 1.0f,
+  1.0f, 1.0f, 1.0f,
+  0.0f, 1.0f, 1.0f
+};
+
+// winding doesn't matter as face culling is disabled when rendering boxes
+static const GLubyte cube_indices[] = {
+  0, 1, 2,  2, 3, 0,
+  4, 5, 6,  6, 7, 4,
+  0, 4, 7,  7, 3, 0,
+  1, 5, 6,  6, 2, 1,
+  3, 2, 6,  6, 7, 3,
+  0, 1, 5,  5, 4, 0
+};
+
+KRR_OCCLUSION* KRR_OCCLUSION_new(int objects_count)
+{
+  KRR_OCCLUSION* out = malloc(sizeof(KRR_OCCLUSION));
+  out->enabled = true;
+  out->objects_count = objects_count;
+  out->objects = malloc(sizeof(KRR_OCCLUSION_OBJECT) * objects_count);
+  for (int i=0; i<objects_count; ++i)
+  {
+    KRR_OCCLUSION_OBJECT* o = &out->objects[i];
+    glGenQueries(KRR_OCCLUSION_FRAMES_IN_FLIGHT, o->query_ids);
+    memset(o->pending, 0, sizeof(o->pending));
+    o->visible = true;
+    o->queued_frame = -1;
+  }
+
+  out->box_matrices = malloc(sizeof(mat4) * objects_count);
+  out->box_objects = malloc(sizeof(int) * objects_count);
+  out->boxes_count = 0;
+  out->frame = 0;
+  memset(&out->stats, 0, sizeof(out->stats));
+
+  // unit cube, scaled and translated to bounding box via box matrix
+  glGenBuffers(1, &out->vbo_id);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, out->vbo_id);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_STATIC_DRAW);
+
+  KRR_GLSTATE_bind_vertex_array(0);
+  glGenBuffers(1, &out->ibo_id);
+  KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, out->ibo_id);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
+
+  glGenVertexArrays(1, &out->vao_id);
+  KRR_GLSTATE_bind_vertex_array(out->vao_id);
+    KRR_OCCLUSIONSHADERPROG_enable_attrib_pointers(shared_occlusion_shaderprogram);
+    KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, out->vbo_id);
+    KRR_OCCLUSIONSHADERPROG_set_vertex_pointer(shared_occlusion_shaderprogram, 3 * sizeof(GLfloat), NULL);
+    KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, out->ibo_id);
+  KRR_GLSTATE_bind_vertex_array(0);
+
+  return out;
+}
+
+void KRR_OCCLUSION_free(KRR_OCCLUSION* occ)
+{
+  for (int i=0; i<occ->objects_count; ++i)
+  {
+    glDeleteQueries(KRR_OCCLUSION_FRAMES_IN_FLIGHT, occ->objects[i].query_ids);
+  }
+  free(occ->objects);
+  occ->objects = NULL;
+  free(occ->box_matrices);
+  occ->box_matrices = NULL;
+  free(occ->box_objects);
+  occ->box_objects = NULL;
+
+  if (occ->vao_id != 0)
+  {
+    KRR_GLSTATE_delete_vertex_arrays(1, &occ->vao_id);
+    occ->vao_id = 0;
+  }
+  if (occ->vbo_id != 0)
+  {
+    KRR_GLSTATE_delete_buffers(1, &occ->vbo_id);
+    occ->vbo_id = 0;
+  }
+  if (occ->ibo_id != 0)
+  {
+    KRR_GLSTATE_delete_buffers(1, &occ->ibo_id);
+    occ->ibo_id = 0;
+  }
+
+  free(occ);
+  occ = NULL;
+}
+
+void KRR_OCCLUSION_begin_frame(KRR_OCCLUSION* occ)
+{
+  memset(&occ->stats, 0, sizeof(occ->stats));
+
+  // read from the oldest to the newest, so the newest available result wins
+  for (int i=0; i<occ->objects_count; ++i)
+  {
+    KRR_OCCLUSION_OBJECT* o = &occ->objects[i];
+    for (int age=KRR_OCCLUSION_FRAMES_IN_FLIGHT-1; age>=0; --age)
+    {
+      int slot = (occ->frame - age + KRR_OCCLUSION_FRAMES_IN_FLIGHT) % KRR_OCCLUSION_FRAMES_IN_FLIGHT;
+      if (!o->pending[slot])
+        continue;
+
+      GLuint available = GL_FALSE;
+      glGetQueryObjectuiv(o->query_ids[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+      if (available == GL_TRUE)
+      {
+        GLuint passed = GL_FALSE;
+        glGetQueryObjectuiv(o->query_ids[slot], GL_QUERY_RESULT, &passed);
+        o->visible = passed != GL_FALSE;
+        o->pending[slot] = false;
+        occ->stats.read++;
+      }
+    }
+  }
+
+  occ->frame++;
+  occ->boxes_count = 0;
+}
+
+/// whether any corner of unit cube transformed by box matrix is behind near plane
+static bool crosses_near_plane(mat4 box_matrix)
+{
+  for (int i=0; i<8; ++i)
+  {
+    vec4 corner = {cube_vertices[i*3], cube_vertices[i*3+1], cube_vertices[i*3+2], 1.0f};
+    vec4 clip;
+    glm_mat4_mulv(box_matrix, corner, clip);
+    if (clip[3] <= 0.0f || clip[2] < -clip[3])
+      return true;
+  }
+  return false;
+}
+
+void KRR_OCCLUSION_query(KRR_OCCLUSION* occ, int object, const KRR_CULL_BOUNDS* bounds, mat4 mvp)
+{
+  if (!occ->enabled)
+    return;
+
+  KRR_OCCLUSION_OBJECT* o = &occ->objects[object];
+  if (o->queued_frame == occ->frame)
+    return;
+
+  // just entered view, there's no recent result to rely on
+  // also drop results in flight which were queried before object left view
+  if (o->queued_frame < occ->frame - 1)
+  {
+    o->visible = true;
+    memset(o->pending, 0, sizeof(o->pending));
+  }
+  o->queued_frame = occ->frame;
+
+  // form box matrix
+  vec3 extent;
+  glm_vec3_sub((float*)bounds->aabb_max, (float*)bounds->aabb_min, extent);
+  for (int i=0; i<3; ++i)
+  {
+    if (extent[i] < MIN_EXTENT) extent[i] = MIN_EXTENT;
+  }
+  CGLM_ALIGN_MAT mat4 box_matrix;
+  glm_translate_to(mvp, (float*)bounds->aabb_min, box_matrix);
+  glm_scale(box_matrix, extent);
+
+  // rendering box from inside would be clipped away, it's visible anyway
+  if (crosses_near_plane(box_matrix))
+  {
+    o->visible = true;
+    return;
+  }
+
+  glm_mat4_copy(box_matrix, occ->box_matrices[occ->boxes_count]);
+  occ->box_objects[occ->boxes_count] = object;
+  occ->boxes_count++;
+}
+
+bool KRR_OCCLUSION_is_visible(KRR_OCCLUSION* occ, int object)
+{
+  if (!occ->enabled || occ->objects[object].visible)
+    return true;
+
+  occ->stats.skipped++;
+  return false;
+}
+
+int KRR_OCCLUSION_cull(KRR_OCCLUSION* occ, int first_object, const KRR_CULL_BOUNDS* bounds, mat4 view_projection, const void* transforms, size_t transforms_stride, int* indices, int count)
+{
+  int visible = 0;
+  CGLM_ALIGN_MAT mat4 mvp;
+  CGLM_ALIGN_MAT mat4 model;
+  for (int i=0; i<count; ++i)
+  {
+    const int index = indices[i];
+    memcpy(model, (const char*)transforms + index*transforms_stride, sizeof(mat4));
+    glm_mat4_mul(view_projection, model, mvp);
+
+    KRR_OCCLUSION_query(occ, first_object + index, bounds, mvp);
+    if (KRR_OCCLUSION_is_visible(occ, first_object + index))
+    {
+      indices[visible++] = index;
+    }
+  }
+  return visible;
+}
+
+void KRR_OCCLUSION_flush(KRR_OCCLUSION* occ)
+{
+  if (!occ->enabled || occ->boxes_count == 0)
+    return;
+
+  // boxes only test against depth buffer, they must not show up or occlude anything
+  const bool cull_face = KRR_GLSTATE_is_enabled(GL_CULL_FACE);
+  const bool depth_test = KRR_GLSTATE_is_enabled(GL_DEPTH_TEST);
+  KRR_GLSTATE_disable(GL_CULL_FACE);
+  KRR_GLSTATE_enable(GL_DEPTH_TEST);
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  glDepthMask(GL_FALSE);
+
+  KRR_OCCLUSIONSHADERPROG* shader = shared_occlusion_shaderprogram;
+  KRR_SHADERPROG_bind(shader->program);
+  KRR_GLSTATE_bind_vertex_array(occ->vao_id);
+
+  const int slot = occ->frame % KRR_OCCLUSION_FRAMES_IN_FLIGHT;
+  for (int i=0; i<occ->boxes_count; ++i)
+  {
+    KRR_OCCLUSION_OBJECT* o = &occ->objects[occ->box_objects[i]];
+    // previous query on this slot is still in flight for too long, skip rather than wait
+    if (o->pending[slot])
+      continue;
+
+    glm_mat4_copy(occ->box_matrices[i], shader->box_matrix);
+    KRR_OCCLUSIONSHADERPROG_update_box_matrix(shader);
+    KRR_SHADERPROG_flush(shader->program);
+
+    glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, o->query_ids[slot]);
+    glDrawElements(GL_TRIANGLES, sizeof(cube_indices), GL_UNSIGNED_BYTE, NULL);
+    glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+
+    o->pending[slot] = true;
+    occ->stats.issued++;
+  }
+
+  KRR_GLSTATE_bind_vertex_array(0);
+
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glDepthMask(GL_TRUE);
+  if (cull_face)
+  {
+    KRR_GLSTATE_enable(GL_CULL_FACE);
+  }
+  if (!depth_test)
+  {
+    KRR_GLSTATE_disable(GL_DEPTH_TEST);
+  }
+
+  occ->boxes_count = 0;
+}
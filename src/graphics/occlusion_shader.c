@@ -0,0 +1,135 @@
+#include "krr/graphics/occlusion_shader.h"
+#include <stdlib.h>
+#include <string.h>
+#include "krr/foundation/log.h"
+
+// this should be set once in user's program
+KRR_OCCLUSIONSHADERPROG* shared_occlusion_shaderprogram = NULL;
+
+KRR_OCCLUSIONSHADERPROG* KRR_OCCLUSIONSHADERPROG_new()
+{
+  KRR_OCCLUSIONSHADERPROG* out = malloc(sizeof(KRR_OCCLUSIONSHADERPROG));
+
+  // init defaults first
+  out->program = NULL;
+  out->vertex_pos3d_location = -1;
+  glm_mat4_identity(out->box_matrix);
+  out->box_matrix_location = -1;
+
+  // create underlying shader program
+  out->program = KRR_SHADERPROG_new();
+
+  return out;
+}
+
+void KRR_OCCLUSIONSHADERPROG_free(KRR_OCCLUSIONSHADERPROG* program)
+{
+  // free underlying shader program
+  KRR_SHADERPROG_free(program->program);
+
+  // free source
+  free(program);
+  program = NULL;
+}
+
+bool KRR_OCCLUSIONSHADERPROG_load_program(KRR_OCCLUSIONSHADERPROG* program)
+{
+  // get underlying shader program
+  KRR_SHADERPROG* uprog = program->program;
+
+  // generate program
+  uprog->program_id = glCreateProgram();
+
+  // load vertex shader
+  GLuint vertex_shader = KRR_SHADERPROG_load_shader_from_file("res/shaders/occlusion.vert", GL_VERTEX_SHADER);
+  // check errors
+  if (vertex_shader == -1)
+  {
+    glDeleteProgram(uprog->program_id);
+    uprog->program_id = 0;
+    return false;
+  }
+
+  // attach vertex shader
+  glAttachShader(uprog->program_id, vertex_shader);
+
+  // create fragment shader
+  GLuint fragment_shader = KRR_SHADERPROG_load_shader_from_file("res/shaders/occlusion.frag", GL_FRAGMENT_SHADER);
+  // check errors
+  if (fragment_shader == -1)
+  {
+    // delete vertex shader
+    glDeleteShader(vertex_shader);
+    vertex_shader = -1;
+
+    // delete program
+    glDeleteProgram(uprog->program_id);
+    uprog->program_id = 0;
+    return false;
+  }
+
+  // attach fragment shader
+  glAttachShader(uprog->program_id, fragment_shader);
+
+  // link program
+  glLinkProgram(uprog->program_id);
+  // check errors
+  GLint link_status = GL_FALSE;
+  glGetProgramiv(uprog->program_id, GL_LINK_STATUS, &link_status);
+  if (link_status != GL_TRUE)
+  {
+    KRR_LOGE("Link program error %d", uprog->program_id);
+    KRR_SHADERPROG_print_program_log(uprog->program_id);
+
+    // delete shaders
+    glDeleteShader(vertex_shader);
+    vertex_shader = -1;
+    glDeleteShader(fragment_shader);
+    fragment_shader = -1;
+    // delete program
+    glDeleteProgram(uprog->program_id);
+    uprog->program_id = 0;
+
+    return false;
+  }
+
+  // clean up
+  glDeleteShader(vertex_shader);
+  vertex_shader = -1;
+  glDeleteShader(fragment_shader);
+  fragment_shader = -1;
+
+  // get variable locations
+  program->box_matrix_location = glGetUniformLocation(uprog->program_id, "box_matrix");
+  if (program->box_matrix_location == -1)
+  {
+    KRR_LOGW("Warning: box_matrix is invalid glsl variable name");
+  }
+  program->vertex_pos3d_location = glGetAttribLocation(uprog->program_id, "vertex_pos3d");
+  if (program->vertex_pos3d_location == -1)
+  {
+    KRR_LOGW("Warning: vertex_pos3d is invalid glsl variable name");
+  }
+
+  return true;
+}
+
+void KRR_OCCLUSIONSHADERPROG_update_box_matrix(KRR_OCCLUSIONSHADERPROG* program)
+{
+  KRR_SHADERPROG_set_uniform(program->program, program->box_matrix_location, GL_FLOAT_MAT4, 1, program->box_matrix[0]);
+}
+
+void KRR_OCCLUSIONSHADERPROG_set_vertex_pointer(KRR_OCCLUSIONSHADERPROG* program, GLsizei stride, const GLvoid* data)
+{
+  glVertexAttribPointer(program->vertex_pos3d_location, 3, GL_FLOAT, GL_FALSE, stride, data);
+}
+
+void KRR_OCCLUSIONSHADERPROG_enable_attrib_pointers(KRR_OCCLUSIONSHADERPROG* program)
+{
+  glEnableVertexAttribArray(program->vertex_pos3d_location);
+}
+
+void KRR_OCCLUSIONSHADERPROG_disable_attrib_pointers(KRR_OCCLUSIONSHADERPROG* program)
+{
+  glDisableVertexAttribArray(program->vertex_pos3d_location);
+}
@@ -0,0 +1,315 @@
+#include "krr/graphics/renderqueue.h"
+#include "krr/graphics/glstate.h"
+#include "krr/foundation/log.h"
+#include <stdlib.h>
+#include <string.h>
+
+// layout of sort key from most significant bit
+//
+// opaque: | 0 | program 12 | texture 12 | vao 12 | depth 24 | unused 3 |
+// alpha:  | 1 | ~depth 24  | program 12 | texture 12 | vao 12 | unused 3 |
+//
+// GL names are truncated to 12 bits. They're small numbers in practice, and collision only
+// costs redundant bind, never wrong rendering as binding compares actual state.
+#define KEY_ID_BITS 12
+#define KEY_ID_MASK ((1u << KEY_ID_BITS) - 1)
+#define KEY_DEPTH_BITS 24
+#define KEY_DEPTH_MASK ((1u << KEY_DEPTH_BITS) - 1)
+
+#define INITIAL_CAPACITY 64
+
+// never a valid name, used to force binding on first packet
+#define UNKNOWN_STATE ((GLuint)-1)
+
+static void init_defaults(KRR_RENDERQUEUE* rq)
+{
+  memset(&rq->stats, 0, sizeof(rq->stats));
+  rq->packets = NULL;
+  rq->items = NULL;
+  rq->items_temp = NULL;
+  rq->count = 0;
+  rq->capacity = 0;
+}
+
+/// convert depth into 24-bit value keeping its order
+static uint32_t depth_bits(float depth)
+{
+  // also catch NaN
+  if (!(depth > 0.0f))
+  {
+    return 0;
+  }
+
+  // bit pattern of positive float is ordered the same as its value, keep only top 24 bits
+  // of exponent and mantissa as sign bit is always 0
+  uint32_t u;
+  memcpy(&u, &depth, sizeof(u));
+  return u >> (31 - KEY_DEPTH_BITS);
+}
+
+static uint64_t make_key(const KRR_RENDERQUEUE_PACKET* p)
+{
+  uint64_t program = (p->program != NULL ? p->program->program_id : 0) & KEY_ID_MASK;
+  uint64_t texture = p->textures[0] & KEY_ID_MASK;
+  uint64_t vao = p->vao_id & KEY_ID_MASK;
+  uint64_t depth = depth_bits(p->depth);
+
+  if (p->alpha)
+  {
+    // back-to-front
+    return (1ULL << 63) |
+      ((KEY_DEPTH_MASK - depth) << 39) |
+      (program << 27) |
+      (texture << 15) |
+      (vao << 3);
+  }
+  else
+  {
+    return (program << 51) |
+      (texture << 39) |
+      (vao << 27) |
+      (depth << 3);
+  }
+}
+
+/// stable LSD radix sort by 8 bits at a time, result is in rq->items
+static void sort_items(KRR_RENDERQUEUE* rq)
+{
+  KRR_RENDERQUEUE_ITEM* src = rq->items;
+  KRR_RENDERQUEUE_ITEM* dst = rq->items_temp;
+  const int n = rq->count;
+
+  for (int shift=0; shift<64; shift+=8)
+  {
+    int histogram[256];
+    memset(histogram, 0, sizeof(histogram));
+    for (int i=0; i<n; ++i)
+    {
+      ++histogram[(src[i].key >> shift) & 0xFF];
+    }
+
+    // skip pass if all keys have the same byte, it's common as most bits are shared
+    // by packets of the same state
+    if (histogram[(src[0].key >> shift) & 0xFF] == n)
+    {
+      continue;
+    }
+
+    // prefix sum into starting offset of each bucket
+    int offset = 0;
+    for (int b=0; b<256; ++b)
+    {
+      int c = histogram[b];
+      histogram[b] = offset;
+      offset += c;
+    }
+
+    for (int i=0; i<n; ++i)
+    {
+      dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+    }
+
+    KRR_RENDERQUEUE_ITEM* t = src;
+    src = dst;
+    dst = t;
+  }
+
+  // result ended up in scratch buffer, swap them
+  if (src != rq->items)
+  {
+    rq->items_temp = rq->items;
+    rq->items = src;
+  }
+}
+
+static bool grow(KRR_RENDERQUEUE* rq)
+{
+  int new_capacity = rq->capacity == 0 ? INITIAL_CAPACITY : rq->capacity * 2;
+
+  KRR_RENDERQUEUE_PACKET* packets = realloc(rq->packets, sizeof(KRR_RENDERQUEUE_PACKET) * new_capacity);
+  if (packets == NULL)
+  {
+    return false;
+  }
+  rq->packets = packets;
+
+  KRR_RENDERQUEUE_ITEM* items = realloc(rq->items, sizeof(KRR_RENDERQUEUE_ITEM) * new_capacity);
+  if (items == NULL)
+  {
+    return false;
+  }
+  rq->items = items;
+
+  // content of scratch buffer doesn't need to be kept
+  free(rq->items_temp);
+  rq->items_temp = malloc(sizeof(KRR_RENDERQUEUE_ITEM) * new_capacity);
+  if (rq->items_temp == NULL)
+  {
+    return false;
+  }
+
+  rq->capacity = new_capacity;
+  return true;
+}
+
+KRR_RENDERQUEUE* KRR_RENDERQUEUE_new(void)
+{
+  KRR_RENDERQUEUE* out = malloc(sizeof(KRR_RENDERQUEUE));
+  init_defaults(out);
+  return out;
+}
+
+void KRR_RENDERQUEUE_submit(KRR_RENDERQUEUE* rq, const KRR_RENDERQUEUE_PACKET* packet)
+{
+  if (rq->count == rq->capacity && !grow(rq))
+  {
+    KRR_LOGE("Cannot grow render queue, packet is dropped");
+    return;
+  }
+
+  rq->packets[rq->count] = *packet;
+  rq->items[rq->count].key = make_key(packet);
+  rq->items[rq->count].index = rq->count;
+  ++rq->count;
+}
+
+void KRR_RENDERQUEUE_flush(KRR_RENDERQUEUE* rq)
+{
+  KRR_RENDERQUEUE_STATS* stats = &rq->stats;
+  memset(stats, 0, sizeof(KRR_RENDERQUEUE_STATS));
+
+  if (rq->count == 0)
+  {
+    return;
+  }
+
+  sort_items(rq);
+
+  // program bound by user might still have uniforms pending, upload them before switching away
+  KRR_SHADERPROG_flush_bound();
+
+  // state as known by queue, we don't query GL for it as it might stall
+  GLuint current_program = UNKNOWN_STATE;
+  GLuint current_vao = UNKNOWN_STATE;
+  GLuint current_textures[KRR_RENDERQUEUE_MAX_TEXTURES];
+  for (int i=0; i<KRR_RENDERQUEUE_MAX_TEXTURES; ++i)
+  {
+    current_textures[i] = UNKNOWN_STATE;
+  }
+  int current_unit = -1;
+
+  for (int i=0; i<rq->count; ++i)
+  {
+    const KRR_RENDERQUEUE_PACKET* p = &rq->packets[rq->items[i].index];
+
+    // program
+    GLuint program_id = p->program != NULL ? p->program->program_id : 0;
+    if (program_id != current_program)
+    {
+      KRR_GLSTATE_use_program(program_id);
+      current_program = program_id;
+      ++stats->program_binds;
+    }
+    else
+    {
+      ++stats->program_binds_avoided;
+    }
+
+    // vao
+    if (p->vao_id != current_vao)
+    {
+      KRR_GLSTATE_bind_vertex_array(p->vao_id);
+      current_vao = p->vao_id;
+      ++stats->vao_binds;
+    }
+    else
+    {
+      ++stats->vao_binds_avoided;
+    }
+
+    // textures
+    for (int t=0; t<KRR_RENDERQUEUE_MAX_TEXTURES; ++t)
+    {
+      if (p->textures[t] == 0)
+      {
+        continue;
+      }
+
+      if (p->textures[t] != current_textures[t])
+      {
+        if (current_unit != t)
+        {
+          KRR_GLSTATE_active_texture(GL_TEXTURE0 + t);
+          current_unit = t;
+        }
+        KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, p->textures[t]);
+        current_textures[t] = p->textures[t];
+        ++stats->texture_binds;
+      }
+      else
+      {
+        ++stats->texture_binds_avoided;
+      }
+    }
+
+    if (p->apply_uniforms != NULL)
+    {
+      p->apply_uniforms(p->uniforms);
+    }
+    // only uniforms which changed from previous packet of the same program are uploaded
+    if (p->program != NULL)
+    {
+      KRR_SHADERPROG_flush(p->program);
+    }
+
+    // draw
+    if (p->index_type == 0)
+    {
+      if (p->instances_count > 0)
+      {
+        glDrawArraysInstanced(p->mode, (GLint)p->offset, p->count, p->instances_count);
+      }
+      else
+      {
+        glDrawArrays(p->mode, (GLint)p->offset, p->count);
+      }
+    }
+    else
+    {
+      if (p->instances_count > 0)
+      {
+        glDrawElementsInstanced(p->mode, p->count, p->index_type, (const GLvoid*)p->offset, p->instances_count);
+      }
+      else
+      {
+        glDrawElements(p->mode, p->count, p->index_type, (const GLvoid*)p->offset);
+      }
+    }
+    ++stats->draws;
+  }
+
+  // leave state as most of code expects
+  KRR_GLSTATE_bind_vertex_array(0);
+  if (current_unit > 0)
+  {
+    KRR_GLSTATE_active_texture(GL_TEXTURE0);
+  }
+
+  rq->count = 0;
+}
+
+void KRR_RENDERQUEUE_clear(KRR_RENDERQUEUE* rq)
+{
+  rq->count = 0;
+}
+
+void KRR_RENDERQUEUE_free(KRR_RENDERQUEUE* rq)
+{
+  free(rq->packets);
+  free(rq->items);
+  free(rq->items_temp);
+  init_defaults(rq);
+
+  free(rq);
+  rq = NULL;
+}
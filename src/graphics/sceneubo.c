@@ -0,0 +1,111 @@
+#include "krr/graphics/sceneubo.h"
+#include "krr/graphics/glstate.h"
+#include "krr/foundation/log.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void init_defaults(KRR_SCENEUBO* ubo)
+{
+  memset(&ubo->camera, 0, sizeof(ubo->camera));
+  glm_mat4_identity(ubo->camera.projection_matrix);
+  glm_mat4_identity(ubo->camera.view_matrix);
+  glm_vec4_copy((vec4){0.5f, 0.5f, 0.5f, 1.0f}, ubo->camera.sky_color);
+  ubo->camera.fog_density = 0.0055f;
+  ubo->camera.fog_gradient = 1.5f;
+
+  memset(&ubo->lights, 0, sizeof(ubo->lights));
+  for (int i=0; i<KRR_SHADERPROG_MAX_LIGHTS; ++i)
+  {
+    glm_vec4_copy((vec4){1.0f, 1.0f, 1.0f, 0.0f}, ubo->lights.color[i]);
+  }
+  glm_vec4_one(ubo->lights.ambient_color);
+
+  ubo->camera_buffer_id = 0;
+  ubo->lights_buffer_id = 0;
+}
+
+/// create buffer of size bytes with initial data, then bind it to binding point
+static GLuint create_buffer(GLuint binding, GLsizeiptr size, const GLvoid* data)
+{
+  GLuint id;
+  glGenBuffers(1, &id);
+  KRR_GLSTATE_bind_buffer(GL_UNIFORM_BUFFER, id);
+  glBufferData(GL_UNIFORM_BUFFER, size, data, GL_DYNAMIC_DRAW);
+  // also binds to generic binding point, that is the same as what we just bound above
+  glBindBufferBase(GL_UNIFORM_BUFFER, binding, id);
+  return id;
+}
+
+KRR_SCENEUBO* KRR_SCENEUBO_new(void)
+{
+  KRR_SCENEUBO* out = malloc(sizeof(KRR_SCENEUBO));
+  init_defaults(out);
+
+  out->camera_buffer_id = create_buffer(KRR_SCENEUBO_CAMERA_BINDING, sizeof(KRR_SCENEUBO_CAMERA), &out->camera);
+  out->lights_buffer_id = create_buffer(KRR_SCENEUBO_LIGHTS_BINDING, sizeof(KRR_SCENEUBO_LIGHTS), &out->lights);
+
+  return out;
+}
+
+void KRR_SCENEUBO_free(KRR_SCENEUBO* ubo)
+{
+  if (ubo->camera_buffer_id != 0)
+  {
+    KRR_GLSTATE_delete_buffers(1, &ubo->camera_buffer_id);
+    ubo->camera_buffer_id = 0;
+  }
+  if (ubo->lights_buffer_id != 0)
+  {
+    KRR_GLSTATE_delete_buffers(1, &ubo->lights_buffer_id);
+    ubo->lights_buffer_id = 0;
+  }
+
+  free(ubo);
+  ubo = NULL;
+}
+
+void KRR_SCENEUBO_update_camera(KRR_SCENEUBO* ubo)
+{
+  // compute once here rather than inverting view matrix for every vertex in shader
+  mat4 inv_view;
+  glm_mat4_inv(ubo->camera.view_matrix, inv_view);
+  glm_vec4_copy(inv_view[3], ubo->camera.camera_position);
+
+  KRR_GLSTATE_bind_buffer(GL_UNIFORM_BUFFER, ubo->camera_buffer_id);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(KRR_SCENEUBO_CAMERA), &ubo->camera);
+}
+
+void KRR_SCENEUBO_update_lights(KRR_SCENEUBO* ubo)
+{
+  KRR_GLSTATE_bind_buffer(GL_UNIFORM_BUFFER, ubo->lights_buffer_id);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(KRR_SCENEUBO_LIGHTS), &ubo->lights);
+}
+
+void KRR_SCENEUBO_set_light(KRR_SCENEUBO* ubo, int index, const LIGHT* light)
+{
+  glm_vec4_copy((vec4){light->pos.x, light->pos.y, light->pos.z, 1.0f}, ubo->lights.position[index]);
+  glm_vec4_copy((vec4){light->color.r, light->color.g, light->color.b, light->attenuation_factor}, ubo->lights.color[index]);
+}
+
+void KRR_SCENEUBO_bind_blocks(GLuint program_id)
+{
+  GLuint camera_index = glGetUniformBlockIndex(program_id, "camera_block");
+  if (camera_index == GL_INVALID_INDEX)
+  {
+    KRR_LOGW("Warning: camera_block is invalid glsl uniform block name");
+  }
+  else
+  {
+    glUniformBlockBinding(program_id, camera_index, KRR_SCENEUBO_CAMERA_BINDING);
+  }
+
+  GLuint lights_index = glGetUniformBlockIndex(program_id, "lights_block");
+  if (lights_index == GL_INVALID_INDEX)
+  {
+    KRR_LOGW("Warning: lights_block is invalid glsl uniform block name");
+  }
+  else
+  {
+    glUniformBlockBinding(program_id, lights_index, KRR_SCENEUBO_LIGHTS_BINDING);
+  }
+}
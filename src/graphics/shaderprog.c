@@ -1,4 +1,5 @@
 #include "krr/graphics/shaderprog.h"
+#include "krr/graphics/glstate.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,9 +10,18 @@
 #include "krr/graphics/shaderprog_internals.h"
 #include "krr/graphics/util.h"
 
+// program bound via KRR_SHADERPROG_bind(), its dirty uniforms are flushed before library draws
+static KRR_SHADERPROG* bound_program = NULL;
+
+static KRR_SHADERPROG_UNIFORM_STATS uniform_stats;
+
 void KRR_SHADERPROG_init_defaults(KRR_SHADERPROG* shader_program)
 {
   shader_program->program_id = 0;
+  shader_program->uniforms = NULL;
+  shader_program->uniforms_count = 0;
+  shader_program->uniforms_capacity = 0;
+  shader_program->dirty = false;
 }
 
 KRR_SHADERPROG* KRR_SHADERPROG_new(void)
@@ -112,23 +122,39 @@ void KRR_SHADERPROG_free_program(KRR_SHADERPROG* shader_program)
   // delete program
   glDeleteProgram(shader_program->program_id);
   shader_program->program_id = 0;
+
+  // cached uniforms belong to deleted program
+  for (int i=0; i<shader_program->uniforms_count; ++i)
+  {
+    free(shader_program->uniforms[i].large_value);
+  }
+  free(shader_program->uniforms);
+  shader_program->uniforms = NULL;
+  shader_program->uniforms_count = 0;
+  shader_program->uniforms_capacity = 0;
+  shader_program->dirty = false;
+  if (bound_program == shader_program)
+  {
+    bound_program = NULL;
+  }
 }
 
 bool KRR_SHADERPROG_bind(KRR_SHADERPROG* shader_program)
 {
-	// check whether we need to bind again
-	GLint current_bound;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &current_bound);
-
+	// check whether we need to bind again, answered from shadow state without querying GL
 	// if such program is already bound, then return now
-	if (current_bound == shader_program->program_id)
+	if (KRR_GLSTATE_current_program() == shader_program->program_id)
 	{
-		KRR_LOGE("Program is already bound, no need to bind again");
+		bound_program = shader_program;
+		KRR_SHADERPROG_flush(shader_program);
 		return true;
 	}
 
+  // previous program is still in use, upload what's left for it before switching
+  KRR_SHADERPROG_flush_bound();
+
   // use shader
-  glUseProgram(shader_program->program_id);
+  KRR_GLSTATE_use_program(shader_program->program_id);
 
   // check for error
   GLenum error = glGetError();
@@ -136,16 +162,184 @@ bool KRR_SHADERPROG_bind(KRR_SHADERPROG* shader_program)
   {
     KRR_util_print_callstack();
     KRR_LOGE("Error use program %u: %s", shader_program->program_id, KRR_gputil_error_string(error));
+    // program in use is not what shadow state thinks it is
+    KRR_GLSTATE_invalidate();
+    bound_program = NULL;
     return false;
   }
 
+  // upload uniforms set while program wasn't bound
+  bound_program = shader_program;
+  KRR_SHADERPROG_flush(shader_program);
+
   return true;
 }
 
 void KRR_SHADERPROG_unbind(KRR_SHADERPROG* shader_program)
 {
+  // upload what's left while program is still in use
+  if (KRR_GLSTATE_current_program() == shader_program->program_id)
+  {
+    KRR_SHADERPROG_flush(shader_program);
+  }
+  bound_program = NULL;
+
   // use default program
-  glUseProgram(0);
+  KRR_GLSTATE_use_program(0);
+}
+
+static int uniform_components(GLenum type)
+{
+  switch (type)
+  {
+    case GL_FLOAT:
+    case GL_INT:
+      return 1;
+    case GL_FLOAT_VEC2: return 2;
+    case GL_FLOAT_VEC3: return 3;
+    case GL_FLOAT_VEC4: return 4;
+    case GL_FLOAT_MAT4: return 16;
+    default: return 0;
+  }
+}
+
+/// get value of cached uniform, either within the entry or on heap
+static GLfloat* uniform_value(KRR_SHADERPROG_UNIFORM* u)
+{
+  return u->large_value != NULL ? u->large_value : u->value.f;
+}
+
+static void upload_uniform(GLint location, GLenum type, GLsizei count, const GLvoid* value)
+{
+  switch (type)
+  {
+    case GL_FLOAT: glUniform1fv(location, count, value); break;
+    case GL_FLOAT_VEC2: glUniform2fv(location, count, value); break;
+    case GL_FLOAT_VEC3: glUniform3fv(location, count, value); break;
+    case GL_FLOAT_VEC4: glUniform4fv(location, count, value); break;
+    case GL_FLOAT_MAT4: glUniformMatrix4fv(location, count, GL_FALSE, value); break;
+    case GL_INT: glUniform1iv(location, count, value); break;
+    default:
+      KRR_LOGW("Warning: unsupported uniform type 0x%x", type);
+      return;
+  }
+  ++uniform_stats.uploaded;
+}
+
+void KRR_SHADERPROG_set_uniform(KRR_SHADERPROG* shader_program, GLint location, GLenum type, GLsizei count, const GLvoid* value)
+{
+  if (location == -1)
+  {
+    return;
+  }
+
+  // both GLfloat and GLint are 4 bytes
+  size_t size = uniform_components(type) * count * sizeof(GLfloat);
+
+  KRR_SHADERPROG_UNIFORM* u = NULL;
+  for (int i=0; i<shader_program->uniforms_count; ++i)
+  {
+    if (shader_program->uniforms[i].location == location)
+    {
+      u = &shader_program->uniforms[i];
+      break;
+    }
+  }
+
+  if (u == NULL)
+  {
+    // grow cache rather than uploading right away, as program might not be in use
+    if (shader_program->uniforms_count == shader_program->uniforms_capacity)
+    {
+      int capacity = shader_program->uniforms_capacity == 0 ? KRR_SHADERPROG_INITIAL_UNIFORMS : shader_program->uniforms_capacity * 2;
+      KRR_SHADERPROG_UNIFORM* uniforms = realloc(shader_program->uniforms, sizeof(KRR_SHADERPROG_UNIFORM) * capacity);
+      if (uniforms == NULL)
+      {
+        KRR_LOGE("Cannot allocate cache of %d uniforms, uniform at location %d is not set", capacity, location);
+        return;
+      }
+      shader_program->uniforms = uniforms;
+      shader_program->uniforms_capacity = capacity;
+    }
+    u = &shader_program->uniforms[shader_program->uniforms_count++];
+    u->location = location;
+    u->type = GL_NONE;
+    u->count = 0;
+    u->dirty = false;
+    u->large_value = NULL;
+  }
+  else if (u->type == type && u->count == count && memcmp(uniform_value(u), value, size) == 0)
+  {
+    ++uniform_stats.skipped;
+    return;
+  }
+
+  // reallocate value on heap whenever its size changes
+  if (size > sizeof(u->value) && (u->large_value == NULL || uniform_components(u->type) * u->count * sizeof(GLfloat) != size))
+  {
+    GLfloat* large_value = malloc(size);
+    if (large_value == NULL)
+    {
+      KRR_LOGE("Cannot allocate %d bytes for uniform at location %d, it is not set", (int)size, location);
+      // drop entry just appended, it has no value yet
+      if (u->type == GL_NONE)
+      {
+        shader_program->uniforms_count--;
+      }
+      return;
+    }
+    free(u->large_value);
+    u->large_value = large_value;
+  }
+  else if (size <= sizeof(u->value) && u->large_value != NULL)
+  {
+    free(u->large_value);
+    u->large_value = NULL;
+  }
+
+  u->type = type;
+  u->count = count;
+  memcpy(uniform_value(u), value, size);
+  u->dirty = true;
+  shader_program->dirty = true;
+}
+
+void KRR_SHADERPROG_flush(KRR_SHADERPROG* shader_program)
+{
+  if (!shader_program->dirty)
+  {
+    return;
+  }
+
+  for (int i=0; i<shader_program->uniforms_count; ++i)
+  {
+    KRR_SHADERPROG_UNIFORM* u = &shader_program->uniforms[i];
+    if (u->dirty)
+    {
+      upload_uniform(u->location, u->type, u->count, uniform_value(u));
+      u->dirty = false;
+    }
+  }
+  shader_program->dirty = false;
+}
+
+void KRR_SHADERPROG_flush_bound(void)
+{
+  // program might have been changed without going through KRR_SHADERPROG_bind()
+  if (bound_program != NULL && bound_program->program_id == KRR_GLSTATE_current_program())
+  {
+    KRR_SHADERPROG_flush(bound_program);
+  }
+}
+
+const KRR_SHADERPROG_UNIFORM_STATS* KRR_SHADERPROG_get_uniform_stats(void)
+{
+  return &uniform_stats;
+}
+
+void KRR_SHADERPROG_reset_uniform_stats(void)
+{
+  memset(&uniform_stats, 0, sizeof(uniform_stats));
 }
 
 void KRR_SHADERPROG_print_program_log(GLuint program_id)
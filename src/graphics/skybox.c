@@ -1,4 +1,5 @@
 #include "krr/graphics/skybox.h"
+#include "krr/graphics/glstate.h"
 #include "krr/graphics/util.h"
 #include "krr/graphics/skybox_shader.h"
 #include <stdlib.h>
@@ -73,39 +74,39 @@ bool KRR_SKYBOX_load(KRR_SKYBOX* sb, const char* right, const char* left, const
 
   // create vbo
   glGenBuffers(1, &sb->vbo_id);
-  glBindBuffer(GL_ARRAY_BUFFER, sb->vbo_id);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, sb->vbo_id);
   glBufferData(GL_ARRAY_BUFFER, 3 * NUM_VERTS * sizeof(float), &vertices, GL_STATIC_DRAW);
 
   // load cubemap
   sb->cubemap_id = KRR_gputil_load_cubemap(right, left, top, bottom, back, front);
   if (sb->cubemap_id == -1)
   {
-    glDeleteBuffers(1, &sb->vbo_id);
+    KRR_GLSTATE_delete_buffers(1, &sb->vbo_id);
     sb->vbo_id = 0;
     return false;
   }
 
   // vao
   glGenVertexArrays(1, &sb->vao_id);
-  glBindVertexArray(sb->vao_id);
+  KRR_GLSTATE_bind_vertex_array(sb->vao_id);
 
     // enable vertex attributes
     // as all models use the same shader, we operate on shared shader here
     KRR_SKYBOXSHADERPROG_enable_attrib_pointers(shared_skybox_shaderprogram);
 
     // set vertex data
-    glBindBuffer(GL_ARRAY_BUFFER, sb->vbo_id);
+    KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, sb->vbo_id);
     // set to 0, as it's tightly packed together
     KRR_SKYBOXSHADERPROG_set_vertex_pointer(shared_skybox_shaderprogram, 0, 0);
 
     // bind cubemap
-    glBindTexture(GL_TEXTURE_CUBE_MAP, sb->cubemap_id);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_CUBE_MAP, sb->cubemap_id);
     // set texture parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
   // unbind vao
-  glBindVertexArray(0);
+  KRR_GLSTATE_bind_vertex_array(0);
 
   return true;
 }
@@ -114,17 +115,17 @@ void KRR_SKYBOX_free_internals(KRR_SKYBOX* sb)
 {
   if (sb->vbo_id != 0)
   {
-    glDeleteBuffers(1, &sb->vbo_id);
+    KRR_GLSTATE_delete_buffers(1, &sb->vbo_id);
     sb->vbo_id = 0;
   }
   if (sb->vao_id != 0)
   {
-    glDeleteBuffers(1, &sb->vao_id);
+    KRR_GLSTATE_delete_vertex_arrays(1, &sb->vao_id);
     sb->vao_id = 0;
   }
   if (sb->cubemap_id != 0)
   {
-    glDeleteTextures(1, &sb->cubemap_id);
+    KRR_GLSTATE_delete_textures(1, &sb->cubemap_id);
     sb->cubemap_id = 0;
   }
 }
@@ -134,6 +135,7 @@ void KRR_SKYBOX_render(KRR_SKYBOX* sb)
   // set to less than or equal to be able to render on deepest depth value or empty pixel
   // as default depth value is 1.0f
   glDepthFunc(GL_LEQUAL);
+  KRR_SHADERPROG_flush_bound();
   glDrawArrays(GL_TRIANGLES, 0, NUM_VERTS);
   // set depth function back to normal
   glDepthFunc(GL_LESS);
@@ -144,7 +144,7 @@ bool KRR_SKYBOXSHADERPROG_load_program(KRR_SKYBOXSHADERPROG* program)
 
 void KRR_SKYBOXSHADERPROG_update_projection_matrix(KRR_SKYBOXSHADERPROG* program)
 {
-  glUniformMatrix4fv(program->projection_matrix_location, 1, GL_FALSE, program->projection_matrix[0]);
+  KRR_SHADERPROG_set_uniform(program->program, program->projection_matrix_location, GL_FLOAT_MAT4, 1, program->projection_matrix[0]);
 }
 
 void KRR_SKYBOXSHADERPROG_update_view_matrix(KRR_SKYBOXSHADERPROG* program)
@@ -154,7 +154,7 @@ void KRR_SKYBOXSHADERPROG_update_view_matrix(KRR_SKYBOXSHADERPROG* program)
   program->view_matrix[3][0] = 0.0f;
   program->view_matrix[3][1] = 0.0f;
   program->view_matrix[3][2] = 0.0f;
-  glUniformMatrix4fv(program->view_matrix_location, 1, GL_FALSE, program->view_matrix[0]);
+  KRR_SHADERPROG_set_uniform(program->program, program->view_matrix_location, GL_FLOAT_MAT4, 1, program->view_matrix[0]);
 }
 
 void KRR_SKYBOXSHADERPROG_set_vertex_pointer(KRR_SKYBOXSHADERPROG* program, GLsizei stride, const GLvoid* data)
@@ -164,17 +164,18 @@ void KRR_SKYBOXSHADERPROG_set_vertex_pointer(KRR_SKYBOXSHADERPROG* program, GLsi
 
 void KRR_SKYBOXSHADERPROG_set_cubemap_sampler(KRR_SKYBOXSHADERPROG* program, GLuint sampler)
 {
-  glUniform1i(program->cubemap_sampler_location, sampler);
+  GLint unit = sampler;
+  KRR_SHADERPROG_set_uniform(program->program, program->cubemap_sampler_location, GL_INT, 1, &unit);
 }
 
 void KRR_SKYBOXSHADERPROG_update_fog_color(KRR_SKYBOXSHADERPROG* program)
 {
-  glUniform3fv(program->fog_color_location, 1, program->fog_color);
+  KRR_SHADERPROG_set_uniform(program->program, program->fog_color_location, GL_FLOAT_VEC3, 1, program->fog_color);
 }
 
 void KRR_SKYBOXSHADERPROG_update_ctrans_limits(KRR_SKYBOXSHADERPROG* program)
 {
-  glUniform2fv(program->ctrans_limits_location, 1, program->ctrans_limits);
+  KRR_SHADERPROG_set_uniform(program->program, program->ctrans_limits_location, GL_FLOAT_VEC2, 1, program->ctrans_limits);
 }
 
 void KRR_SKYBOXSHADERPROG_enable_attrib_pointers(KRR_SKYBOXSHADERPROG* program)
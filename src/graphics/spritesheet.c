@@ -1,4 +1,5 @@
 #include "krr/graphics/spritesheet.h"
+#include "krr/graphics/glstate.h"
 #include <stdlib.h>
 #include <stdlib.h>
 #include <stddef.h>
@@ -15,6 +16,7 @@ void init_defaults(KRR_SPRITESHEET* spritesheet)
   spritesheet->clips = NULL;
   spritesheet->vertex_data_buffer = 0;
   spritesheet->index_buffers = NULL;
+  spritesheet->index_type = GL_UNSIGNED_INT;
   spritesheet->vao = 0;
 }
 
@@ -100,6 +102,9 @@ bool KRR_SPRITESHEET_generate_databuffer(KRR_SPRITESHEET* spritesheet)
     GLfloat texture_pheight = spritesheet->ltexture->physical_height_;
     GLuint sprite_indices[4] = {0, 0, 0, 0};
 
+    // 16-bit indices are enough unless there are more than 16384 sprites
+    spritesheet->index_type = KRR_gputil_index_type_for(total_sprites * 4);
+
     for (int i=0; i<total_sprites; i++)
     {
       // initialize indices
@@ -147,9 +152,12 @@ bool KRR_SPRITESHEET_generate_databuffer(KRR_SPRITESHEET* spritesheet)
       vertex_data[sprite_indices[3]].texcoord.s = tex_right;
       vertex_data[sprite_indices[3]].texcoord.t = tex_top;
 
+      // narrow indices in-place, they're not used anymore after this for current sprite
+      KRR_gputil_narrow_indices(sprite_indices, 4, spritesheet->index_type);
+
       // bind sprite index buffer data
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, spritesheet->index_buffers[i]);
-      glBufferData(GL_ELEMENT_ARRAY_BUFFER, 4 * sizeof(GLuint), sprite_indices, GL_STATIC_DRAW);
+      KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, spritesheet->index_buffers[i]);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, 4 * KRR_gputil_index_size(spritesheet->index_type), sprite_indices, GL_STATIC_DRAW);
 
 			GLenum error = glGetError();
 			if (error != GL_NO_ERROR)
@@ -160,17 +168,17 @@ bool KRR_SPRITESHEET_generate_databuffer(KRR_SPRITESHEET* spritesheet)
     }
 
     // bind vertex data
-    glBindBuffer(GL_ARRAY_BUFFER, spritesheet->vertex_data_buffer);
+    KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, spritesheet->vertex_data_buffer);
     glBufferData(GL_ARRAY_BUFFER, total_sprites * 4 * sizeof(VERTEXTEX2D), vertex_data, GL_STATIC_DRAW);
 
     // set up binding process for vao
-    glBindVertexArray(spritesheet->vao);
+    KRR_GLSTATE_bind_vertex_array(spritesheet->vao);
 
       // enable all attribute pointers
       KRR_TEXSHADERPROG2D_enable_attrib_pointers(shared_textured_shaderprogram);
 
       // bind vertex data
-      glBindBuffer(GL_ARRAY_BUFFER, spritesheet->vertex_data_buffer);
+      KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, spritesheet->vertex_data_buffer);
 
       // set texture coordinate attrib pointer
       KRR_TEXSHADERPROG2D_set_vertex_pointer(shared_textured_shaderprogram, sizeof(VERTEXTEX2D), (GLvoid*)offsetof(VERTEXTEX2D, texcoord));
@@ -178,7 +186,7 @@ bool KRR_SPRITESHEET_generate_databuffer(KRR_SPRITESHEET* spritesheet)
       KRR_TEXSHADERPROG2D_set_texcoord_pointer(shared_textured_shaderprogram, sizeof(VERTEXTEX2D), (GLvoid*)offsetof(VERTEXTEX2D, position));
 
     // unbind vao
-    glBindVertexArray(0);
+    KRR_GLSTATE_bind_vertex_array(0);
 
 		GLenum error = glGetError();
 		if (error != GL_NO_ERROR)
@@ -210,14 +218,14 @@ void KRR_SPRITESHEET_free_sheet(KRR_SPRITESHEET* spritesheet)
   // delete vertex buffer
   if (spritesheet->vertex_data_buffer != 0)
   {
-    glDeleteBuffers(1, &spritesheet->vertex_data_buffer);
+    KRR_GLSTATE_delete_buffers(1, &spritesheet->vertex_data_buffer);
     spritesheet->vertex_data_buffer = 0;
   }
 
   // delete index buffer
   if (spritesheet->index_buffers != NULL)
   {
-    glDeleteBuffers(spritesheet->clips->len, spritesheet->index_buffers);
+    KRR_GLSTATE_delete_buffers(spritesheet->clips->len, spritesheet->index_buffers);
     // since we dynamically allocate for index buffers, we free them here
     free(spritesheet->index_buffers);
     spritesheet->index_buffers = NULL;
@@ -226,7 +234,7 @@ void KRR_SPRITESHEET_free_sheet(KRR_SPRITESHEET* spritesheet)
   // delete vao
   if (spritesheet->vao != 0)
   {
-    glDeleteVertexArrays(1, &spritesheet->vao);
+    KRR_GLSTATE_delete_vertex_arrays(1, &spritesheet->vao);
     spritesheet->vao = 0;
   }
 
@@ -237,10 +245,10 @@ void KRR_SPRITESHEET_free_sheet(KRR_SPRITESHEET* spritesheet)
 void KRR_SPRITESHET_bind_vao(KRR_SPRITESHEET* spritesheet)
 {
   // bind vao
-  glBindVertexArray(spritesheet->vao);
+  KRR_GLSTATE_bind_vertex_array(spritesheet->vao);
 
   // bind texture
-  glBindTexture(GL_TEXTURE_2D, spritesheet->ltexture->texture_id);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, spritesheet->ltexture->texture_id);
 }
 
 void KRR_SPRITESHEET_render_sprite(KRR_SPRITESHEET* spritesheet, int index, GLfloat x, GLfloat y)
@@ -251,12 +259,13 @@ void KRR_SPRITESHEET_render_sprite(KRR_SPRITESHEET* spritesheet, int index, GLfl
   KRR_TEXSHADERPROG2D_update_view_matrix(shared_textured_shaderprogram);
 
   // bind index buffer
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, spritesheet->index_buffers[index]);
+  KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, spritesheet->index_buffers[index]);
   // draw using data from vertex and index buffer
-  glDrawElements(GL_TRIANGLE_FAN, 4, GL_UNSIGNED_INT, NULL);
+  KRR_SHADERPROG_flush(shared_textured_shaderprogram->program);
+  glDrawElements(GL_TRIANGLE_FAN, 4, spritesheet->index_type, NULL);
 }
 
 void KRR_SPRITESHEET_unbind_vao(KRR_SPRITESHEET* spritesheet)
 {
-  glBindVertexArray(0);
+  KRR_GLSTATE_bind_vertex_array(0);
 }
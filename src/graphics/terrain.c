@@ -1,14 +1,198 @@
 #include "krr/graphics/terrain.h"
+#include "krr/graphics/glstate.h"
 #include "krr/graphics/terrain_shader3d.h"
+#include "krr/graphics/heightmap.h"
+#include "krr/graphics/meshcache.h"
+#include "krr/graphics/meshopt.h"
 #include "krr/graphics/objloader.h"
-#include "krr/graphics/texture.h"
+#include "krr/graphics/terraintiles.h"
+#include "krr/graphics/util.h"
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
 #include "krr/foundation/log.h"
 #include "krr/foundation/mem.h"
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_cpuinfo.h>
+#include <SDL2/SDL_error.h>
+#include <SDL2/SDL_mutex.h>
 
 #define MIN_TERRAIN_HEIGHT -50
 #define MAX_TERRAIN_HEIGHT 100
 
+#define CHUNK_CELLS KRR_TERRAIN_CHUNK_CELLS
+// vertices along each side of a chunk
+#define CHUNK_STRIDE (CHUNK_CELLS + 1)
+// grid vertices of a chunk come first, then one skirt vertex for each vertex along its perimeter
+#define CHUNK_PERIMETER (CHUNK_CELLS * 4)
+#define CHUNK_VERTICES (CHUNK_STRIDE * CHUNK_STRIDE + CHUNK_PERIMETER)
+
+// index ending a triangle strip, only while GL_PRIMITIVE_RESTART_FIXED_INDEX is enabled as it's off by default
+#define STRIP_RESTART_INDEX 0xFFFF
+
+// minimum number of rows of grid vertices worth generating by an additional thread
+#define MIN_GENERATE_BAND_ROWS 64
+// upper limit of number of threads generating terrain
+#define MAX_GENERATE_BANDS 16
+
+// number of points processed at once by KRR_TERRAIN_query()
+#define QUERY_BATCH_SIZE 64
+
+// upper limit of vertices uploaded at once when updating terrain, either a row of chunk or its skirts
+#define UPDATE_MAX_VERTICES CHUNK_PERIMETER
+// extra range of quantization added on each side when heights go beyond it, in fraction of range
+#define QUANTIZATION_HEADROOM 0.25f
+
+// tolerance in barycentric coordinates when ray is tested against triangles of terrain
+#define RAYCAST_EDGE_EPSILON 1e-5f
+// nodes pending to visit by ray, each visited node adds at most 3 more
+#define RAYCAST_STACK_SIZE (KRR_TERRAIN_MINMAX_LEVELS * 3 + 1)
+
+// upper limit of number of threads meshing tiles of paged terrain
+#define MAX_PAGE_WORKERS 4
+// tiles being meshed or waiting to be uploaded at once, per worker thread
+#define PAGE_STAGINGS_PER_WORKER 2
+
+// vertex of grid patch shared by all chunks of heightfield terrain
+typedef struct
+{
+  // in cells relative to patch
+  GLubyte x;
+  GLubyte z;
+  // 1 for skirt vertex, otherwise 0
+  GLubyte skirt;
+  GLubyte pad;
+} GRIDVERTEX;
+
+// per-instance data of heightfield patch, origin in cells then skirt depth
+#define PATCH_FLOATS 3
+
+// resident tile of paged terrain, occupying a slot of CHUNK_VERTICES vertices in vbo
+typedef struct
+{
+  // tile index, or -1 if slot is free
+  int tile;
+  // index of its chunk in `chunks` of terrain
+  int chunk;
+  // update count when tile was wanted the last time
+  unsigned int last_used;
+  // vao whose vertex attributes start at this slot
+  GLuint vao_id;
+} TERRAIN_PAGE;
+
+typedef enum
+{
+  STAGING_FREE,
+  STAGING_QUEUED,
+  STAGING_MESHING,
+  STAGING_READY
+} STAGING_STATE;
+
+// tile meshed by worker thread to be uploaded
+typedef struct
+{
+  int tile;
+  STAGING_STATE state;
+  TERRAIN_CHUNK chunk;
+  VERTEXTEXNORM3D* vertices;
+} TERRAIN_STAGING;
+
+// worker thread meshing queued tiles, each reads tiles through its own reader
+typedef struct
+{
+  TERRAIN_PAGING* pg;
+  SDL_Thread* thread;
+  KRR_TERRAINTILES_READER reader;
+} TERRAIN_PAGE_WORKER;
+
+struct TERRAIN_PAGING
+{
+  KRR_TERRAINTILES tiles;
+  // reader for meshing tiles on calling thread when there's no worker thread
+  KRR_TERRAINTILES_READER reader;
+  // conversion of tile samples into heights, as of KRR_TERRAIN_generate()
+  float height_scale;
+  float height_offset;
+  float size;
+  float hfactor;
+
+  TERRAIN_PAGE* pages;
+  int pages_count;
+  // page of each resident chunk
+  int* chunk_pages;
+  // open addressing hash table from tile index to its page, -1 for empty entry
+  int* table;
+  int table_mask;
+  unsigned int updates;
+
+  // state of stagings is guarded by `mutex`, worker threads wait on `cond` for queued ones
+  TERRAIN_STAGING* stagings;
+  int stagings_count;
+  SDL_mutex* mutex;
+  SDL_cond* cond;
+  TERRAIN_PAGE_WORKER workers[MAX_PAGE_WORKERS];
+  int workers_count;
+  bool quit;
+};
+
+/// stop worker threads then free all paging state, GL objects of resident chunks included
+static void free_paging(TERRAIN* tr)
+{
+  TERRAIN_PAGING* pg = tr->paging;
+  if (pg == NULL)
+    return;
+
+  SDL_LockMutex(pg->mutex);
+  pg->quit = true;
+  SDL_CondBroadcast(pg->cond);
+  SDL_UnlockMutex(pg->mutex);
+  for (int i=0; i<pg->workers_count; ++i)
+  {
+    SDL_WaitThread(pg->workers[i].thread, NULL);
+    KRR_TERRAINTILES_reader_close(&pg->workers[i].reader);
+  }
+  SDL_DestroyCond(pg->cond);
+  SDL_DestroyMutex(pg->mutex);
+
+  for (int i=0; i<pg->stagings_count; ++i)
+  {
+    free(pg->stagings[i].vertices);
+  }
+  free(pg->stagings);
+
+  // chunks share vao of their page
+  for (int i=0; i<pg->pages_count; ++i)
+  {
+    if (pg->pages[i].vao_id != 0)
+    {
+      KRR_GLSTATE_delete_vertex_arrays(1, &pg->pages[i].vao_id);
+    }
+  }
+  for (int i=0; i<tr->chunks_count; ++i)
+  {
+    tr->chunks[i].vao_id = 0;
+  }
+  tr->vao_id = 0;
+
+  free(pg->pages);
+  free(pg->chunk_pages);
+  free(pg->table);
+  KRR_TERRAINTILES_reader_close(&pg->reader);
+  KRR_TERRAINTILES_close(&pg->tiles);
+
+  free(pg);
+  tr->paging = NULL;
+}
+
+static void reset_dequant(TERRAIN* tr)
+{
+  tr->dequant.position_offset = (VERTEXPOS3D){0.0f, 0.0f, 0.0f};
+  tr->dequant.position_scale = (VERTEXPOS3D){1.0f, 1.0f, 1.0f};
+  tr->dequant.texcoord_offset = (TEXCOORD2D){0.0f, 0.0f};
+  tr->dequant.texcoord_scale = (TEXCOORD2D){1.0f, 1.0f};
+}
+
 static void init_defaults(TERRAIN* tr)
 {
   tr->vertices = NULL;
@@ -16,13 +200,48 @@ static void init_defaults(TERRAIN* tr)
 
   tr->indices = NULL;
   tr->indices_count = 0;
+  tr->index_type = GL_UNSIGNED_INT;
+
+  tr->chunks = NULL;
+  tr->chunks_count = 0;
+  memset(tr->lod_indices_offset, 0, sizeof(tr->lod_indices_offset));
+  memset(tr->lod_indices_count, 0, sizeof(tr->lod_indices_count));
+  tr->lod_indices_mode = GL_TRIANGLES;
+  tr->strips = false;
+
+  tr->max_pixel_error = 2.0f;
+  tr->rendered_chunks = 0;
+  tr->rendered_triangles = 0;
+
+  tr->packed = false;
+  reset_dequant(tr);
+  memset(&tr->bounds, 0, sizeof(tr->bounds));
+
+  tr->heightfield = false;
+  tr->heightfield_normalmap = false;
+  memset(&tr->heightfield_params, 0, sizeof(tr->heightfield_params));
+  tr->heightmap_texture_id = 0;
+  tr->normalmap_texture_id = 0;
+  tr->patches_vbo_id = 0;
+  tr->patches = NULL;
 
   tr->grid_width = 0;
   tr->grid_height = 0;
   
+  tr->cell_size = 0.0f;
+  tr->height_factor = 0.0f;
   tr->heights = NULL;
   tr->normals = NULL;
 
+  tr->page_radius = 6;
+  tr->page_capacity = 0;
+  tr->page_uploads_per_update = 4;
+  tr->paging = NULL;
+
+  tr->minmax_tree = NULL;
+  tr->minmax_levels = 0;
+  memset(tr->minmax_level_offset, 0, sizeof(tr->minmax_level_offset));
+
   tr->vbo_id = 0;
   tr->ibo_id = 0;
   tr->vao_id = 0;
@@ -38,6 +257,9 @@ TERRAIN* KRR_TERRAIN_new()
 
 void KRR_TERRAIN_free_internals(TERRAIN* tr)
 {
+  // `page_radius`, `page_capacity` and `page_uploads_per_update` are kept as user's settings
+  free_paging(tr);
+
   if (tr->vertices != NULL)
   {
     free(tr->vertices);
@@ -52,8 +274,39 @@ void KRR_TERRAIN_free_internals(TERRAIN* tr)
     tr->indices_count = 0;
   }
 
+  tr->index_type = GL_UNSIGNED_INT;
+
+  // `packed` is kept as it's user's setting for next loading
+  reset_dequant(tr);
+  memset(&tr->bounds, 0, sizeof(tr->bounds));
+
+  // as well as `heightfield` and `heightfield_normalmap`
+  memset(&tr->heightfield_params, 0, sizeof(tr->heightfield_params));
+  if (tr->heightmap_texture_id != 0)
+  {
+    KRR_GLSTATE_delete_textures(1, &tr->heightmap_texture_id);
+    tr->heightmap_texture_id = 0;
+  }
+  if (tr->normalmap_texture_id != 0)
+  {
+    KRR_GLSTATE_delete_textures(1, &tr->normalmap_texture_id);
+    tr->normalmap_texture_id = 0;
+  }
+  if (tr->patches_vbo_id != 0)
+  {
+    KRR_GLSTATE_delete_buffers(1, &tr->patches_vbo_id);
+    tr->patches_vbo_id = 0;
+  }
+  if (tr->patches != NULL)
+  {
+    free(tr->patches);
+    tr->patches = NULL;
+  }
+
   tr->grid_width = 0;
   tr->grid_height = 0;
+  tr->cell_size = 0.0f;
+  tr->height_factor = 0.0f;
 
   if (tr->heights != NULL)
   {
@@ -67,310 +320,2331 @@ void KRR_TERRAIN_free_internals(TERRAIN* tr)
     tr->normals = NULL;    
   }
 
+  if (tr->minmax_tree != NULL)
+  {
+    free(tr->minmax_tree);
+    tr->minmax_tree = NULL;
+  }
+  tr->minmax_levels = 0;
+
   if (tr->vbo_id != 0)
   {
-    glDeleteBuffers(1, &tr->vbo_id);
+    KRR_GLSTATE_delete_buffers(1, &tr->vbo_id);
     tr->vbo_id = 0;
   }
   if (tr->ibo_id != 0)
   {
-    glDeleteBuffers(1, &tr->ibo_id);
+    KRR_GLSTATE_delete_buffers(1, &tr->ibo_id);
     tr->ibo_id = 0;
   }
   if (tr->vao_id != 0)
   {
-    glDeleteBuffers(1, &tr->vao_id);
+    KRR_GLSTATE_delete_vertex_arrays(1, &tr->vao_id);
     tr->vao_id = 0;
   }
+
+  if (tr->chunks != NULL)
+  {
+    // vao of first chunk is `vao_id` which is already deleted above
+    // chunks of heightfield terrain have no vao of their own
+    for (int i=1; i<tr->chunks_count; ++i)
+    {
+      if (tr->chunks[i].vao_id != 0)
+      {
+        KRR_GLSTATE_delete_vertex_arrays(1, &tr->chunks[i].vao_id);
+      }
+    }
+    free(tr->chunks);
+    tr->chunks = NULL;
+    tr->chunks_count = 0;
+  }
+  memset(tr->lod_indices_offset, 0, sizeof(tr->lod_indices_offset));
+  memset(tr->lod_indices_count, 0, sizeof(tr->lod_indices_count));
+  tr->lod_indices_mode = GL_TRIANGLES;
+  // `max_pixel_error` is kept as it's user's setting
+  tr->rendered_chunks = 0;
+  tr->rendered_triangles = 0;
 }
 
-bool KRR_TERRAIN_load_objfile(TERRAIN* tr, const char* filepath)
+/// upload vertices into newly created vbo, packing them first if needed
+static void upload_vertices(TERRAIN* tr, const VERTEXTEXNORM3D* vertices)
 {
-  // unload first
-  KRR_TERRAIN_unload(tr);
-
-  // load .obj file
-  KRR_load_objfile(filepath, &tr->vertices, &tr->vertices_count, &tr->indices, &tr->indices_count);
-
-  // create vbo
   glGenBuffers(1, &tr->vbo_id);
-  glBindBuffer(GL_ARRAY_BUFFER, tr->vbo_id);
-  glBufferData(GL_ARRAY_BUFFER, tr->vertices_count * sizeof(VERTEXTEXNORM3D), tr->vertices, GL_STATIC_DRAW);
-
-  glGenBuffers(1, &tr->ibo_id);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tr->ibo_id);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, tr->indices_count * sizeof(GLuint), tr->indices, GL_STATIC_DRAW);
-
-  // free vertices and indices as we loaded into opengl buffer now
-  free(tr->vertices);
-  tr->vertices = NULL;
-  free(tr->indices);
-  tr->indices = NULL;
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, tr->vbo_id);
+  if (tr->packed)
+  {
+    VERTEXTEXNORM3D_PACKED* packed = malloc(sizeof(VERTEXTEXNORM3D_PACKED) * tr->vertices_count);
+    KRR_MESHOPT_pack_vertices(vertices, tr->vertices_count, packed, &tr->dequant);
+    glBufferData(GL_ARRAY_BUFFER, tr->vertices_count * sizeof(VERTEXTEXNORM3D_PACKED), packed, GL_STATIC_DRAW);
+    free(packed);
+  }
+  else
+  {
+    glBufferData(GL_ARRAY_BUFFER, tr->vertices_count * sizeof(VERTEXTEXNORM3D), vertices, GL_STATIC_DRAW);
+  }
+}
 
-  // vao
-  glGenVertexArrays(1, &tr->vao_id);
-  glBindVertexArray(tr->vao_id);
+/// create vao for vertices starting at `base_vertex` in vbo
+static GLuint create_vao(const TERRAIN* tr, int base_vertex)
+{
+  GLuint vao_id;
+  glGenVertexArrays(1, &vao_id);
+  KRR_GLSTATE_bind_vertex_array(vao_id);
 
     // enable vertex attributes
     KRR_TERRAINSHADERPROG3D_enable_attrib_pointers(shared_terrain3d_shaderprogram);
 
     // set vertex data
-    glBindBuffer(GL_ARRAY_BUFFER, tr->vbo_id);
-    KRR_TERRAINSHADERPROG3D_set_vertex_pointer(shared_terrain3d_shaderprogram, sizeof(VERTEXTEXNORM3D), (GLvoid*)offsetof(VERTEXTEXNORM3D, position));
-    KRR_TERRAINSHADERPROG3D_set_texcoord_pointer(shared_terrain3d_shaderprogram, sizeof(VERTEXTEXNORM3D), (GLvoid*)offsetof(VERTEXTEXNORM3D, texcoord));
-    KRR_TERRAINSHADERPROG3D_set_normal_pointer(shared_terrain3d_shaderprogram, sizeof(VERTEXTEXNORM3D), (GLvoid*)offsetof(VERTEXTEXNORM3D, normal));
+    KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, tr->vbo_id);
+    if (tr->packed)
+    {
+      const size_t base = (size_t)base_vertex * sizeof(VERTEXTEXNORM3D_PACKED);
+      KRR_TERRAINSHADERPROG3D_set_packed_vertex_pointer(shared_terrain3d_shaderprogram, sizeof(VERTEXTEXNORM3D_PACKED), (GLvoid*)(base + offsetof(VERTEXTEXNORM3D_PACKED, position)));
+      KRR_TERRAINSHADERPROG3D_set_packed_texcoord_pointer(shared_terrain3d_shaderprogram, sizeof(VERTEXTEXNORM3D_PACKED), (GLvoid*)(base + offsetof(VERTEXTEXNORM3D_PACKED, texcoord)));
+      KRR_TERRAINSHADERPROG3D_set_packed_normal_pointer(shared_terrain3d_shaderprogram, sizeof(VERTEXTEXNORM3D_PACKED), (GLvoid*)(base + offsetof(VERTEXTEXNORM3D_PACKED, normal)));
+    }
+    else
+    {
+      const size_t base = (size_t)base_vertex * sizeof(VERTEXTEXNORM3D);
+      KRR_TERRAINSHADERPROG3D_set_vertex_pointer(shared_terrain3d_shaderprogram, sizeof(VERTEXTEXNORM3D), (GLvoid*)(base + offsetof(VERTEXTEXNORM3D, position)));
+      KRR_TERRAINSHADERPROG3D_set_texcoord_pointer(shared_terrain3d_shaderprogram, sizeof(VERTEXTEXNORM3D), (GLvoid*)(base + offsetof(VERTEXTEXNORM3D, texcoord)));
+      KRR_TERRAINSHADERPROG3D_set_normal_pointer(shared_terrain3d_shaderprogram, sizeof(VERTEXTEXNORM3D), (GLvoid*)(base + offsetof(VERTEXTEXNORM3D, normal)));
+    }
 
     // ibo
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tr->ibo_id);
+    KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, tr->ibo_id);
 
   // unbind vao
-  glBindVertexArray(0);
+  KRR_GLSTATE_bind_vertex_array(0);
 
-  return true;
+  return vao_id;
 }
 
-bool KRR_TERRAIN_load_from_generation(TERRAIN* tr, const char* heightmap_path, float size, float hfactor)
+/// get index of grid vertex at position `p` along perimeter of chunk.
+/// Perimeter is walked north (+x), east (+z), south (-x), then west (-z), so that skirts face outward.
+static int perimeter_vertex(int p)
 {
-  // generate terrain's vertices and indices
-  if (!KRR_TERRAIN_generate(heightmap_path, size, hfactor, &tr->vertices, &tr->vertices_count, &tr->indices, &tr->indices_count, &tr->grid_width, &tr->grid_height, &tr->heights, &tr->normals))
-  {
-    return false;
-  }
+  if (p < CHUNK_CELLS)
+    return p;
+  if (p < CHUNK_CELLS*2)
+    return (p - CHUNK_CELLS)*CHUNK_STRIDE + CHUNK_CELLS;
+  if (p < CHUNK_CELLS*3)
+    return CHUNK_CELLS*CHUNK_STRIDE + (CHUNK_CELLS*3 - p);
+  return (CHUNK_CELLS*4 - p)*CHUNK_STRIDE;
+}
 
-  KRR_LOGI("terrain vertices count = %d", tr->vertices_count);
-  KRR_LOGI("terrain indices count = %d", tr->indices_count);
+/// build indices of all LOD levels shared by all chunks, return number of indices written into `out`
+static int build_lod_indices(TERRAIN* tr, GLushort* out)
+{
+  int cursor = 0;
+  for (int l=0; l<KRR_TERRAIN_LODS; ++l)
+  {
+    const int step = 1 << l;
+    tr->lod_indices_offset[l] = cursor * sizeof(GLushort);
 
-  // create vbo
-  glGenBuffers(1, &tr->vbo_id);
-  glBindBuffer(GL_ARRAY_BUFFER, tr->vbo_id);
-  glBufferData(GL_ARRAY_BUFFER, tr->vertices_count * sizeof(VERTEXTEXNORM3D), tr->vertices, GL_STATIC_DRAW);
+    // same winding as of KRR_TERRAIN_generate()
+    for (int j=0; j<CHUNK_CELLS; j+=step)
+    {
+      for (int i=0; i<CHUNK_CELLS; i+=step)
+      {
+        const GLushort a = j*CHUNK_STRIDE + i;
+        const GLushort b = j*CHUNK_STRIDE + i + step;
+        const GLushort c = (j+step)*CHUNK_STRIDE + i;
+        const GLushort d = (j+step)*CHUNK_STRIDE + i + step;
+
+        out[cursor++] = a;
+        out[cursor++] = c;
+        out[cursor++] = b;
+
+        out[cursor++] = b;
+        out[cursor++] = c;
+        out[cursor++] = d;
+      }
+    }
 
-  glGenBuffers(1, &tr->ibo_id);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tr->ibo_id);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, tr->indices_count * sizeof(GLuint), tr->indices, GL_STATIC_DRAW);
+    // skirts along perimeter, joining edge vertices of this level to their skirt vertices
+    for (int p=0; p<CHUNK_PERIMETER; p+=step)
+    {
+      const int q = (p + step) % CHUNK_PERIMETER;
+      const GLushort e0 = perimeter_vertex(p);
+      const GLushort e1 = perimeter_vertex(q);
+      const GLushort s0 = CHUNK_STRIDE*CHUNK_STRIDE + p;
+      const GLushort s1 = CHUNK_STRIDE*CHUNK_STRIDE + q;
+
+      out[cursor++] = e0;
+      out[cursor++] = e1;
+      out[cursor++] = s0;
+
+      out[cursor++] = e1;
+      out[cursor++] = s1;
+      out[cursor++] = s0;
+    }
 
-  // free vertices and indices as we loaded into opengl buffer now
-  free(tr->vertices);
-  tr->vertices = NULL;
-  free(tr->indices);
-  tr->indices = NULL;
+    tr->lod_indices_count[l] = cursor - tr->lod_indices_offset[l] / sizeof(GLushort);
+  }
+  return cursor;
+}
 
-  // vao
-  glGenVertexArrays(1, &tr->vao_id);
-  glBindVertexArray(tr->vao_id);
+/// build triangle strips of all LOD levels shared by all chunks, return number of indices written into `out`.
+/// Each row of cells is a strip, then skirts are a single strip around perimeter.
+static int build_lod_strips(TERRAIN* tr, GLushort* out)
+{
+  int cursor = 0;
+  for (int l=0; l<KRR_TERRAIN_LODS; ++l)
+  {
+    const int step = 1 << l;
+    tr->lod_indices_offset[l] = cursor * sizeof(GLushort);
 
-    // enable vertex attributes
-    KRR_TERRAINSHADERPROG3D_enable_attrib_pointers(shared_terrain3d_shaderprogram);
+    // zigzag down and right, its triangles are exactly the ones of build_lod_indices()
+    for (int j=0; j<CHUNK_CELLS; j+=step)
+    {
+      for (int i=0; i<=CHUNK_CELLS; i+=step)
+      {
+        out[cursor++] = j*CHUNK_STRIDE + i;
+        out[cursor++] = (j+step)*CHUNK_STRIDE + i;
+      }
+      out[cursor++] = STRIP_RESTART_INDEX;
+    }
 
-    // set vertex data
-    glBindBuffer(GL_ARRAY_BUFFER, tr->vbo_id);
-    KRR_TERRAINSHADERPROG3D_set_vertex_pointer(shared_terrain3d_shaderprogram, sizeof(VERTEXTEXNORM3D), (GLvoid*)offsetof(VERTEXTEXNORM3D, position));
-    KRR_TERRAINSHADERPROG3D_set_texcoord_pointer(shared_terrain3d_shaderprogram, sizeof(VERTEXTEXNORM3D), (GLvoid*)offsetof(VERTEXTEXNORM3D, texcoord));
-    KRR_TERRAINSHADERPROG3D_set_normal_pointer(shared_terrain3d_shaderprogram, sizeof(VERTEXTEXNORM3D), (GLvoid*)offsetof(VERTEXTEXNORM3D, normal));
+    // skirts split along the other diagonal, facing outward the same, and wrap around to the first vertex
+    for (int p=0; p<=CHUNK_PERIMETER; p+=step)
+    {
+      const int q = p % CHUNK_PERIMETER;
+      out[cursor++] = CHUNK_STRIDE*CHUNK_STRIDE + q;
+      out[cursor++] = perimeter_vertex(q);
+    }
 
-    // ibo
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tr->ibo_id);
+    tr->lod_indices_count[l] = cursor - tr->lod_indices_offset[l] / sizeof(GLushort);
+  }
+  return cursor;
+}
 
-  // unbind vao
-  glBindVertexArray(0);
+/// get number of indices of all LOD levels, either as triangle strips or independent triangles
+static int lod_indices_total(bool strips)
+{
+  int total = 0;
+  for (int l=0; l<KRR_TERRAIN_LODS; ++l)
+  {
+    const int n = CHUNK_CELLS >> l;
+    if (strips)
+      total += n*((n+1)*2 + 1) + (n*4 + 1)*2;
+    else
+      total += n*n*6 + n*4*6;
+  }
+  return total;
+}
 
-  return true;
+/// get number of triangles of a chunk rendered at LOD level `lod`
+static int lod_triangles(int lod)
+{
+  const int n = CHUNK_CELLS >> lod;
+  return n*n*2 + n*4*2;
 }
 
-void KRR_TERRAIN_render(TERRAIN* tr)
+/// compute maximum height error of rendering grid vertices of chunk every `step` vertices
+static float lod_error(const float* heights, int step)
 {
-  glDrawElements(GL_TRIANGLES, tr->indices_count, GL_UNSIGNED_INT, NULL);
+#define H(i, j) (heights[(j)*CHUNK_STRIDE + (i)])
+  float max_error = 0.0f;
+  for (int j0=0; j0<CHUNK_CELLS; j0+=step)
+  {
+    for (int i0=0; i0<CHUNK_CELLS; i0+=step)
+    {
+      const int i1 = i0 + step;
+      const int j1 = j0 + step;
+      const float ha = H(i0, j0);
+      const float hb = H(i1, j0);
+      const float hc = H(i0, j1);
+      const float hd = H(i1, j1);
+
+      // interpolate on the same triangles as rendered, a-c-b then b-c-d
+      for (int dj=0; dj<=step; ++dj)
+      {
+        for (int di=0; di<=step; ++di)
+        {
+          const float u = (float)di / step;
+          const float w = (float)dj / step;
+          const float h = (u + w <= 1.0f) ?
+            ha + u*(hb - ha) + w*(hc - ha) :
+            hd + (1.0f - u)*(hc - hd) + (1.0f - w)*(hb - hd);
+          const float e = fabsf(H(i0 + di, j0 + dj) - h);
+          if (e > max_error) max_error = e;
+        }
+      }
+    }
+  }
+  return max_error;
+#undef H
 }
 
-void KRR_TERRAIN_unload(TERRAIN* tr)
+/// get number of chunks along x and z
+static void chunks_size(const TERRAIN* tr, int* out_nx, int* out_ny)
 {
-  // just call internal freeing
-  // with this we don't free the source itself
-  // as we will need it for future loading
-  KRR_TERRAIN_free_internals(tr);
+  *out_nx = (tr->grid_width + CHUNK_CELLS - 1) / CHUNK_CELLS;
+  *out_ny = (tr->grid_height + CHUNK_CELLS - 1) / CHUNK_CELLS;
 }
 
-void KRR_TERRAIN_free(TERRAIN* tr)
+/// compute errors of all LOD levels of chunk from `heights` of terrain
+static void update_lod_errors(const TERRAIN* tr, TERRAIN_CHUNK* chunk)
 {
-  KRR_TERRAIN_free_internals(tr);
-  
-  // free source
-  free(tr);
-  tr = NULL;
+  // grid vertices of chunk, padded by repeating the last row and column of grid
+  float h[CHUNK_STRIDE * CHUNK_STRIDE];
+  for (int j=0; j<CHUNK_STRIDE; ++j)
+  {
+    int gz = chunk->cell_z + j; if (gz > tr->grid_height) gz = tr->grid_height;
+    for (int i=0; i<CHUNK_STRIDE; ++i)
+    {
+      int gx = chunk->cell_x + i; if (gx > tr->grid_width) gx = tr->grid_width;
+      h[j*CHUNK_STRIDE + i] = tr->heights[gz*(tr->grid_width + 1) + gx];
+    }
+  }
+
+  // keep errors non-decreasing, so coarser level is never selected over finer one
+  chunk->lod_errors[0] = 0.0f;
+  for (int l=1; l<KRR_TERRAIN_LODS; ++l)
+  {
+    const float e = lod_error(h, 1 << l);
+    chunk->lod_errors[l] = e > chunk->lod_errors[l-1] ? e : chunk->lod_errors[l-1];
+  }
 }
 
-bool KRR_TERRAIN_generate(const char* heightmap_path, float size, float hfactor, VERTEXTEXNORM3D** dst_vertices, int* vertices_count, GLuint** dst_indices, int* indices_count, int* rst_grid_width, int* rst_grid_height, float** rst_heights, vec3** rst_normals)
+/// compute skirt depth of chunk at (cx, cy) deep enough to cover gap to any neighbour,
+/// which is at most sum of both errors
+static void update_skirt_depth(TERRAIN* tr, int cx, int cy)
 {
-  // load the heightmap
-  KRR_TEXTURE* heightmap = KRR_TEXTURE_new();
-  if (!KRR_TEXTURE_load_grayscale_texture_from_file(heightmap, heightmap_path))
+  int nx, ny;
+  chunks_size(tr, &nx, &ny);
+
+  float neighbour_error = 0.0f;
+  const int neighbours[4][2] = { {cx-1, cy}, {cx+1, cy}, {cx, cy-1}, {cx, cy+1} };
+  for (int n=0; n<4; ++n)
   {
-    KRR_LOGE("Error loading height map file file");
-    return false;
+    const int nbx = neighbours[n][0];
+    const int nby = neighbours[n][1];
+    if (nbx < 0 || nbx >= nx || nby < 0 || nby >= ny)
+      continue;
+    const float e = tr->chunks[nbx + nby*nx].lod_errors[KRR_TERRAIN_LODS-1];
+    if (e > neighbour_error) neighbour_error = e;
   }
 
-  const int grid_width_size = heightmap->width;
-  const int grid_height_size = heightmap->height;
-  const int verts_count = (grid_width_size + 1) * (grid_height_size + 1);
-  const int ids_count = grid_width_size * grid_height_size * 2 * 3;
+  TERRAIN_CHUNK* chunk = &tr->chunks[cx + cy*nx];
+  chunk->skirt_depth = chunk->lod_errors[KRR_TERRAIN_LODS-1] + neighbour_error;
+}
 
-  VERTEXTEXNORM3D* vertices = malloc(sizeof(VERTEXTEXNORM3D) * verts_count);
-  GLuint* indices = malloc(sizeof(GLuint) * ids_count);
+/// upload heights and normals of grid vertices in [x0, x1] x [z0, z1] into textures of heightfield
+static void upload_heightfield_region(const TERRAIN* tr, int x0, int z0, int x1, int z1)
+{
+  const int stride = tr->grid_width + 1;
+  const int width = x1 - x0 + 1;
+  const int height = z1 - z0 + 1;
+
+  const float offset = tr->heightfield_params.height_offset;
+  const float inv_scale = tr->heightfield_params.height_scale > 0.0f ? 1.0f / tr->heightfield_params.height_scale : 0.0f;
+  GLushort* quantized = malloc(sizeof(GLushort) * width * height);
+  for (int j=0; j<height; ++j)
+  {
+    const float* restrict src = tr->heights + (z0 + j)*stride + x0;
+    GLushort* restrict dst = quantized + j*width;
+    for (int i=0; i<width; ++i)
+    {
+      float q = (src[i] - offset) * inv_scale + 0.5f;
+      q = q < 0.0f ? 0.0f : (q > 65535.0f ? 65535.0f : q);
+      dst[i] = (GLushort)q;
+    }
+  }
 
-  int idx = 0;
+  // rows of 16-bit texels are not necessarily 4-byte aligned
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, tr->heightmap_texture_id);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, x0, z0, width, height, GL_RED_INTEGER, GL_UNSIGNED_SHORT, quantized);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  free(quantized);
 
-  // lock texture to get access to its pixel data
-  if (!KRR_TEXTURE_lock(heightmap))
+  if (tr->normalmap_texture_id != 0)
   {
-    KRR_LOGE("Error locking heightmap file");
-    return false;
+    GLbyte* normals = malloc(sizeof(GLbyte) * 4 * width * height);
+    for (int j=0; j<height; ++j)
+    {
+      for (int i=0; i<width; ++i)
+      {
+        const float* n = tr->normals[(z0 + j)*stride + x0 + i];
+        GLbyte* out = normals + (j*width + i)*4;
+        out[0] = (GLbyte)lroundf(n[0] * 127.0f);
+        out[1] = (GLbyte)lroundf(n[1] * 127.0f);
+        out[2] = (GLbyte)lroundf(n[2] * 127.0f);
+        out[3] = 0;
+      }
+    }
+
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, tr->normalmap_texture_id);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x0, z0, width, height, GL_RGBA, GL_BYTE, normals);
+    free(normals);
   }
 
-  // create heights memory space to store height information
-  // that will allow user to access such data and use in the game
-  // initially set to zero height for all vertices
-  float* heights = calloc(1, verts_count * sizeof(float));
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, 0);
+}
 
-  // create normals memory space to store normal information
-  // that will allow user to access in the game i.e. rotate object on
-  // terrain according to make it oriented with normals on that position of terrain
-  // note: remember to free this memory space with KRR_MEM_free8()
-  vec3* normals = KRR_MEM_malloc8(verts_count * sizeof(vec3));
+/// set range of heights quantized into heightmap texture
+static void set_heightfield_range(TERRAIN* tr, float min_h, float max_h)
+{
+  tr->heightfield_params.height_offset = min_h;
+  tr->heightfield_params.height_scale = max_h > min_h ? (max_h - min_h) / 65535.0f : 0.0f;
+}
 
-  //
-  // A ---- B
-  // |    / |
-  // |  /   |
-  // C ---- D
-  //
-  // operate 4 vertices at the time starting from A-C-B then B-C-D
-  for (int j=0; j<=grid_height_size; ++j)
+/// upload heights of grid as quantized texture, and normals if enabled
+static void upload_heightfield(TERRAIN* tr, float size)
+{
+  const int width = tr->grid_width + 1;
+  const int height = tr->grid_height + 1;
+
+  // range of heights is at root of min/max tree
+  const float* root = tr->minmax_tree + tr->minmax_level_offset[tr->minmax_levels - 1];
+  set_heightfield_range(tr, root[0], root[1]);
+  tr->heightfield_params.cell_size = size;
+  tr->heightfield_params.height_factor = tr->height_factor;
+  tr->heightfield_params.grid_width = tr->grid_width;
+  tr->heightfield_params.grid_height = tr->grid_height;
+  tr->heightfield_params.normalmap_enabled = tr->heightfield_normalmap ? 1.0f : 0.0f;
+
+  // integer texture can only be fetched without filtering, which is exactly what vertices need
+  glGenTextures(1, &tr->heightmap_texture_id);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, tr->heightmap_texture_id);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16UI, width, height);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  if (tr->heightfield_normalmap)
   {
-    for (int i=0; i<=grid_width_size; ++i)
-    {
-      VERTEXTEXNORM3D v;
+    glGenTextures(1, &tr->normalmap_texture_id);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, tr->normalmap_texture_id);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8_SNORM, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  }
 
-      // get index to get height value from heightmap
-      int heightmap_i = i;
-      if (heightmap_i >= grid_width_size)
-        heightmap_i = grid_width_size - 1;
+  upload_heightfield_region(tr, 0, 0, tr->grid_width, tr->grid_height);
+}
 
-      int heightmap_j = j;
-      if (heightmap_j >= grid_height_size)
-        heightmap_j = grid_height_size - 1;
+/// upload grid patch shared by all chunks, laid out the same as vertices of a chunk
+static void upload_grid_patch(TERRAIN* tr)
+{
+  GRIDVERTEX* grid = malloc(sizeof(GRIDVERTEX) * CHUNK_VERTICES);
+  for (int j=0; j<CHUNK_STRIDE; ++j)
+  {
+    for (int i=0; i<CHUNK_STRIDE; ++i)
+    {
+      grid[j*CHUNK_STRIDE + i] = (GRIDVERTEX){i, j, 0, 0};
+    }
+  }
+  for (int p=0; p<CHUNK_PERIMETER; ++p)
+  {
+    GRIDVERTEX* skirt = &grid[CHUNK_STRIDE*CHUNK_STRIDE + p];
+    *skirt = grid[perimeter_vertex(p)];
+    skirt->skirt = 1;
+  }
 
-      // convert to proper range of height value
-      // as it's grayscale, each color component has the same value, thus we just get value
-      // from a single component (not alpha)
-      // then we try to convert it into range that has no need to be adjusted in-game later i.e. [-N,N]
-#define H_VAL(i, j) (heightmap->pixels8[i + j*heightmap->width])
-#define H_CONV(h) (MAX_TERRAIN_HEIGHT - MIN_TERRAIN_HEIGHT) * h / 255.0f + MIN_TERRAIN_HEIGHT
-      float height_val = H_VAL(heightmap_i, heightmap_j);
-      height_val = H_CONV(height_val);
-      
-      // vertex
-      v.position.x = i*size;
-      v.position.y = height_val*hfactor;
-      v.position.z = j*size;
+  glGenBuffers(1, &tr->vbo_id);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, tr->vbo_id);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(GRIDVERTEX) * CHUNK_VERTICES, grid, GL_STATIC_DRAW);
+  free(grid);
+
+  // patches of visible chunks are streamed every frame
+  glGenBuffers(1, &tr->patches_vbo_id);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, tr->patches_vbo_id);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * PATCH_FLOATS * tr->chunks_count, NULL, GL_STREAM_DRAW);
+  tr->patches = malloc(sizeof(float) * PATCH_FLOATS * tr->chunks_count);
+}
 
-      // also save height into heights info buffer
-      heights[i + j*grid_width_size] = v.position.y;
+/// create vao for grid patch, patch pointer is set for each LOD level when rendering
+static GLuint create_heightfield_vao(const TERRAIN* tr)
+{
+  GLuint vao_id;
+  glGenVertexArrays(1, &vao_id);
+  KRR_GLSTATE_bind_vertex_array(vao_id);
 
-      // texcoord
-      // repeating of texture coord will be set in shader code
-      v.texcoord.s = (i*size) / (grid_width_size*size);
-      v.texcoord.t = (j*size) / (grid_height_size*size);
+    // enable vertex attributes
+    KRR_TERRAINSHADERPROG3D_enable_attrib_pointers(shared_terrain3d_shaderprogram);
 
-      int hL_i = i-1; if (hL_i < 0) hL_i = 0;
-      int hR_i = i+1; if (hR_i >= grid_width_size) hR_i = grid_width_size - 1;
-      int hD_i = j-1; if (hD_i < 0) hD_i = 0;
-      int hU_i = j+1; if (hU_i >= grid_height_size) hU_i = grid_height_size - 1;
+    // set vertex data
+    KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, tr->vbo_id);
+    KRR_TERRAINSHADERPROG3D_set_grid_vertex_pointer(shared_terrain3d_shaderprogram, sizeof(GRIDVERTEX), NULL);
 
-      int normal_i = i;
-      if (normal_i >= grid_width_size) normal_i = grid_width_size - 1;
-      int normal_j = j;
-      if (normal_j >= grid_height_size) normal_j = grid_height_size - 1;
+    KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, tr->patches_vbo_id);
+    KRR_TERRAINSHADERPROG3D_set_patch_pointer(shared_terrain3d_shaderprogram, sizeof(float) * PATCH_FLOATS, NULL);
 
-      float hL = H_CONV(H_VAL(hL_i, normal_j));
-      float hR = H_CONV(H_VAL(hR_i, normal_j));
-      float hD = H_CONV(H_VAL(normal_i, hD_i));
-      float hU = H_CONV(H_VAL(normal_i, hU_i));
+    // ibo
+    KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, tr->ibo_id);
 
-      CGLM_ALIGN(8) vec3 n;
-      glm_vec3_copy((vec3){hL - hR, 2.0f, hD - hU}, n);
-      glm_vec3_normalize(n);
+  // unbind vao
+  KRR_GLSTATE_bind_vertex_array(0);
 
-      // normal
-      v.normal.x = n[0];
-      v.normal.y = n[1];
-      v.normal.z = n[2];
+  return vao_id;
+}
 
-      // store normals information
-      glm_vec3_copy((vec3){n[0], n[1], n[2]}, normals[i + j*grid_width_size]);
+bool KRR_TERRAIN_load_objfile(TERRAIN* tr, const char* filepath)
+{
+  // unload first
+  KRR_TERRAIN_unload(tr);
 
-      // set to result vertices pointer
-      memcpy(vertices + idx++, &v, sizeof(v));
-    }
+  // load .obj file, or its cache if source file is unchanged
+  KRR_MESHCACHE mc;
+  if (!KRR_MESHCACHE_load_objfile(&mc, filepath, KRR_OBJLOADER_FLAG_OPTIMIZE))
+  {
+    return false;
   }
+  tr->vertices_count = mc.header.vertices_count;
+  tr->indices_count = mc.header.indices_count;
+  tr->index_type = mc.index_type;
 
-  idx = 0;
+  // bounds as computed when mesh was cached
+  memcpy(tr->bounds.aabb_min, mc.header.aabb_min, sizeof(tr->bounds.aabb_min));
+  memcpy(tr->bounds.aabb_max, mc.header.aabb_max, sizeof(tr->bounds.aabb_max));
+  memcpy(tr->bounds.center, mc.header.sphere_center, sizeof(tr->bounds.center));
+  tr->bounds.radius = mc.header.sphere_radius;
 
-  int real_width_size = grid_width_size+1;
-  // set indices
-  for (int j=0; j<grid_height_size; ++j)
-  {
-    for (int i=0; i<grid_width_size; ++i)
-    {
-      indices[idx++] = j*real_width_size + i;
-      indices[idx++] = (j+1)*real_width_size + i;
-      indices[idx++] = j*real_width_size + i + 1;
+  // create vbo, upload directly from mesh data
+  upload_vertices(tr, mc.vertices);
 
-      indices[idx++] = j*real_width_size + i + 1;
-      indices[idx++] = (j+1)*real_width_size + i;
-      indices[idx++] = (j+1)*real_width_size + i + 1;
-    }
-  }
+  glGenBuffers(1, &tr->ibo_id);
+  KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, tr->ibo_id);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, tr->indices_count * mc.header.index_size, mc.indices, GL_STATIC_DRAW);
 
-  // unlock texture
-  KRR_TEXTURE_unlock(heightmap);
+  // release mesh data as we loaded into opengl buffer now
+  KRR_MESHCACHE_close(&mc);
 
-  // free heightmap
-  KRR_TEXTURE_free(heightmap);
-  heightmap = NULL;
+  // vao
+  tr->vao_id = create_vao(tr, 0);
 
-  // return the results
-  if (dst_vertices != NULL)
+  return true;
+}
+
+// number of nodes along x and z of level of min/max tree
+static void minmax_level_size(const TERRAIN* tr, int level, int* out_w, int* out_h)
+{
+  *out_w = ((tr->grid_width - 1) >> level) + 1;
+  *out_h = ((tr->grid_height - 1) >> level) + 1;
+}
+
+// recompute min/max tree over cells [x0, x1) x [z0, z1) and their ancestors
+static void update_minmax_tree(TERRAIN* tr, int x0, int z0, int x1, int z1)
+{
+  const int stride = tr->grid_width + 1;
+
+  // each cell from its 4 corners
+  float* restrict cells = tr->minmax_tree;
+  for (int j=z0; j<z1; ++j)
   {
-    *dst_vertices = vertices;
+    const float* restrict h0 = tr->heights + j*stride;
+    const float* restrict h1 = h0 + stride;
+    float* restrict row = cells + j*tr->grid_width*2;
+    for (int i=x0; i<x1; ++i)
+    {
+      float mn = fminf(fminf(h0[i], h0[i+1]), fminf(h1[i], h1[i+1]));
+      float mx = fmaxf(fmaxf(h0[i], h0[i+1]), fmaxf(h1[i], h1[i+1]));
+      row[i*2] = mn;
+      row[i*2 + 1] = mx;
+    }
   }
-  if (vertices_count != NULL)
+
+  // each node from its up to 2x2 children
+  for (int l=1; l<tr->minmax_levels; ++l)
   {
-    *vertices_count = verts_count;
+    x0 >>= 1; z0 >>= 1;
+    x1 = ((x1 - 1) >> 1) + 1; z1 = ((z1 - 1) >> 1) + 1;
+
+    int cw, ch, w, h;
+    minmax_level_size(tr, l - 1, &cw, &ch);
+    minmax_level_size(tr, l, &w, &h);
+    const float* children = tr->minmax_tree + tr->minmax_level_offset[l - 1];
+    float* nodes = tr->minmax_tree + tr->minmax_level_offset[l];
+    for (int j=z0; j<z1; ++j)
+    {
+      for (int i=x0; i<x1; ++i)
+      {
+        float mn = FLT_MAX;
+        float mx = -FLT_MAX;
+        for (int cj=j*2; cj<j*2+2 && cj<ch; ++cj)
+        {
+          for (int ci=i*2; ci<i*2+2 && ci<cw; ++ci)
+          {
+            mn = fminf(mn, children[(cj*cw + ci)*2]);
+            mx = fmaxf(mx, children[(cj*cw + ci)*2 + 1]);
+          }
+        }
+        nodes[(j*w + i)*2] = mn;
+        nodes[(j*w + i)*2 + 1] = mx;
+      }
+    }
   }
-  if (dst_indices != NULL)
+}
+
+static void build_minmax_tree(TERRAIN* tr)
+{
+  int nodes = 0;
+  int level = 0;
+  for (;;)
   {
-    *dst_indices = indices;
+    int w, h;
+    minmax_level_size(tr, level, &w, &h);
+    tr->minmax_level_offset[level] = nodes * 2;
+    nodes += w * h;
+    level++;
+    if (w == 1 && h == 1)
+      break;
   }
-  if (indices_count != NULL)
+  tr->minmax_levels = level;
+  tr->minmax_tree = malloc(sizeof(float) * 2 * nodes);
+
+  update_minmax_tree(tr, 0, 0, tr->grid_width, tr->grid_height);
+}
+
+/// bounds of chunk from min/max tree, lowered by its skirts
+static void update_chunk_bounds(const TERRAIN* tr, TERRAIN_CHUNK* chunk)
+{
+  // a node at level of chunk size covers exactly the cells of chunk, or root if terrain is smaller
+  int level = 0;
+  while ((1 << level) < CHUNK_CELLS && level < tr->minmax_levels - 1)
+    level++;
+  int w, h;
+  minmax_level_size(tr, level, &w, &h);
+  const float* mm = tr->minmax_tree + tr->minmax_level_offset[level] + ((chunk->cell_z >> level)*w + (chunk->cell_x >> level))*2;
+
+  const int x1 = chunk->cell_x + CHUNK_CELLS < tr->grid_width ? chunk->cell_x + CHUNK_CELLS : tr->grid_width;
+  const int z1 = chunk->cell_z + CHUNK_CELLS < tr->grid_height ? chunk->cell_z + CHUNK_CELLS : tr->grid_height;
+  KRR_CULL_BOUNDS* b = &chunk->bounds;
+  glm_vec3_copy((vec3){chunk->cell_x * tr->cell_size, mm[0] - chunk->skirt_depth, chunk->cell_z * tr->cell_size}, b->aabb_min);
+  glm_vec3_copy((vec3){x1 * tr->cell_size, mm[1], z1 * tr->cell_size}, b->aabb_max);
+  glm_vec3_center(b->aabb_min, b->aabb_max, b->center);
+  b->radius = glm_vec3_distance(b->aabb_min, b->aabb_max) * 0.5f;
+}
+
+/// grid vertex at (gx, gz) as of KRR_TERRAIN_generate(), lowered by `drop`
+static void grid_vertex(const TERRAIN* tr, int gx, int gz, float drop, VERTEXTEXNORM3D* out)
+{
+  const int index = gz*(tr->grid_width + 1) + gx;
+  out->position.x = gx * tr->cell_size;
+  out->position.y = tr->heights[index] - drop;
+  out->position.z = gz * tr->cell_size;
+  out->texcoord.s = (gx * tr->cell_size) / (tr->grid_width * tr->cell_size);
+  out->texcoord.t = (gz * tr->cell_size) / (tr->grid_height * tr->cell_size);
+  out->normal.x = tr->normals[index][0];
+  out->normal.y = tr->normals[index][1];
+  out->normal.z = tr->normals[index][2];
+}
+
+/// split grid into chunks of CHUNK_CELLS^2 cells, each with its own copy of vertices including shared
+/// edges and skirts. Chunks at the far edges are padded by repeating the last row and column of grid,
+/// resulting in degenerate triangles. Only errors, skirts and bounds are computed from `heights` here,
+/// vertices are built by upload_all_chunks().
+static void build_chunks(TERRAIN* tr)
+{
+  int nx, ny;
+  chunks_size(tr, &nx, &ny);
+  const int chunks_count = nx * ny;
+
+  TERRAIN_CHUNK* chunks = malloc(sizeof(TERRAIN_CHUNK) * chunks_count);
+  tr->chunks = chunks;
+  tr->chunks_count = chunks_count;
+
+  // measure errors of each LOD level
+  for (int cy=0; cy<ny; ++cy)
   {
-    *indices_count = ids_count;
+    for (int cx=0; cx<nx; ++cx)
+    {
+      TERRAIN_CHUNK* chunk = &chunks[cx + cy*nx];
+      chunk->vao_id = 0;
+      chunk->cell_x = cx*CHUNK_CELLS;
+      chunk->cell_z = cy*CHUNK_CELLS;
+      chunk->lod = 0;
+
+      update_lod_errors(tr, chunk);
+    }
   }
-  if (rst_grid_width != NULL)
+
+  // skirts hang down along edges
+  for (int cy=0; cy<ny; ++cy)
   {
-    *rst_grid_width = grid_width_size;
+    for (int cx=0; cx<nx; ++cx)
+    {
+      update_skirt_depth(tr, cx, cy);
+      update_chunk_bounds(tr, &chunks[cx + cy*nx]);
+    }
   }
-  if (rst_grid_height != NULL)
+}
+
+/// set range of packed vertices to cover all chunks including skirts, as KRR_MESHOPT_pack_vertices() would find
+static void set_chunks_dequant(TERRAIN* tr)
+{
+  float min_h = FLT_MAX;
+  float max_h = -FLT_MAX;
+  for (int i=0; i<tr->chunks_count; ++i)
   {
-    *rst_grid_height = grid_height_size;
+    min_h = fminf(min_h, tr->chunks[i].bounds.aabb_min[1]);
+    max_h = fmaxf(max_h, tr->chunks[i].bounds.aabb_max[1]);
   }
-  if (rst_heights != NULL)
+
+  tr->dequant.position_offset.x = 0.0f;
+  tr->dequant.position_offset.y = min_h;
+  tr->dequant.position_offset.z = 0.0f;
+  tr->dequant.position_scale.x = tr->grid_width * tr->cell_size;
+  tr->dequant.position_scale.y = max_h - min_h;
+  tr->dequant.position_scale.z = tr->grid_height * tr->cell_size;
+  // texcoords span [0, 1] over grid
+  tr->dequant.texcoord_offset.s = 0.0f;
+  tr->dequant.texcoord_offset.t = 0.0f;
+  tr->dequant.texcoord_scale.s = 1.0f;
+  tr->dequant.texcoord_scale.t = 1.0f;
+}
+
+/// upload all vertices of all chunks, one chunk at a time
+static void upload_all_chunks(const TERRAIN* tr)
+{
+  VERTEXTEXNORM3D* vertices = malloc(sizeof(VERTEXTEXNORM3D) * CHUNK_VERTICES);
+  VERTEXTEXNORM3D_PACKED* packed = tr->packed ? malloc(sizeof(VERTEXTEXNORM3D_PACKED) * CHUNK_VERTICES) : NULL;
+  for (int c=0; c<tr->chunks_count; ++c)
+  {
+    const TERRAIN_CHUNK* chunk = &tr->chunks[c];
+    for (int j=0; j<CHUNK_STRIDE; ++j)
+    {
+      const int gz = chunk->cell_z + j < tr->grid_height ? chunk->cell_z + j : tr->grid_height;
+      for (int i=0; i<CHUNK_STRIDE; ++i)
+      {
+        const int gx = chunk->cell_x + i < tr->grid_width ? chunk->cell_x + i : tr->grid_width;
+        grid_vertex(tr, gx, gz, 0.0f, &vertices[j*CHUNK_STRIDE + i]);
+      }
+    }
+    for (int p=0; p<CHUNK_PERIMETER; ++p)
+    {
+      VERTEXTEXNORM3D* skirt = &vertices[CHUNK_STRIDE*CHUNK_STRIDE + p];
+      *skirt = vertices[perimeter_vertex(p)];
+      skirt->position.y -= chunk->skirt_depth;
+    }
+
+    if (tr->packed)
+    {
+      KRR_MESHOPT_pack_vertices_dequant(vertices, CHUNK_VERTICES, packed, &tr->dequant);
+      glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)c * CHUNK_VERTICES * sizeof(VERTEXTEXNORM3D_PACKED), CHUNK_VERTICES * sizeof(VERTEXTEXNORM3D_PACKED), packed);
+    }
+    else
+    {
+      glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)c * CHUNK_VERTICES * sizeof(VERTEXTEXNORM3D), CHUNK_VERTICES * sizeof(VERTEXTEXNORM3D), vertices);
+    }
+  }
+  free(vertices);
+  free(packed);
+}
+
+/// build index buffers of all LOD levels into newly created ibo
+static void upload_lod_indices(TERRAIN* tr)
+{
+  tr->index_type = GL_UNSIGNED_SHORT;
+  tr->lod_indices_mode = tr->strips ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+  GLushort* lod_indices = malloc(sizeof(GLushort) * lod_indices_total(tr->strips));
+  tr->indices_count = tr->strips ? build_lod_strips(tr, lod_indices) : build_lod_indices(tr, lod_indices);
+
+  KRR_LOGI("terrain index buffer uses %s, %d bytes as triangle strips vs %d bytes as triangle list", tr->strips ? "strips" : "list", (int)(lod_indices_total(true) * sizeof(GLushort)), (int)(lod_indices_total(false) * sizeof(GLushort)));
+
+  glGenBuffers(1, &tr->ibo_id);
+  KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, tr->ibo_id);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, tr->indices_count * sizeof(GLushort), lod_indices, GL_STATIC_DRAW);
+
+  free(lod_indices);
+}
+
+bool KRR_TERRAIN_load_from_generation(TERRAIN* tr, const char* heightmap_path, float size, float hfactor)
+{
+  // load the heightmap, it's decoded on CPU without going through GL
+  KRR_HEIGHTMAP* heightmap = KRR_HEIGHTMAP_new();
+  if (!KRR_HEIGHTMAP_load(heightmap, heightmap_path))
+  {
+    KRR_LOGE("Error loading height map file file");
+    KRR_HEIGHTMAP_free(heightmap);
+    return false;
+  }
+
+  bool result = KRR_TERRAIN_load_from_heightmap(tr, heightmap, size, hfactor);
+
+  KRR_HEIGHTMAP_free(heightmap);
+  return result;
+}
+
+bool KRR_TERRAIN_load_from_heightmap(TERRAIN* tr, const KRR_HEIGHTMAP* heightmap, float size, float hfactor)
+{
+  // generate heights and normals only, chunks are built straight from them
+  if (!KRR_TERRAIN_generate_from_heightmap(heightmap, size, hfactor, NULL, NULL, NULL, NULL, &tr->grid_width, &tr->grid_height, &tr->heights, &tr->normals))
+  {
+    return false;
+  }
+
+  tr->cell_size = size;
+  tr->height_factor = hfactor;
+  build_minmax_tree(tr);
+
+  KRR_LOGI("terrain grid %dx%d, %d grid vertices", tr->grid_width, tr->grid_height, (tr->grid_width + 1) * (tr->grid_height + 1));
+
+  // range of heights is at root of min/max tree
+  const float* root = tr->minmax_tree + tr->minmax_level_offset[tr->minmax_levels - 1];
+  glm_vec3_copy((vec3){0.0f, root[0], 0.0f}, tr->bounds.aabb_min);
+  glm_vec3_copy((vec3){tr->grid_width * size, root[1], tr->grid_height * size}, tr->bounds.aabb_max);
+  glm_vec3_center(tr->bounds.aabb_min, tr->bounds.aabb_max, tr->bounds.center);
+  tr->bounds.radius = glm_vec3_distance(tr->bounds.aabb_min, tr->bounds.aabb_max) * 0.5f;
+
+  // split into chunks sharing index buffers of all LOD levels
+  build_chunks(tr);
+  tr->vertices_count = CHUNK_VERTICES * tr->chunks_count;
+
+  KRR_LOGI("terrain split into %d chunks, vertices count = %d", tr->chunks_count, tr->vertices_count);
+
+  upload_lod_indices(tr);
+
+  if (tr->heightfield)
+  {
+    upload_heightfield(tr, size);
+    upload_grid_patch(tr);
+    tr->vertices_count = CHUNK_VERTICES;
+
+    KRR_LOGI("terrain as heightfield, %d texels", (tr->grid_width + 1) * (tr->grid_height + 1));
+
+    tr->vao_id = create_heightfield_vao(tr);
+    return true;
+  }
+
+  // create vbo then fill it chunk by chunk, so chunked vertices are never held all at once
+  glGenBuffers(1, &tr->vbo_id);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, tr->vbo_id);
+  if (tr->packed)
+  {
+    set_chunks_dequant(tr);
+    glBufferData(GL_ARRAY_BUFFER, tr->vertices_count * sizeof(VERTEXTEXNORM3D_PACKED), NULL, GL_STATIC_DRAW);
+  }
+  else
+  {
+    glBufferData(GL_ARRAY_BUFFER, tr->vertices_count * sizeof(VERTEXTEXNORM3D), NULL, GL_STATIC_DRAW);
+  }
+  upload_all_chunks(tr);
+
+  // vao
+  for (int i=0; i<tr->chunks_count; ++i)
+  {
+    tr->chunks[i].vao_id = create_vao(tr, i * CHUNK_VERTICES);
+  }
+  tr->vao_id = tr->chunks[0].vao_id;
+
+  return true;
+}
+
+void KRR_TERRAIN_render(TERRAIN* tr)
+{
+  KRR_TERRAIN_render_culled(tr, NULL);
+}
+
+/// get distance from point to aabb, zero if point is inside
+static float distance_to_aabb(const KRR_CULL_BOUNDS* bounds, const float* p)
+{
+  float d2 = 0.0f;
+  for (int i=0; i<3; ++i)
+  {
+    float d = 0.0f;
+    if (p[i] < bounds->aabb_min[i]) d = bounds->aabb_min[i] - p[i];
+    else if (p[i] > bounds->aabb_max[i]) d = p[i] - bounds->aabb_max[i];
+    d2 += d*d;
+  }
+  return sqrtf(d2);
+}
+
+/// select the coarsest LOD level of chunk whose projected error is within `max_pixel_error`
+static int select_lod(const TERRAIN* tr, const TERRAIN_CHUNK* chunk, const float* camera_pos, float error_scale)
+{
+  const float distance = distance_to_aabb(&chunk->bounds, camera_pos);
+  // projected error = error * error_scale / distance, compared without division
+  const float budget = tr->max_pixel_error * distance;
+  for (int l=KRR_TERRAIN_LODS-1; l>0; --l)
+  {
+    if (chunk->lod_errors[l] * error_scale <= budget)
+      return l;
+  }
+  return 0;
+}
+
+/// render visible patches of heightfield with one instanced draw call for each LOD level
+static void render_heightfield(TERRAIN* tr, const KRR_CULL_FRUSTUM* frustum, const float* camera_pos, float error_scale)
+{
+  // count visible chunks of each LOD level first, to group their patches by level
+  int lod_counts[KRR_TERRAIN_LODS] = {0};
+  for (int i=0; i<tr->chunks_count; ++i)
+  {
+    TERRAIN_CHUNK* chunk = &tr->chunks[i];
+    if (frustum != NULL && !KRR_CULL_test_aabb(frustum, chunk->bounds.aabb_min, chunk->bounds.aabb_max))
+    {
+      chunk->lod = -1;
+      continue;
+    }
+    chunk->lod = camera_pos != NULL ? select_lod(tr, chunk, camera_pos, error_scale) : 0;
+    lod_counts[chunk->lod]++;
+  }
+
+  int lod_firsts[KRR_TERRAIN_LODS];
+  int cursors[KRR_TERRAIN_LODS];
+  int total = 0;
+  for (int l=0; l<KRR_TERRAIN_LODS; ++l)
+  {
+    lod_firsts[l] = total;
+    cursors[l] = total;
+    total += lod_counts[l];
+  }
+  if (total == 0)
+    return;
+
+  for (int i=0; i<tr->chunks_count; ++i)
+  {
+    const TERRAIN_CHUNK* chunk = &tr->chunks[i];
+    if (chunk->lod < 0)
+      continue;
+    float* patch = tr->patches + PATCH_FLOATS * cursors[chunk->lod]++;
+    patch[0] = chunk->cell_x;
+    patch[1] = chunk->cell_z;
+    patch[2] = chunk->skirt_depth;
+  }
+
+  // orphan previous content so driver doesn't wait for draws still using it
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, tr->patches_vbo_id);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * PATCH_FLOATS * tr->chunks_count, NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * PATCH_FLOATS * total, tr->patches);
+
+  KRR_GLSTATE_active_texture(GL_TEXTURE0 + KRR_TERRAINSHADERPROG3D_HEIGHTMAP_UNIT);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, tr->heightmap_texture_id);
+  if (tr->normalmap_texture_id != 0)
+  {
+    KRR_GLSTATE_active_texture(GL_TEXTURE0 + KRR_TERRAINSHADERPROG3D_NORMALMAP_UNIT);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, tr->normalmap_texture_id);
+  }
+  KRR_GLSTATE_active_texture(GL_TEXTURE0);
+
+  KRR_SHADERPROG_flush_bound();
+
+  // vao of grid patch is already bound by user
+  for (int l=0; l<KRR_TERRAIN_LODS; ++l)
+  {
+    if (lod_counts[l] == 0)
+      continue;
+
+    KRR_TERRAINSHADERPROG3D_set_patch_pointer(shared_terrain3d_shaderprogram, sizeof(float) * PATCH_FLOATS, (const GLvoid*)(sizeof(float) * PATCH_FLOATS * lod_firsts[l]));
+    glDrawElementsInstanced(tr->lod_indices_mode, tr->lod_indices_count[l], tr->index_type, (const GLvoid*)tr->lod_indices_offset[l], lod_counts[l]);
+
+    tr->rendered_chunks += lod_counts[l];
+    tr->rendered_triangles += lod_triangles(l) * lod_counts[l];
+  }
+}
+
+/// render chunks inside frustum, at full resolution if `camera_pos` is NULL
+static void render_chunks(TERRAIN* tr, const KRR_CULL_FRUSTUM* frustum, const float* camera_pos, float error_scale)
+{
+  tr->rendered_chunks = 0;
+  tr->rendered_triangles = 0;
+
+  if (tr->chunks == NULL)
+  {
+    if (frustum == NULL || KRR_CULL_test_aabb(frustum, tr->bounds.aabb_min, tr->bounds.aabb_max))
+    {
+      KRR_SHADERPROG_flush_bound();
+      glDrawElements(GL_TRIANGLES, tr->indices_count, tr->index_type, NULL);
+      tr->rendered_triangles = tr->indices_count / 3;
+    }
+    return;
+  }
+
+  // strips are joined by restart index, left enabled afterwards as no 16-bit mesh references vertex 0xffff
+  if (tr->lod_indices_mode == GL_TRIANGLE_STRIP)
+  {
+    KRR_GLSTATE_enable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+  }
+
+  if (tr->heightfield)
+  {
+    render_heightfield(tr, frustum, camera_pos, error_scale);
+    return;
+  }
+
+  KRR_SHADERPROG_flush_bound();
+
+  // vao of first chunk is already bound by user
+  // KRR_GLSTATE filters out binding the same vao again
+  for (int i=0; i<tr->chunks_count; ++i)
+  {
+    TERRAIN_CHUNK* chunk = &tr->chunks[i];
+    if (frustum != NULL && !KRR_CULL_test_aabb(frustum, chunk->bounds.aabb_min, chunk->bounds.aabb_max))
+    {
+      continue;
+    }
+    chunk->lod = camera_pos != NULL ? select_lod(tr, chunk, camera_pos, error_scale) : 0;
+
+    KRR_GLSTATE_bind_vertex_array(chunk->vao_id);
+    glDrawElements(tr->lod_indices_mode, tr->lod_indices_count[chunk->lod], tr->index_type, (const GLvoid*)tr->lod_indices_offset[chunk->lod]);
+
+    tr->rendered_chunks++;
+    tr->rendered_triangles += lod_triangles(chunk->lod);
+  }
+
+  // leave the same vao bound as before
+  KRR_GLSTATE_bind_vertex_array(tr->vao_id);
+}
+
+void KRR_TERRAIN_render_culled(TERRAIN* tr, const KRR_CULL_FRUSTUM* frustum)
+{
+  render_chunks(tr, frustum, NULL, 0.0f);
+}
+
+void KRR_TERRAIN_render_lod(TERRAIN* tr, const KRR_CULL_FRUSTUM* frustum, vec3 camera_pos, float error_scale)
+{
+  render_chunks(tr, frustum, camera_pos, error_scale);
+}
+
+float KRR_TERRAIN_lod_error_scale(mat4 projection, float viewport_height)
+{
+  // projection[1][1] is cot(fovy/2), half of viewport height spans that much over unit distance
+  return projection[1][1] * viewport_height * 0.5f;
+}
+
+void KRR_TERRAIN_query(const TERRAIN* tr, KRR_TERRAIN_QUERY_MODE mode, const float* xs, const float* zs, int count, float* out_heights, float* out_normals_x, float* out_normals_y, float* out_normals_z, float* out_slopes)
+{
+  if (tr->heights == NULL)
+    return;
+
+  const int stride = tr->grid_width + 1;
+  const float inv_cell = 1.0f / tr->cell_size;
+  const float max_i = (float)(tr->grid_width - 1);
+  const float max_j = (float)(tr->grid_height - 1);
+  const float triangle = mode == KRR_TERRAIN_QUERY_TRIANGLE ? 1.0f : 0.0f;
+  const bool need_normals = out_normals_x != NULL && out_normals_y != NULL && out_normals_z != NULL;
+
+  for (int base=0; base<count; base+=QUERY_BATCH_SIZE)
+  {
+    const int n = count - base < QUERY_BATCH_SIZE ? count - base : QUERY_BATCH_SIZE;
+    const float* restrict bx = xs + base;
+    const float* restrict bz = zs + base;
+
+    // locate cell and position inside it, clamped to terrain
+    int corner[QUERY_BATCH_SIZE];
+    float u[QUERY_BATCH_SIZE];
+    float w[QUERY_BATCH_SIZE];
+    for (int k=0; k<n; ++k)
+    {
+      float fi = bx[k] * inv_cell;
+      float fj = bz[k] * inv_cell;
+      fi = fi < 0.0f ? 0.0f : (fi > tr->grid_width ? tr->grid_width : fi);
+      fj = fj < 0.0f ? 0.0f : (fj > tr->grid_height ? tr->grid_height : fj);
+      // last row and column belong to the cell before them
+      float ci = floorf(fi); ci = ci > max_i ? max_i : ci;
+      float cj = floorf(fj); cj = cj > max_j ? max_j : cj;
+      u[k] = fi - ci;
+      w[k] = fj - cj;
+      corner[k] = (int)cj * stride + (int)ci;
+    }
+
+    // weights of corners a (i,j), b (i+1,j), c (i,j+1), d (i+1,j+1), for both modes without branching
+    float wa[QUERY_BATCH_SIZE];
+    float wb[QUERY_BATCH_SIZE];
+    float wc[QUERY_BATCH_SIZE];
+    float wd[QUERY_BATCH_SIZE];
+    // which triangle, 0 for a-c-b, 1 for b-c-d
+    float t[QUERY_BATCH_SIZE];
+    for (int k=0; k<n; ++k)
+    {
+      const float uk = u[k];
+      const float wk = w[k];
+      const float tk = triangle * (uk + wk > 1.0f ? 1.0f : 0.0f);
+      const float bilinear = 1.0f - triangle;
+      t[k] = tk;
+
+      wa[k] = triangle * (1.0f - tk) * (1.0f - uk - wk) + bilinear * (1.0f - uk) * (1.0f - wk);
+      wb[k] = triangle * ((1.0f - tk) * uk + tk * (1.0f - wk)) + bilinear * uk * (1.0f - wk);
+      wc[k] = triangle * ((1.0f - tk) * wk + tk * (1.0f - uk)) + bilinear * (1.0f - uk) * wk;
+      wd[k] = triangle * tk * (uk + wk - 1.0f) + bilinear * uk * wk;
+    }
+
+    if (out_heights != NULL || out_slopes != NULL)
+    {
+      float ha[QUERY_BATCH_SIZE];
+      float hb[QUERY_BATCH_SIZE];
+      float hc[QUERY_BATCH_SIZE];
+      float hd[QUERY_BATCH_SIZE];
+      for (int k=0; k<n; ++k)
+      {
+        const float* h = tr->heights + corner[k];
+        ha[k] = h[0];
+        hb[k] = h[1];
+        hc[k] = h[stride];
+        hd[k] = h[stride + 1];
+      }
+
+      if (out_heights != NULL)
+      {
+        float* restrict oh = out_heights + base;
+        for (int k=0; k<n; ++k)
+        {
+          oh[k] = wa[k]*ha[k] + wb[k]*hb[k] + wc[k]*hc[k] + wd[k]*hd[k];
+        }
+      }
+
+      if (out_slopes != NULL)
+      {
+        float* restrict os = out_slopes + base;
+        for (int k=0; k<n; ++k)
+        {
+          // derivatives along x and z of the same surface as height
+          const float tk = t[k];
+          const float tri_dx = (1.0f - tk) * (hb[k] - ha[k]) + tk * (hd[k] - hc[k]);
+          const float tri_dz = (1.0f - tk) * (hc[k] - ha[k]) + tk * (hd[k] - hb[k]);
+          const float bil_dx = (hb[k] - ha[k]) * (1.0f - w[k]) + (hd[k] - hc[k]) * w[k];
+          const float bil_dz = (hc[k] - ha[k]) * (1.0f - u[k]) + (hd[k] - hb[k]) * u[k];
+          const float dx = (triangle * tri_dx + (1.0f - triangle) * bil_dx) * inv_cell;
+          const float dz = (triangle * tri_dz + (1.0f - triangle) * bil_dz) * inv_cell;
+          os[k] = sqrtf(dx*dx + dz*dz);
+        }
+      }
+    }
+
+    if (need_normals)
+    {
+      float* restrict onx = out_normals_x + base;
+      float* restrict ony = out_normals_y + base;
+      float* restrict onz = out_normals_z + base;
+      for (int k=0; k<n; ++k)
+      {
+        const float* na = tr->normals[corner[k]];
+        const float* nb = tr->normals[corner[k] + 1];
+        const float* nc = tr->normals[corner[k] + stride];
+        const float* nd = tr->normals[corner[k] + stride + 1];
+        onx[k] = wa[k]*na[0] + wb[k]*nb[0] + wc[k]*nc[0] + wd[k]*nd[0];
+        ony[k] = wa[k]*na[1] + wb[k]*nb[1] + wc[k]*nc[1] + wd[k]*nd[1];
+        onz[k] = wa[k]*na[2] + wb[k]*nb[2] + wc[k]*nc[2] + wd[k]*nd[2];
+      }
+      for (int k=0; k<n; ++k)
+      {
+        const float inv_len = 1.0f / sqrtf(onx[k]*onx[k] + ony[k]*ony[k] + onz[k]*onz[k]);
+        onx[k] *= inv_len;
+        ony[k] *= inv_len;
+        onz[k] *= inv_len;
+      }
+    }
+  }
+}
+
+// two-sided ray-triangle intersection, return distance along ray or FLT_MAX if missed
+static float intersect_triangle(const float o[3], const float d[3], const float a[3], const float b[3], const float c[3])
+{
+  const float e1[3] = {b[0]-a[0], b[1]-a[1], b[2]-a[2]};
+  const float e2[3] = {c[0]-a[0], c[1]-a[1], c[2]-a[2]};
+  const float p[3] = {d[1]*e2[2] - d[2]*e2[1], d[2]*e2[0] - d[0]*e2[2], d[0]*e2[1] - d[1]*e2[0]};
+  const float det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+  if (fabsf(det) < 1e-12f)
+    return FLT_MAX;
+
+  const float inv_det = 1.0f / det;
+  const float s[3] = {o[0]-a[0], o[1]-a[1], o[2]-a[2]};
+  const float u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2]) * inv_det;
+  // slightly widen triangle so ray can't slip through shared edges
+  if (u < -RAYCAST_EDGE_EPSILON || u > 1.0f + RAYCAST_EDGE_EPSILON)
+    return FLT_MAX;
+
+  const float q[3] = {s[1]*e1[2] - s[2]*e1[1], s[2]*e1[0] - s[0]*e1[2], s[0]*e1[1] - s[1]*e1[0]};
+  const float v = (d[0]*q[0] + d[1]*q[1] + d[2]*q[2]) * inv_det;
+  if (v < -RAYCAST_EDGE_EPSILON || u + v > 1.0f + RAYCAST_EDGE_EPSILON)
+    return FLT_MAX;
+
+  const float t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2]) * inv_det;
+  return t >= 0.0f ? t : FLT_MAX;
+}
+
+// nearest hit of ray with both triangles of cell, FLT_MAX if missed
+static float intersect_cell(const TERRAIN* tr, int i, int j, const float o[3], const float d[3])
+{
+  const int stride = tr->grid_width + 1;
+  const float* h = tr->heights + j*stride + i;
+  const float x0 = i * tr->cell_size;
+  const float x1 = (i + 1) * tr->cell_size;
+  const float z0 = j * tr->cell_size;
+  const float z1 = (j + 1) * tr->cell_size;
+
+  const float a[3] = {x0, h[0], z0};
+  const float b[3] = {x1, h[1], z0};
+  const float c[3] = {x0, h[stride], z1};
+  const float dd[3] = {x1, h[stride + 1], z1};
+
+  // same triangles as of KRR_TERRAIN_generate(), A-C-B then B-C-D
+  return fminf(intersect_triangle(o, d, a, c, b), intersect_triangle(o, d, b, c, dd));
+}
+
+bool KRR_TERRAIN_raycast(const TERRAIN* tr, vec3 origin, vec3 direction, float max_t, float* out_t)
+{
+  if (tr->minmax_tree == NULL)
+    return false;
+
+  // avoid division by zero, ray parallel to an axis just never crosses its slabs
+  float inv_d[3];
+  for (int k=0; k<3; ++k)
+  {
+    const float d = fabsf(direction[k]) < 1e-20f ? copysignf(1e-20f, direction[k]) : direction[k];
+    inv_d[k] = 1.0f / d;
+  }
+
+  // nodes to visit as level, x, z
+  int stack[RAYCAST_STACK_SIZE][3];
+  int top = 0;
+  stack[top][0] = tr->minmax_levels - 1;
+  stack[top][1] = 0;
+  stack[top][2] = 0;
+  top++;
+
+  // visit children nearer to origin first, so farther ones are mostly pruned once hit is found
+  const int near_x = direction[0] < 0.0f ? 1 : 0;
+  const int near_z = direction[2] < 0.0f ? 1 : 0;
+
+  float best = max_t;
+  bool hit = false;
+  while (top > 0)
+  {
+    top--;
+    const int level = stack[top][0];
+    const int nx = stack[top][1];
+    const int nz = stack[top][2];
+
+    // bounds of node, partial nodes along far edges are cut to the grid
+    const int span = 1 << level;
+    const int cx0 = nx * span;
+    const int cz0 = nz * span;
+    const int cx1 = cx0 + span < tr->grid_width ? cx0 + span : tr->grid_width;
+    const int cz1 = cz0 + span < tr->grid_height ? cz0 + span : tr->grid_height;
+
+    int w, h;
+    minmax_level_size(tr, level, &w, &h);
+    const float* mm = tr->minmax_tree + tr->minmax_level_offset[level] + (nz*w + nx)*2;
+
+    const float bmin[3] = {cx0 * tr->cell_size, mm[0], cz0 * tr->cell_size};
+    const float bmax[3] = {cx1 * tr->cell_size, mm[1], cz1 * tr->cell_size};
+    float t0 = 0.0f;
+    float t1 = best;
+    for (int k=0; k<3; ++k)
+    {
+      float ta = (bmin[k] - origin[k]) * inv_d[k];
+      float tb = (bmax[k] - origin[k]) * inv_d[k];
+      t0 = fmaxf(t0, fminf(ta, tb));
+      t1 = fminf(t1, fmaxf(ta, tb));
+    }
+    if (t0 > t1)
+      continue;
+
+    if (level == 0)
+    {
+      const float t = intersect_cell(tr, nx, nz, origin, direction);
+      if (t < FLT_MAX && t <= best)
+      {
+        best = t;
+        hit = true;
+      }
+      continue;
+    }
+
+    // push far child first, so near child is popped first
+    int cw, ch;
+    minmax_level_size(tr, level - 1, &cw, &ch);
+    static const int order[4][2] = { {1, 1}, {1, 0}, {0, 1}, {0, 0} };
+    for (int k=0; k<4; ++k)
+    {
+      const int ci = nx*2 + (order[k][0] ^ near_x);
+      const int cj = nz*2 + (order[k][1] ^ near_z);
+      if (ci < cw && cj < ch)
+      {
+        stack[top][0] = level - 1;
+        stack[top][1] = ci;
+        stack[top][2] = cj;
+        top++;
+      }
+    }
+  }
+
+  if (hit && out_t != NULL)
+  {
+    *out_t = best;
+  }
+  return hit;
+}
+
+int KRR_TERRAIN_raycast_batch(const TERRAIN* tr, const vec3* origins, const vec3* directions, float max_t, int count, float* out_ts)
+{
+  int hits = 0;
+  for (int i=0; i<count; ++i)
+  {
+    float t;
+    if (KRR_TERRAIN_raycast(tr, (float*)origins[i], (float*)directions[i], max_t, &t))
+    {
+      out_ts[i] = t;
+      hits++;
+    }
+    else
+    {
+      out_ts[i] = -1.0f;
+    }
+  }
+  return hits;
+}
+
+/// recompute normals of grid vertices in [x0, x1] x [z0, z1] from central differences as of KRR_TERRAIN_generate()
+static void update_normals(TERRAIN* tr, int x0, int z0, int x1, int z1)
+{
+  const int stride = tr->grid_width + 1;
+  // generation takes differences of heights before applying height factor
+  const float ny = 2.0f * tr->height_factor;
+  for (int j=z0; j<=z1; ++j)
+  {
+    const float* mid = tr->heights + j*stride;
+    const float* down = tr->heights + (j > 0 ? j - 1 : 0)*stride;
+    const float* up = tr->heights + (j < tr->grid_height ? j + 1 : tr->grid_height)*stride;
+    for (int i=x0; i<=x1; ++i)
+    {
+      const float nx = mid[i > 0 ? i - 1 : 0] - mid[i < tr->grid_width ? i + 1 : tr->grid_width];
+      const float nz = down[i] - up[i];
+      const float inv_len = 1.0f / sqrtf(nx*nx + ny*ny + nz*nz);
+      float* n = tr->normals[j*stride + i];
+      n[0] = nx * inv_len;
+      n[1] = ny * inv_len;
+      n[2] = nz * inv_len;
+    }
+  }
+}
+
+/// upload `count` vertices to vbo starting at `first` vertex, packing them first if needed
+static void upload_vertices_range(const TERRAIN* tr, int first, const VERTEXTEXNORM3D* vertices, int count)
+{
+  if (tr->packed)
+  {
+    VERTEXTEXNORM3D_PACKED packed[UPDATE_MAX_VERTICES];
+    KRR_MESHOPT_pack_vertices_dequant(vertices, count, packed, &tr->dequant);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)first * sizeof(VERTEXTEXNORM3D_PACKED), count * sizeof(VERTEXTEXNORM3D_PACKED), packed);
+  }
+  else
+  {
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)first * sizeof(VERTEXTEXNORM3D), count * sizeof(VERTEXTEXNORM3D), vertices);
+  }
+}
+
+/// upload grid vertices of chunk in [x0, x1] x [z0, z1] of grid
+static void upload_chunk_region(const TERRAIN* tr, int chunk_index, int x0, int z0, int x1, int z1)
+{
+  const TERRAIN_CHUNK* chunk = &tr->chunks[chunk_index];
+
+  // padded vertices past far edges of grid repeat the last row and column
+  int i0 = x0 - chunk->cell_x; if (i0 < 0) i0 = 0;
+  int j0 = z0 - chunk->cell_z; if (j0 < 0) j0 = 0;
+  int i1 = x1 < tr->grid_width ? x1 - chunk->cell_x : CHUNK_CELLS; if (i1 > CHUNK_CELLS) i1 = CHUNK_CELLS;
+  int j1 = z1 < tr->grid_height ? z1 - chunk->cell_z : CHUNK_CELLS; if (j1 > CHUNK_CELLS) j1 = CHUNK_CELLS;
+
+  VERTEXTEXNORM3D row[CHUNK_STRIDE];
+  for (int j=j0; j<=j1; ++j)
+  {
+    const int gz = chunk->cell_z + j < tr->grid_height ? chunk->cell_z + j : tr->grid_height;
+    for (int i=i0; i<=i1; ++i)
+    {
+      const int gx = chunk->cell_x + i < tr->grid_width ? chunk->cell_x + i : tr->grid_width;
+      grid_vertex(tr, gx, gz, 0.0f, &row[i - i0]);
+    }
+    upload_vertices_range(tr, chunk_index*CHUNK_VERTICES + j*CHUNK_STRIDE + i0, row, i1 - i0 + 1);
+  }
+}
+
+/// upload all skirt vertices of chunk
+static void upload_chunk_skirts(const TERRAIN* tr, int chunk_index)
+{
+  const TERRAIN_CHUNK* chunk = &tr->chunks[chunk_index];
+
+  VERTEXTEXNORM3D skirts[CHUNK_PERIMETER];
+  for (int p=0; p<CHUNK_PERIMETER; ++p)
+  {
+    const int v = perimeter_vertex(p);
+    int gx = chunk->cell_x + v % CHUNK_STRIDE; if (gx > tr->grid_width) gx = tr->grid_width;
+    int gz = chunk->cell_z + v / CHUNK_STRIDE; if (gz > tr->grid_height) gz = tr->grid_height;
+    grid_vertex(tr, gx, gz, chunk->skirt_depth, &skirts[p]);
+  }
+  upload_vertices_range(tr, chunk_index*CHUNK_VERTICES + CHUNK_STRIDE*CHUNK_STRIDE, skirts, CHUNK_PERIMETER);
+}
+
+/// widen range of quantization to cover heights from `min_h` to `max_h` if needed, with some headroom
+/// for further edits. Return true if range changed, thus everything needs to be uploaded again.
+static bool widen_quantization(TERRAIN* tr, float min_h, float max_h)
+{
+  float lo, hi;
+  if (tr->heightfield)
+  {
+    lo = tr->heightfield_params.height_offset;
+    hi = lo + tr->heightfield_params.height_scale * 65535.0f;
+  }
+  else if (tr->packed)
+  {
+    lo = tr->dequant.position_offset.y;
+    hi = lo + tr->dequant.position_scale.y;
+  }
+  else
+  {
+    return false;
+  }
+
+  if (min_h >= lo && max_h <= hi)
+    return false;
+
+  if (min_h > lo) min_h = lo;
+  if (max_h < hi) max_h = hi;
+  const float headroom = (max_h - min_h) * QUANTIZATION_HEADROOM;
+  min_h -= headroom;
+  max_h += headroom;
+
+  if (tr->heightfield)
+  {
+    set_heightfield_range(tr, min_h, max_h);
+  }
+  else
+  {
+    tr->dequant.position_offset.y = min_h;
+    tr->dequant.position_scale.y = max_h - min_h;
+  }
+  return true;
+}
+
+bool KRR_TERRAIN_update_heights(TERRAIN* tr, int x0, int z0, int x1, int z1)
+{
+  if (tr->heights == NULL || tr->chunks == NULL)
+    return false;
+
+  if (x0 < 0) x0 = 0;
+  if (z0 < 0) z0 = 0;
+  if (x1 > tr->grid_width) x1 = tr->grid_width;
+  if (z1 > tr->grid_height) z1 = tr->grid_height;
+  if (x0 > x1 || z0 > z1)
+    return true;
+
+  // normals take central differences, so they change one vertex further
+  int rx0 = x0 > 0 ? x0 - 1 : 0;
+  int rz0 = z0 > 0 ? z0 - 1 : 0;
+  int rx1 = x1 < tr->grid_width ? x1 + 1 : tr->grid_width;
+  int rz1 = z1 < tr->grid_height ? z1 + 1 : tr->grid_height;
+  update_normals(tr, rx0, rz0, rx1, rz1);
+
+  // cells having any modified vertex as their corner
+  update_minmax_tree(tr, rx0, rz0, x1 < tr->grid_width ? x1 + 1 : tr->grid_width, z1 < tr->grid_height ? z1 + 1 : tr->grid_height);
+
+  // chunks sharing any changed vertex, a vertex on edge between chunks belongs to both
+  int nx, ny;
+  chunks_size(tr, &nx, &ny);
+  const int cx0 = rx0 > 0 ? (rx0 - 1) / CHUNK_CELLS : 0;
+  const int cz0 = rz0 > 0 ? (rz0 - 1) / CHUNK_CELLS : 0;
+  const int cx1 = rx1 / CHUNK_CELLS < nx ? rx1 / CHUNK_CELLS : nx - 1;
+  const int cz1 = rz1 / CHUNK_CELLS < ny ? rz1 / CHUNK_CELLS : ny - 1;
+
+  for (int cy=cz0; cy<=cz1; ++cy)
+  {
+    for (int cx=cx0; cx<=cx1; ++cx)
+    {
+      update_lod_errors(tr, &tr->chunks[cx + cy*nx]);
+    }
+  }
+
+  // skirts of neighbours depend on errors of changed chunks
+  const int sx0 = cx0 > 0 ? cx0 - 1 : 0;
+  const int sz0 = cz0 > 0 ? cz0 - 1 : 0;
+  const int sx1 = cx1 < nx - 1 ? cx1 + 1 : nx - 1;
+  const int sz1 = cz1 < ny - 1 ? cz1 + 1 : ny - 1;
+  float min_h = FLT_MAX;
+  float max_h = -FLT_MAX;
+  for (int cy=sz0; cy<=sz1; ++cy)
+  {
+    for (int cx=sx0; cx<=sx1; ++cx)
+    {
+      TERRAIN_CHUNK* chunk = &tr->chunks[cx + cy*nx];
+      update_skirt_depth(tr, cx, cy);
+      update_chunk_bounds(tr, chunk);
+      min_h = fminf(min_h, chunk->bounds.aabb_min[1]);
+      max_h = fmaxf(max_h, chunk->bounds.aabb_max[1]);
+    }
+  }
+
+  // whole terrain
+  const float* root = tr->minmax_tree + tr->minmax_level_offset[tr->minmax_levels - 1];
+  tr->bounds.aabb_min[1] = root[0];
+  tr->bounds.aabb_max[1] = root[1];
+  glm_vec3_center(tr->bounds.aabb_min, tr->bounds.aabb_max, tr->bounds.center);
+  tr->bounds.radius = glm_vec3_distance(tr->bounds.aabb_min, tr->bounds.aabb_max) * 0.5f;
+
+  if (tr->heightfield)
+  {
+    // skirts are lowered in vertex shader, only heights are quantized
+    if (widen_quantization(tr, root[0], root[1]))
+    {
+      rx0 = 0; rz0 = 0; rx1 = tr->grid_width; rz1 = tr->grid_height;
+    }
+    upload_heightfield_region(tr, rx0, rz0, rx1, rz1);
+    return true;
+  }
+
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, tr->vbo_id);
+  if (widen_quantization(tr, min_h, max_h))
+  {
+    upload_all_chunks(tr);
+    return true;
+  }
+
+  for (int cy=cz0; cy<=cz1; ++cy)
+  {
+    for (int cx=cx0; cx<=cx1; ++cx)
+    {
+      upload_chunk_region(tr, cx + cy*nx, rx0, rz0, rx1, rz1);
+    }
+  }
+  for (int cy=sz0; cy<=sz1; ++cy)
+  {
+    for (int cx=sx0; cx<=sx1; ++cx)
+    {
+      upload_chunk_skirts(tr, cx + cy*nx);
+    }
+  }
+  return true;
+}
+
+bool KRR_TERRAIN_brush(TERRAIN* tr, float x, float z, float radius, float amount)
+{
+  if (tr->heights == NULL || radius <= 0.0f)
+    return false;
+
+  int x0 = (int)ceilf((x - radius) / tr->cell_size);
+  int z0 = (int)ceilf((z - radius) / tr->cell_size);
+  int x1 = (int)floorf((x + radius) / tr->cell_size);
+  int z1 = (int)floorf((z + radius) / tr->cell_size);
+  if (x0 < 0) x0 = 0;
+  if (z0 < 0) z0 = 0;
+  if (x1 > tr->grid_width) x1 = tr->grid_width;
+  if (z1 > tr->grid_height) z1 = tr->grid_height;
+
+  // smooth falloff reaching zero at radius
+  const float inv_r2 = 1.0f / (radius * radius);
+  for (int j=z0; j<=z1; ++j)
+  {
+    float* restrict row = tr->heights + j*(tr->grid_width + 1);
+    const float dz = j*tr->cell_size - z;
+    for (int i=x0; i<=x1; ++i)
+    {
+      const float dx = i*tr->cell_size - x;
+      float f = 1.0f - (dx*dx + dz*dz) * inv_r2;
+      f = f > 0.0f ? f : 0.0f;
+      row[i] += amount * f * f;
+    }
+  }
+
+  return KRR_TERRAIN_update_heights(tr, x0, z0, x1, z1);
+}
+
+/// mesh tile of paged terrain into vertices of chunk with skirts, along with its LOD errors and bounds.
+/// Grid vertices are the same as of KRR_TERRAIN_generate() for the same heightmap.
+/// Return false if samples of tile cannot be read.
+static bool mesh_tile(const TERRAIN_PAGING* pg, KRR_TERRAINTILES_READER* reader, int tile, VERTEXTEXNORM3D* v, TERRAIN_CHUNK* chunk)
+{
+  const KRR_TERRAINTILES_HEADER* hd = &pg->tiles.header;
+  const int w = hd->grid_width;
+  const int h = hd->grid_height;
+  const int tx = tile % hd->tiles_x;
+  const int tz = tile / hd->tiles_x;
+  // samples of tile start one vertex before its first one along both axes
+  const int stride = CHUNK_CELLS + 3;
+  const GLushort* samples = KRR_TERRAINTILES_read(&pg->tiles, reader, tx, tz);
+  if (samples == NULL)
+    return false;
+  const float scale = pg->height_scale;
+  const float offset = pg->height_offset;
+
+  chunk->vao_id = 0;
+  chunk->cell_x = tx*CHUNK_CELLS;
+  chunk->cell_z = tz*CHUNK_CELLS;
+  chunk->lod = 0;
+
+  // chunks at the far edges are padded by repeating the last row and column of grid, as of build_chunks()
+  float heights[CHUNK_STRIDE * CHUNK_STRIDE];
+  for (int j=0; j<CHUNK_STRIDE; ++j)
+  {
+    int gz = chunk->cell_z + j; if (gz > h) gz = h;
+    const GLushort* mid = samples + (gz - chunk->cell_z + 1)*stride;
+    const GLushort* down = mid - stride;
+    const GLushort* up = mid + stride;
+    for (int i=0; i<CHUNK_STRIDE; ++i)
+    {
+      int gx = chunk->cell_x + i; if (gx > w) gx = w;
+      const int k = gx - chunk->cell_x + 1;
+
+      // central differences, on heights before applying height factor
+      const float x = (mid[k-1] * scale + offset) - (mid[k+1] * scale + offset);
+      const float z = (down[k] * scale + offset) - (up[k] * scale + offset);
+      const float inv_len = 1.0f / sqrtf(x*x + 4.0f + z*z);
+      const float y = (mid[k] * scale + offset) * pg->hfactor;
+      heights[j*CHUNK_STRIDE + i] = y;
+
+      VERTEXTEXNORM3D* out = &v[j*CHUNK_STRIDE + i];
+      out->position.x = gx*pg->size;
+      out->position.y = y;
+      out->position.z = gz*pg->size;
+      out->texcoord.s = (gx*pg->size) / (w*pg->size);
+      out->texcoord.t = (gz*pg->size) / (h*pg->size);
+      out->normal.x = x * inv_len;
+      out->normal.y = 2.0f * inv_len;
+      out->normal.z = z * inv_len;
+    }
+  }
+
+  chunk->lod_errors[0] = 0.0f;
+  for (int l=1; l<KRR_TERRAIN_LODS; ++l)
+  {
+    const float e = lod_error(heights, 1 << l);
+    chunk->lod_errors[l] = e > chunk->lod_errors[l-1] ? e : chunk->lod_errors[l-1];
+  }
+
+  // neighbours may not be resident to take their errors into account as build_chunks() does.
+  // Both sides of shared edge interpolate the same edge vertices though, and errors along the edge
+  // are within errors of this chunk, so the gap is at most twice of them.
+  chunk->skirt_depth = 2.0f * chunk->lod_errors[KRR_TERRAIN_LODS-1];
+  for (int p=0; p<CHUNK_PERIMETER; ++p)
+  {
+    VERTEXTEXNORM3D* skirt = &v[CHUNK_STRIDE*CHUNK_STRIDE + p];
+    *skirt = v[perimeter_vertex(p)];
+    skirt->position.y -= chunk->skirt_depth;
+  }
+
+  KRR_CULL_bounds_from_vertices(v, CHUNK_VERTICES, &chunk->bounds);
+  return true;
+}
+
+static int page_worker_thread(void* data)
+{
+  TERRAIN_PAGE_WORKER* worker = data;
+  TERRAIN_PAGING* pg = worker->pg;
+
+  SDL_LockMutex(pg->mutex);
+  while (!pg->quit)
+  {
+    TERRAIN_STAGING* st = NULL;
+    for (int i=0; i<pg->stagings_count && st == NULL; ++i)
+    {
+      if (pg->stagings[i].state == STAGING_QUEUED)
+        st = &pg->stagings[i];
+    }
+    if (st == NULL)
+    {
+      SDL_CondWait(pg->cond, pg->mutex);
+      continue;
+    }
+
+    st->state = STAGING_MESHING;
+    SDL_UnlockMutex(pg->mutex);
+
+    const bool meshed = mesh_tile(pg, &worker->reader, st->tile, st->vertices, &st->chunk);
+
+    // tile failed to be read is queued again on next update
+    SDL_LockMutex(pg->mutex);
+    st->state = meshed ? STAGING_READY : STAGING_FREE;
+  }
+  SDL_UnlockMutex(pg->mutex);
+
+  return 0;
+}
+
+static int page_hash(const TERRAIN_PAGING* pg, int tile)
+{
+  return (int)(((unsigned int)tile * 2654435761u) & (unsigned int)pg->table_mask);
+}
+
+/// get page holding tile, or -1 if it's not resident
+static int find_page(const TERRAIN_PAGING* pg, int tile)
+{
+  for (int k=page_hash(pg, tile); pg->table[k] >= 0; k=(k + 1) & pg->table_mask)
+  {
+    if (pg->pages[pg->table[k]].tile == tile)
+      return pg->table[k];
+  }
+  return -1;
+}
+
+static void insert_page(TERRAIN_PAGING* pg, int page)
+{
+  int k = page_hash(pg, pg->pages[page].tile);
+  while (pg->table[k] >= 0)
+    k = (k + 1) & pg->table_mask;
+  pg->table[k] = page;
+}
+
+static void remove_page(TERRAIN_PAGING* pg, int page)
+{
+  int hole = page_hash(pg, pg->pages[page].tile);
+  while (pg->table[hole] != page)
+    hole = (hole + 1) & pg->table_mask;
+  pg->table[hole] = -1;
+
+  // shift back following entries of the same run which can no longer be reached past the hole
+  for (int k=(hole + 1) & pg->table_mask; pg->table[k] >= 0; k=(k + 1) & pg->table_mask)
+  {
+    const int home = page_hash(pg, pg->pages[pg->table[k]].tile);
+    if (((k - home) & pg->table_mask) >= ((k - hole) & pg->table_mask))
+    {
+      pg->table[hole] = pg->table[k];
+      pg->table[k] = -1;
+      hole = k;
+    }
+  }
+}
+
+/// get free page, or evict least recently used one not wanted by current update.
+/// Return -1 if all pages are wanted.
+static int acquire_page(TERRAIN* tr)
+{
+  TERRAIN_PAGING* pg = tr->paging;
+
+  int lru = -1;
+  for (int i=0; i<pg->pages_count; ++i)
+  {
+    const TERRAIN_PAGE* page = &pg->pages[i];
+    if (page->tile < 0)
+      return i;
+    if (page->last_used != pg->updates && (lru < 0 || page->last_used < pg->pages[lru].last_used))
+      lru = i;
+  }
+  if (lru < 0)
+    return -1;
+
+  // remove its chunk by moving the last chunk into its place
+  TERRAIN_PAGE* page = &pg->pages[lru];
+  remove_page(pg, lru);
+  const int last = --tr->chunks_count;
+  if (page->chunk != last)
+  {
+    tr->chunks[page->chunk] = tr->chunks[last];
+    pg->chunk_pages[page->chunk] = pg->chunk_pages[last];
+    pg->pages[pg->chunk_pages[last]].chunk = page->chunk;
+  }
+  page->tile = -1;
+  page->chunk = -1;
+  return lru;
+}
+
+/// upload meshed tile into page, making its chunk resident
+static void upload_page(TERRAIN* tr, int page_index, const TERRAIN_STAGING* st)
+{
+  TERRAIN_PAGING* pg = tr->paging;
+  TERRAIN_PAGE* page = &pg->pages[page_index];
+
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, tr->vbo_id);
+  glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)page_index * CHUNK_VERTICES * sizeof(VERTEXTEXNORM3D), CHUNK_VERTICES * sizeof(VERTEXTEXNORM3D), st->vertices);
+
+  page->tile = st->tile;
+  page->last_used = pg->updates;
+  page->chunk = tr->chunks_count++;
+  insert_page(pg, page_index);
+
+  pg->chunk_pages[page->chunk] = page_index;
+  tr->chunks[page->chunk] = st->chunk;
+  tr->chunks[page->chunk].vao_id = page->vao_id;
+}
+
+/// get distance in tiles from camera's tile to tile, along the farther axis
+static int tile_distance(const TERRAIN_PAGING* pg, int tile, int camera_tx, int camera_tz)
+{
+  const int dx = abs(tile % (int)pg->tiles.header.tiles_x - camera_tx);
+  const int dz = abs(tile / (int)pg->tiles.header.tiles_x - camera_tz);
+  return dx > dz ? dx : dz;
+}
+
+bool KRR_TERRAIN_load_paged(TERRAIN* tr, const char* tiles_path, float size, float hfactor)
+{
+  if (tr->heightfield)
+  {
+    KRR_LOGE("Paged terrain cannot be rendered as heightfield");
+    return false;
+  }
+  if (tr->page_radius < 0 || tr->page_uploads_per_update <= 0)
+  {
+    KRR_LOGE("Invalid paging settings, radius = %d, uploads per update = %d", tr->page_radius, tr->page_uploads_per_update);
+    return false;
+  }
+
+  TERRAIN_PAGING* pg = malloc(sizeof(TERRAIN_PAGING));
+  if (!KRR_TERRAINTILES_open(&pg->tiles, tiles_path))
+  {
+    KRR_LOGE("Cannot open tiles file %s", tiles_path);
+    free(pg);
+    return false;
+  }
+  const KRR_TERRAINTILES_HEADER* hd = &pg->tiles.header;
+  if (hd->tile_cells != CHUNK_CELLS)
+  {
+    KRR_LOGE("Tiles of %s are of %u cells, but chunks are of %d cells", tiles_path, hd->tile_cells, CHUNK_CELLS);
+    KRR_TERRAINTILES_close(&pg->tiles);
+    free(pg);
+    return false;
+  }
+  if (!KRR_TERRAINTILES_reader_open(&pg->tiles, &pg->reader))
+  {
+    KRR_TERRAINTILES_close(&pg->tiles);
+    free(pg);
+    return false;
+  }
+
+  // positions span the whole world, too far apart to be quantized into 16 bits
+  if (tr->packed)
+  {
+    KRR_LOGW("Warning: Vertices of paged terrain are not packed");
+    tr->packed = false;
+  }
+
+  pg->height_scale = (MAX_TERRAIN_HEIGHT - MIN_TERRAIN_HEIGHT) / 65535.0f;
+  pg->height_offset = MIN_TERRAIN_HEIGHT;
+  pg->size = size;
+  pg->hfactor = hfactor;
+  tr->paging = pg;
+
+  tr->grid_width = hd->grid_width;
+  tr->grid_height = hd->grid_height;
+  tr->cell_size = size;
+  tr->height_factor = hfactor;
+
+  // whole range heights can take, lowered by the deepest skirts possible
+  const float min_h = MIN_TERRAIN_HEIGHT * hfactor;
+  const float max_h = MAX_TERRAIN_HEIGHT * hfactor;
+  KRR_CULL_BOUNDS* b = &tr->bounds;
+  glm_vec3_copy((vec3){0.0f, min_h - 2.0f*(max_h - min_h), 0.0f}, b->aabb_min);
+  glm_vec3_copy((vec3){tr->grid_width * size, max_h, tr->grid_height * size}, b->aabb_max);
+  glm_vec3_center(b->aabb_min, b->aabb_max, b->center);
+  b->radius = glm_vec3_distance(b->aabb_min, b->aabb_max) * 0.5f;
+
+  // all tiles within radius must fit
+  const int wanted = (2*tr->page_radius + 1) * (2*tr->page_radius + 1);
+  pg->pages_count = tr->page_capacity > 0 ? tr->page_capacity : (2*tr->page_radius + 2) * (2*tr->page_radius + 2);
+  if (pg->pages_count < wanted)
+  {
+    KRR_LOGW("Warning: Page capacity %d is less than %d tiles within radius, use %d", tr->page_capacity, wanted, wanted);
+    pg->pages_count = wanted;
+  }
+
+  pg->pages = malloc(sizeof(TERRAIN_PAGE) * pg->pages_count);
+  pg->chunk_pages = malloc(sizeof(int) * pg->pages_count);
+  for (int i=0; i<pg->pages_count; ++i)
+  {
+    pg->pages[i].tile = -1;
+    pg->pages[i].chunk = -1;
+    pg->pages[i].last_used = 0;
+    pg->pages[i].vao_id = 0;
+  }
+
+  // keep table at most half full
+  int table_size = 1;
+  while (table_size < pg->pages_count * 2)
+    table_size <<= 1;
+  pg->table = malloc(sizeof(int) * table_size);
+  pg->table_mask = table_size - 1;
+  for (int i=0; i<table_size; ++i)
+  {
+    pg->table[i] = -1;
+  }
+  pg->updates = 0;
+
+  // leave a core for rendering thread
+  int workers = SDL_GetCPUCount() - 1;
+  if (workers < 1) workers = 1;
+  if (workers > MAX_PAGE_WORKERS) workers = MAX_PAGE_WORKERS;
+
+  pg->stagings_count = workers * PAGE_STAGINGS_PER_WORKER;
+  pg->stagings = malloc(sizeof(TERRAIN_STAGING) * pg->stagings_count);
+  for (int i=0; i<pg->stagings_count; ++i)
+  {
+    pg->stagings[i].tile = -1;
+    pg->stagings[i].state = STAGING_FREE;
+    pg->stagings[i].vertices = malloc(sizeof(VERTEXTEXNORM3D) * CHUNK_VERTICES);
+  }
+
+  pg->mutex = SDL_CreateMutex();
+  pg->cond = SDL_CreateCond();
+  pg->quit = false;
+  pg->workers_count = 0;
+  for (int i=0; i<workers && pg->mutex != NULL && pg->cond != NULL; ++i)
+  {
+    // fallback to mesh tiles on calling thread if none can be created
+    TERRAIN_PAGE_WORKER* worker = &pg->workers[pg->workers_count];
+    worker->pg = pg;
+    if (!KRR_TERRAINTILES_reader_open(&pg->tiles, &worker->reader))
+      break;
+    worker->thread = SDL_CreateThread(page_worker_thread, "terrainpage", worker);
+    if (worker->thread == NULL)
+    {
+      KRR_LOGW("Warning: Cannot create thread to page terrain, %s", SDL_GetError());
+      KRR_TERRAINTILES_reader_close(&worker->reader);
+      break;
+    }
+    pg->workers_count++;
+  }
+
+  upload_lod_indices(tr);
+
+  // slots of all pages, filled as tiles become resident
+  tr->vertices_count = pg->pages_count * CHUNK_VERTICES;
+  glGenBuffers(1, &tr->vbo_id);
+  KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, tr->vbo_id);
+  glBufferData(GL_ARRAY_BUFFER, tr->vertices_count * sizeof(VERTEXTEXNORM3D), NULL, GL_DYNAMIC_DRAW);
+
+  tr->chunks = malloc(sizeof(TERRAIN_CHUNK) * pg->pages_count);
+  tr->chunks_count = 0;
+  for (int i=0; i<pg->pages_count; ++i)
+  {
+    pg->pages[i].vao_id = create_vao(tr, i * CHUNK_VERTICES);
+  }
+  tr->vao_id = pg->pages[0].vao_id;
+
+  KRR_LOGI("terrain paged from %s, %ux%u tiles, %d resident at most taking %d KB, %d worker threads", tiles_path, hd->tiles_x, hd->tiles_z, pg->pages_count, (int)(tr->vertices_count * sizeof(VERTEXTEXNORM3D) / 1024), pg->workers_count);
+  return true;
+}
+
+void KRR_TERRAIN_update_paging(TERRAIN* tr, vec3 camera_pos)
+{
+  TERRAIN_PAGING* pg = tr->paging;
+  if (pg == NULL)
+    return;
+  pg->updates++;
+
+  const int tiles_x = pg->tiles.header.tiles_x;
+  const int tiles_z = pg->tiles.header.tiles_z;
+  const float tile_size = CHUNK_CELLS * tr->cell_size;
+  const int camera_tx = (int)floorf(camera_pos[0] / tile_size);
+  const int camera_tz = (int)floorf(camera_pos[2] / tile_size);
+
+  SDL_LockMutex(pg->mutex);
+
+  // walk rings of tiles outward, so nearer missing tiles are queued first
+  bool queued = false;
+  int free_staging = 0;
+  for (int r=0; r<=tr->page_radius; ++r)
+  {
+    for (int dz=-r; dz<=r; ++dz)
+    {
+      // rows between the first and the last one of ring only have both ends on it
+      const int step = (dz == -r || dz == r) ? 1 : 2*r;
+      for (int dx=-r; dx<=r; dx+=step)
+      {
+        const int tx = camera_tx + dx;
+        const int tz = camera_tz + dz;
+        if (tx < 0 || tx >= tiles_x || tz < 0 || tz >= tiles_z)
+          continue;
+
+        const int tile = tz*tiles_x + tx;
+        const int page = find_page(pg, tile);
+        if (page >= 0)
+        {
+          pg->pages[page].last_used = pg->updates;
+          continue;
+        }
+
+        bool staged = false;
+        for (int i=0; i<pg->stagings_count && !staged; ++i)
+        {
+          staged = pg->stagings[i].state != STAGING_FREE && pg->stagings[i].tile == tile;
+        }
+        if (staged)
+          continue;
+
+        while (free_staging < pg->stagings_count && pg->stagings[free_staging].state != STAGING_FREE)
+          free_staging++;
+        if (free_staging < pg->stagings_count)
+        {
+          pg->stagings[free_staging].tile = tile;
+          pg->stagings[free_staging].state = STAGING_QUEUED;
+          queued = true;
+        }
+      }
+    }
+  }
+
+  if (pg->workers_count == 0)
+  {
+    // no worker thread, mesh them right away
+    for (int i=0; i<pg->stagings_count; ++i)
+    {
+      TERRAIN_STAGING* st = &pg->stagings[i];
+      if (st->state == STAGING_QUEUED)
+      {
+        st->state = mesh_tile(pg, &pg->reader, st->tile, st->vertices, &st->chunk) ? STAGING_READY : STAGING_FREE;
+      }
+    }
+  }
+  else if (queued)
+  {
+    SDL_CondBroadcast(pg->cond);
+  }
+
+  // ready ones are only touched by this thread, upload them without blocking worker threads
+  int ready[MAX_PAGE_WORKERS * PAGE_STAGINGS_PER_WORKER];
+  int ready_count = 0;
+  for (int i=0; i<pg->stagings_count; ++i)
+  {
+    if (pg->stagings[i].state == STAGING_READY)
+      ready[ready_count++] = i;
+  }
+  SDL_UnlockMutex(pg->mutex);
+
+  // upload nearest to camera first within budget, drop ones camera moved away from while being meshed
+  bool done[MAX_PAGE_WORKERS * PAGE_STAGINGS_PER_WORKER];
+  for (int i=0; i<ready_count; ++i)
+  {
+    done[i] = tile_distance(pg, pg->stagings[ready[i]].tile, camera_tx, camera_tz) > tr->page_radius;
+  }
+  for (int uploads=0; uploads<tr->page_uploads_per_update; ++uploads)
+  {
+    int nearest = -1;
+    int nearest_distance = 0;
+    for (int i=0; i<ready_count; ++i)
+    {
+      if (done[i])
+        continue;
+      const int d = tile_distance(pg, pg->stagings[ready[i]].tile, camera_tx, camera_tz);
+      if (nearest < 0 || d < nearest_distance)
+      {
+        nearest = i;
+        nearest_distance = d;
+      }
+    }
+    if (nearest < 0)
+      break;
+
+    const int page = acquire_page(tr);
+    if (page < 0)
+      break;
+    upload_page(tr, page, &pg->stagings[ready[nearest]]);
+    done[nearest] = true;
+  }
+
+  SDL_LockMutex(pg->mutex);
+  for (int i=0; i<ready_count; ++i)
+  {
+    if (done[i])
+      pg->stagings[ready[i]].state = STAGING_FREE;
+  }
+  SDL_UnlockMutex(pg->mutex);
+}
+
+void KRR_TERRAIN_unload(TERRAIN* tr)
+{
+  // just call internal freeing
+  // with this we don't free the source itself
+  // as we will need it for future loading
+  KRR_TERRAIN_free_internals(tr);
+}
+
+void KRR_TERRAIN_free(TERRAIN* tr)
+{
+  KRR_TERRAIN_free_internals(tr);
+  
+  // free source
+  free(tr);
+  tr = NULL;
+}
+
+// band of grid rows generated by one thread in KRR_TERRAIN_generate()
+typedef struct
+{
+  const GLushort* pixels;
+  // conversion of heightmap samples into heights
+  float height_scale;
+  float height_offset;
+  int grid_width;
+  int grid_height;
+  float size;
+  float hfactor;
+
+  // rows [row_begin, row_end) of grid vertices to generate
+  int row_begin;
+  int row_end;
+
+  VERTEXTEXNORM3D* vertices;
+  GLuint* indices;
+  float* heights;
+  vec3* normals;
+} GENERATE_BAND;
+
+// convert row `j` of heightmap, clamped to its edges, into `dst`
+// dst[k] holds converted height of pixel at column k-1 clamped, for k in [0, grid_width+2]
+// so neighbours of vertex i are at dst[i] and dst[i+2] without clamping
+static void convert_heightmap_row(const GENERATE_BAND* b, int j, float* restrict dst)
+{
+  if (j < 0) j = 0;
+  if (j >= b->grid_height) j = b->grid_height - 1;
+
+  const int w = b->grid_width;
+  const GLushort* restrict row = b->pixels + j*w;
+  const float scale = b->height_scale;
+  const float offset = b->height_offset;
+  for (int i=0; i<w; ++i)
+  {
+    dst[i+1] = row[i] * scale + offset;
+  }
+  dst[0] = dst[1];
+  dst[w+1] = dst[w];
+  dst[w+2] = dst[w];
+}
+
+static void generate_band(GENERATE_BAND* b)
+{
+  const int w = b->grid_width;
+  const int h = b->grid_height;
+  const int real_width_size = w + 1;
+
+  // three converted rows around current one, plus normal of each vertex along it
+  float* scratch = malloc(sizeof(float) * (3*(w+3) + 3*(w+1)));
+  float* down = scratch;
+  float* mid = down + (w+3);
+  float* up = mid + (w+3);
+  float* nx = up + (w+3);
+  float* ny = nx + (w+1);
+  float* nz = ny + (w+1);
+
+  convert_heightmap_row(b, b->row_begin - 1, down);
+  convert_heightmap_row(b, b->row_begin, mid);
+  convert_heightmap_row(b, b->row_begin + 1, up);
+
+  for (int j=b->row_begin; j<b->row_end; ++j)
+  {
+    // central differences, on heights before applying height factor
+    {
+      const float* restrict l = mid;
+      const float* restrict d = down;
+      const float* restrict u = up;
+      float* restrict ox = nx;
+      float* restrict oy = ny;
+      float* restrict oz = nz;
+      for (int i=0; i<=w; ++i)
+      {
+        const float x = l[i] - l[i+2];
+        const float z = d[i+1] - u[i+1];
+        const float inv_len = 1.0f / sqrtf(x*x + 4.0f + z*z);
+        ox[i] = x * inv_len;
+        oy[i] = 2.0f * inv_len;
+        oz[i] = z * inv_len;
+      }
+    }
+
+    float* restrict hs = b->heights + j*real_width_size;
+    vec3* restrict ns = b->normals + j*real_width_size;
+    for (int i=0; i<=w; ++i)
+    {
+      hs[i] = mid[i+1] * b->hfactor;
+      ns[i][0] = nx[i];
+      ns[i][1] = ny[i];
+      ns[i][2] = nz[i];
+    }
+
+    if (b->vertices != NULL)
+    {
+      VERTEXTEXNORM3D* restrict v = b->vertices + j*real_width_size;
+      for (int i=0; i<=w; ++i)
+      {
+        v[i].position.x = i*b->size;
+        v[i].position.y = hs[i];
+        v[i].position.z = j*b->size;
+
+        // repeating of texture coord will be set in shader code
+        v[i].texcoord.s = (i*b->size) / (w*b->size);
+        v[i].texcoord.t = (j*b->size) / (h*b->size);
+
+        v[i].normal.x = nx[i];
+        v[i].normal.y = ny[i];
+        v[i].normal.z = nz[i];
+      }
+    }
+
+    // cells below this row of vertices
+    if (j < h && b->indices != NULL)
+    {
+      GLuint* restrict ids = b->indices + j*w*6;
+      const GLuint row = j*real_width_size;
+      for (int i=0; i<w; ++i)
+      {
+        ids[i*6 + 0] = row + i;
+        ids[i*6 + 1] = row + real_width_size + i;
+        ids[i*6 + 2] = row + i + 1;
+
+        ids[i*6 + 3] = row + i + 1;
+        ids[i*6 + 4] = row + real_width_size + i;
+        ids[i*6 + 5] = row + real_width_size + i + 1;
+      }
+    }
+
+    // slide rows down by one, reusing buffer of the row falling off
+    float* t = down;
+    down = mid;
+    mid = up;
+    up = t;
+    convert_heightmap_row(b, j + 2, up);
+  }
+
+  free(scratch);
+}
+
+static int generate_band_thread(void* data)
+{
+  generate_band(data);
+  return 0;
+}
+
+bool KRR_TERRAIN_generate(const char* heightmap_path, float size, float hfactor, VERTEXTEXNORM3D** dst_vertices, int* vertices_count, GLuint** dst_indices, int* indices_count, int* rst_grid_width, int* rst_grid_height, float** rst_heights, vec3** rst_normals)
+{
+  // load the heightmap, it's decoded on CPU without going through GL
+  KRR_HEIGHTMAP* heightmap = KRR_HEIGHTMAP_new();
+  if (!KRR_HEIGHTMAP_load(heightmap, heightmap_path))
+  {
+    KRR_LOGE("Error loading height map file file");
+    KRR_HEIGHTMAP_free(heightmap);
+    return false;
+  }
+
+  bool result = KRR_TERRAIN_generate_from_heightmap(heightmap, size, hfactor, dst_vertices, vertices_count, dst_indices, indices_count, rst_grid_width, rst_grid_height, rst_heights, rst_normals);
+
+  // free heightmap
+  KRR_HEIGHTMAP_free(heightmap);
+  heightmap = NULL;
+
+  return result;
+}
+
+bool KRR_TERRAIN_generate_from_heightmap(const KRR_HEIGHTMAP* heightmap, float size, float hfactor, VERTEXTEXNORM3D** dst_vertices, int* vertices_count, GLuint** dst_indices, int* indices_count, int* rst_grid_width, int* rst_grid_height, float** rst_heights, vec3** rst_normals)
+{
+  if (heightmap->pixels == NULL)
+  {
+    KRR_LOGE("Heightmap to generate terrain from is empty");
+    return false;
+  }
+
+  const int grid_width_size = heightmap->width;
+  const int grid_height_size = heightmap->height;
+  const int verts_count = (grid_width_size + 1) * (grid_height_size + 1);
+  const int ids_count = grid_width_size * grid_height_size * 2 * 3;
+
+  // flat grid of vertices and its triangles are only generated when asked for
+  VERTEXTEXNORM3D* vertices = dst_vertices != NULL ? malloc(sizeof(VERTEXTEXNORM3D) * verts_count) : NULL;
+  GLuint* indices = dst_indices != NULL ? malloc(sizeof(GLuint) * ids_count) : NULL;
+
+  // create heights memory space to store height information
+  // that will allow user to access such data and use in the game
+  float* heights = malloc(verts_count * sizeof(float));
+
+  // create normals memory space to store normal information
+  // that will allow user to access in the game i.e. rotate object on
+  // terrain according to make it oriented with normals on that position of terrain
+  // note: remember to free this memory space with KRR_MEM_free8()
+  vec3* normals = KRR_MEM_malloc8(verts_count * sizeof(vec3));
+
+  // convert to proper range of height value
+  // we try to convert it into range that has no need to be adjusted in-game later i.e. [-N,N]
+  const float height_scale = (MAX_TERRAIN_HEIGHT - MIN_TERRAIN_HEIGHT) / 65535.0f;
+  const float height_offset = MIN_TERRAIN_HEIGHT;
+
+  // split rows of grid vertices into bands, each one is generated independently
+  const int rows = grid_height_size + 1;
+  int bands_count = SDL_GetCPUCount();
+  if (bands_count > rows / MIN_GENERATE_BAND_ROWS)
+    bands_count = rows / MIN_GENERATE_BAND_ROWS;
+  if (bands_count > MAX_GENERATE_BANDS)
+    bands_count = MAX_GENERATE_BANDS;
+  if (bands_count < 1)
+    bands_count = 1;
+
+  //
+  // A ---- B
+  // |    / |
+  // |  /   |
+  // C ---- D
+  //
+  // each cell is 2 triangles, A-C-B then B-C-D
+  GENERATE_BAND bands[MAX_GENERATE_BANDS];
+  for (int i=0; i<bands_count; ++i)
+  {
+    GENERATE_BAND* b = &bands[i];
+    b->pixels = heightmap->pixels;
+    b->height_scale = height_scale;
+    b->height_offset = height_offset;
+    b->grid_width = grid_width_size;
+    b->grid_height = grid_height_size;
+    b->size = size;
+    b->hfactor = hfactor;
+    b->row_begin = rows * i / bands_count;
+    b->row_end = rows * (i + 1) / bands_count;
+    b->vertices = vertices;
+    b->indices = indices;
+    b->heights = heights;
+    b->normals = normals;
+  }
+
+  // the first band is generated on this thread, others on worker threads
+  SDL_Thread* threads[MAX_GENERATE_BANDS];
+  for (int i=1; i<bands_count; ++i)
+  {
+    threads[i] = SDL_CreateThread(generate_band_thread, "terraingen", &bands[i]);
+    // fallback to generate it later on this thread
+    if (threads[i] == NULL)
+    {
+      KRR_LOGW("Warning: Cannot create thread to generate terrain, %s", SDL_GetError());
+    }
+  }
+  generate_band(&bands[0]);
+  for (int i=1; i<bands_count; ++i)
+  {
+    if (threads[i] != NULL)
+    {
+      SDL_WaitThread(threads[i], NULL);
+    }
+    else
+    {
+      generate_band(&bands[i]);
+    }
+  }
+
+  // return the results
+  if (dst_vertices != NULL)
+  {
+    *dst_vertices = vertices;
+  }
+  if (vertices_count != NULL)
+  {
+    *vertices_count = verts_count;
+  }
+  if (dst_indices != NULL)
+  {
+    *dst_indices = indices;
+  }
+  if (indices_count != NULL)
+  {
+    *indices_count = ids_count;
+  }
+  if (rst_grid_width != NULL)
+  {
+    *rst_grid_width = grid_width_size;
+  }
+  if (rst_grid_height != NULL)
+  {
+    *rst_grid_height = grid_height_size;
+  }
+  if (rst_heights != NULL)
   {
     *rst_heights = heights;
   }
+  else
+  {
+    free(heights);
+  }
   if (rst_normals != NULL)
   {
     *rst_normals = normals;
   }
+  else
+  {
+    KRR_MEM_free8(normals);
+  }
 
   return true;
 }
@@ -1,4 +1,5 @@
 #include "krr/graphics/terrain_shader3d.h"
+#include "krr/graphics/sceneubo.h"
 #include <stdlib.h>
 #include <string.h>
 #include "krr/foundation/log.h"
@@ -22,39 +23,25 @@ KRR_TERRAINSHADERPROG3D* KRR_TERRAINSHADERPROG3D_new(void)
   out->multitexture_texture_g_location = -1;
   out->multitexture_texture_b_location = -1;
   out->multitexture_blendmap_location = -1;
-  glm_mat4_identity(out->projection_matrix);
-  out->projection_matrix_location = -1;
-  glm_mat4_identity(out->view_matrix);
-  out->view_matrix_location = -1;
   glm_mat4_identity(out->model_matrix);
   out->model_matrix_location = -1;
-  for (int i=0; i<KRR_SHADERPROG_MAX_LIGHTS; ++i)
-  {
-    out->light_position_locations[i] = -1;
-    out->light_color_locations[i] = -1;
-    out->light_attenuation_locations[i] = -1;
-
-    memset(&out->lights[i].pos, 0, sizeof(out->lights[i].pos)); 
-    out->lights[i].color.r = 1.0f;
-    out->lights[i].color.g = 1.0f;
-    out->lights[i].color.b = 1.0f;
-    out->lights[i].attenuation_factor = 0.0f;
-  }
-  out->light_num_location = -1;
   out->shine_damper = 1.0f;
   out->reflectivity = 0.0f;
   out->texcoord_repeat_location = -1;
   out->texcoord_repeat = 20.0f;
-  out->ambient_color_location = -1;
-  glm_vec3_one(out->ambient_color);
-  out->sky_color_location = -1;
-  glm_vec3_copy((vec3){0.5f, 0.5f, 0.5f}, out->sky_color);
-  out->fog_enabled_location = -1;
-  out->fog_enabled = false;
-  out->fog_density_location = -1;
-  out->fog_gradient_location = -1;
-  out->fog_density = 0.0055;
-  out->fog_gradient = 1.5;
+  out->dequant_position_location = -1;
+  out->dequant_texcoord_location = -1;
+  out->dequant.position_offset = (VERTEXPOS3D){0.0f, 0.0f, 0.0f};
+  out->dequant.position_scale = (VERTEXPOS3D){1.0f, 1.0f, 1.0f};
+  out->dequant.texcoord_offset = (TEXCOORD2D){0.0f, 0.0f};
+  out->dequant.texcoord_scale = (TEXCOORD2D){1.0f, 1.0f};
+  out->heightfield = false;
+  out->grid_vertex_location = -1;
+  out->patch_location = -1;
+  out->heightmap_sampler_location = -1;
+  out->normalmap_sampler_location = -1;
+  out->heightfield_params_location = -1;
+  memset(&out->heightfield_params, 0, sizeof(out->heightfield_params));
 
   // create underlying shader program
   out->program = KRR_SHADERPROG_new();
@@ -72,7 +59,7 @@ void KRR_TERRAINSHADERPROG3D_free(KRR_TERRAINSHADERPROG3D* program)
   program = NULL;
 }
 
-bool KRR_TERRAINSHADERPROG3D_load_program(KRR_TERRAINSHADERPROG3D* program)
+static bool load_program(KRR_TERRAINSHADERPROG3D* program, const char* vertex_shader_path, const char* fragment_shader_path)
 {
   // get underlying shader program
   KRR_SHADERPROG* uprog = program->program;
@@ -81,7 +68,7 @@ bool KRR_TERRAINSHADERPROG3D_load_program(KRR_TERRAINSHADERPROG3D* program)
   uprog->program_id = glCreateProgram();
 
   // load vertex shader
-  GLuint vertex_shader = KRR_SHADERPROG_load_shader_from_file("res/shaders/terrain3d.vert", GL_VERTEX_SHADER);
+  GLuint vertex_shader = KRR_SHADERPROG_load_shader_from_file(vertex_shader_path, GL_VERTEX_SHADER);
   // check errors
   if (vertex_shader == -1)
   {
@@ -94,7 +81,7 @@ bool KRR_TERRAINSHADERPROG3D_load_program(KRR_TERRAINSHADERPROG3D* program)
   glAttachShader(uprog->program_id, vertex_shader);
 
   // create fragment shader
-  GLuint fragment_shader = KRR_SHADERPROG_load_shader_from_file("res/shaders/terrain3d.frag", GL_FRAGMENT_SHADER);
+  GLuint fragment_shader = KRR_SHADERPROG_load_shader_from_file(fragment_shader_path, GL_FRAGMENT_SHADER);
   // check errors
   if (fragment_shader == -1)
   {
@@ -139,37 +126,61 @@ bool KRR_TERRAINSHADERPROG3D_load_program(KRR_TERRAINSHADERPROG3D* program)
   glDeleteShader(fragment_shader);
   fragment_shader = -1;
 
+  // connect camera and lights to uniform buffers shared by all 3D shaders
+  KRR_SCENEUBO_bind_blocks(uprog->program_id);
+
   // get variable locations
-  program->projection_matrix_location = glGetUniformLocation(uprog->program_id, "projection_matrix");
-  if (program->projection_matrix_location == -1)
-  {
-    KRR_LOGW("Warning: projection_matrix is invalid glsl variable name");
-  }
-  program->view_matrix_location = glGetUniformLocation(uprog->program_id, "view_matrix");
-  if (program->view_matrix_location == -1)
-  {
-    KRR_LOGW("Warning: view_matrix is invalid glsl variable name");
-  }
   program->model_matrix_location = glGetUniformLocation(uprog->program_id, "model_matrix");
   if (program->model_matrix_location == -1)
   {
     KRR_LOGW("Warning: model_matrix is invalid glsl variable name");
   }
 
-  program->vertex_pos3d_location = glGetAttribLocation(uprog->program_id, "vertex_pos3d");
-  if (program->vertex_pos3d_location == -1)
-  {
-    KRR_LOGW("Warning: vertex_pos3d is invalid glsl variable name");
-  }
-  program->texcoord_location = glGetAttribLocation(uprog->program_id, "texcoord");
-  if (program->texcoord_location == -1)
+  if (program->heightfield)
   {
-    KRR_LOGW("Warning: texcoord_location is invalid glsl variable name");
+    program->grid_vertex_location = glGetAttribLocation(uprog->program_id, "grid_vertex");
+    if (program->grid_vertex_location == -1)
+    {
+      KRR_LOGW("Warning: grid_vertex is invalid glsl variable name");
+    }
+    program->patch_location = glGetAttribLocation(uprog->program_id, "patch");
+    if (program->patch_location == -1)
+    {
+      KRR_LOGW("Warning: patch is invalid glsl variable name");
+    }
+    program->heightmap_sampler_location = glGetUniformLocation(uprog->program_id, "heightmap_sampler");
+    if (program->heightmap_sampler_location == -1)
+    {
+      KRR_LOGW("Warning: heightmap_sampler is invalid glsl variable name");
+    }
+    program->normalmap_sampler_location = glGetUniformLocation(uprog->program_id, "normalmap_sampler");
+    if (program->normalmap_sampler_location == -1)
+    {
+      KRR_LOGW("Warning: normalmap_sampler is invalid glsl variable name");
+    }
+    program->heightfield_params_location = glGetUniformLocation(uprog->program_id, "heightfield_params");
+    if (program->heightfield_params_location == -1)
+    {
+      KRR_LOGW("Warning: heightfield_params is invalid glsl variable name");
+    }
   }
-  program->normal_location = glGetAttribLocation(uprog->program_id, "normal");
-  if (program->normal_location == -1)
+  else
   {
-    KRR_LOGW("Warning: normal_location is invalid glsl variable name");
+    program->vertex_pos3d_location = glGetAttribLocation(uprog->program_id, "vertex_pos3d");
+    if (program->vertex_pos3d_location == -1)
+    {
+      KRR_LOGW("Warning: vertex_pos3d is invalid glsl variable name");
+    }
+    program->texcoord_location = glGetAttribLocation(uprog->program_id, "texcoord");
+    if (program->texcoord_location == -1)
+    {
+      KRR_LOGW("Warning: texcoord_location is invalid glsl variable name");
+    }
+    program->normal_location = glGetAttribLocation(uprog->program_id, "normal");
+    if (program->normal_location == -1)
+    {
+      KRR_LOGW("Warning: normal_location is invalid glsl variable name");
+    }
   }
   program->texture_sampler_location = glGetUniformLocation(uprog->program_id, "texture_sampler");
   if (program->texture_sampler_location == -1)
@@ -201,45 +212,6 @@ bool KRR_TERRAINSHADERPROG3D_load_program(KRR_TERRAINSHADERPROG3D* program)
   {
     KRR_LOGW("Warning: multitexture_blendmap is invalid glsl variable name");
   }
-
-  program->light_num_location = glGetUniformLocation(uprog->program_id, "light_num");
-  if (program->light_num_location == -1)
-  {
-    KRR_LOGW("Warning: light_num is invalid glsl variable name");
-  }
-
-  // exact byte allocation enough to hold "light_attenuation[%d], light_position[%d]" and "light_color[%d]"
-  const int temp_str_size = 21;
-  char temp_str[temp_str_size];
-  for (int i=0; i<KRR_SHADERPROG_MAX_LIGHTS; ++i)
-  {
-    // form string used to refer to the variable in glsl
-    snprintf(temp_str, temp_str_size, "light_position[%d]", i);
-
-    program->light_position_locations[i] = glGetUniformLocation(uprog->program_id, temp_str);
-    if (program->light_position_locations[i] == -1)
-    {
-      KRR_LOGW("Warning: light_position[%d] is invalid glsl variable name", i);
-    }
-
-    // form string again for "light_color[%d]"
-    snprintf(temp_str, temp_str_size, "light_color[%d]", i);
-
-    program->light_color_locations[i] = glGetUniformLocation(uprog->program_id, temp_str);
-    if (program->light_color_locations[i] == -1)
-    {
-      KRR_LOGW("Warning: light_color[%d] is invalid glsl variable name", i);
-    }
-
-    // form string again for "light_attnuation[%d]"
-    snprintf(temp_str, temp_str_size, "light_attenuation[%d]", i);
-
-    program->light_attenuation_locations[i] = glGetUniformLocation(uprog->program_id, temp_str);
-    if (program->light_attenuation_locations[i] == -1)
-    {
-      KRR_LOGW("Warning: light_attenuation[%d] is invalid glsl variable name", i);
-    }
-  }
   program->shine_damper_location = glGetUniformLocation(uprog->program_id, "shine_damper");
   if (program->shine_damper_location == -1)
   {
@@ -255,162 +227,173 @@ bool KRR_TERRAINSHADERPROG3D_load_program(KRR_TERRAINSHADERPROG3D* program)
   {
     KRR_LOGW("Warning: texcoord_repeat is invalid glsl variable name");
   }
-  program->ambient_color_location = glGetUniformLocation(uprog->program_id, "ambient_color");
-  if (program->ambient_color_location == -1)
-  {
-    KRR_LOGW("Warning: ambient_color is invalid glsl variable name");
-  }
-  program->sky_color_location = glGetUniformLocation(uprog->program_id, "sky_color");
-  if (program->sky_color_location == -1)
-  {
-    KRR_LOGW("Warning: sky_color is invalid glsl variable name");
-  }
-  program->fog_enabled_location = glGetUniformLocation(uprog->program_id, "fog_enabled");
-  if (program->fog_enabled_location == -1)
+
+  if (program->heightfield)
   {
-    KRR_LOGW("Warning: fog_enabled is invalid glsl variable name");
+    // heightfield textures have their own units next to multitexturing ones
+    KRR_TERRAINSHADERPROG3D_set_heightmap_sampler(program, KRR_TERRAINSHADERPROG3D_HEIGHTMAP_UNIT);
+    KRR_TERRAINSHADERPROG3D_set_normalmap_sampler(program, KRR_TERRAINSHADERPROG3D_NORMALMAP_UNIT);
+    return true;
   }
-  program->fog_density_location = glGetUniformLocation(uprog->program_id, "fog_density");
-  if (program->fog_density_location == -1)
+
+  program->dequant_position_location = glGetUniformLocation(uprog->program_id, "dequant_position");
+  if (program->dequant_position_location == -1)
   {
-    KRR_LOGW("Warning: fog_density is invalid glsl variable name");
+    KRR_LOGW("Warning: dequant_position is invalid glsl variable name");
   }
-  program->fog_gradient_location = glGetUniformLocation(uprog->program_id, "fog_gradient");
-  if (program->fog_gradient_location == -1)
+  program->dequant_texcoord_location = glGetUniformLocation(uprog->program_id, "dequant_texcoord");
+  if (program->dequant_texcoord_location == -1)
   {
-    KRR_LOGW("Warning: fog_gradient is invalid glsl variable name");
+    KRR_LOGW("Warning: dequant_texcoord is invalid glsl variable name");
   }
 
+  // uniforms are zero initially, set identity dequantization so full-float vertices
+  // are rendered as they are without user's intervention, it's uploaded when program is first bound
+  KRR_TERRAINSHADERPROG3D_update_dequant(program);
+
   return true;
 }
 
-void KRR_TERRAINSHADERPROG3D_update_projection_matrix(KRR_TERRAINSHADERPROG3D* program)
+bool KRR_TERRAINSHADERPROG3D_load_program(KRR_TERRAINSHADERPROG3D* program)
 {
-  glUniformMatrix4fv(program->projection_matrix_location, 1, GL_FALSE, program->projection_matrix[0]);
+  program->heightfield = false;
+  return load_program(program, "res/shaders/terrain3d.vert", "res/shaders/terrain3d.frag");
 }
 
-void KRR_TERRAINSHADERPROG3D_update_view_matrix(KRR_TERRAINSHADERPROG3D* program)
+bool KRR_TERRAINSHADERPROG3D_load_heightfield_program(KRR_TERRAINSHADERPROG3D* program)
 {
-  glUniformMatrix4fv(program->view_matrix_location, 1, GL_FALSE, program->view_matrix[0]);
+  // fragment shader is shared with vertex-based variant
+  program->heightfield = true;
+  return load_program(program, "res/shaders/terrain3d_heightfield.vert", "res/shaders/terrain3d.frag");
 }
 
 void KRR_TERRAINSHADERPROG3D_update_model_matrix(KRR_TERRAINSHADERPROG3D* program)
 {
-  glUniformMatrix4fv(program->model_matrix_location, 1, GL_FALSE, program->model_matrix[0]);
+  KRR_SHADERPROG_set_uniform(program->program, program->model_matrix_location, GL_FLOAT_MAT4, 1, program->model_matrix[0]);
 }
 
-void KRR_TERRAINSHADERPROG3D_update_lights(KRR_TERRAINSHADERPROG3D* program)
+void KRR_TERRAINSHADERPROG3D_update_texcoord_repeat(KRR_TERRAINSHADERPROG3D* program)
 {
-  for (int i=0; i<KRR_SHADERPROG_MAX_LIGHTS; ++i)
-  {
-    glUniform3fv(program->light_position_locations[i], 1, &program->lights[i].pos.x);
-    glUniform3fv(program->light_color_locations[i], 1, &program->lights[i].color.r);
-    glUniform1f(program->light_attenuation_locations[i], program->lights[i].attenuation_factor);
-  }
+  KRR_SHADERPROG_set_uniform(program->program, program->texcoord_repeat_location, GL_FLOAT, 1, &program->texcoord_repeat);
+}
 
-  // automatically update number of lights to be used in shader
-  glUniform1i(program->light_num_location, KRR_SHADERPROG_MAX_LIGHTS);
+void KRR_TERRAINSHADERPROG3D_update_dequant(KRR_TERRAINSHADERPROG3D* program)
+{
+  // offset and scale are next to each other, send both in one go
+  KRR_SHADERPROG_set_uniform(program->program, program->dequant_position_location, GL_FLOAT_VEC3, 2, &program->dequant.position_offset.x);
+  KRR_SHADERPROG_set_uniform(program->program, program->dequant_texcoord_location, GL_FLOAT_VEC2, 2, &program->dequant.texcoord_offset.s);
 }
 
-void KRR_TERRAINSHADERPROG3D_update_lights_num(KRR_TERRAINSHADERPROG3D* program, int num_lights)
+void KRR_TERRAINSHADERPROG3D_update_heightfield(KRR_TERRAINSHADERPROG3D* program)
 {
-  for (int i=0; i<num_lights; ++i)
-  {
-    // FIXME: possible for further optimization to send struct as whole not one by one
-    glUniform3fv(program->light_position_locations[i], 1, &program->lights[i].pos.x);
-    glUniform3fv(program->light_color_locations[i], 1, &program->lights[i].color.r);
-    glUniform1f(program->light_attenuation_locations[i], program->lights[i].attenuation_factor);
-  }
+  KRR_SHADERPROG_set_uniform(program->program, program->heightfield_params_location, GL_FLOAT_VEC4, 2, &program->heightfield_params.height_offset);
+}
 
-  // automatically update number of lights to be used in shader
-  glUniform1i(program->light_num_location, num_lights);
+void KRR_TERRAINSHADERPROG3D_update_shininess(KRR_TERRAINSHADERPROG3D* program)
+{
+  KRR_SHADERPROG_set_uniform(program->program, program->shine_damper_location, GL_FLOAT, 1, &program->shine_damper);
+  KRR_SHADERPROG_set_uniform(program->program, program->reflectivity_location, GL_FLOAT, 1, &program->reflectivity);
 }
 
-void KRR_TERRAINSHADERPROG3D_update_texcoord_repeat(KRR_TERRAINSHADERPROG3D* program)
+void KRR_TERRAINSHADERPROG3D_set_vertex_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data)
 {
-  glUniform1f(program->texcoord_repeat_location, program->texcoord_repeat);
+  glVertexAttribPointer(program->vertex_pos3d_location, 3, GL_FLOAT, GL_FALSE, stride, data); 
 }
 
-void KRR_TERRAINSHADERPROG3D_update_ambient_color(KRR_TERRAINSHADERPROG3D* program)
+void KRR_TERRAINSHADERPROG3D_set_texcoord_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data)
 {
-  glUniform3fv(program->ambient_color_location, 1, program->ambient_color);
+  glVertexAttribPointer(program->texcoord_location, 2, GL_FLOAT, GL_FALSE, stride, data);
 }
 
-void KRR_TERRAINSHADERPROG3D_update_fog_enabled(KRR_TERRAINSHADERPROG3D* program)
+void KRR_TERRAINSHADERPROG3D_set_normal_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data)
 {
-  // avoid using boolean type as it's not guarunteed to be supported by graphics card
-  // see https://stackoverflow.com/a/33690786/571227
-  glUniform1f(program->fog_enabled_location, program->fog_enabled ? 1.0f : 0.0f);
+  glVertexAttribPointer(program->normal_location, 3, GL_FLOAT, GL_FALSE, stride, data);
 }
 
-void KRR_TERRAINSHADERPROG3D_update_fog_density(KRR_TERRAINSHADERPROG3D* program)
+void KRR_TERRAINSHADERPROG3D_set_packed_vertex_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data)
 {
-  glUniform1f(program->fog_density_location, program->fog_density);
+  glVertexAttribPointer(program->vertex_pos3d_location, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, data);
 }
 
-void KRR_TERRAINSHADERPROG3D_update_fog_gradient(KRR_TERRAINSHADERPROG3D* program)
+void KRR_TERRAINSHADERPROG3D_set_packed_texcoord_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data)
 {
-  glUniform1f(program->fog_gradient_location, program->fog_gradient);
+  glVertexAttribPointer(program->texcoord_location, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, data);
 }
 
-void KRR_TERRAINSHADERPROG3D_update_sky_color(KRR_TERRAINSHADERPROG3D* program)
+void KRR_TERRAINSHADERPROG3D_set_packed_normal_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data)
 {
-  glUniform3fv(program->sky_color_location, 1, program->sky_color);
+  // packed format requires all 4 components, w is ignored by shader
+  glVertexAttribPointer(program->normal_location, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, data);
 }
 
-void KRR_TERRAINSHADERPROG3D_update_shininess(KRR_TERRAINSHADERPROG3D* program)
+void KRR_TERRAINSHADERPROG3D_set_grid_vertex_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data)
 {
-  glUniform1f(program->shine_damper_location, program->shine_damper);
-  glUniform1f(program->reflectivity_location, program->reflectivity);
+  glVertexAttribPointer(program->grid_vertex_location, 3, GL_UNSIGNED_BYTE, GL_FALSE, stride, data);
 }
 
-void KRR_TERRAINSHADERPROG3D_set_vertex_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data)
+void KRR_TERRAINSHADERPROG3D_set_patch_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data)
 {
-  glVertexAttribPointer(program->vertex_pos3d_location, 3, GL_FLOAT, GL_FALSE, stride, data); 
+  glVertexAttribPointer(program->patch_location, 3, GL_FLOAT, GL_FALSE, stride, data);
 }
 
-void KRR_TERRAINSHADERPROG3D_set_texcoord_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data)
+void KRR_TERRAINSHADERPROG3D_set_heightmap_sampler(KRR_TERRAINSHADERPROG3D* program, GLuint sampler)
 {
-  glVertexAttribPointer(program->texcoord_location, 2, GL_FLOAT, GL_FALSE, stride, data);
+  GLint unit = sampler;
+  KRR_SHADERPROG_set_uniform(program->program, program->heightmap_sampler_location, GL_INT, 1, &unit);
 }
 
-void KRR_TERRAINSHADERPROG3D_set_normal_pointer(KRR_TERRAINSHADERPROG3D* program, GLsizei stride, const GLvoid* data)
+void KRR_TERRAINSHADERPROG3D_set_normalmap_sampler(KRR_TERRAINSHADERPROG3D* program, GLuint sampler)
 {
-  glVertexAttribPointer(program->normal_location, 3, GL_FLOAT, GL_FALSE, stride, data);
+  GLint unit = sampler;
+  KRR_SHADERPROG_set_uniform(program->program, program->normalmap_sampler_location, GL_INT, 1, &unit);
 }
 
 void KRR_TERRAINSHADERPROG3D_set_texture_sampler(KRR_TERRAINSHADERPROG3D* program, GLuint sampler)
 {
-  glUniform1i(program->texture_sampler_location, sampler);
+  GLint unit = sampler;
+  KRR_SHADERPROG_set_uniform(program->program, program->texture_sampler_location, GL_INT, 1, &unit);
 }
 
 void KRR_TERRAINSHADERPROG3D_update_multitexture_enabled(KRR_TERRAINSHADERPROG3D* program)
 {
-  glUniform1f(program->multitexture_enabled_location, program->multitexture_enabled ? 1.0f : 0.0f);
+  GLfloat enabled = program->multitexture_enabled ? 1.0f : 0.0f;
+  KRR_SHADERPROG_set_uniform(program->program, program->multitexture_enabled_location, GL_FLOAT, 1, &enabled);
 }
 
 void KRR_TERRAINSHADERPROG3D_set_multitexture_texture_r_sampler(KRR_TERRAINSHADERPROG3D* program, GLuint sampler)
 {
-  glUniform1i(program->multitexture_texture_r_location, sampler);
+  GLint unit = sampler;
+  KRR_SHADERPROG_set_uniform(program->program, program->multitexture_texture_r_location, GL_INT, 1, &unit);
 }
 
 void KRR_TERRAINSHADERPROG3D_set_multitexture_texture_g_sampler(KRR_TERRAINSHADERPROG3D* program, GLuint sampler)
 {
-  glUniform1i(program->multitexture_texture_g_location, sampler);
+  GLint unit = sampler;
+  KRR_SHADERPROG_set_uniform(program->program, program->multitexture_texture_g_location, GL_INT, 1, &unit);
 }
 
 void KRR_TERRAINSHADERPROG3D_set_multitexture_texture_b_sampler(KRR_TERRAINSHADERPROG3D* program, GLuint sampler)
 {
-  glUniform1i(program->multitexture_texture_b_location, sampler);
+  GLint unit = sampler;
+  KRR_SHADERPROG_set_uniform(program->program, program->multitexture_texture_b_location, GL_INT, 1, &unit);
 }
 
 void KRR_TERRAINSHADERPROG3D_set_multitexture_blendmap_sampler(KRR_TERRAINSHADERPROG3D* program, GLuint sampler)
 {
-  glUniform1i(program->multitexture_blendmap_location, sampler);
+  GLint unit = sampler;
+  KRR_SHADERPROG_set_uniform(program->program, program->multitexture_blendmap_location, GL_INT, 1, &unit);
 }
 
 void KRR_TERRAINSHADERPROG3D_enable_attrib_pointers(KRR_TERRAINSHADERPROG3D* program)
 {
+  if (program->heightfield)
+  {
+    glEnableVertexAttribArray(program->grid_vertex_location);
+    glEnableVertexAttribArray(program->patch_location);
+    // patch advances per instance
+    glVertexAttribDivisor(program->patch_location, 1);
+    return;
+  }
   glEnableVertexAttribArray(program->vertex_pos3d_location);
   glEnableVertexAttribArray(program->texcoord_location);
   glEnableVertexAttribArray(program->normal_location);
@@ -418,6 +401,12 @@ void KRR_TERRAINSHADERPROG3D_enable_attrib_pointers(KRR_TERRAINSHADERPROG3D* pro
 
 void KRR_TERRAINSHADERPROG3D_disable_attrib_pointers(KRR_TERRAINSHADERPROG3D* program)
 {
+  if (program->heightfield)
+  {
+    glDisableVertexAttribArray(program->grid_vertex_location);
+    glDisableVertexAttribArray(program->patch_location);
+    return;
+  }
   glDisableVertexAttribArray(program->vertex_pos3d_location);
   glDisableVertexAttribArray(program->texcoord_location);
   glDisableVertexAttribArray(program->normal_location);
@@ -0,0 +1,324 @@
+#include "krr/graphics/terraintiles.h"
+#include "krr/graphics/heightmap.h"
+#include "krr/foundation/log.h"
+#include <SDL2/SDL_stdinc.h>
+#include <SDL2/SDL_rwops.h>
+#include <SDL2/SDL_error.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define TERRAINTILES_MAGIC "KRRT"
+
+// source heightmap being converted, either headerless 16-bit little-endian samples or decoded pixels
+typedef struct
+{
+  const GLubyte* raw;
+  const GLushort* pixels;
+  int width;
+  int height;
+} TILES_SOURCE;
+
+static void init_defaults(KRR_TERRAINTILES* tt)
+{
+  memset(&tt->header, 0, sizeof(tt->header));
+  tt->fm.data = NULL;
+  tt->fm.size = 0;
+  tt->fm.mapped = false;
+  tt->path = NULL;
+}
+
+static bool has_extension(const char* path, const char* ext)
+{
+  size_t path_len = strlen(path);
+  size_t ext_len = strlen(ext);
+  return path_len >= ext_len && SDL_strcasecmp(path + path_len - ext_len, ext) == 0;
+}
+
+static size_t tile_samples(uint32_t tile_cells)
+{
+  return (size_t)(tile_cells + 3) * (tile_cells + 3);
+}
+
+/// get sample at (x, z) clamped to edges of source
+static GLushort source_sample(const TILES_SOURCE* src, int x, int z)
+{
+  if (x < 0) x = 0;
+  if (x >= src->width) x = src->width - 1;
+  if (z < 0) z = 0;
+  if (z >= src->height) z = src->height - 1;
+
+  const size_t i = (size_t)z * src->width + x;
+  if (src->raw != NULL)
+  {
+    // read byte by byte as samples are little-endian regardless of platform
+    return (GLushort)(src->raw[i*2] | (src->raw[i*2 + 1] << 8));
+  }
+  return src->pixels[i];
+}
+
+static bool write_file(const char* tiles_path, const TILES_SOURCE* src, int tile_cells)
+{
+  KRR_TERRAINTILES_HEADER h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, TERRAINTILES_MAGIC, 4);
+  h.version = KRR_TERRAINTILES_VERSION;
+  h.tile_cells = tile_cells;
+  h.grid_width = src->width;
+  h.grid_height = src->height;
+  h.tiles_x = (src->width + tile_cells - 1) / tile_cells;
+  h.tiles_z = (src->height + tile_cells - 1) / tile_cells;
+
+  // write into temporary file first, then replace the target
+  // thus a reader never sees partially written file
+  size_t len = strlen(tiles_path);
+  char* tmp_path = malloc(len + sizeof(".tmp"));
+  memcpy(tmp_path, tiles_path, len);
+  memcpy(tmp_path + len, ".tmp", sizeof(".tmp"));
+
+  FILE* file = fopen(tmp_path, "wb");
+  if (file == NULL)
+  {
+    free(tmp_path);
+    return false;
+  }
+
+  const int stride = tile_cells + 3;
+  const size_t samples = tile_samples(tile_cells);
+  GLushort* tile = malloc(sizeof(GLushort) * samples);
+
+  bool ok = fwrite(&h, sizeof(h), 1, file) == 1;
+  for (uint32_t tz=0; tz<h.tiles_z && ok; ++tz)
+  {
+    for (uint32_t tx=0; tx<h.tiles_x && ok; ++tx)
+    {
+      const int x0 = tx*tile_cells - 1;
+      const int z0 = tz*tile_cells - 1;
+      for (int j=0; j<stride; ++j)
+      {
+        for (int i=0; i<stride; ++i)
+        {
+          tile[j*stride + i] = source_sample(src, x0 + i, z0 + j);
+        }
+      }
+      ok = fwrite(tile, sizeof(GLushort), samples, file) == samples;
+    }
+  }
+  free(tile);
+  ok = fclose(file) == 0 && ok;
+
+  if (ok)
+  {
+    // rename() doesn't replace existing file on Windows
+    remove(tiles_path);
+    ok = rename(tmp_path, tiles_path) == 0;
+  }
+  if (!ok)
+  {
+    remove(tmp_path);
+  }
+
+  free(tmp_path);
+  return ok;
+}
+
+bool KRR_TERRAINTILES_build(const char* heightmap_path, int width, int height, int tile_cells, const char* tiles_path)
+{
+  if (tile_cells <= 0)
+  {
+    KRR_LOGE("Invalid tile size %d", tile_cells);
+    return false;
+  }
+
+  TILES_SOURCE src = { NULL, NULL, 0, 0 };
+  bool ok = false;
+
+  if (has_extension(heightmap_path, ".raw") || has_extension(heightmap_path, ".r16"))
+  {
+    // map instead of reading it whole, it can be larger than memory
+    KRR_FILEMAP fm;
+    if (!KRR_FILEMAP_open(&fm, heightmap_path))
+    {
+      KRR_LOGE("Cannot read heightmap file %s", heightmap_path);
+      return false;
+    }
+
+    if (width == 0 && height == 0)
+    {
+      width = (int)sqrt((double)(fm.size / sizeof(GLushort)));
+      height = width;
+    }
+    if (width <= 0 || height <= 0 || (size_t)width * height * sizeof(GLushort) != fm.size)
+    {
+      KRR_LOGE("Size of raw heightmap %s doesn't match its dimensions", heightmap_path);
+      KRR_FILEMAP_close(&fm);
+      return false;
+    }
+
+    src.raw = fm.data;
+    src.width = width;
+    src.height = height;
+    ok = write_file(tiles_path, &src, tile_cells);
+
+    KRR_FILEMAP_close(&fm);
+  }
+  else
+  {
+    KRR_HEIGHTMAP* heightmap = KRR_HEIGHTMAP_new();
+    if (!KRR_HEIGHTMAP_load(heightmap, heightmap_path))
+    {
+      KRR_HEIGHTMAP_free(heightmap);
+      return false;
+    }
+
+    src.pixels = heightmap->pixels;
+    src.width = heightmap->width;
+    src.height = heightmap->height;
+    ok = write_file(tiles_path, &src, tile_cells);
+
+    KRR_HEIGHTMAP_free(heightmap);
+  }
+
+  if (!ok)
+  {
+    KRR_LOGE("Cannot write tiles file %s", tiles_path);
+    return false;
+  }
+
+  KRR_LOGI("convert heightmap %dx%d into tiles of %d cells at %s", src.width, src.height, tile_cells, tiles_path);
+  return true;
+}
+
+/// check that header is valid for file of `file_size` bytes before trusting any value from it
+static bool valid_header(const KRR_TERRAINTILES_HEADER* h, uint64_t file_size)
+{
+  return file_size >= sizeof(KRR_TERRAINTILES_HEADER) &&
+      memcmp(h->magic, TERRAINTILES_MAGIC, 4) == 0 &&
+      h->version == KRR_TERRAINTILES_VERSION &&
+      h->tile_cells != 0 &&
+      h->grid_width != 0 && h->grid_height != 0 &&
+      h->tiles_x == (h->grid_width + h->tile_cells - 1) / h->tile_cells &&
+      h->tiles_z == (h->grid_height + h->tile_cells - 1) / h->tile_cells &&
+      file_size == sizeof(KRR_TERRAINTILES_HEADER) + (uint64_t)h->tiles_x * h->tiles_z * tile_samples(h->tile_cells) * sizeof(GLushort);
+}
+
+/// open file without mapping it, only its header is read
+static bool open_unmapped(KRR_TERRAINTILES* tt, const char* tiles_path)
+{
+  SDL_RWops* file = SDL_RWFromFile(tiles_path, "rb");
+  if (file == NULL)
+  {
+    return false;
+  }
+
+  KRR_TERRAINTILES_HEADER h;
+  const Sint64 size = SDL_RWsize(file);
+  const bool valid = size >= 0 && SDL_RWread(file, &h, sizeof(h), 1) == 1 && valid_header(&h, (uint64_t)size);
+  SDL_RWclose(file);
+  if (!valid)
+  {
+    KRR_LOGW("Invalid or outdated tiles file %s", tiles_path);
+    return false;
+  }
+
+  tt->header = h;
+  const size_t len = strlen(tiles_path);
+  tt->path = malloc(len + 1);
+  memcpy(tt->path, tiles_path, len + 1);
+  return true;
+}
+
+bool KRR_TERRAINTILES_open(KRR_TERRAINTILES* tt, const char* tiles_path)
+{
+  init_defaults(tt);
+
+  // reading the whole file instead of mapping it would take memory as large as the world
+  if (!KRR_FILEMAP_can_map())
+  {
+    return open_unmapped(tt, tiles_path);
+  }
+
+  if (!KRR_FILEMAP_open(&tt->fm, tiles_path))
+  {
+    return false;
+  }
+
+  const KRR_TERRAINTILES_HEADER* h = tt->fm.data;
+  if (!valid_header(h, tt->fm.size))
+  {
+    KRR_LOGW("Invalid or outdated tiles file %s", tiles_path);
+    KRR_TERRAINTILES_close(tt);
+    return false;
+  }
+
+  tt->header = *h;
+  return true;
+}
+
+const GLushort* KRR_TERRAINTILES_tile(const KRR_TERRAINTILES* tt, int tx, int tz)
+{
+  if (tt->fm.data == NULL)
+  {
+    return NULL;
+  }
+  const GLushort* tiles = (const GLushort*)((const KRR_TERRAINTILES_HEADER*)tt->fm.data + 1);
+  return tiles + ((size_t)tz * tt->header.tiles_x + tx) * tile_samples(tt->header.tile_cells);
+}
+
+bool KRR_TERRAINTILES_reader_open(const KRR_TERRAINTILES* tt, KRR_TERRAINTILES_READER* reader)
+{
+  reader->file = NULL;
+  reader->samples = NULL;
+
+  // mapped file is read directly
+  if (tt->path == NULL)
+  {
+    return true;
+  }
+
+  reader->file = SDL_RWFromFile(tt->path, "rb");
+  if (reader->file == NULL)
+  {
+    KRR_LOGE("Cannot open tiles file %s, %s", tt->path, SDL_GetError());
+    return false;
+  }
+  reader->samples = malloc(sizeof(GLushort) * tile_samples(tt->header.tile_cells));
+  return true;
+}
+
+const GLushort* KRR_TERRAINTILES_read(const KRR_TERRAINTILES* tt, KRR_TERRAINTILES_READER* reader, int tx, int tz)
+{
+  if (reader->file == NULL)
+  {
+    return KRR_TERRAINTILES_tile(tt, tx, tz);
+  }
+
+  const size_t samples = tile_samples(tt->header.tile_cells);
+  const Sint64 offset = (Sint64)(sizeof(KRR_TERRAINTILES_HEADER) + ((size_t)tz * tt->header.tiles_x + tx) * samples * sizeof(GLushort));
+  if (SDL_RWseek(reader->file, offset, RW_SEEK_SET) != offset ||
+      SDL_RWread(reader->file, reader->samples, sizeof(GLushort), samples) != samples)
+  {
+    KRR_LOGE("Cannot read tile (%d, %d) of %s", tx, tz, tt->path);
+    return NULL;
+  }
+  return reader->samples;
+}
+
+void KRR_TERRAINTILES_reader_close(KRR_TERRAINTILES_READER* reader)
+{
+  if (reader->file != NULL)
+  {
+    SDL_RWclose(reader->file);
+  }
+  free(reader->samples);
+  reader->file = NULL;
+  reader->samples = NULL;
+}
+
+void KRR_TERRAINTILES_close(KRR_TERRAINTILES* tt)
+{
+  KRR_FILEMAP_close(&tt->fm);
+  free(tt->path);
+  init_defaults(tt);
+}
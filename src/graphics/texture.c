@@ -1,5 +1,6 @@
 #include "krr/platforms/platforms_config.h"
 #include "krr/graphics/texture.h"
+#include "krr/graphics/glstate.h"
 #include "krr/foundation/common.h"
 #include "krr/foundation/math.h"
 #include "krr/foundation/util.h"
@@ -44,7 +45,7 @@ void KRR_TEXTURE_free_internal_texture(KRR_TEXTURE* texture)
 {
   if (texture != NULL && texture->texture_id != 0)
   {
-    glDeleteTextures(1, &texture->texture_id);
+    KRR_GLSTATE_delete_textures(1, &texture->texture_id);
     texture->texture_id = 0;
   }
 
@@ -474,7 +475,7 @@ bool KRR_TEXTURE_load_dds_texture_from_file(KRR_TEXTURE* texture, const char* pa
   // generate texture id
   glGenTextures(1, &texture_id);
   // bind texture
-  glBindTexture(GL_TEXTURE_2D, texture_id);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, texture_id);
 
   // set texture paremters
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
@@ -507,7 +508,7 @@ bool KRR_TEXTURE_load_dds_texture_from_file(KRR_TEXTURE* texture, const char* pa
   free(images_buffer);
   images_buffer = NULL;
 
-  glBindTexture(GL_TEXTURE_2D, 0);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, 0);
 
   texture->texture_id = texture_id;
   texture->width = header.width;
@@ -625,7 +626,7 @@ bool KRR_TEXTURE_load_dds_texture_from_file(KRR_TEXTURE* texture, const char* pa
   // generate texture id
   glGenTextures(1, &texture_id);
   // bind texture
-  glBindTexture(GL_TEXTURE_2D, texture_id);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, texture_id);
 
   // set texture paremters
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
@@ -659,7 +660,7 @@ bool KRR_TEXTURE_load_dds_texture_from_file(KRR_TEXTURE* texture, const char* pa
   free(images_buffer);
   images_buffer = NULL;
 
-  glBindTexture(GL_TEXTURE_2D, 0);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, 0);
 
   texture->texture_id = texture_id;
   texture->width = header.width;
@@ -772,7 +773,7 @@ bool KRR_TEXTURE_load_texture_from_pixels32(KRR_TEXTURE* texture, GLuint* pixels
   glGenTextures(1, &texture->texture_id);
 
   // bind texture id
-  glBindTexture(GL_TEXTURE_2D, texture->texture_id);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, texture->texture_id);
 
   // set texture parameters
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -801,7 +802,7 @@ bool KRR_TEXTURE_load_texture_from_pixels32(KRR_TEXTURE* texture, GLuint* pixels
   }
 
   // unbind texture
-  glBindTexture(GL_TEXTURE_2D, 0);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, 0);
 
   // free resized buffer (if need)
   if (is_need_to_resize)
@@ -914,7 +915,7 @@ bool KRR_TEXTURE_load_texture_from_pixels8(KRR_TEXTURE* texture, GLubyte* pixels
   glGenTextures(1, &texture->texture_id);
 
   // bind texture id
-  glBindTexture(GL_TEXTURE_2D, texture->texture_id);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, texture->texture_id);
 
   // set texture parameters
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -936,7 +937,7 @@ bool KRR_TEXTURE_load_texture_from_pixels8(KRR_TEXTURE* texture, GLubyte* pixels
   }
 
   // unbind texture
-  glBindTexture(GL_TEXTURE_2D, 0);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, 0);
 
   // free resized buffer (if need)
   if (is_need_to_resize)
@@ -967,10 +968,10 @@ bool KRR_TEXTURE_load_texture_from_pixels8(KRR_TEXTURE* texture, GLubyte* pixels
 void KRR_TEXTURE_bind_vao(KRR_TEXTURE* texture)
 {
   // bind vao
-  glBindVertexArray(texture->VAO_id);
+  KRR_GLSTATE_bind_vertex_array(texture->VAO_id);
 
   // bind texture
-  glBindTexture(GL_TEXTURE_2D, texture->texture_id);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, texture->texture_id);
 }
 
 void KRR_TEXTURE_render(KRR_TEXTURE* texture, GLfloat x, GLfloat y, const RECT* clip)
@@ -1015,12 +1016,13 @@ void KRR_TEXTURE_render(KRR_TEXTURE* texture, GLfloat x, GLfloat y, const RECT*
   KRR_TEXSHADERPROG2D_update_model_matrix(shared_textured_shaderprogram);
 
   // draw
-  glDrawElements(GL_TRIANGLE_FAN, 4, GL_UNSIGNED_INT, NULL);
+  KRR_SHADERPROG_flush(shared_textured_shaderprogram->program);
+  glDrawElements(GL_TRIANGLE_FAN, 4, GL_UNSIGNED_SHORT, NULL);
 }
 
 void KRR_TEXTURE_unbind_vao(KRR_TEXTURE* texture)
 {
-  glBindVertexArray(0);
+  KRR_GLSTATE_bind_vertex_array(0);
 }
 
 bool KRR_TEXTURE_lock(KRR_TEXTURE* texture)
@@ -1052,7 +1054,7 @@ bool KRR_TEXTURE_lock(KRR_TEXTURE* texture)
     glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
     // bind texture
-    glBindTexture(GL_TEXTURE_2D, texture->texture_id);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, texture->texture_id);
 
     // get pixels data from opengl texture
     // no need to consider sRGB here as we just read in data in texture
@@ -1078,9 +1080,9 @@ bool KRR_TEXTURE_lock(KRR_TEXTURE* texture)
     }
     // save current viewport setting, set these values back after reading pixel from fbo
     GLint main_viewport[4];
-    glGetIntegerv(GL_VIEWPORT, main_viewport);
+    KRR_GLSTATE_get_viewport(main_viewport);
     // set viewport to fbo
-    glViewport(0, 0, texture->physical_width_, texture->physical_height_);
+    KRR_GLSTATE_viewport(0, 0, texture->physical_width_, texture->physical_height_);
 
     // read pixels
     if (texture->pixel_format == GL_RED)
@@ -1096,14 +1098,14 @@ bool KRR_TEXTURE_lock(KRR_TEXTURE* texture)
     // bind to main fbo again
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     // set back default viewport
-    glViewport(main_viewport[0], main_viewport[1], main_viewport[2], main_viewport[3]);
+    KRR_GLSTATE_viewport(main_viewport[0], main_viewport[1], main_viewport[2], main_viewport[3]);
 
     // delete fbo
     glDeleteFramebuffers(1, &fbo);
     fbo = -1;
 
     // unbind texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, 0);
 
     return true;
   }
@@ -1118,7 +1120,7 @@ bool KRR_TEXTURE_unlock(KRR_TEXTURE* texture)
   if ((texture->pixels != NULL || texture->pixels8 != NULL) && texture->texture_id != 0)
   {
     // bind current texture
-    glBindTexture(GL_TEXTURE_2D, texture->texture_id);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, texture->texture_id);
 
     // get proper pixel buffer from pixel format texture was created to
     void* pixels = texture->pixel_format == GL_RGBA ? (void*)texture->pixels : (void*)texture->pixels8;
@@ -1139,7 +1141,7 @@ bool KRR_TEXTURE_unlock(KRR_TEXTURE* texture)
     }
 
     // unbind texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, 0);
 
     return true;
   }
@@ -1500,7 +1502,7 @@ bool KRR_TEXTURE_load_texture_from_precreated_pixels32(KRR_TEXTURE* texture)
     glGenTextures(1, &texture->texture_id);
 
     // bind texture id
-    glBindTexture(GL_TEXTURE_2D, texture->texture_id);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, texture->texture_id);
 
     // set texture parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -1518,7 +1520,7 @@ bool KRR_TEXTURE_load_texture_from_precreated_pixels32(KRR_TEXTURE* texture)
 #endif
 
     // unbind texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, 0);
 
     // check for errors
     GLenum error = glGetError();
@@ -1569,7 +1571,7 @@ bool KRR_TEXTURE_load_texture_from_precreated_pixels8(KRR_TEXTURE* texture)
     glGenTextures(1, &texture->texture_id);
 
     // bind texture id
-    glBindTexture(GL_TEXTURE_2D, texture->texture_id);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, texture->texture_id);
 
     // set texture parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -1583,7 +1585,7 @@ bool KRR_TEXTURE_load_texture_from_precreated_pixels8(KRR_TEXTURE* texture)
     glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, texture->physical_width_, texture->physical_height_, 0, GL_RED, GL_UNSIGNED_BYTE, texture->pixels8);
 
     // unbind texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_2D, 0);
 
     // check for errors
     GLenum error = glGetError();
@@ -1663,7 +1665,7 @@ void init_VAO_VBO_IBO(KRR_TEXTURE* texture)
     vertex_data[3].position.x = quad_width;   vertex_data[3].position.y = 0.f;
 
     // set rendering indices
-    GLuint index_data[4];
+    GLushort index_data[4];
     index_data[0] = 0;
     index_data[1] = 1;
     index_data[2] = 2;
@@ -1671,24 +1673,24 @@ void init_VAO_VBO_IBO(KRR_TEXTURE* texture)
 
     // create VBO
     glGenBuffers(1, &texture->VBO_id);
-    glBindBuffer(GL_ARRAY_BUFFER, texture->VBO_id);
+    KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, texture->VBO_id);
     glBufferData(GL_ARRAY_BUFFER, 4 * sizeof(VERTEXTEX2D), vertex_data, GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, 0);
 
     // create IBO
     glGenBuffers(1, &texture->IBO_id);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, texture->IBO_id);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 4 * sizeof(GLuint), index_data, GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, texture->IBO_id);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 4 * sizeof(GLushort), index_data, GL_DYNAMIC_DRAW);
+    KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
     // set up binding process for VAO
-    glBindVertexArray(texture->VAO_id);
+    KRR_GLSTATE_bind_vertex_array(texture->VAO_id);
 
       // enable vertex attribute arrays
       KRR_TEXSHADERPROG2D_enable_attrib_pointers(shared_textured_shaderprogram);
 
       // bind vertex buffer
-      glBindBuffer(GL_ARRAY_BUFFER, texture->VBO_id);
+      KRR_GLSTATE_bind_buffer(GL_ARRAY_BUFFER, texture->VBO_id);
 
       // set texture coordinate data
       KRR_TEXSHADERPROG2D_set_texcoord_pointer(shared_textured_shaderprogram, sizeof(VERTEXTEX2D), (const GLvoid*)offsetof(VERTEXTEX2D, texcoord));
@@ -1696,10 +1698,10 @@ void init_VAO_VBO_IBO(KRR_TEXTURE* texture)
       KRR_TEXSHADERPROG2D_set_vertex_pointer(shared_textured_shaderprogram, sizeof(VERTEXTEX2D), (const GLvoid*)offsetof(VERTEXTEX2D, position));
 
       // bind ibo
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, texture->IBO_id);
+      KRR_GLSTATE_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, texture->IBO_id);
 
     // unbind vao
-    glBindVertexArray(0);
+    KRR_GLSTATE_bind_vertex_array(0);
   }
 }
 
@@ -1707,19 +1709,19 @@ void free_VAO_VBO_IBO(KRR_TEXTURE* texture)
 {
   if (texture->VBO_id != 0)
   {
-    glDeleteBuffers(1, &texture->VBO_id);
+    KRR_GLSTATE_delete_buffers(1, &texture->VBO_id);
     texture->VBO_id = 0;
   }
 
   if (texture->IBO_id != 0)
   {
-    glDeleteBuffers(1, &texture->IBO_id);
+    KRR_GLSTATE_delete_buffers(1, &texture->IBO_id);
     texture->IBO_id = 0;
   }
 
   if (texture->VAO_id != 0)
   {
-    glDeleteVertexArrays(1, &texture->VAO_id);
+    KRR_GLSTATE_delete_vertex_arrays(1, &texture->VAO_id);
     texture->VAO_id = 0;
   }
 }
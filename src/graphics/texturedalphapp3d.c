@@ -1,4 +1,5 @@
 #include "krr/graphics/texturedalphapp3d.h"
+#include "krr/graphics/sceneubo.h"
 #include <stdlib.h>
 #include <string.h>
 #include "krr/foundation/log.h"
@@ -12,44 +13,24 @@ KRR_TEXALPHASHADERPROG3D* KRR_TEXALPHASHADERPROG3D_new(void)
 
   // init defaults first
   out->program = NULL;
+  out->instanced = false;
   out->vertex_pos3d_location = -1;
   out->texcoord_location = -1;
   out->normal_location = -1;
   out->texture_sampler_location = -1;
-  glm_mat4_identity(out->projection_matrix);
-  out->projection_matrix_location = -1;
-  glm_mat4_identity(out->view_matrix);
-  out->view_matrix_location = -1;
   glm_mat4_identity(out->model_matrix);
   out->model_matrix_location = -1;
 	out->clipped_texcoord_location = -1;
 	// all zeros means we don't set such values in shader
 	glm_vec4_zero(out->clipped_texcoord);
-  for (int i=0; i<KRR_SHADERPROG_MAX_LIGHTS; ++i)
-  {
-    out->light_position_locations[i] = -1;
-    out->light_color_locations[i] = -1;
-    out->light_attenuation_locations[i] = -1;
-
-    memset(&out->lights[i].pos, 0, sizeof(out->lights[i].pos)); 
-    out->lights[i].color.r = 1.0f;
-    out->lights[i].color.g = 1.0f;
-    out->lights[i].color.b = 1.0f;
-    out->lights[i].attenuation_factor = 0.0f;
-  }
-  out->light_num_location = -1;
   out->shine_damper = 1.0f;
   out->reflectivity = 0.0f;
-  out->ambient_color_location = -1;
-  glm_vec3_one(out->ambient_color);
-  out->sky_color_location = -1;
-  glm_vec3_copy((vec3){0.5f, 0.5f, 0.5f}, out->sky_color);
-  out->fog_enabled_location = -1;
-  out->fog_enabled = false;
-  out->fog_density_location = -1;
-  out->fog_gradient_location = -1;
-  out->fog_density = 0.0055;
-  out->fog_gradient = 1.5;
+  out->dequant_position_location = -1;
+  out->dequant_texcoord_location = -1;
+  out->dequant.position_offset = (VERTEXPOS3D){0.0f, 0.0f, 0.0f};
+  out->dequant.position_scale = (VERTEXPOS3D){1.0f, 1.0f, 1.0f};
+  out->dequant.texcoord_offset = (TEXCOORD2D){0.0f, 0.0f};
+  out->dequant.texcoord_scale = (TEXCOORD2D){1.0f, 1.0f};
 
   // create underlying shader program
   out->program = KRR_SHADERPROG_new();
@@ -67,7 +48,7 @@ void KRR_TEXALPHASHADERPROG3D_free(KRR_TEXALPHASHADERPROG3D* program)
   program = NULL;
 }
 
-bool KRR_TEXALPHASHADERPROG3D_load_program(KRR_TEXALPHASHADERPROG3D* program)
+static bool load_program(KRR_TEXALPHASHADERPROG3D* program, const char* vertex_shader_path, const char* fragment_shader_path)
 {
   // get underlying shader program
   KRR_SHADERPROG* uprog = program->program;
@@ -76,7 +57,7 @@ bool KRR_TEXALPHASHADERPROG3D_load_program(KRR_TEXALPHASHADERPROG3D* program)
   uprog->program_id = glCreateProgram();
 
   // load vertex shader
-  GLuint vertex_shader = KRR_SHADERPROG_load_shader_from_file("res/shaders/texturedalphapp3d.vert", GL_VERTEX_SHADER);
+  GLuint vertex_shader = KRR_SHADERPROG_load_shader_from_file(vertex_shader_path, GL_VERTEX_SHADER);
   // check errors
   if (vertex_shader == -1)
   {
@@ -89,7 +70,7 @@ bool KRR_TEXALPHASHADERPROG3D_load_program(KRR_TEXALPHASHADERPROG3D* program)
   glAttachShader(uprog->program_id, vertex_shader);
 
   // create fragment shader
-  GLuint fragment_shader = KRR_SHADERPROG_load_shader_from_file("res/shaders/texturedalphapp3d.frag", GL_FRAGMENT_SHADER);
+  GLuint fragment_shader = KRR_SHADERPROG_load_shader_from_file(fragment_shader_path, GL_FRAGMENT_SHADER);
   // check errors
   if (fragment_shader == -1)
   {
@@ -134,17 +115,10 @@ bool KRR_TEXALPHASHADERPROG3D_load_program(KRR_TEXALPHASHADERPROG3D* program)
   glDeleteShader(fragment_shader);
   fragment_shader = -1;
 
+  // connect camera and lights to uniform buffers shared by all 3D shaders
+  KRR_SCENEUBO_bind_blocks(uprog->program_id);
+
   // get variable locations
-  program->projection_matrix_location = glGetUniformLocation(uprog->program_id, "projection_matrix");
-  if (program->projection_matrix_location == -1)
-  {
-    KRR_LOGW("Warning: projection_matrix is invalid glsl variable name");
-  }
-  program->view_matrix_location = glGetUniformLocation(uprog->program_id, "view_matrix");
-  if (program->view_matrix_location == -1)
-  {
-    KRR_LOGW("Warning: view_matrix is invalid glsl variable name");
-  }
   program->model_matrix_location = glGetUniformLocation(uprog->program_id, "model_matrix");
   if (program->model_matrix_location == -1)
   {
@@ -171,42 +145,13 @@ bool KRR_TEXALPHASHADERPROG3D_load_program(KRR_TEXALPHASHADERPROG3D* program)
   {
     KRR_LOGW("Warning: texture_sampler is invalid glsl variable name");
   }
-	program->clipped_texcoord_location = glGetUniformLocation(uprog->program_id, "packed_clip_texture_uv");
-	if (program->clipped_texcoord_location == -1)
-	{
-		KRR_LOGW("Warning: packed_clip_texture_uv is invalid glsl variable name");
-	}
-
-  // exact byte allocation enough to hold "light_attenuation[%d]", "light_position[%d]" and "light_color[%d]"
-  const int temp_str_size = 21;
-  char temp_str[temp_str_size];
-  for (int i=0; i<KRR_SHADERPROG_MAX_LIGHTS; ++i)
+  // instanced variant takes clipped texture coordinate per instance instead
+  if (!program->instanced)
   {
-    // form string used to refer to the variable in glsl
-    snprintf(temp_str, temp_str_size, "light_position[%d]", i);
-
-    program->light_position_locations[i] = glGetUniformLocation(uprog->program_id, temp_str);
-    if (program->light_position_locations[i] == -1)
+    program->clipped_texcoord_location = glGetUniformLocation(uprog->program_id, "packed_clip_texture_uv");
+    if (program->clipped_texcoord_location == -1)
     {
-      KRR_LOGW("Warning: light_position[%d] is invalid glsl variable name", i);
-    }
-
-    // form string again for "light_color[%d]"
-    snprintf(temp_str, temp_str_size, "light_color[%d]", i);
-
-    program->light_color_locations[i] = glGetUniformLocation(uprog->program_id, temp_str);
-    if (program->light_color_locations[i] == -1)
-    {
-      KRR_LOGW("Warning: light_color[%d] is invalid glsl variable name", i);
-    }
-
-    // form string again for "light_attenuation[%d]"
-    snprintf(temp_str, temp_str_size, "light_attenuation[%d]", i);
-
-    program->light_attenuation_locations[i] = glGetUniformLocation(uprog->program_id, temp_str);
-    if (program->light_attenuation_locations[i] == -1)
-    {
-      KRR_LOGW("Warning: light_attenuation[%d] is invalid glsl variable name", i);
+      KRR_LOGW("Warning: packed_clip_texture_uv is invalid glsl variable name");
     }
   }
   program->shine_damper_location = glGetUniformLocation(uprog->program_id, "shine_damper");
@@ -219,132 +164,95 @@ bool KRR_TEXALPHASHADERPROG3D_load_program(KRR_TEXALPHASHADERPROG3D* program)
   {
     KRR_LOGW("Warning: reflectivity is invalid glsl variable name");
   }
-  program->ambient_color_location = glGetUniformLocation(uprog->program_id, "ambient_color");
-  if (program->ambient_color_location == -1)
-  {
-    KRR_LOGW("Warning: ambient color is invalid glsl variable name");
-  }
-  program->sky_color_location = glGetUniformLocation(uprog->program_id, "sky_color");
-  if (program->sky_color_location == -1)
-  {
-    KRR_LOGW("Warning: sky_color is invalid glsl variable name");
-  }
-  program->fog_enabled_location = glGetUniformLocation(uprog->program_id, "fog_enabled");
-  if (program->fog_enabled_location == -1)
+  program->dequant_position_location = glGetUniformLocation(uprog->program_id, "dequant_position");
+  if (program->dequant_position_location == -1)
   {
-    KRR_LOGW("Warning: fog_enabled is invalid glsl variable name");
+    KRR_LOGW("Warning: dequant_position is invalid glsl variable name");
   }
-  program->fog_density_location = glGetUniformLocation(uprog->program_id, "fog_density");
-  if (program->fog_density_location == -1)
+  program->dequant_texcoord_location = glGetUniformLocation(uprog->program_id, "dequant_texcoord");
+  if (program->dequant_texcoord_location == -1)
   {
-    KRR_LOGW("Warning: fog_density is invalid glsl variable name");
-  }
-  program->fog_gradient_location = glGetUniformLocation(uprog->program_id, "fog_gradient");
-  if (program->fog_gradient_location == -1)
-  {
-    KRR_LOGW("Warning: fog_gradient is invalid glsl variable name");
+    KRR_LOGW("Warning: dequant_texcoord is invalid glsl variable name");
   }
 
+  // uniforms are zero initially, set identity dequantization so full-float vertices
+  // are rendered as they are without user's intervention, it's uploaded when program is first bound
+  KRR_TEXALPHASHADERPROG3D_update_dequant(program);
+
   return true;
 }
 
-void KRR_TEXALPHASHADERPROG3D_update_projection_matrix(KRR_TEXALPHASHADERPROG3D* program)
+bool KRR_TEXALPHASHADERPROG3D_load_program(KRR_TEXALPHASHADERPROG3D* program)
 {
-  glUniformMatrix4fv(program->projection_matrix_location, 1, GL_FALSE, program->projection_matrix[0]);
+  program->instanced = false;
+  return load_program(program, "res/shaders/texturedalphapp3d.vert", "res/shaders/texturedalphapp3d.frag");
 }
 
-void KRR_TEXALPHASHADERPROG3D_update_view_matrix(KRR_TEXALPHASHADERPROG3D* program)
+bool KRR_TEXALPHASHADERPROG3D_load_instanced_program(KRR_TEXALPHASHADERPROG3D* program)
 {
-  glUniformMatrix4fv(program->view_matrix_location, 1, GL_FALSE, program->view_matrix[0]);
+  // fragment shader is shared with non-instanced variant
+  program->instanced = true;
+  return load_program(program, "res/shaders/texturedalphapp3d_instanced.vert", "res/shaders/texturedalphapp3d.frag");
 }
 
 void KRR_TEXALPHASHADERPROG3D_update_model_matrix(KRR_TEXALPHASHADERPROG3D* program)
 {
-  glUniformMatrix4fv(program->model_matrix_location, 1, GL_FALSE, program->model_matrix[0]);
+  KRR_SHADERPROG_set_uniform(program->program, program->model_matrix_location, GL_FLOAT_MAT4, 1, program->model_matrix[0]);
 }
 
 void KRR_TEXALPHASHADERPROG3D_update_clipped_texcoord(KRR_TEXALPHASHADERPROG3D* program)
 {
-	glUniform4fv(program->clipped_texcoord_location, 1, &program->clipped_texcoord[0]);
-}
-
-void KRR_TEXALPHASHADERPROG3D_update_lights(KRR_TEXALPHASHADERPROG3D* program)
-{
-  for (int i=0; i<KRR_SHADERPROG_MAX_LIGHTS; ++i)
-  {
-    glUniform3fv(program->light_position_locations[i], 1, &program->lights[i].pos.x);
-    glUniform3fv(program->light_color_locations[i], 1, &program->lights[i].color.r);
-    glUniform1f(program->light_attenuation_locations[i], program->lights[i].attenuation_factor);
-  }
-
-  // automatically update number of lights to be used in shader
-  glUniform1i(program->light_num_location, KRR_SHADERPROG_MAX_LIGHTS);
-}
-
-void KRR_TEXALPHASHADERPROG3D_update_lights_num(KRR_TEXALPHASHADERPROG3D* program, int num_lights)
-{
-  for (int i=0; i<num_lights; ++i)
-  {
-    glUniform3fv(program->light_position_locations[i], 1, &program->lights[i].pos.x);
-    glUniform3fv(program->light_color_locations[i], 1, &program->lights[i].color.r);
-    glUniform1f(program->light_attenuation_locations[i], program->lights[i].attenuation_factor);
-  }
-
-  // automatically update number of lights to be used in shader
-  glUniform1i(program->light_num_location, num_lights);
+	KRR_SHADERPROG_set_uniform(program->program, program->clipped_texcoord_location, GL_FLOAT_VEC4, 1, &program->clipped_texcoord[0]);
 }
 
-void KRR_TEXALPHASHADERPROG3D_update_ambient_color(KRR_TEXALPHASHADERPROG3D* program)
+void KRR_TEXALPHASHADERPROG3D_update_dequant(KRR_TEXALPHASHADERPROG3D* program)
 {
-  glUniform3fv(program->ambient_color_location, 1, program->ambient_color);
+  // offset and scale are next to each other, send both in one go
+  KRR_SHADERPROG_set_uniform(program->program, program->dequant_position_location, GL_FLOAT_VEC3, 2, &program->dequant.position_offset.x);
+  KRR_SHADERPROG_set_uniform(program->program, program->dequant_texcoord_location, GL_FLOAT_VEC2, 2, &program->dequant.texcoord_offset.s);
 }
 
-void KRR_TEXALPHASHADERPROG3D_update_fog_enabled(KRR_TEXALPHASHADERPROG3D* program)
-{
-  // avoid using boolean type as it's not guarunteed to be supported by graphics card
-  // see https://stackoverflow.com/a/33690786/571227
-  glUniform1f(program->fog_enabled_location, program->fog_enabled ? 1.0f : 0.0f);
-}
-
-void KRR_TEXALPHASHADERPROG3D_update_fog_density(KRR_TEXALPHASHADERPROG3D* program)
+void KRR_TEXALPHASHADERPROG3D_update_shininess(KRR_TEXALPHASHADERPROG3D* program)
 {
-  glUniform1f(program->fog_density_location, program->fog_density);
+  KRR_SHADERPROG_set_uniform(program->program, program->shine_damper_location, GL_FLOAT, 1, &program->shine_damper);
+  KRR_SHADERPROG_set_uniform(program->program, program->reflectivity_location, GL_FLOAT, 1, &program->reflectivity);
 }
 
-void KRR_TEXALPHASHADERPROG3D_update_fog_gradient(KRR_TEXALPHASHADERPROG3D* program)
+void KRR_TEXALPHASHADERPROG3D_set_vertex_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data)
 {
-  glUniform1f(program->fog_gradient_location, program->fog_gradient);
+  glVertexAttribPointer(program->vertex_pos3d_location, 3, GL_FLOAT, GL_FALSE, stride, data); 
 }
 
-void KRR_TEXALPHASHADERPROG3D_update_sky_color(KRR_TEXALPHASHADERPROG3D* program)
+void KRR_TEXALPHASHADERPROG3D_set_texcoord_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data)
 {
-  glUniform3fv(program->sky_color_location, 1, program->sky_color);
+  glVertexAttribPointer(program->texcoord_location, 2, GL_FLOAT, GL_FALSE, stride, data);
 }
 
-void KRR_TEXALPHASHADERPROG3D_update_shininess(KRR_TEXALPHASHADERPROG3D* program)
+void KRR_TEXALPHASHADERPROG3D_set_normal_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data)
 {
-  glUniform1f(program->shine_damper_location, program->shine_damper);
-  glUniform1f(program->reflectivity_location, program->reflectivity);
+  glVertexAttribPointer(program->normal_location, 3, GL_FLOAT, GL_FALSE, stride, data);
 }
 
-void KRR_TEXALPHASHADERPROG3D_set_vertex_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data)
+void KRR_TEXALPHASHADERPROG3D_set_packed_vertex_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data)
 {
-  glVertexAttribPointer(program->vertex_pos3d_location, 3, GL_FLOAT, GL_FALSE, stride, data); 
+  glVertexAttribPointer(program->vertex_pos3d_location, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, data);
 }
 
-void KRR_TEXALPHASHADERPROG3D_set_texcoord_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data)
+void KRR_TEXALPHASHADERPROG3D_set_packed_texcoord_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data)
 {
-  glVertexAttribPointer(program->texcoord_location, 2, GL_FLOAT, GL_FALSE, stride, data);
+  glVertexAttribPointer(program->texcoord_location, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, data);
 }
 
-void KRR_TEXALPHASHADERPROG3D_set_normal_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data)
+void KRR_TEXALPHASHADERPROG3D_set_packed_normal_pointer(KRR_TEXALPHASHADERPROG3D* program, GLsizei stride, const GLvoid* data)
 {
-  glVertexAttribPointer(program->normal_location, 3, GL_FLOAT, GL_FALSE, stride, data);
+  // packed format requires all 4 components, w is ignored by shader
+  glVertexAttribPointer(program->normal_location, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, data);
 }
 
 void KRR_TEXALPHASHADERPROG3D_set_texture_sampler(KRR_TEXALPHASHADERPROG3D* program, GLuint sampler)
 {
-  glUniform1i(program->texture_sampler_location, sampler);
+  GLint unit = sampler;
+  KRR_SHADERPROG_set_uniform(program->program, program->texture_sampler_location, GL_INT, 1, &unit);
 }
 
 void KRR_TEXALPHASHADERPROG3D_enable_attrib_pointers(KRR_TEXALPHASHADERPROG3D* program)
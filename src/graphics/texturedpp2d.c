@@ -146,17 +146,17 @@ bool KRR_TEXSHADERPROG2D_load_program(KRR_TEXSHADERPROG2D* program)
 
 void KRR_TEXSHADERPROG2D_update_projection_matrix(KRR_TEXSHADERPROG2D* program)
 {
-  glUniformMatrix4fv(program->projection_matrix_location, 1, GL_FALSE, program->projection_matrix[0]);
+  KRR_SHADERPROG_set_uniform(program->program, program->projection_matrix_location, GL_FLOAT_MAT4, 1, program->projection_matrix[0]);
 }
 
 void KRR_TEXSHADERPROG2D_update_view_matrix(KRR_TEXSHADERPROG2D* program)
 {
-  glUniformMatrix4fv(program->view_matrix_location, 1, GL_FALSE, program->view_matrix[0]);
+  KRR_SHADERPROG_set_uniform(program->program, program->view_matrix_location, GL_FLOAT_MAT4, 1, program->view_matrix[0]);
 }
 
 void KRR_TEXSHADERPROG2D_update_model_matrix(KRR_TEXSHADERPROG2D* program)
 {
-  glUniformMatrix4fv(program->model_matrix_location, 1, GL_FALSE, program->model_matrix[0]);
+  KRR_SHADERPROG_set_uniform(program->program, program->model_matrix_location, GL_FLOAT_MAT4, 1, program->model_matrix[0]);
 }
 
 void KRR_TEXSHADERPROG2D_set_vertex_pointer(KRR_TEXSHADERPROG2D* program, GLsizei stride, const GLvoid* data)
@@ -171,12 +171,13 @@ void KRR_TEXSHADERPROG2D_set_texcoord_pointer(KRR_TEXSHADERPROG2D* program, GLsi
 
 void KRR_TEXSHADERPROG2D_set_texture_color(KRR_TEXSHADERPROG2D* program, COLOR32 color)
 {
-  glUniform4fv(program->texture_color_location, 1, (const GLfloat*)&color);
+  KRR_SHADERPROG_set_uniform(program->program, program->texture_color_location, GL_FLOAT_VEC4, 1, (const GLfloat*)&color);
 }
 
 void KRR_TEXSHADERPROG2D_set_texture_sampler(KRR_TEXSHADERPROG2D* program, GLuint sampler)
 {
-  glUniform1i(program->texture_sampler_location, sampler);
+  GLint unit = sampler;
+  KRR_SHADERPROG_set_uniform(program->program, program->texture_sampler_location, GL_INT, 1, &unit);
 }
 
 void KRR_TEXSHADERPROG2D_enable_attrib_pointers(KRR_TEXSHADERPROG2D* program)
@@ -1,12 +1,14 @@
 #include "krr/graphics/util.h"
+#include "krr/graphics/glstate.h"
 #include <stdarg.h>
+#include <string.h>
 #include "krr/foundation/log.h"
 #include <SDL2/SDL_image.h>
 
 void KRR_gputil_adapt_to_normal(int screen_width, int screen_height)
 {
 	// set viewport
-	glViewport(0.0, 0.0, screen_width, screen_height);
+	KRR_GLSTATE_viewport(0.0, 0.0, screen_width, screen_height);
 }
 
 void KRR_gputil_adapt_to_letterbox(int screen_width, int screen_height, int logical_width, int logical_height, int* result_view_width, int* result_view_height, int* offset_x, int* offset_y)
@@ -32,7 +34,7 @@ void KRR_gputil_adapt_to_letterbox(int screen_width, int screen_height, int logi
 	int viewport_y = (screen_height - view_height) / 2;
 
 	// set viewport
-  glViewport(viewport_x, viewport_y, view_width, view_height);
+  KRR_GLSTATE_viewport(viewport_x, viewport_y, view_width, view_height);
 
 	// returning values back from functions via variables
 	if (result_view_width != NULL)
@@ -170,7 +172,7 @@ int KRR_gputil_load_cubemap(const char* right, const char* left, const char* top
   // generate texture name for cubemap
   GLuint textureID;
   glGenTextures(1, &textureID);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_CUBE_MAP, textureID);
   
   // set texture parameters
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -192,7 +194,7 @@ int KRR_gputil_load_cubemap(const char* right, const char* left, const char* top
   {
     KRR_LOGE("Unable to load %s! Error: %s", right, IMG_GetError());
     // clear generated texture name
-    glDeleteTextures(1, &textureID);
+    KRR_GLSTATE_delete_textures(1, &textureID);
     return -1;
   }
   // convert pixel format
@@ -202,8 +204,8 @@ int KRR_gputil_load_cubemap(const char* right, const char* left, const char* top
     KRR_LOGE("Cannot convert to ABGR8888 format");
     SDL_FreeSurface(temptex);
     
-    glDeleteTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    KRR_GLSTATE_delete_textures(1, &textureID);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_CUBE_MAP, 0);
     return -1;
   }
   SDL_FreeSurface(temptex);
@@ -228,7 +230,7 @@ int KRR_gputil_load_cubemap(const char* right, const char* left, const char* top
   {
     KRR_LOGE("Unable to load %s! Error: %s", left, IMG_GetError());
     // clear generated texture name
-    glDeleteTextures(1, &textureID);
+    KRR_GLSTATE_delete_textures(1, &textureID);
     return -1;
   }
   // convert pixel format
@@ -238,8 +240,8 @@ int KRR_gputil_load_cubemap(const char* right, const char* left, const char* top
     KRR_LOGE("Cannot convert to ABGR8888 format");
     SDL_FreeSurface(temptex);
     
-    glDeleteTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    KRR_GLSTATE_delete_textures(1, &textureID);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_CUBE_MAP, 0);
     return -1;
   }
   SDL_FreeSurface(temptex);
@@ -263,7 +265,7 @@ int KRR_gputil_load_cubemap(const char* right, const char* left, const char* top
   {
     KRR_LOGE("Unable to load %s! Error: %s", top, IMG_GetError());
     // clear generated texture name
-    glDeleteTextures(1, &textureID);
+    KRR_GLSTATE_delete_textures(1, &textureID);
     return -1;
   }
   // convert pixel format
@@ -273,8 +275,8 @@ int KRR_gputil_load_cubemap(const char* right, const char* left, const char* top
     KRR_LOGE("Cannot convert to ABGR8888 format");
     SDL_FreeSurface(temptex);
     
-    glDeleteTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    KRR_GLSTATE_delete_textures(1, &textureID);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_CUBE_MAP, 0);
     return -1;
   }
   SDL_FreeSurface(temptex);
@@ -298,7 +300,7 @@ int KRR_gputil_load_cubemap(const char* right, const char* left, const char* top
   {
     KRR_LOGE("Unable to load %s! Error: %s", bottom, IMG_GetError());
     // clear generated texture name
-    glDeleteTextures(1, &textureID);
+    KRR_GLSTATE_delete_textures(1, &textureID);
     return -1;
   }
   // convert pixel format
@@ -308,8 +310,8 @@ int KRR_gputil_load_cubemap(const char* right, const char* left, const char* top
     KRR_LOGE("Cannot convert to ABGR8888 format");
     SDL_FreeSurface(temptex);
     
-    glDeleteTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    KRR_GLSTATE_delete_textures(1, &textureID);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_CUBE_MAP, 0);
     return -1;
   }
   SDL_FreeSurface(temptex);
@@ -333,7 +335,7 @@ int KRR_gputil_load_cubemap(const char* right, const char* left, const char* top
   {
     KRR_LOGE("Unable to load %s! Error: %s", back, IMG_GetError());
     // clear generated texture name
-    glDeleteTextures(1, &textureID);
+    KRR_GLSTATE_delete_textures(1, &textureID);
     return -1;
   }
   // convert pixel format
@@ -343,8 +345,8 @@ int KRR_gputil_load_cubemap(const char* right, const char* left, const char* top
     KRR_LOGE("Cannot convert to ABGR8888 format");
     SDL_FreeSurface(temptex);
     
-    glDeleteTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    KRR_GLSTATE_delete_textures(1, &textureID);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_CUBE_MAP, 0);
     return -1;
   }
   SDL_FreeSurface(temptex);
@@ -368,7 +370,7 @@ int KRR_gputil_load_cubemap(const char* right, const char* left, const char* top
   {
     KRR_LOGE("Unable to load %s! Error: %s", front, IMG_GetError());
     // clear generated texture name
-    glDeleteTextures(1, &textureID);
+    KRR_GLSTATE_delete_textures(1, &textureID);
     return -1;
   }
   // convert pixel format
@@ -378,8 +380,8 @@ int KRR_gputil_load_cubemap(const char* right, const char* left, const char* top
     KRR_LOGE("Cannot convert to ABGR8888 format");
     SDL_FreeSurface(temptex);
     
-    glDeleteTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    KRR_GLSTATE_delete_textures(1, &textureID);
+    KRR_GLSTATE_bind_texture(GL_TEXTURE_CUBE_MAP, 0);
     return -1;
   }
   SDL_FreeSurface(temptex);
@@ -397,7 +399,52 @@ int KRR_gputil_load_cubemap(const char* right, const char* left, const char* top
   ctemptex = NULL;
 
   // unbind cubemap texture
-  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+  KRR_GLSTATE_bind_texture(GL_TEXTURE_CUBE_MAP, 0);
 
   return textureID;
 }
+
+GLenum KRR_gputil_index_type_for(int vertices_count)
+{
+  return vertices_count < 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+int KRR_gputil_index_size(GLenum type)
+{
+  switch (type)
+  {
+    case GL_UNSIGNED_BYTE:
+      return sizeof(GLubyte);
+    case GL_UNSIGNED_SHORT:
+      return sizeof(GLushort);
+    default:
+      return sizeof(GLuint);
+  }
+}
+
+void KRR_gputil_narrow_indices(void* indices, int count, GLenum type)
+{
+  // destination element is never larger than source, so writing i-th element
+  // never overwrites source elements not yet read
+  // memcpy() is used as both types alias the same memory
+  unsigned char* p = indices;
+  if (type == GL_UNSIGNED_SHORT)
+  {
+    for (int i=0; i<count; ++i)
+    {
+      GLuint v;
+      memcpy(&v, p + i*sizeof(GLuint), sizeof(v));
+      GLushort n = (GLushort)v;
+      memcpy(p + i*sizeof(GLushort), &n, sizeof(n));
+    }
+  }
+  else if (type == GL_UNSIGNED_BYTE)
+  {
+    for (int i=0; i<count; ++i)
+    {
+      GLuint v;
+      memcpy(&v, p + i*sizeof(GLuint), sizeof(v));
+      p[i] = (GLubyte)v;
+    }
+  }
+}